@@ -34,6 +34,7 @@
 #include <common/common.h>
 #include <common/consumer/consumer.h>
 #include <common/consumer/consumer-timer.h>
+#include <common/consumer/consumer-affinity.h>
 #include <common/compat/poll.h>
 #include <common/compat/getenv.h>
 #include <common/sessiond-comm/sessiond-comm.h>
@@ -44,8 +45,9 @@
 
 /* threads (channel handling, poll, metadata, sessiond) */
 
-static pthread_t channel_thread, data_thread, metadata_thread,
+static pthread_t channel_thread, metadata_thread,
 		sessiond_thread, metadata_timer_thread, health_thread;
+static pthread_t *data_threads;
 static bool metadata_timer_thread_online;
 
 /* to count the number of times the user pressed ctrl+c */
@@ -61,6 +63,14 @@ static const char *progname;
 static char command_sock_path[PATH_MAX]; /* Global command socket path */
 static char error_sock_path[PATH_MAX]; /* Global error path */
 static enum lttng_consumer_type opt_type = LTTNG_CONSUMER_KERNEL;
+static unsigned int opt_data_threads;
+static enum consumer_data_thread_affinity opt_data_thread_affinity;
+static bool opt_data_thread_affinity_set;
+static bool opt_relayd_zerocopy;
+static enum lttng_compression_algorithm opt_relayd_compression;
+static bool opt_relayd_compression_set;
+static uint64_t opt_trace_file_preallocation;
+static bool opt_trace_file_preallocation_set;
 
 /* the liblttngconsumerd context */
 static struct lttng_consumer_local_data *ctx;
@@ -165,6 +175,101 @@ static void usage(FILE *fp)
 			" (support not compiled in)"
 #endif
 			);
+	fprintf(fp, "      --data-threads COUNT           "
+			"Consume the data streams with COUNT threads. (default: %d)\n",
+			DEFAULT_CONSUMERD_DATA_THREADS);
+	fprintf(fp, "      --data-thread-affinity MODE    "
+			"Pin the data threads to the CPUs (cpu) or NUMA nodes (node)\n"
+			"                                     "
+			"of the buffers they consume. (default: none)\n");
+	fprintf(fp, "      --relayd-zerocopy              "
+			"Send the large data packets to the relay daemons\n"
+			"                                     "
+			"with MSG_ZEROCOPY.\n");
+	fprintf(fp, "      --relayd-compression ALGO      "
+			"Compress the data packets sent to the relay daemons\n"
+			"                                     "
+			"with ALGO (none, lz4 or zstd). (default: none)\n");
+	fprintf(fp, "      --trace-file-preallocation SIZE\n"
+			"                                     "
+			"Allocate the storage of the trace files in steps\n"
+			"                                     "
+			"of SIZE bytes. (default: 0, disabled)\n");
+}
+
+static int parse_data_thread_affinity(const char *str)
+{
+	int ret;
+
+	ret = consumer_data_thread_affinity_from_string(str,
+			&opt_data_thread_affinity);
+	if (ret) {
+		ERR("Invalid data thread affinity \"%s\": expecting none, cpu or node",
+				str);
+		goto end;
+	}
+	opt_data_thread_affinity_set = true;
+end:
+	return ret;
+}
+
+static int parse_relayd_compression(const char *str)
+{
+	int ret;
+
+	ret = lttng_compression_algorithm_from_string(str,
+			&opt_relayd_compression);
+	if (ret) {
+		ERR("Invalid relay daemon compression \"%s\": expecting none, lz4 or zstd",
+				str);
+		goto end;
+	}
+	if (!lttng_compression_algorithm_is_supported(opt_relayd_compression)) {
+		WARN("%s compression is not supported by this build, sending the data uncompressed",
+				str);
+		opt_relayd_compression = LTTNG_COMPRESSION_ALGORITHM_NONE;
+	}
+	opt_relayd_compression_set = true;
+end:
+	return ret;
+}
+
+static int parse_trace_file_preallocation(const char *str)
+{
+	int ret;
+
+	ret = utils_parse_size_suffix(str, &opt_trace_file_preallocation);
+	if (ret) {
+		ERR("Invalid trace file preallocation size \"%s\"", str);
+		ret = -1;
+		goto end;
+	}
+	opt_trace_file_preallocation_set = true;
+end:
+	return ret;
+}
+
+/*
+ * Parse a number of data threads. Returns 0 on success, -1 on error.
+ */
+static int parse_data_threads(const char *str, unsigned int *count)
+{
+	int ret = 0;
+	char *end;
+	unsigned long value;
+
+	errno = 0;
+	value = strtoul(str, &end, 10);
+	if (errno != 0 || end == str || *end != '\0' || value == 0 ||
+			value > DEFAULT_CONSUMERD_MAX_DATA_THREADS) {
+		ERR("Invalid number of data threads \"%s\": expecting a value between 1 and %d",
+				str, DEFAULT_CONSUMERD_MAX_DATA_THREADS);
+		ret = -1;
+		goto end;
+	}
+	*count = value;
+end:
+	return ret;
 }
 
 /*
@@ -187,6 +292,11 @@ static int parse_args(int argc, char **argv)
 #ifdef HAVE_LIBLTTNG_UST_CTL
 		{ "ust", 0, 0, 'u' },
 #endif
+		{ "data-threads", 1, 0, 0 },
+		{ "data-thread-affinity", 1, 0, 0 },
+		{ "relayd-zerocopy", 0, 0, 0 },
+		{ "relayd-compression", 1, 0, 0 },
+		{ "trace-file-preallocation", 1, 0, 0 },
 		{ NULL, 0, 0, 0 }
 	};
 
@@ -200,6 +310,39 @@ static int parse_args(int argc, char **argv)
 
 		switch (c) {
 		case 0:
+			if (!strcmp(long_options[option_index].name,
+					"data-threads")) {
+				if (parse_data_threads(optarg, &opt_data_threads)) {
+					ret = -1;
+					goto end;
+				}
+				break;
+			} else if (!strcmp(long_options[option_index].name,
+					"data-thread-affinity")) {
+				if (parse_data_thread_affinity(optarg)) {
+					ret = -1;
+					goto end;
+				}
+				break;
+			} else if (!strcmp(long_options[option_index].name,
+					"relayd-zerocopy")) {
+				opt_relayd_zerocopy = true;
+				break;
+			} else if (!strcmp(long_options[option_index].name,
+					"relayd-compression")) {
+				if (parse_relayd_compression(optarg)) {
+					ret = -1;
+					goto end;
+				}
+				break;
+			} else if (!strcmp(long_options[option_index].name,
+					"trace-file-preallocation")) {
+				if (parse_trace_file_preallocation(optarg)) {
+					ret = -1;
+					goto end;
+				}
+				break;
+			}
 			fprintf(stderr, "option %s",
 				long_options[option_index].name);
 			if (optarg) {
@@ -296,6 +439,7 @@ static void set_ulimit(void)
 int main(int argc, char **argv)
 {
 	int ret = 0, retval = 0;
+	unsigned int data_thread_count = 0, data_thread_index;
 	void *status;
 	struct lttng_consumer_local_data *tmp_ctx;
 
@@ -317,6 +461,52 @@ int main(int argc, char **argv)
 		goto exit_options;
 	}
 
+	/* The command-line option overrides the environment variable. */
+	if (!opt_data_threads) {
+		const char *env_value = lttng_secure_getenv(
+				DEFAULT_CONSUMERD_DATA_THREADS_ENV);
+
+		opt_data_threads = DEFAULT_CONSUMERD_DATA_THREADS;
+		if (env_value && parse_data_threads(env_value,
+				&opt_data_threads)) {
+			retval = -1;
+			goto exit_options;
+		}
+	}
+	if (!opt_data_thread_affinity_set) {
+		const char *env_value = lttng_secure_getenv(
+				DEFAULT_CONSUMERD_DATA_THREAD_AFFINITY_ENV);
+
+		if (env_value && parse_data_thread_affinity(env_value)) {
+			retval = -1;
+			goto exit_options;
+		}
+	}
+	if (!opt_relayd_zerocopy) {
+		const char *env_value = lttng_secure_getenv(
+				DEFAULT_CONSUMERD_RELAYD_ZEROCOPY_ENV);
+
+		opt_relayd_zerocopy = env_value && !strcmp(env_value, "1");
+	}
+	if (!opt_relayd_compression_set) {
+		const char *env_value = lttng_secure_getenv(
+				DEFAULT_CONSUMERD_RELAYD_COMPRESSION_ENV);
+
+		if (env_value && parse_relayd_compression(env_value)) {
+			retval = -1;
+			goto exit_options;
+		}
+	}
+	if (!opt_trace_file_preallocation_set) {
+		const char *env_value = lttng_secure_getenv(
+				DEFAULT_CONSUMERD_TRACE_FILE_PREALLOCATION_ENV);
+
+		if (env_value && parse_trace_file_preallocation(env_value)) {
+			retval = -1;
+			goto exit_options;
+		}
+	}
+
 	/* Daemonize */
 	if (opt_daemon) {
 		int i;
@@ -407,13 +597,24 @@ int main(int argc, char **argv)
 
 	/* create the consumer instance with and assign the callbacks */
 	ctx = lttng_consumer_create(opt_type, lttng_consumer_read_subbuffer,
-		NULL, lttng_consumer_on_recv_stream, NULL);
+		NULL, lttng_consumer_on_recv_stream, NULL, opt_data_threads);
 	if (!ctx) {
 		retval = -1;
 		goto exit_init_data;
 	}
 
 	lttng_consumer_set_command_sock_path(ctx, command_sock_path);
+	ctx->relayd_zerocopy = opt_relayd_zerocopy;
+	ctx->relayd_compression = opt_relayd_compression;
+	consumer_data.trace_file_preallocation_size =
+			opt_trace_file_preallocation;
+
+	ret = consumer_affinity_configure(ctx, opt_data_thread_affinity);
+	if (ret) {
+		ERR("Failed to configure the affinity of the data threads");
+		retval = -1;
+		goto exit_init_data;
+	}
 	if (*error_sock_path == '\0') {
 		switch (opt_type) {
 		case LTTNG_CONSUMER_KERNEL:
@@ -533,15 +734,26 @@ int main(int argc, char **argv)
 		goto exit_metadata_thread;
 	}
 
-	/* Create thread to manage the polling/writing of trace data */
-	ret = pthread_create(&data_thread, default_pthread_attr(),
-			consumer_thread_data_poll, (void *) ctx);
-	if (ret) {
-		errno = ret;
-		PERROR("pthread_create");
+	/* Create threads to manage the polling/writing of trace data */
+	data_threads = zmalloc(sizeof(*data_threads) * ctx->data_thread_count);
+	if (!data_threads) {
+		PERROR("zmalloc data threads");
 		retval = -1;
 		goto exit_data_thread;
 	}
+	for (; data_thread_count < ctx->data_thread_count;
+			data_thread_count++) {
+		ret = pthread_create(&data_threads[data_thread_count],
+				default_pthread_attr(), consumer_thread_data_poll,
+				(void *) &ctx->data_threads[data_thread_count]);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_create");
+			retval = -1;
+			goto exit_data_thread;
+		}
+	}
+	DBG("Launched %u data threads", data_thread_count);
 
 	/* Create the thread to manage the reception of fds */
 	ret = pthread_create(&sessiond_thread, default_pthread_attr(),
@@ -568,13 +780,17 @@ int main(int argc, char **argv)
 	}
 exit_sessiond_thread:
 
-	ret = pthread_join(data_thread, &status);
-	if (ret) {
-		errno = ret;
-		PERROR("pthread_join data_thread");
-		retval = -1;
-	}
 exit_data_thread:
+	for (data_thread_index = 0; data_thread_index < data_thread_count;
+			data_thread_index++) {
+		ret = pthread_join(data_threads[data_thread_index], &status);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_join data_thread");
+			retval = -1;
+		}
+	}
+	free(data_threads);
 
 	ret = pthread_join(metadata_thread, &status);
 	if (ret) {
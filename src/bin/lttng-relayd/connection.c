@@ -9,9 +9,12 @@
 
 #define _LGPL_SOURCE
 #include <common/common.h>
+#include <common/fd-tracker/utils.h>
 #include <urcu/rculist.h>
+#include <fcntl.h>
 
 #include "connection.h"
+#include "lttng-relayd.h"
 #include "stream.h"
 #include "viewer-session.h"
 
@@ -101,6 +104,13 @@ struct relay_connection *connection_create(struct lttcomm_sock *sock,
 	lttng_ht_node_init_ulong(&conn->sock_n, (unsigned long) conn->sock->fd);
 	if (conn->type == RELAY_CONTROL) {
 		lttng_dynamic_buffer_init(&conn->protocol.ctrl.reception_buffer);
+	} else if (conn->type == RELAY_DATA) {
+		conn->protocol.data.splice_pipe[0] = -1;
+		conn->protocol.data.splice_pipe[1] = -1;
+		lttng_dynamic_buffer_init(
+				&conn->protocol.data.compressed_payload);
+		lttng_dynamic_buffer_init(
+				&conn->protocol.data.decompressed_payload);
 	}
 	connection_reset_protocol_state(conn);
 end:
@@ -120,6 +130,14 @@ static void rcu_free_connection(struct rcu_head *head)
 	if (conn->type == RELAY_CONTROL) {
 		lttng_dynamic_buffer_reset(
 				&conn->protocol.ctrl.reception_buffer);
+	} else if (conn->type == RELAY_DATA) {
+		free(conn->protocol.data.batch_buffer.data);
+		lttng_dynamic_buffer_reset(
+				&conn->protocol.data.compressed_payload);
+		lttng_dynamic_buffer_reset(
+				&conn->protocol.data.decompressed_payload);
+		lttng_compression_context_destroy(
+				conn->protocol.data.decompression_context);
 	}
 	free(conn);
 }
@@ -152,6 +170,19 @@ static void connection_release(struct urcu_ref *ref)
 	if (conn->viewer_session) {
 		viewer_session_close(conn->viewer_session);
 	}
+	if (conn->type == RELAY_DATA) {
+		const struct data_connection_stats *stats =
+				&conn->protocol.data.stats;
+
+		DBG("Data connection socket %d received %" PRIu64 " packets using %" PRIu64 " receive and %" PRIu64 " write calls (%.2f calls per packet)",
+				conn->sock->fd, stats->packets,
+				stats->recv_calls, stats->write_calls,
+				stats->packets ?
+					(double) (stats->recv_calls + stats->write_calls) /
+							stats->packets :
+					0.0);
+		connection_disable_splice(conn);
+	}
 	destroy_connection(conn);
 }
 
@@ -194,3 +225,110 @@ int connection_set_session(struct relay_connection *conn,
 	}
 	return ret;
 }
+
+/*
+ * Receive the payloads of a data connection by splicing them from its
+ * socket to the streams' files.
+ *
+ * The connection's socket is set in non-blocking mode since splice(2) does
+ * not provide an equivalent to MSG_DONTWAIT for its input.
+ */
+int connection_enable_splice(struct relay_connection *conn)
+{
+	int ret, flags;
+
+	assert(conn->type == RELAY_DATA);
+	assert(!connection_uses_splice(conn));
+
+	flags = fcntl(conn->sock->fd, F_GETFL);
+	if (flags < 0) {
+		PERROR("Failed to get flags of data connection socket %d",
+				conn->sock->fd);
+		ret = -1;
+		goto end;
+	}
+	ret = fcntl(conn->sock->fd, F_SETFL, flags | O_NONBLOCK);
+	if (ret < 0) {
+		PERROR("Failed to set data connection socket %d in non-blocking mode",
+				conn->sock->fd);
+		goto end;
+	}
+
+	ret = fd_tracker_util_pipe_open_cloexec(the_fd_tracker,
+			"Data connection splice pipe",
+			conn->protocol.data.splice_pipe);
+	if (ret) {
+		ERR("Failed to create splice pipe of data connection socket %d",
+				conn->sock->fd);
+		goto end;
+	}
+
+	/*
+	 * Best effort: a larger pipe allows more data to be moved by each
+	 * splice(2) call.
+	 */
+	if (fcntl(conn->protocol.data.splice_pipe[1], F_SETPIPE_SZ,
+			DEFAULT_RELAYD_SPLICE_PIPE_SIZE) < 0) {
+		DBG("Failed to set splice pipe size of data connection socket %d to %d bytes",
+				conn->sock->fd, DEFAULT_RELAYD_SPLICE_PIPE_SIZE);
+	}
+end:
+	return ret;
+}
+
+/*
+ * Revert a data connection to the reception of its payloads by copy.
+ *
+ * The splice pipe must be empty.
+ */
+void connection_disable_splice(struct relay_connection *conn)
+{
+	assert(conn->type == RELAY_DATA);
+
+	if (!connection_uses_splice(conn)) {
+		return;
+	}
+
+	(void) fd_tracker_util_pipe_close(the_fd_tracker,
+			conn->protocol.data.splice_pipe);
+}
+
+bool connection_uses_splice(const struct relay_connection *conn)
+{
+	return conn->type == RELAY_DATA &&
+			conn->protocol.data.splice_pipe[0] >= 0;
+}
+
+/*
+ * Receive as much data as is available on the connection's socket in a
+ * buffer of `buffer_size` bytes on every pass, which allows multiple
+ * packets to be processed for each receive call.
+ */
+int connection_enable_batch_reception(struct relay_connection *conn,
+		size_t buffer_size)
+{
+	int ret = 0;
+	struct data_connection_batch_buffer *buffer =
+			&conn->protocol.data.batch_buffer;
+
+	assert(conn->type == RELAY_DATA);
+	assert(!connection_uses_batch_reception(conn));
+	assert(buffer_size >= sizeof(struct lttcomm_relayd_data_hdr));
+
+	buffer->data = zmalloc(buffer_size);
+	if (!buffer->data) {
+		PERROR("Failed to allocate reception buffer of data connection socket %d",
+				conn->sock->fd);
+		ret = -1;
+		goto end;
+	}
+	buffer->capacity = buffer_size;
+end:
+	return ret;
+}
+
+bool connection_uses_batch_reception(const struct relay_connection *conn)
+{
+	return conn->type == RELAY_DATA &&
+			conn->protocol.data.batch_buffer.data;
+}
@@ -21,6 +21,7 @@
 #include <common/sessiond-comm/sessiond-comm.h>
 #include <common/sessiond-comm/relayd.h>
 #include <common/dynamic-buffer.h>
+#include <common/compression.h>
 
 #include "session.h"
 
@@ -53,6 +54,43 @@ struct data_connection_state_receive_payload {
 	bool rotate_index;
 };
 
+/*
+ * Buffer in which a data connection receives as much data as is available
+ * on its socket. Its contents are entirely processed after every receive
+ * call.
+ */
+struct data_connection_batch_buffer {
+	char *data;
+	size_t capacity;
+};
+
+/*
+ * Number of system calls issued to receive the packets of a data
+ * connection. The relay daemon has no statistics interface: the counts are
+ * only logged at the debug level when the connection is released.
+ */
+struct data_connection_stats {
+	uint64_t packets;
+	uint64_t recv_calls;
+	uint64_t write_calls;
+};
+
+/*
+ * LTTNG_VIEWER_WAIT_NEW_DATA request held by the live worker owning a viewer
+ * connection until new data is available or the request times out.
+ */
+struct viewer_connection_wait {
+	bool pending;
+	/* Reference held while the request is pending. */
+	struct relay_session *session;
+	/* Value of the session's viewer_new_data_seq when the request began. */
+	unsigned long new_data_seq;
+	/* CLOCK_MONOTONIC time at which the request times out. */
+	uint64_t deadline_ns;
+	/* Member of the live worker's waiting list. */
+	struct cds_list_head node;
+};
+
 struct ctrl_connection_state_receive_header {
 	uint64_t received, left_to_receive;
 };
@@ -71,7 +109,8 @@ struct ctrl_connection_state_receive_payload {
  * from the live worker thread.
  *
  * The connections between the consumerd/sessiond and the relayd are only
- * handled by the "main" worker thread (as in, the worker thread in main.c).
+ * handled by the "main" worker thread (as in, the worker thread in main.c)
+ * to which they were dispatched.
  *
  * This is why there are no back references to connections from the
  * sessions and session list.
@@ -97,6 +136,10 @@ struct relay_connection {
 	 */
 	uint32_t major;
 	uint32_t minor;
+	/*
+	 * enum lttng_viewer_capability negotiated by a viewer connection.
+	 */
+	uint32_t viewer_capabilities;
 
 	struct urcu_ref ref;
 
@@ -117,6 +160,26 @@ struct relay_connection {
 				struct data_connection_state_receive_header receive_header;
 				struct data_connection_state_receive_payload receive_payload;
 			} state;
+			/*
+			 * Pipe through which the payloads are spliced from the
+			 * socket to the streams' files. Set to -1 when the
+			 * payloads are received by copy.
+			 */
+			int splice_pipe[2];
+			/*
+			 * Set when several headers and payloads are received
+			 * in each pass (NULL data otherwise).
+			 */
+			struct data_connection_batch_buffer batch_buffer;
+			/*
+			 * Payload of the compressed packet being received and
+			 * its decompressed content.
+			 */
+			struct lttng_dynamic_buffer compressed_payload;
+			struct lttng_dynamic_buffer decompressed_payload;
+			/* Created on reception of the first compressed packet. */
+			struct lttng_compression_context *decompression_context;
+			struct data_connection_stats stats;
 		} data;
 		struct {
 			enum ctrl_connection_state state_id;
@@ -126,6 +189,9 @@ struct relay_connection {
 			} state;
 			struct lttng_dynamic_buffer reception_buffer;
 		} ctrl;
+		struct {
+			struct viewer_connection_wait wait;
+		} viewer;
 	} protocol;
 };
 
@@ -140,5 +206,11 @@ void connection_ht_add(struct lttng_ht *relay_connections_ht,
 		struct relay_connection *conn);
 int connection_set_session(struct relay_connection *conn,
 		struct relay_session *session);
+int connection_enable_splice(struct relay_connection *conn);
+void connection_disable_splice(struct relay_connection *conn);
+bool connection_uses_splice(const struct relay_connection *conn);
+int connection_enable_batch_reception(struct relay_connection *conn,
+		size_t buffer_size);
+bool connection_uses_batch_reception(const struct relay_connection *conn);
 
 #endif /* _CONNECTION_H */
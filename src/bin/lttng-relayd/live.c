@@ -13,6 +13,7 @@
 #include <grp.h>
 #include <inttypes.h>
 #include <limits.h>
+#include <poll.h>
 #include <pthread.h>
 #include <signal.h>
 #include <stdio.h>
@@ -32,6 +33,7 @@
 
 #include <common/common.h>
 #include <common/compat/endian.h>
+#include <common/compat/fcntl.h>
 #include <common/compat/poll.h>
 #include <common/compat/socket.h>
 #include <common/defaults.h>
@@ -52,29 +54,67 @@
 #include "health-relayd.h"
 #include "live.h"
 #include "lttng-relayd.h"
+#include "packet-cache.h"
 #include "session.h"
 #include "stream.h"
 #include "testpoint.h"
 #include "utils.h"
 #include "viewer-session.h"
 #include "viewer-stream.h"
+#include "worker-pool.h"
 
 #define SESSION_BUF_DEFAULT_COUNT	16
+/*
+ * Size of the buffer through which the packet data is copied when it cannot
+ * be sent with sendfile().
+ */
+#define PACKET_COPY_CHUNK_SIZE		(64 * 1024)
+/*
+ * Time a viewer may leave its socket's send buffer full while packet data is
+ * sent to it before its connection is considered broken.
+ */
+#define PACKET_SEND_TIMEOUT_MS		10000
 
 static struct lttng_uri *live_uri;
 
 /*
- * This pipe is used to inform the worker thread that a command is queued and
- * ready to be processed.
+ * Worker thread servicing a subset of the viewer connections.
+ *
+ * A viewer connection is handed to a single worker by the dispatcher and
+ * remains owned by that worker for its whole lifetime. Since a session can
+ * only be attached to a single viewer, the viewer streams of a session are
+ * only ever accessed by the worker owning the connection of its viewer.
  */
-static int live_conn_pipe[2] = { -1, -1 };
+struct live_worker {
+	/* Must be the first member, see relay_worker_pool_create(). */
+	struct relay_worker base;
+	/*
+	 * Written to by the threads receiving the trace data to wake up the
+	 * worker when a viewer waiting for new data may be answered. See
+	 * session_notify_live_viewer().
+	 */
+	int wake_pipe[2];
+	/*
+	 * Connections holding a LTTNG_VIEWER_WAIT_NEW_DATA request, only
+	 * accessed by the worker.
+	 */
+	struct cds_list_head waiting_connections;
+};
+
+static struct relay_worker_pool live_worker_pool;
+
+static
+struct live_worker *live_worker_get(unsigned int i)
+{
+	return caa_container_of(live_worker_pool.workers[i],
+			struct live_worker, base);
+}
 
 /* Shared between threads */
 static int live_dispatch_thread_exit;
 
 static pthread_t live_listener_thread;
 static pthread_t live_dispatcher_thread;
-static pthread_t live_worker_thread;
 
 /*
  * Relay command queue.
@@ -94,8 +134,19 @@ static pthread_mutex_t last_relay_viewer_session_id_lock =
 static
 void cleanup_relayd_live(void)
 {
+	unsigned int i;
+
 	DBG("Cleaning up");
 
+	for (i = 0; i < live_worker_pool.worker_count; i++) {
+		struct live_worker *worker = live_worker_get(i);
+
+		if (worker->wake_pipe[0] >= 0) {
+			(void) fd_tracker_util_pipe_close(the_fd_tracker,
+					worker->wake_pipe);
+		}
+	}
+	relay_worker_pool_destroy(&live_worker_pool);
 	free(live_uri);
 }
 
@@ -856,18 +907,9 @@ void *thread_dispatcher(void *data)
 				break;
 			}
 			conn = caa_container_of(node, struct relay_connection, qnode);
-			DBG("Dispatching viewer request waiting on sock %d",
-					conn->sock->fd);
-
-			/*
-			 * Inform worker thread of the new request. This
-			 * call is blocking so we can be assured that
-			 * the data will be read at some point in time
-			 * or wait to the end of the world :)
-			 */
-			ret = lttng_write(live_conn_pipe[1], &conn, sizeof(conn));
+			ret = relay_worker_pool_dispatch(&live_worker_pool,
+					conn);
 			if (ret < 0) {
-				PERROR("write conn pipe");
 				connection_put(conn);
 				goto error;
 			}
@@ -950,6 +992,15 @@ int viewer_connect(struct relay_connection *conn)
 		goto end;
 	}
 
+	/* Only the viewers asking for them get the additional commands. */
+	msg.viewer_session_id = be64toh(msg.viewer_session_id);
+	if ((msg.viewer_session_id >> 32) == LTTNG_VIEWER_CAPABILITIES_MAGIC) {
+		conn->viewer_capabilities = msg.viewer_session_id &
+				(LTTNG_VIEWER_CAPABILITY_WAIT_NEW_DATA |
+				LTTNG_VIEWER_CAPABILITY_BATCH);
+	}
+	reply.type = htobe32(conn->viewer_capabilities);
+
 	reply.major = htobe32(reply.major);
 	reply.minor = htobe32(reply.minor);
 	if (conn->type == RELAY_VIEWER_COMMAND) {
@@ -973,7 +1024,8 @@ int viewer_connect(struct relay_connection *conn)
 
 	health_code_update();
 
-	DBG("Version check done using protocol %u.%u", conn->major, conn->minor);
+	DBG("Version check done using protocol %u.%u, capabilities = %#x",
+			conn->major, conn->minor, conn->viewer_capabilities);
 	ret = 0;
 
 end:
@@ -1529,15 +1581,16 @@ index_ready:
 }
 
 /*
- * Send the next index for a stream.
+ * Get the next index of a viewer stream, ready to be sent to the viewer.
  *
- * Return 0 on success or else a negative value.
+ * Return 0 on success (`viewer_index` may then hold an error status) or else
+ * a negative value.
  */
 static
-int viewer_get_next_index(struct relay_connection *conn)
+int get_stream_next_index(struct relay_connection *conn, uint64_t stream_id,
+		struct lttng_viewer_index *out_index)
 {
-	int ret;
-	struct lttng_viewer_get_next_index request_index;
+	int ret = 0;
 	struct lttng_viewer_index viewer_index;
 	struct ctf_packet_index packet_index;
 	struct relay_viewer_stream *vstream = NULL;
@@ -1547,21 +1600,12 @@ int viewer_get_next_index(struct relay_connection *conn)
 
 	assert(conn);
 
-	DBG("Viewer get next index");
-
 	memset(&viewer_index, 0, sizeof(viewer_index));
-	health_code_update();
 
-	ret = recv_request(conn->sock, &request_index, sizeof(request_index));
-	if (ret < 0) {
-		goto end;
-	}
-	health_code_update();
-
-	vstream = viewer_stream_get_by_id(be64toh(request_index.stream_id));
+	vstream = viewer_stream_get_by_id(stream_id);
 	if (!vstream) {
 		DBG("Client requested index of unknown stream id %" PRIu64,
-				(uint64_t) be64toh(request_index.stream_id));
+				stream_id);
 		viewer_index.status = htobe32(LTTNG_VIEWER_INDEX_ERR);
 		goto send_reply;
 	}
@@ -1747,20 +1791,9 @@ send_reply:
 	}
 
 	viewer_index.flags = htobe32(viewer_index.flags);
-	health_code_update();
-
-	ret = send_response(conn->sock, &viewer_index, sizeof(viewer_index));
-	if (ret < 0) {
-		goto end;
-	}
-	health_code_update();
+	*out_index = viewer_index;
+	ret = 0;
 
-	if (vstream) {
-		DBG("Index %" PRIu64 " for stream %" PRIu64 " sent",
-				vstream->index_sent_seqcount,
-				vstream->stream->stream_handle);
-	}
-end:
 	if (metadata_viewer_stream) {
 		viewer_stream_put(metadata_viewer_stream);
 	}
@@ -1779,138 +1812,121 @@ error_put:
 }
 
 /*
- * Send the next index for a stream
+ * Send the next index for a stream.
  *
  * Return 0 on success or else a negative value.
  */
 static
-int viewer_get_packet(struct relay_connection *conn)
+int viewer_get_next_index(struct relay_connection *conn)
 {
 	int ret;
-	off_t lseek_ret;
-	char *reply = NULL;
-	struct lttng_viewer_get_packet get_packet_info;
-	struct lttng_viewer_trace_packet reply_header;
-	struct relay_viewer_stream *vstream = NULL;
-	uint32_t reply_size = sizeof(reply_header);
-	uint32_t packet_data_len = 0;
-	ssize_t read_len;
 	uint64_t stream_id;
+	struct lttng_viewer_get_next_index request_index;
+	struct lttng_viewer_index viewer_index;
 
-	DBG2("Relay get data packet");
+	DBG("Viewer get next index");
 
 	health_code_update();
 
-	ret = recv_request(conn->sock, &get_packet_info,
-			sizeof(get_packet_info));
+	ret = recv_request(conn->sock, &request_index, sizeof(request_index));
 	if (ret < 0) {
 		goto end;
 	}
 	health_code_update();
 
-	/* From this point on, the error label can be reached. */
-	memset(&reply_header, 0, sizeof(reply_header));
-	stream_id = (uint64_t) be64toh(get_packet_info.stream_id);
-
-	vstream = viewer_stream_get_by_id(stream_id);
-	if (!vstream) {
-		DBG("Client requested packet of unknown stream id %" PRIu64,
-				stream_id);
-		reply_header.status = htobe32(LTTNG_VIEWER_GET_PACKET_ERR);
-		goto send_reply_nolock;
-	} else {
-		packet_data_len = be32toh(get_packet_info.len);
-		reply_size += packet_data_len;
-	}
-
-	reply = zmalloc(reply_size);
-	if (!reply) {
-		PERROR("packet reply zmalloc");
-		reply_size = sizeof(reply_header);
-		goto error;
+	stream_id = be64toh(request_index.stream_id);
+	ret = get_stream_next_index(conn, stream_id, &viewer_index);
+	if (ret < 0) {
+		goto end;
 	}
+	health_code_update();
 
-	pthread_mutex_lock(&vstream->stream->lock);
-	lseek_ret = fs_handle_seek(vstream->stream_file.handle,
-			be64toh(get_packet_info.offset), SEEK_SET);
-	if (lseek_ret < 0) {
-		PERROR("Failed to seek file system handle of viewer stream %" PRIu64
-		       " to offset %" PRIu64,
-				stream_id,
-				(uint64_t) be64toh(get_packet_info.offset));
-		goto error;
-	}
-	read_len = fs_handle_read(vstream->stream_file.handle,
-			reply + sizeof(reply_header), packet_data_len);
-	if (read_len < packet_data_len) {
-		PERROR("Failed to read from file system handle of viewer stream id %" PRIu64
-		       ", offset: %" PRIu64,
-				stream_id,
-				(uint64_t) be64toh(get_packet_info.offset));
-		goto error;
+	ret = send_response(conn->sock, &viewer_index, sizeof(viewer_index));
+	if (ret < 0) {
+		goto end;
 	}
-	reply_header.status = htobe32(LTTNG_VIEWER_GET_PACKET_OK);
-	reply_header.len = htobe32(packet_data_len);
-	goto send_reply;
+	health_code_update();
 
-error:
-	reply_header.status = htobe32(LTTNG_VIEWER_GET_PACKET_ERR);
+	DBG("Index for stream %" PRIu64 " sent", stream_id);
+end:
+	return ret;
+}
 
-send_reply:
-	if (vstream) {
-		pthread_mutex_unlock(&vstream->stream->lock);
-	}
-send_reply_nolock:
+/*
+ * Append the IDs of the data streams of a session to `stream_ids`.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static
+int get_session_data_stream_ids(struct relay_session *session,
+		struct lttng_dynamic_buffer *stream_ids)
+{
+	int ret = 0;
+	struct lttng_ht_iter iter;
+	struct relay_viewer_stream *vstream;
 
-	health_code_update();
+	rcu_read_lock();
+	cds_lfht_for_each_entry(viewer_streams_ht->ht, &iter.iter, vstream,
+			stream_n.node) {
+		uint64_t stream_id;
+		bool session_data_stream;
 
-	if (reply) {
-		memcpy(reply, &reply_header, sizeof(reply_header));
-		ret = send_response(conn->sock, reply, reply_size);
-	} else {
-		/* No reply to send. */
-		ret = send_response(conn->sock, &reply_header,
-				reply_size);
-	}
+		health_code_update();
 
-	health_code_update();
-	if (ret < 0) {
-		PERROR("sendmsg of packet data failed");
-		goto end_free;
-	}
+		if (!viewer_stream_get(vstream)) {
+			continue;
+		}
+		stream_id = vstream->stream->stream_handle;
+		session_data_stream = vstream->stream->trace->session == session &&
+				!vstream->stream->is_metadata;
+		viewer_stream_put(vstream);
+		if (!session_data_stream) {
+			continue;
+		}
 
-	DBG("Sent %u bytes for stream %" PRIu64, reply_size, stream_id);
+		if (stream_ids->size / sizeof(stream_id) >=
+				LTTNG_VIEWER_BATCH_MAX_COUNT) {
+			ERR("Session %" PRIu64 " has more than %d viewer streams",
+					session->id,
+					LTTNG_VIEWER_BATCH_MAX_COUNT);
+			ret = -1;
+			break;
+		}
 
-end_free:
-	free(reply);
-end:
-	if (vstream) {
-		viewer_stream_put(vstream);
+		ret = lttng_dynamic_buffer_append(stream_ids, &stream_id,
+				sizeof(stream_id));
+		if (ret) {
+			ERR("Failed to append viewer stream id");
+			break;
+		}
 	}
+	rcu_read_unlock();
 	return ret;
 }
 
 /*
- * Send the session's metadata
+ * Send the next index of several streams of a session.
  *
- * Return 0 on success else a negative value.
+ * The indexes are sent in a single reply: the viewer reads the indexes of
+ * a session having hundreds of streams in a single round-trip.
+ *
+ * Return 0 on success or else a negative value.
  */
 static
-int viewer_get_metadata(struct relay_connection *conn)
+int viewer_get_next_indexes(struct relay_connection *conn)
 {
-	int ret = 0;
-	int fd = -1;
-	ssize_t read_len;
-	uint64_t len = 0;
-	char *data = NULL;
-	struct lttng_viewer_get_metadata request;
-	struct lttng_viewer_metadata_packet reply;
-	struct relay_viewer_stream *vstream = NULL;
-
-	assert(conn);
+	int ret;
+	uint32_t i, stream_count;
+	struct lttng_viewer_get_next_indexes_request request;
+	struct lttng_viewer_get_next_indexes_response response;
+	struct lttng_dynamic_buffer stream_ids, reply;
+	struct relay_session *session = NULL;
 
-	DBG("Relay get metadata");
+	DBG("Viewer get next indexes");
 
+	lttng_dynamic_buffer_init(&stream_ids);
+	lttng_dynamic_buffer_init(&reply);
+	memset(&response, 0, sizeof(response));
 	health_code_update();
 
 	ret = recv_request(conn->sock, &request, sizeof(request));
@@ -1919,90 +1935,580 @@ int viewer_get_metadata(struct relay_connection *conn)
 	}
 	health_code_update();
 
-	memset(&reply, 0, sizeof(reply));
-
-	vstream = viewer_stream_get_by_id(be64toh(request.stream_id));
-	if (!vstream) {
-		/*
-		 * The metadata stream can be closed by a CLOSE command
-		 * just before we attach. It can also be closed by
-		 * per-pid tracing during tracing. Therefore, it is
-		 * possible that we cannot find this viewer stream.
-		 * Reply back to the client with an error if we cannot
-		 * find it.
-		 */
-		DBG("Client requested metadata of unknown stream id %" PRIu64,
-				(uint64_t) be64toh(request.stream_id));
-		reply.status = htobe32(LTTNG_VIEWER_METADATA_ERR);
-		goto send_reply;
+	stream_count = be32toh(request.stream_count);
+	if (stream_count > LTTNG_VIEWER_BATCH_MAX_COUNT) {
+		ERR("Viewer requested the indexes of %" PRIu32 " streams, the maximum is %d",
+				stream_count, LTTNG_VIEWER_BATCH_MAX_COUNT);
+		ret = -1;
+		goto end;
 	}
-	pthread_mutex_lock(&vstream->stream->lock);
-	if (!vstream->stream->is_metadata) {
-		ERR("Invalid metadata stream");
-		goto error;
+
+	/* The stream IDs are received even if the request fails. */
+	ret = lttng_dynamic_buffer_set_size(&stream_ids,
+			stream_count * sizeof(uint64_t));
+	if (ret) {
+		ERR("Failed to allocate viewer stream id list");
+		goto end;
 	}
+	if (stream_count) {
+		ret = recv_request(conn->sock, stream_ids.data,
+				stream_ids.size);
+		if (ret < 0) {
+			goto end;
+		}
+		for (i = 0; i < stream_count; i++) {
+			uint64_t *stream_id = (uint64_t *) stream_ids.data + i;
 
-	if (vstream->metadata_sent >= vstream->stream->metadata_received) {
-		/*
-		 * The live viewers expect to receive a NO_NEW_METADATA
-		 * status before a stream disappears, otherwise they abort the
-		 * entire live connection when receiving an error status.
-		 *
-		 * Clear feature resets the metadata_sent to 0 until the
-		 * same metadata is received again.
-		 */
-		reply.status = htobe32(LTTNG_VIEWER_NO_NEW_METADATA);
-		/*
-		 * The live viewer considers a closed 0 byte metadata stream as
-		 * an error.
-		 */
-		if (vstream->metadata_sent > 0) {
-			vstream->stream->no_new_metadata_notified = true;
-			if (vstream->stream->closed) {
-				/* Release ownership for the viewer metadata stream. */
-				viewer_stream_put(vstream);
-			}
+			*stream_id = be64toh(*stream_id);
 		}
+	}
+	health_code_update();
+
+	session = session_get_by_id(be64toh(request.session_id));
+	if (!session) {
+		DBG("Relay session %" PRIu64 " not found",
+				(uint64_t) be64toh(request.session_id));
+		response.status = htobe32(LTTNG_VIEWER_GET_NEXT_INDEXES_ERR);
 		goto send_reply;
 	}
 
-	if (vstream->stream->trace_chunk &&
-			!lttng_trace_chunk_ids_equal(
-				conn->viewer_session->current_trace_chunk,
-				vstream->stream->trace_chunk)) {
-		/* A rotation has occurred on the relay stream. */
-		DBG("Metadata relay stream and viewer chunk ids differ");
+	if (viewer_session_is_attached(conn->viewer_session, session) != 1) {
+		DBG("Not attached to this session");
+		response.status = htobe32(LTTNG_VIEWER_GET_NEXT_INDEXES_ERR);
+		goto send_reply;
+	}
 
-		ret = viewer_session_set_trace_chunk_copy(
-				conn->viewer_session,
-				vstream->stream->trace_chunk);
+	if (!stream_count) {
+		ret = get_session_data_stream_ids(session, &stream_ids);
 		if (ret) {
-			reply.status = htobe32(LTTNG_VIEWER_METADATA_ERR);
+			response.status = htobe32(
+					LTTNG_VIEWER_GET_NEXT_INDEXES_ERR);
 			goto send_reply;
 		}
+		stream_count = stream_ids.size / sizeof(uint64_t);
 	}
 
-	if (conn->viewer_session->current_trace_chunk !=
-			vstream->stream_file.trace_chunk) {
-		bool acquired_reference;
+	ret = lttng_dynamic_buffer_set_size(&reply, sizeof(response) +
+			stream_count * sizeof(struct lttng_viewer_stream_index));
+	if (ret) {
+		ERR("Failed to allocate viewer indexes reply");
+		response.status = htobe32(LTTNG_VIEWER_GET_NEXT_INDEXES_ERR);
+		goto send_reply;
+	}
 
-		DBG("Viewer session and viewer stream chunk differ: "
-				"vsession chunk %p vstream chunk %p",
-				conn->viewer_session->current_trace_chunk,
-				vstream->stream_file.trace_chunk);
-		lttng_trace_chunk_put(vstream->stream_file.trace_chunk);
-		acquired_reference = lttng_trace_chunk_get(conn->viewer_session->current_trace_chunk);
-		assert(acquired_reference);
-		vstream->stream_file.trace_chunk =
-			conn->viewer_session->current_trace_chunk;
-		viewer_stream_close_files(vstream);
+	for (i = 0; i < stream_count; i++) {
+		const uint64_t stream_id = ((uint64_t *) stream_ids.data)[i];
+		struct lttng_viewer_stream_index stream_index;
+
+		health_code_update();
+
+		ret = get_stream_next_index(conn, stream_id,
+				&stream_index.index);
+		if (ret < 0) {
+			goto end;
+		}
+		stream_index.id = htobe64(stream_id);
+		memcpy(reply.data + sizeof(response) +
+				i * sizeof(stream_index),
+				&stream_index, sizeof(stream_index));
 	}
 
-	len = vstream->stream->metadata_received - vstream->metadata_sent;
+	response.status = htobe32(LTTNG_VIEWER_GET_NEXT_INDEXES_OK);
+	response.index_count = htobe32(stream_count);
 
-	/*
-	 * Either this is the first time the metadata file is read, or a
-	 * rotation of the corresponding relay stream has occured.
+send_reply:
+	health_code_update();
+	if (!reply.size) {
+		ret = send_response(conn->sock, &response, sizeof(response));
+	} else {
+		memcpy(reply.data, &response, sizeof(response));
+		ret = send_response(conn->sock, reply.data, reply.size);
+	}
+	if (ret < 0) {
+		goto end;
+	}
+	health_code_update();
+
+	DBG("Indexes of %" PRIu32 " streams sent", stream_count);
+	ret = 0;
+end:
+	if (session) {
+		session_put(session);
+	}
+	lttng_dynamic_buffer_reset(&stream_ids);
+	lttng_dynamic_buffer_reset(&reply);
+	return ret;
+}
+
+/*
+ * Wait for a viewer's socket to have room in its send buffer.
+ *
+ * Return 0 when the socket is writable or else a negative value, notably
+ * when the viewer did not consume any data for PACKET_SEND_TIMEOUT_MS.
+ */
+static
+int wait_viewer_socket_writable(int fd)
+{
+	int ret;
+	struct pollfd fds;
+
+	fds.fd = fd;
+	fds.events = POLLOUT;
+	fds.revents = 0;
+	do {
+		ret = poll(&fds, 1, PACKET_SEND_TIMEOUT_MS);
+	} while (ret < 0 && errno == EINTR);
+	if (ret < 0) {
+		PERROR("poll viewer socket %d", fd);
+		goto error;
+	} else if (ret == 0) {
+		ERR("Timed out waiting for viewer socket %d to be writable",
+				fd);
+		goto error;
+	} else if (!(fds.revents & POLLOUT)) {
+		/* Either hup or error */
+		ERR("Viewer socket %d closed while sending packet data", fd);
+		goto error;
+	}
+
+	return 0;
+error:
+	return -1;
+}
+
+/*
+ * Send `len` bytes of a trace file, starting at `offset`, on a viewer's
+ * socket.
+ *
+ * The data is moved from the page cache to the socket with sendfile(). It is
+ * copied through a bounded buffer when the file system or the platform does
+ * not support sendfile().
+ *
+ * Return 0 on success or else a negative value. On error, part of the data
+ * may have been sent: the connection must then be closed.
+ */
+static
+int send_packet_data(struct lttcomm_sock *sock, int fd, off_t offset,
+		size_t len)
+{
+	int ret = 0;
+	char *chunk = NULL;
+
+	while (len > 0) {
+		ssize_t sent;
+
+		sent = lttng_sendfile(sock->fd, fd, &offset, len);
+		if (sent < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN) {
+				/*
+				 * The send buffer is full: wait for the viewer
+				 * to consume data rather than spinning.
+				 */
+				ret = wait_viewer_socket_writable(sock->fd);
+				if (ret) {
+					goto end;
+				}
+				continue;
+			}
+			if (errno == EINVAL || errno == ENOSYS) {
+				DBG("sendfile() not supported on viewer socket %d, copying the packet data",
+						sock->fd);
+				break;
+			}
+			PERROR("Failed to send packet data to viewer");
+			ret = -1;
+			goto end;
+		} else if (sent == 0) {
+			ERR("Trace file ended before the requested packet data was sent");
+			ret = -1;
+			goto end;
+		}
+		/* sendfile() advances `offset`. */
+		len -= sent;
+	}
+
+	if (len > 0) {
+		chunk = zmalloc(PACKET_COPY_CHUNK_SIZE);
+		if (!chunk) {
+			PERROR("packet data chunk zmalloc");
+			ret = -1;
+			goto end;
+		}
+	}
+
+	while (len > 0) {
+		const size_t to_copy = min_t(size_t, len, PACKET_COPY_CHUNK_SIZE);
+		ssize_t read_len, sent;
+
+		read_len = pread(fd, chunk, to_copy, offset);
+		if (read_len < 0 && errno == EINTR) {
+			continue;
+		} else if (read_len <= 0) {
+			PERROR("Failed to read packet data from trace file");
+			ret = -1;
+			goto end;
+		}
+
+		sent = sock->ops->sendmsg(sock, chunk, read_len, 0);
+		if (sent != read_len) {
+			ERR("Failed to send packet data to viewer");
+			ret = -1;
+			goto end;
+		}
+		offset += read_len;
+		len -= read_len;
+	}
+end:
+	free(chunk);
+	return ret;
+}
+
+/*
+ * Send a packet of a stream, as requested by `get_packet_info`.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static
+int send_stream_packet(struct relay_connection *conn,
+		const struct lttng_viewer_get_packet *get_packet_info)
+{
+	int ret;
+	int fd = -1;
+	struct stat file_stat;
+	struct lttng_viewer_trace_packet reply_header;
+	struct relay_viewer_stream *vstream = NULL;
+	struct relay_packet_cache_entry *cached_packet = NULL;
+	uint32_t packet_data_len = 0;
+	uint64_t stream_id, offset;
+
+	/* From this point on, the error label can be reached. */
+	memset(&reply_header, 0, sizeof(reply_header));
+	stream_id = (uint64_t) be64toh(get_packet_info->stream_id);
+	offset = be64toh(get_packet_info->offset);
+
+	vstream = viewer_stream_get_by_id(stream_id);
+	if (!vstream) {
+		DBG("Client requested packet of unknown stream id %" PRIu64,
+				stream_id);
+		reply_header.status = htobe32(LTTNG_VIEWER_GET_PACKET_ERR);
+		goto send_reply_nolock;
+	}
+
+	pthread_mutex_lock(&vstream->stream->lock);
+	if (!vstream->stream_file.handle) {
+		ERR("Client requested packet of stream id %" PRIu64 " which has no open trace file",
+				stream_id);
+		goto error;
+	}
+
+	/*
+	 * The fd remains pinned until the packet data is sent. The viewer
+	 * stream's file handle is only used by the worker owning this
+	 * connection: the stream lock need not be held while the data is
+	 * sent to a possibly slow viewer.
+	 */
+	fd = fs_handle_get_fd(vstream->stream_file.handle);
+	if (fd < 0) {
+		ERR("Failed to restore file descriptor of viewer stream id %" PRIu64,
+				stream_id);
+		goto error;
+	}
+
+	/*
+	 * The reply header announces the packet data before it is sent: make
+	 * sure the trace file holds all of it.
+	 */
+	packet_data_len = be32toh(get_packet_info->len);
+	ret = fstat(fd, &file_stat);
+	if (ret < 0) {
+		PERROR("Failed to stat trace file of viewer stream id %" PRIu64,
+				stream_id);
+		goto error_put_fd;
+	}
+	if (offset > file_stat.st_size ||
+			packet_data_len > file_stat.st_size - offset) {
+		ERR("Client requested packet beyond the end of the trace file of viewer stream id %" PRIu64
+		       ", offset: %" PRIu64 ", len: %" PRIu32,
+				stream_id, offset, packet_data_len);
+		goto error_put_fd;
+	}
+
+	/* Recent packets are served from memory. */
+	cached_packet = relay_packet_cache_get(&vstream->stream->packet_cache,
+			&file_stat, offset, packet_data_len);
+	if (cached_packet) {
+		fs_handle_put_fd(vstream->stream_file.handle);
+		fd = -1;
+	}
+
+	reply_header.status = htobe32(LTTNG_VIEWER_GET_PACKET_OK);
+	reply_header.len = htobe32(packet_data_len);
+	pthread_mutex_unlock(&vstream->stream->lock);
+
+	health_code_update();
+
+	/* Only the header is sent from user space. */
+	ret = conn->sock->ops->sendmsg(conn->sock, &reply_header,
+			sizeof(reply_header), MSG_MORE);
+	if (ret != sizeof(reply_header)) {
+		ERR("Relayd failed to send response.");
+		ret = -1;
+		goto end_put_fd;
+	}
+
+	if (cached_packet) {
+		ret = conn->sock->ops->sendmsg(conn->sock, cached_packet->data,
+				packet_data_len, 0);
+		if (ret != packet_data_len) {
+			ERR("Failed to send packet data to viewer");
+			ret = -1;
+		} else {
+			ret = 0;
+		}
+	} else {
+		ret = send_packet_data(conn->sock, fd, offset,
+				packet_data_len);
+	}
+	health_code_update();
+	if (ret < 0) {
+		goto end_put_fd;
+	}
+
+	DBG("Sent %zu bytes for stream %" PRIu64 "%s",
+			sizeof(reply_header) + packet_data_len, stream_id,
+			cached_packet ? " from the packet cache" : "");
+end_put_fd:
+	if (cached_packet) {
+		relay_packet_cache_entry_put(cached_packet);
+	} else {
+		fs_handle_put_fd(vstream->stream_file.handle);
+	}
+	goto end;
+
+error_put_fd:
+	fs_handle_put_fd(vstream->stream_file.handle);
+error:
+	reply_header.status = htobe32(LTTNG_VIEWER_GET_PACKET_ERR);
+	pthread_mutex_unlock(&vstream->stream->lock);
+send_reply_nolock:
+
+	health_code_update();
+
+	ret = send_response(conn->sock, &reply_header, sizeof(reply_header));
+	health_code_update();
+	if (ret < 0) {
+		PERROR("sendmsg of packet data failed");
+	}
+end:
+	if (vstream) {
+		viewer_stream_put(vstream);
+	}
+	return ret;
+}
+
+/*
+ * Send a packet of a stream.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static
+int viewer_get_packet(struct relay_connection *conn)
+{
+	int ret;
+	struct lttng_viewer_get_packet get_packet_info;
+
+	DBG2("Relay get data packet");
+
+	health_code_update();
+
+	ret = recv_request(conn->sock, &get_packet_info,
+			sizeof(get_packet_info));
+	if (ret < 0) {
+		goto end;
+	}
+	health_code_update();
+
+	ret = send_stream_packet(conn, &get_packet_info);
+end:
+	return ret;
+}
+
+/*
+ * Send several packets, possibly of different streams, in a row.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static
+int viewer_get_packets(struct relay_connection *conn)
+{
+	int ret;
+	uint32_t i, packet_count;
+	struct lttng_viewer_get_packets_request request;
+	struct lttng_viewer_get_packet *packets = NULL;
+
+	DBG2("Relay get data packets");
+
+	health_code_update();
+
+	ret = recv_request(conn->sock, &request, sizeof(request));
+	if (ret < 0) {
+		goto end;
+	}
+	health_code_update();
+
+	packet_count = be32toh(request.packet_count);
+	if (packet_count > LTTNG_VIEWER_BATCH_MAX_COUNT) {
+		ERR("Viewer requested %" PRIu32 " packets, the maximum is %d",
+				packet_count, LTTNG_VIEWER_BATCH_MAX_COUNT);
+		ret = -1;
+		goto end;
+	} else if (!packet_count) {
+		goto end;
+	}
+
+	packets = zmalloc(packet_count * sizeof(*packets));
+	if (!packets) {
+		PERROR("viewer packet requests zmalloc");
+		ret = -1;
+		goto end;
+	}
+
+	ret = recv_request(conn->sock, packets,
+			packet_count * sizeof(*packets));
+	if (ret < 0) {
+		goto end;
+	}
+
+	for (i = 0; i < packet_count; i++) {
+		health_code_update();
+		ret = send_stream_packet(conn, &packets[i]);
+		if (ret < 0) {
+			goto end;
+		}
+	}
+	ret = 0;
+end:
+	free(packets);
+	return ret;
+}
+
+/*
+ * Send the session's metadata
+ *
+ * Return 0 on success else a negative value.
+ */
+static
+int viewer_get_metadata(struct relay_connection *conn)
+{
+	int ret = 0;
+	int fd = -1;
+	ssize_t read_len;
+	uint64_t len = 0;
+	char *data = NULL;
+	struct stat file_stat;
+	struct lttng_viewer_get_metadata request;
+	struct lttng_viewer_metadata_packet reply;
+	struct relay_viewer_stream *vstream = NULL;
+
+	assert(conn);
+
+	DBG("Relay get metadata");
+
+	health_code_update();
+
+	ret = recv_request(conn->sock, &request, sizeof(request));
+	if (ret < 0) {
+		goto end;
+	}
+	health_code_update();
+
+	memset(&reply, 0, sizeof(reply));
+
+	vstream = viewer_stream_get_by_id(be64toh(request.stream_id));
+	if (!vstream) {
+		/*
+		 * The metadata stream can be closed by a CLOSE command
+		 * just before we attach. It can also be closed by
+		 * per-pid tracing during tracing. Therefore, it is
+		 * possible that we cannot find this viewer stream.
+		 * Reply back to the client with an error if we cannot
+		 * find it.
+		 */
+		DBG("Client requested metadata of unknown stream id %" PRIu64,
+				(uint64_t) be64toh(request.stream_id));
+		reply.status = htobe32(LTTNG_VIEWER_METADATA_ERR);
+		goto send_reply;
+	}
+	pthread_mutex_lock(&vstream->stream->lock);
+	if (!vstream->stream->is_metadata) {
+		ERR("Invalid metadata stream");
+		goto error;
+	}
+
+	if (vstream->metadata_sent >= vstream->stream->metadata_received) {
+		/*
+		 * The live viewers expect to receive a NO_NEW_METADATA
+		 * status before a stream disappears, otherwise they abort the
+		 * entire live connection when receiving an error status.
+		 *
+		 * Clear feature resets the metadata_sent to 0 until the
+		 * same metadata is received again.
+		 */
+		reply.status = htobe32(LTTNG_VIEWER_NO_NEW_METADATA);
+		/*
+		 * The live viewer considers a closed 0 byte metadata stream as
+		 * an error.
+		 */
+		if (vstream->metadata_sent > 0) {
+			vstream->stream->no_new_metadata_notified = true;
+			if (vstream->stream->closed) {
+				/* Release ownership for the viewer metadata stream. */
+				viewer_stream_put(vstream);
+			}
+		}
+		goto send_reply;
+	}
+
+	if (vstream->stream->trace_chunk &&
+			!lttng_trace_chunk_ids_equal(
+				conn->viewer_session->current_trace_chunk,
+				vstream->stream->trace_chunk)) {
+		/* A rotation has occurred on the relay stream. */
+		DBG("Metadata relay stream and viewer chunk ids differ");
+
+		ret = viewer_session_set_trace_chunk_copy(
+				conn->viewer_session,
+				vstream->stream->trace_chunk);
+		if (ret) {
+			reply.status = htobe32(LTTNG_VIEWER_METADATA_ERR);
+			goto send_reply;
+		}
+	}
+
+	if (conn->viewer_session->current_trace_chunk !=
+			vstream->stream_file.trace_chunk) {
+		bool acquired_reference;
+
+		DBG("Viewer session and viewer stream chunk differ: "
+				"vsession chunk %p vstream chunk %p",
+				conn->viewer_session->current_trace_chunk,
+				vstream->stream_file.trace_chunk);
+		lttng_trace_chunk_put(vstream->stream_file.trace_chunk);
+		acquired_reference = lttng_trace_chunk_get(conn->viewer_session->current_trace_chunk);
+		assert(acquired_reference);
+		vstream->stream_file.trace_chunk =
+			conn->viewer_session->current_trace_chunk;
+		viewer_stream_close_files(vstream);
+	}
+
+	len = vstream->stream->metadata_received - vstream->metadata_sent;
+
+	/*
+	 * Either this is the first time the metadata file is read, or a
+	 * rotation of the corresponding relay stream has occured.
 	 */
 	if (!vstream->stream_file.handle && len > 0) {
 		struct fs_handle *fs_handle;
@@ -2080,7 +2586,20 @@ int viewer_get_metadata(struct relay_connection *conn)
 		ERR("Failed to restore viewer stream file system handle");
 		goto error;
 	}
-	read_len = lttng_read(fd, data, len);
+
+	/*
+	 * The metadata most recently received is served from memory. The
+	 * file position is then moved past it as if it had been read.
+	 */
+	if (!fstat(fd, &file_stat) &&
+			!relay_packet_cache_read(&vstream->stream->packet_cache,
+				&file_stat, vstream->metadata_sent, len,
+				data) &&
+			lseek(fd, len, SEEK_CUR) >= 0) {
+		read_len = len;
+	} else {
+		read_len = lttng_read(fd, data, len);
+	}
 	fs_handle_put_fd(vstream->stream_file.handle);
 	fd = -1;
 	if (read_len < len) {
@@ -2261,6 +2780,208 @@ end:
 	return ret;
 }
 
+static
+uint64_t live_monotonic_time_ns(void)
+{
+	struct timespec now;
+
+	if (lttng_clock_gettime(CLOCK_MONOTONIC, &now)) {
+		PERROR("Failed to sample the monotonic clock");
+		return 0;
+	}
+	return (uint64_t) now.tv_sec * NSEC_PER_SEC + now.tv_nsec;
+}
+
+/*
+ * Check whether any viewer stream of a session has data that was not sent to
+ * the viewer yet.
+ */
+static
+bool session_has_new_data(struct relay_session *session)
+{
+	bool new_data = false;
+	struct lttng_ht_iter iter;
+	struct relay_viewer_stream *vstream;
+
+	if (uatomic_read(&session->new_streams)) {
+		return true;
+	}
+
+	rcu_read_lock();
+	cds_lfht_for_each_entry(viewer_streams_ht->ht, &iter.iter, vstream,
+			stream_n.node) {
+		struct relay_stream *rstream;
+
+		health_code_update();
+
+		if (!viewer_stream_get(vstream)) {
+			continue;
+		}
+
+		rstream = vstream->stream;
+		if (rstream->trace->session != session) {
+			viewer_stream_put(vstream);
+			continue;
+		}
+
+		pthread_mutex_lock(&rstream->lock);
+		if (rstream->is_metadata) {
+			new_data = vstream->metadata_sent <
+					rstream->metadata_received;
+		} else {
+			/* A closed stream has at least a HUP to report. */
+			new_data = rstream->closed ||
+					rstream->index_received_seqcount >
+						vstream->index_sent_seqcount;
+		}
+		pthread_mutex_unlock(&rstream->lock);
+		viewer_stream_put(vstream);
+		if (new_data) {
+			break;
+		}
+	}
+	rcu_read_unlock();
+	return new_data;
+}
+
+/*
+ * Release the LTTNG_VIEWER_WAIT_NEW_DATA request held for a connection, if
+ * any, without replying to it.
+ */
+static
+void viewer_wait_cancel(struct relay_connection *conn)
+{
+	struct viewer_connection_wait *wait = &conn->protocol.viewer.wait;
+
+	if (!wait->pending) {
+		return;
+	}
+
+	uatomic_set(&wait->session->viewer_wake_fd, -1);
+	cds_list_del(&wait->node);
+	session_put(wait->session);
+	wait->session = NULL;
+	wait->pending = false;
+}
+
+static
+int viewer_wait_reply(struct relay_connection *conn,
+		enum lttng_viewer_wait_new_data_return_code status)
+{
+	int ret;
+	struct lttng_viewer_wait_new_data_response response;
+
+	memset(&response, 0, sizeof(response));
+	response.status = htobe32(status);
+
+	health_code_update();
+	ret = send_response(conn->sock, &response, sizeof(response));
+	health_code_update();
+	return ret < 0 ? ret : 0;
+}
+
+static
+int viewer_wait_complete(struct relay_connection *conn,
+		enum lttng_viewer_wait_new_data_return_code status)
+{
+	viewer_wait_cancel(conn);
+	return viewer_wait_reply(conn, status);
+}
+
+/*
+ * Reply to a viewer when any stream of its session may have new data.
+ *
+ * The request is not answered immediately when no new data is available:
+ * the connection is held by the worker until new data is signaled by
+ * session_notify_live_viewer() or the request times out. The worker keeps
+ * servicing its other connections in the meantime.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static
+int viewer_wait_new_data(struct relay_connection *conn,
+		struct live_worker *worker)
+{
+	int ret;
+	unsigned long new_data_seq;
+	uint32_t timeout_ms;
+	struct lttng_viewer_wait_new_data_request request;
+	enum lttng_viewer_wait_new_data_return_code status;
+	struct relay_session *session = NULL;
+	struct viewer_connection_wait *wait = &conn->protocol.viewer.wait;
+
+	DBG("Viewer wait new data received");
+
+	health_code_update();
+
+	ret = recv_request(conn->sock, &request, sizeof(request));
+	if (ret < 0) {
+		goto end;
+	}
+	timeout_ms = be32toh(request.timeout_ms);
+
+	health_code_update();
+
+	session = session_get_by_id(be64toh(request.session_id));
+	if (!session) {
+		DBG("Relay session %" PRIu64 " not found",
+				(uint64_t) be64toh(request.session_id));
+		status = LTTNG_VIEWER_WAIT_NEW_DATA_ERR;
+		goto send_reply;
+	}
+
+	if (viewer_session_is_attached(conn->viewer_session, session) != 1) {
+		DBG("Not attached to this session");
+		status = LTTNG_VIEWER_WAIT_NEW_DATA_ERR;
+		goto send_reply;
+	}
+
+	/*
+	 * Sampled before the streams are checked: data received after the
+	 * check changes the sequence number.
+	 */
+	new_data_seq = uatomic_read(&session->viewer_new_data_seq);
+	cmm_smp_mb();
+
+	if (session->connection_closed) {
+		status = LTTNG_VIEWER_WAIT_NEW_DATA_HUP;
+		goto send_reply;
+	} else if (session_has_new_data(session)) {
+		status = LTTNG_VIEWER_WAIT_NEW_DATA_OK;
+		goto send_reply;
+	} else if (timeout_ms == 0) {
+		status = LTTNG_VIEWER_WAIT_NEW_DATA_TIMEOUT;
+		goto send_reply;
+	}
+
+	/* Hold the request; the session reference is moved to it. */
+	wait->pending = true;
+	wait->session = session;
+	wait->new_data_seq = new_data_seq;
+	wait->deadline_ns = live_monotonic_time_ns() +
+			(uint64_t) timeout_ms * NSEC_PER_MSEC;
+	cds_list_add_tail(&wait->node, &worker->waiting_connections);
+	uatomic_set(&session->viewer_wake_pending, 0);
+	uatomic_set(&session->viewer_wake_fd, worker->wake_pipe[1]);
+	cmm_smp_mb();
+	DBG("Viewer waiting for new data of session %" PRIu64 " for %" PRIu32 " ms",
+			session->id, timeout_ms);
+
+	/* New data may have been signaled before the pipe was published. */
+	if (uatomic_read(&session->viewer_new_data_seq) != new_data_seq) {
+		ret = viewer_wait_complete(conn, LTTNG_VIEWER_WAIT_NEW_DATA_OK);
+	}
+	goto end;
+
+send_reply:
+	if (session) {
+		session_put(session);
+	}
+	ret = viewer_wait_reply(conn, status);
+end:
+	return ret;
+}
+
 /*
  * live_relay_unknown_command: send -1 if received unknown command
  */
@@ -2279,7 +3000,7 @@ void live_relay_unknown_command(struct relay_connection *conn)
  */
 static
 int process_control(struct lttng_viewer_cmd *recv_hdr,
-		struct relay_connection *conn)
+		struct relay_connection *conn, struct live_worker *worker)
 {
 	int ret = 0;
 	uint32_t msg_value;
@@ -2296,6 +3017,13 @@ int process_control(struct lttng_viewer_cmd *recv_hdr,
 		goto end;
 	}
 
+	if (conn->protocol.viewer.wait.pending) {
+		ERR("Viewer command %" PRIu32 " received while waiting for new data",
+				msg_value);
+		ret = -1;
+		goto end;
+	}
+
 	switch (msg_value) {
 	case LTTNG_VIEWER_CONNECT:
 		ret = viewer_connect(conn);
@@ -2324,6 +3052,29 @@ int process_control(struct lttng_viewer_cmd *recv_hdr,
 	case LTTNG_VIEWER_DETACH_SESSION:
 		ret = viewer_detach_session(conn);
 		break;
+	case LTTNG_VIEWER_WAIT_NEW_DATA:
+		if (!(conn->viewer_capabilities &
+				LTTNG_VIEWER_CAPABILITY_WAIT_NEW_DATA)) {
+			ERR("Viewer wait new data command received on a connection that did not negotiate it");
+			live_relay_unknown_command(conn);
+			ret = -1;
+			goto end;
+		}
+		ret = viewer_wait_new_data(conn, worker);
+		break;
+	case LTTNG_VIEWER_GET_NEXT_INDEXES:
+	case LTTNG_VIEWER_GET_PACKETS:
+		if (!(conn->viewer_capabilities &
+				LTTNG_VIEWER_CAPABILITY_BATCH)) {
+			ERR("Viewer batched command received on a connection that did not negotiate it");
+			live_relay_unknown_command(conn);
+			ret = -1;
+			goto end;
+		}
+		ret = msg_value == LTTNG_VIEWER_GET_NEXT_INDEXES ?
+				viewer_get_next_indexes(conn) :
+				viewer_get_packets(conn);
+		break;
 	default:
 		ERR("Received unknown viewer command (%u)",
 				be32toh(recv_hdr->cmd));
@@ -2350,6 +3101,80 @@ void cleanup_connection_pollfd(struct lttng_poll_event *events, int pollfd)
 	}
 }
 
+static
+void live_worker_close_connection(struct live_worker *worker,
+		struct lttng_poll_event *events, int pollfd,
+		struct relay_connection *conn)
+{
+	viewer_wait_cancel(conn);
+	cleanup_connection_pollfd(events, pollfd);
+	/* Put "create" ownership reference. */
+	connection_put(conn);
+	uatomic_dec(&worker->base.connection_count);
+	DBG("Viewer connection closed with %d by worker %u", pollfd,
+			worker->base.id);
+}
+
+/*
+ * Reply to the viewers waiting for new data which may have new data or whose
+ * request timed out.
+ *
+ * Return the time, in milliseconds, until the next request times out or -1
+ * if no viewer is waiting.
+ */
+static
+int live_worker_service_waits(struct live_worker *worker,
+		struct lttng_poll_event *events)
+{
+	int timeout = -1;
+	uint64_t now_ns;
+	struct relay_connection *conn, *tmp;
+
+	if (cds_list_empty(&worker->waiting_connections)) {
+		goto end;
+	}
+
+	now_ns = live_monotonic_time_ns();
+	cds_list_for_each_entry_safe(conn, tmp, &worker->waiting_connections,
+			protocol.viewer.wait.node) {
+		struct viewer_connection_wait *wait =
+				&conn->protocol.viewer.wait;
+		struct relay_session *session = wait->session;
+		enum lttng_viewer_wait_new_data_return_code status;
+
+		/* Data received from now on must wake up the worker again. */
+		uatomic_set(&session->viewer_wake_pending, 0);
+		cmm_smp_mb();
+
+		if (uatomic_read(&session->viewer_new_data_seq) !=
+				wait->new_data_seq) {
+			status = session->connection_closed ?
+					LTTNG_VIEWER_WAIT_NEW_DATA_HUP :
+					LTTNG_VIEWER_WAIT_NEW_DATA_OK;
+		} else if (now_ns >= wait->deadline_ns) {
+			status = LTTNG_VIEWER_WAIT_NEW_DATA_TIMEOUT;
+		} else {
+			const uint64_t left_ms = (wait->deadline_ns - now_ns +
+					NSEC_PER_MSEC - 1) / NSEC_PER_MSEC;
+
+			if (timeout < 0 || left_ms < (uint64_t) timeout) {
+				timeout = (int) min_t(uint64_t, left_ms,
+						INT_MAX);
+			}
+			continue;
+		}
+
+		DBG("Viewer wait for new data of session %" PRIu64 " completed: status = %d",
+				session->id, (int) status);
+		if (viewer_wait_complete(conn, status)) {
+			live_worker_close_connection(worker, events,
+					conn->sock->fd, conn);
+		}
+	}
+end:
+	return timeout;
+}
+
 /*
  * This thread does the actual work
  */
@@ -2357,14 +3182,17 @@ static
 void *thread_worker(void *data)
 {
 	int ret, err = -1;
+	int timeout = -1;
 	uint32_t nb_fd;
 	struct lttng_poll_event events;
 	struct lttng_ht *viewer_connections_ht;
 	struct lttng_ht_iter iter;
 	struct lttng_viewer_cmd recv_hdr;
-	struct relay_connection *destroy_conn;
+	struct relay_connection *destroy_conn, *waiting_conn, *tmp_conn;
+	struct live_worker *worker = caa_container_of(
+			(struct relay_worker *) data, struct live_worker, base);
 
-	DBG("[thread] Live viewer relay worker started");
+	DBG("[thread] Live viewer relay worker %u started", worker->base.id);
 
 	rcu_register_thread();
 
@@ -2380,13 +3208,19 @@ void *thread_worker(void *data)
 		goto viewer_connections_ht_error;
 	}
 
-	ret = create_named_thread_poll_set(&events, 2,
+	ret = create_named_thread_poll_set(&events, 3,
 			"Live viewer worker thread epoll");
 	if (ret < 0) {
 		goto error_poll_create;
 	}
 
-	ret = lttng_poll_add(&events, live_conn_pipe[0], LPOLLIN | LPOLLRDHUP);
+	ret = lttng_poll_add(&events, worker->base.conn_pipe[0],
+			LPOLLIN | LPOLLRDHUP);
+	if (ret < 0) {
+		goto error;
+	}
+
+	ret = lttng_poll_add(&events, worker->wake_pipe[0], LPOLLIN | LPOLLRDHUP);
 	if (ret < 0) {
 		goto error;
 	}
@@ -2397,10 +3231,13 @@ restart:
 
 		health_code_update();
 
-		/* Infinite blocking call, waiting for transmission */
+		/*
+		 * Blocking call, waiting for transmission or for the next
+		 * viewer waiting for new data to time out.
+		 */
 		DBG3("Relayd live viewer worker thread polling...");
 		health_poll_entry();
-		ret = lttng_poll_wait(&events, -1);
+		ret = lttng_poll_wait(&events, timeout);
 		health_poll_exit();
 		if (ret < 0) {
 			/*
@@ -2434,11 +3271,11 @@ restart:
 			}
 
 			/* Inspect the relay conn pipe for new connection. */
-			if (pollfd == live_conn_pipe[0]) {
+			if (pollfd == worker->base.conn_pipe[0]) {
 				if (revents & LPOLLIN) {
 					struct relay_connection *conn;
 
-					ret = lttng_read(live_conn_pipe[0],
+					ret = lttng_read(worker->base.conn_pipe[0],
 							&conn, sizeof(conn));
 					if (ret < 0) {
 						goto error;
@@ -2451,7 +3288,8 @@ restart:
 						goto error;
 					}
 					connection_ht_add(viewer_connections_ht, conn);
-					DBG("Connection socket %d added to poll", conn->sock->fd);
+					DBG("Connection socket %d added to poll of worker %u",
+							conn->sock->fd, worker->base.id);
 				} else if (revents & (LPOLLERR | LPOLLHUP | LPOLLRDHUP)) {
 					ERR("Relay live pipe error");
 					goto error;
@@ -2459,6 +3297,24 @@ restart:
 					ERR("Unexpected poll events %u for sock %d", revents, pollfd);
 					goto error;
 				}
+			} else if (pollfd == worker->wake_pipe[0]) {
+				if (revents & LPOLLIN) {
+					char wake[64];
+
+					/*
+					 * The waiting viewers are checked
+					 * below; drain what is available.
+					 */
+					ret = read(worker->wake_pipe[0], wake,
+							sizeof(wake));
+					if (ret < 0 && errno != EINTR) {
+						PERROR("Failed to read live worker wake-up pipe");
+						goto error;
+					}
+				} else {
+					ERR("Relay live wake-up pipe error");
+					goto error;
+				}
 			} else {
 				/* Connection activity. */
 				struct relay_connection *conn;
@@ -2473,24 +3329,21 @@ restart:
 							sizeof(recv_hdr), 0);
 					if (ret <= 0) {
 						/* Connection closed. */
-						cleanup_connection_pollfd(&events, pollfd);
-						/* Put "create" ownership reference. */
-						connection_put(conn);
-						DBG("Viewer control conn closed with %d", pollfd);
+						live_worker_close_connection(worker,
+								&events, pollfd, conn);
 					} else {
-						ret = process_control(&recv_hdr, conn);
+						ret = process_control(&recv_hdr, conn,
+								worker);
 						if (ret < 0) {
 							/* Clear the session on error. */
-							cleanup_connection_pollfd(&events, pollfd);
-							/* Put "create" ownership reference. */
-							connection_put(conn);
-							DBG("Viewer connection closed with %d", pollfd);
+							live_worker_close_connection(worker,
+									&events, pollfd,
+									conn);
 						}
 					}
 				} else if (revents & (LPOLLERR | LPOLLHUP | LPOLLRDHUP)) {
-					cleanup_connection_pollfd(&events, pollfd);
-					/* Put "create" ownership reference. */
-					connection_put(conn);
+					live_worker_close_connection(worker, &events,
+							pollfd, conn);
 				} else {
 					ERR("Unexpected poll events %u for sock %d", revents, pollfd);
 					connection_put(conn);
@@ -2500,12 +3353,19 @@ restart:
 				connection_put(conn);
 			}
 		}
+
+		timeout = live_worker_service_waits(worker, &events);
 	}
 
 exit:
 error:
 	(void) fd_tracker_util_poll_clean(the_fd_tracker, &events);
 
+	cds_list_for_each_entry_safe(waiting_conn, tmp_conn,
+			&worker->waiting_connections, protocol.viewer.wait.node) {
+		viewer_wait_cancel(waiting_conn);
+	}
+
 	/* Cleanup remaining connection object. */
 	rcu_read_lock();
 	cds_lfht_for_each_entry(viewer_connections_ht->ht, &iter.iter,
@@ -2518,12 +3378,10 @@ error:
 error_poll_create:
 	lttng_ht_destroy(viewer_connections_ht);
 viewer_connections_ht_error:
-	/* Close relay conn pipes */
-	(void) fd_tracker_util_pipe_close(the_fd_tracker, live_conn_pipe);
 	if (err) {
 		DBG("Viewer worker thread exited with error");
 	}
-	DBG("Viewer worker thread cleanup complete");
+	DBG("Viewer worker thread %u cleanup complete", worker->base.id);
 error_testpoint:
 	if (err) {
 		health_error();
@@ -2538,13 +3396,58 @@ error_testpoint:
 }
 
 /*
- * Create the relay command pipe to wake thread_manage_apps.
- * Closed in cleanup().
+ * Allocate the worker threads' descriptions and create the connection and
+ * wake-up pipes through which the dispatcher and the data reception threads
+ * reach them. Closed in cleanup_relayd_live().
  */
-static int create_conn_pipe(void)
+static int create_live_workers(unsigned int count)
 {
-	return fd_tracker_util_pipe_open_cloexec(the_fd_tracker,
-			"Live connection pipe", live_conn_pipe);
+	int ret;
+	unsigned int i;
+
+	ret = relay_worker_pool_create(&live_worker_pool, "Live worker",
+			count, sizeof(struct live_worker));
+	for (i = 0; i < live_worker_pool.worker_count; i++) {
+		struct live_worker *worker = live_worker_get(i);
+
+		worker->wake_pipe[0] = worker->wake_pipe[1] = -1;
+		CDS_INIT_LIST_HEAD(&worker->waiting_connections);
+	}
+	if (ret) {
+		goto end;
+	}
+
+	for (i = 0; i < live_worker_pool.worker_count; i++) {
+		struct live_worker *worker = live_worker_get(i);
+		char *pipe_name = NULL;
+
+		ret = asprintf(&pipe_name, "Live worker %u wake-up pipe", i);
+		if (ret < 0) {
+			PERROR("Failed to format live worker wake-up pipe name");
+			ret = -1;
+			goto end;
+		}
+
+		ret = fd_tracker_util_pipe_open_cloexec(the_fd_tracker,
+				pipe_name, worker->wake_pipe);
+		free(pipe_name);
+		if (ret) {
+			goto end;
+		}
+
+		/*
+		 * The data reception threads must never block on a worker:
+		 * a full pipe already holds a pending wake-up.
+		 */
+		ret = fcntl(worker->wake_pipe[1], F_SETFL, O_NONBLOCK);
+		if (ret < 0) {
+			PERROR("fcntl O_NONBLOCK live worker wake-up pipe");
+			ret = -1;
+			goto end;
+		}
+	}
+end:
+	return ret;
 }
 
 int relayd_live_join(void)
@@ -2559,10 +3462,7 @@ int relayd_live_join(void)
 		retval = -1;
 	}
 
-	ret = pthread_join(live_worker_thread, &status);
-	if (ret) {
-		errno = ret;
-		PERROR("pthread_join live worker");
+	if (relay_worker_pool_join(&live_worker_pool)) {
 		retval = -1;
 	}
 
@@ -2581,7 +3481,7 @@ int relayd_live_join(void)
 /*
  * main
  */
-int relayd_live_create(struct lttng_uri *uri)
+int relayd_live_create(struct lttng_uri *uri, unsigned int worker_count)
 {
 	int ret = 0, retval = 0;
 	void *status;
@@ -2604,8 +3504,8 @@ int relayd_live_create(struct lttng_uri *uri)
 		}
 	}
 
-	/* Setup the thread apps communication pipe. */
-	if (create_conn_pipe()) {
+	/* Setup the worker threads' communication pipes. */
+	if (create_live_workers(worker_count)) {
 		retval = -1;
 		goto exit_init_data;
 	}
@@ -2629,13 +3529,14 @@ int relayd_live_create(struct lttng_uri *uri)
 		goto exit_dispatcher_thread;
 	}
 
-	/* Setup the worker thread */
-	ret = pthread_create(&live_worker_thread, default_pthread_attr(),
-			thread_worker, NULL);
+	/* Setup the worker threads */
+	ret = relay_worker_pool_launch(&live_worker_pool, thread_worker);
 	if (ret) {
-		errno = ret;
-		PERROR("pthread_create viewer worker");
 		retval = -1;
+		/* Stop the worker threads that were already launched. */
+		if (lttng_relay_stop_threads()) {
+			ERR("Error stopping threads");
+		}
 		goto exit_worker_thread;
 	}
 
@@ -2660,14 +3561,10 @@ int relayd_live_create(struct lttng_uri *uri)
 	 */
 
 exit_listener_thread:
-
-	ret = pthread_join(live_worker_thread, &status);
-	if (ret) {
-		errno = ret;
-		PERROR("pthread_join live worker");
+exit_worker_thread:
+	if (relay_worker_pool_join(&live_worker_pool)) {
 		retval = -1;
 	}
-exit_worker_thread:
 
 	ret = pthread_join(live_dispatcher_thread, &status);
 	if (ret) {
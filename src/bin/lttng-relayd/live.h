@@ -14,7 +14,7 @@
 
 #include "lttng-relayd.h"
 
-int relayd_live_create(struct lttng_uri *live_uri);
+int relayd_live_create(struct lttng_uri *live_uri, unsigned int worker_count);
 int relayd_live_stop(void);
 int relayd_live_join(void);
 
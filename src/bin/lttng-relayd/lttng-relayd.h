@@ -10,12 +10,14 @@
  *
  */
 
+#include <inttypes.h>
 #include <limits.h>
 #include <urcu.h>
 #include <urcu/wfcqueue.h>
 
 #include <common/hashtable/hashtable.h>
 #include <common/fd-tracker/fd-tracker.h>
+#include <common/fs-handle-async.h>
 
 struct sessiond_trace_chunk_registry;
 
@@ -34,6 +36,18 @@ enum relay_group_output_by {
 	RELAYD_GROUP_OUTPUT_BY_SESSION,
 };
 
+enum relay_data_receive_mode {
+	/* Payloads are received in a user space buffer and written by copy. */
+	RELAYD_DATA_RECEIVE_MODE_COPY,
+	/* Payloads are spliced from the socket to the streams' files. */
+	RELAYD_DATA_RECEIVE_MODE_SPLICE,
+	/*
+	 * Headers and payloads of multiple packets are received in a single
+	 * user space buffer and written from there.
+	 */
+	RELAYD_DATA_RECEIVE_MODE_BATCH,
+};
+
 /*
  * Contains stream indexed by ID. This is important since many commands lookup
  * streams only by ID thus also keeping them in this hash table makes the
@@ -48,10 +62,12 @@ extern char *opt_output_path;
 extern const char *tracing_group_name;
 extern const char * const config_section_name;
 extern enum relay_group_output_by opt_group_output_by;
+extern uint64_t opt_trace_file_preallocation_size;
 
 extern int thread_quit_pipe[2];
 
 extern struct fd_tracker *the_fd_tracker;
+extern struct fs_handle_async_writer *the_async_writer;
 
 void lttng_relay_notify_ready(void);
 int lttng_relay_stop_threads(void);
@@ -17,6 +17,9 @@
 #define LTTNG_VIEWER_NAME_MAX		255
 #define LTTNG_VIEWER_HOST_NAME_MAX	64
 
+/* Maximal number of streams or packets of a batched request. */
+#define LTTNG_VIEWER_BATCH_MAX_COUNT		4096
+
 /* Flags in reply to get_next_index and get_packet. */
 enum {
 	/* New metadata is required to read this packet. */
@@ -35,6 +38,9 @@ enum lttng_viewer_command {
 	LTTNG_VIEWER_GET_NEW_STREAMS	= 7,
 	LTTNG_VIEWER_CREATE_SESSION	= 8,
 	LTTNG_VIEWER_DETACH_SESSION	= 9,
+	LTTNG_VIEWER_WAIT_NEW_DATA	= 10,
+	LTTNG_VIEWER_GET_NEXT_INDEXES	= 11,
+	LTTNG_VIEWER_GET_PACKETS	= 12,
 };
 
 enum lttng_viewer_attach_return_code {
@@ -73,6 +79,30 @@ enum lttng_viewer_connection_type {
 	LTTNG_VIEWER_CLIENT_NOTIFICATION	= 2,
 };
 
+/*
+ * Commands supported beyond the upstream protocol, negotiated on
+ * LTTNG_VIEWER_CONNECT without changing the protocol version.
+ *
+ * The viewer sets the capabilities it supports in the `viewer_session_id`
+ * field of its request, along with LTTNG_VIEWER_CAPABILITIES_MAGIC in the
+ * upper 32 bits, and the relay daemon replies with those it supports too in
+ * the `type` field of its reply. A relay daemon which is not aware of the
+ * capabilities ignores the `viewer_session_id` field of the request and
+ * replies with a `type` of 0: the viewer then falls back to the upstream
+ * commands on the same connection.
+ */
+enum lttng_viewer_capability {
+	/* LTTNG_VIEWER_WAIT_NEW_DATA command. */
+	LTTNG_VIEWER_CAPABILITY_WAIT_NEW_DATA	= (1U << 16),
+	/* LTTNG_VIEWER_GET_NEXT_INDEXES and LTTNG_VIEWER_GET_PACKETS commands. */
+	LTTNG_VIEWER_CAPABILITY_BATCH		= (1U << 17),
+};
+
+/* "LTCP", distinguishes the capabilities from the -1 sent by the viewers. */
+#define LTTNG_VIEWER_CAPABILITIES_MAGIC		0x4C544350U
+#define LTTNG_VIEWER_CAPABILITIES(capabilities) \
+	(((uint64_t) LTTNG_VIEWER_CAPABILITIES_MAGIC << 32) | (capabilities))
+
 enum lttng_viewer_seek {
 	/* Receive the trace packets from the beginning. */
 	LTTNG_VIEWER_SEEK_BEGINNING	= 1,
@@ -98,6 +128,18 @@ enum lttng_viewer_detach_session_return_code {
 	LTTNG_VIEWER_DETACH_SESSION_ERR         = 3,
 };
 
+enum lttng_viewer_get_next_indexes_return_code {
+	LTTNG_VIEWER_GET_NEXT_INDEXES_OK	= 1,
+	LTTNG_VIEWER_GET_NEXT_INDEXES_ERR	= 2,
+};
+
+enum lttng_viewer_wait_new_data_return_code {
+	LTTNG_VIEWER_WAIT_NEW_DATA_OK		= 1, /* New data may be available. */
+	LTTNG_VIEWER_WAIT_NEW_DATA_TIMEOUT	= 2, /* No new data before the timeout. */
+	LTTNG_VIEWER_WAIT_NEW_DATA_HUP		= 3, /* Session closed. */
+	LTTNG_VIEWER_WAIT_NEW_DATA_ERR		= 4,
+};
+
 struct lttng_viewer_session {
 	uint64_t id;
 	uint32_t live_timer;
@@ -237,4 +279,69 @@ struct lttng_viewer_detach_session_response {
 	uint32_t status;
 } LTTNG_PACKED;
 
+/*
+ * LTTNG_VIEWER_WAIT_NEW_DATA payload.
+ *
+ * The reply is sent as soon as new data may be available on any stream of
+ * the attached session (new index, live beacon, new stream or closed
+ * stream) or once the timeout expires. The viewer must not send other
+ * commands on the connection until it receives the reply.
+ */
+struct lttng_viewer_wait_new_data_request {
+	uint64_t session_id;
+	uint32_t timeout_ms;
+} LTTNG_PACKED;
+
+struct lttng_viewer_wait_new_data_response {
+	/* enum lttng_viewer_wait_new_data_return_code */
+	uint32_t status;
+} LTTNG_PACKED;
+
+/*
+ * LTTNG_VIEWER_GET_NEXT_INDEXES payload.
+ *
+ * Get the next index of several data streams of an attached session in a
+ * single round-trip. The request is followed by `stream_count` viewer stream
+ * IDs (uint64_t). When `stream_count` is 0, the next index of every data
+ * stream of the session is returned.
+ *
+ * The response is followed by `index_count` struct lttng_viewer_stream_index,
+ * each one holding what LTTNG_VIEWER_GET_NEXT_INDEX would have returned for
+ * that stream.
+ */
+struct lttng_viewer_get_next_indexes_request {
+	uint64_t session_id;
+	uint32_t stream_count;
+	/* uint64_t viewer stream IDs */
+	char stream_ids[];
+} LTTNG_PACKED;
+
+struct lttng_viewer_get_next_indexes_response {
+	/* enum lttng_viewer_get_next_indexes_return_code */
+	uint32_t status;
+	uint32_t index_count;
+	/* struct lttng_viewer_stream_index */
+	char index_list[];
+} LTTNG_PACKED;
+
+struct lttng_viewer_stream_index {
+	/* Viewer stream ID. */
+	uint64_t id;
+	struct lttng_viewer_index index;
+} LTTNG_PACKED;
+
+/*
+ * LTTNG_VIEWER_GET_PACKETS payload.
+ *
+ * The request is followed by `packet_count` struct lttng_viewer_get_packet.
+ * The reply is the concatenation of the replies LTTNG_VIEWER_GET_PACKET would
+ * have sent for each packet, in order: a struct lttng_viewer_trace_packet
+ * followed by its data.
+ */
+struct lttng_viewer_get_packets_request {
+	uint32_t packet_count;
+	/* struct lttng_viewer_get_packet */
+	char packet_list[];
+} LTTNG_PACKED;
+
 #endif /* LTTNG_VIEWER_ABI_H */
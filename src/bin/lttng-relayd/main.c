@@ -52,6 +52,7 @@
 #include <common/config/session-config.h>
 #include <common/dynamic-buffer.h>
 #include <common/buffer-view.h>
+#include <common/compression.h>
 #include <common/string-utils/format.h>
 #include <common/fd-tracker/fd-tracker.h>
 #include <common/fd-tracker/utils.h>
@@ -64,6 +65,8 @@
 #include "index.h"
 #include "live.h"
 #include "lttng-relayd.h"
+#include "packet-cache.h"
+#include "write-buffer.h"
 #include "session.h"
 #include "sessiond-trace-chunks.h"
 #include "stream.h"
@@ -73,6 +76,7 @@
 #include "utils.h"
 #include "version.h"
 #include "viewer-stream.h"
+#include "worker-pool.h"
 
 static const char *help_msg =
 #ifdef LTTNG_EMBED_HELP
@@ -94,6 +98,8 @@ enum relay_connection_status {
 char *opt_output_path, *opt_working_directory;
 static int opt_daemon, opt_background, opt_print_version, opt_allow_clear = 1;
 enum relay_group_output_by opt_group_output_by = RELAYD_GROUP_OUTPUT_BY_UNKNOWN;
+static enum relay_data_receive_mode opt_data_receive_mode =
+		RELAYD_DATA_RECEIVE_MODE_COPY;
 
 /*
  * We need to wait for listener and live listener threads, as well as
@@ -125,18 +131,29 @@ const char * const config_section_name = "relayd";
  */
 int thread_quit_pipe[2] = { -1, -1 };
 
-/*
- * This pipe is used to inform the worker thread that a command is queued and
- * ready to be processed.
- */
-static int relay_conn_pipe[2] = { -1, -1 };
+/* Number of worker threads servicing the control and data connections. */
+static unsigned int opt_worker_threads = DEFAULT_RELAYD_WORKER_THREADS;
+/* Number of worker threads servicing the live viewer connections. */
+static unsigned int opt_live_worker_threads = DEFAULT_RELAYD_LIVE_WORKER_THREADS;
+/* Memory used to cache the recent packets of the live streams, in bytes. */
+static uint64_t opt_live_packet_cache_size =
+		DEFAULT_RELAYD_LIVE_PACKET_CACHE_SIZE;
+static unsigned int opt_async_output_threads =
+		DEFAULT_RELAYD_ASYNC_OUTPUT_THREADS;
+/* Size of the buffer coalescing the writes of each stream, in bytes. */
+static uint64_t opt_stream_write_buffer_size =
+		DEFAULT_RELAYD_STREAM_WRITE_BUFFER_SIZE;
+/* Steps in which the storage of the trace files is allocated, in bytes. */
+uint64_t opt_trace_file_preallocation_size =
+		DEFAULT_RELAYD_TRACE_FILE_PREALLOCATION_SIZE;
+/* Workers servicing the control and data connections. */
+static struct relay_worker_pool relay_worker_pool;
 
 /* Shared between threads */
 static int dispatch_thread_exit;
 
 static pthread_t listener_thread;
 static pthread_t dispatcher_thread;
-static pthread_t worker_thread;
 static pthread_t health_thread;
 
 /*
@@ -173,6 +190,7 @@ struct sessiond_trace_chunk_registry *sessiond_trace_chunk_registry;
 
 /* Global fd tracker. */
 struct fd_tracker *the_fd_tracker;
+struct fs_handle_async_writer *the_async_writer;
 
 static struct option long_options[] = {
 	{ "control-port", 1, 0, 'C', },
@@ -182,6 +200,13 @@ static struct option long_options[] = {
 	{ "background", 0, 0, 'b', },
 	{ "group", 1, 0, 'g', },
 	{ "fd-pool-size", 1, 0, '\0', },
+	{ "worker-threads", 1, 0, '\0', },
+	{ "live-worker-threads", 1, 0, '\0', },
+	{ "live-packet-cache-size", 1, 0, '\0', },
+	{ "data-receive-mode", 1, 0, '\0', },
+	{ "async-output-threads", 1, 0, '\0', },
+	{ "stream-write-buffer-size", 1, 0, '\0', },
+	{ "trace-file-preallocation", 1, 0, '\0', },
 	{ "help", 0, 0, 'h', },
 	{ "output", 1, 0, 'o', },
 	{ "verbose", 0, 0, 'v', },
@@ -241,6 +266,95 @@ static int set_option(int opt, const char *arg, const char *optname)
 				goto end;
 			}
 			lttng_opt_fd_pool_size = (unsigned int) v;
+		} else if (!strcmp(optname, "worker-threads")) {
+			unsigned long v;
+
+			errno = 0;
+			v = strtoul(arg, NULL, 0);
+			if (errno != 0 || !isdigit((unsigned char) arg[0]) ||
+					v == 0) {
+				ERR("Wrong value in --worker-threads parameter: %s", arg);
+				ret = -1;
+				goto end;
+			}
+			if (v > DEFAULT_RELAYD_MAX_WORKER_THREADS) {
+				ERR("Worker thread count in --worker-threads parameter exceeds the maximum (%d): %s",
+						DEFAULT_RELAYD_MAX_WORKER_THREADS, arg);
+				ret = -1;
+				goto end;
+			}
+			opt_worker_threads = (unsigned int) v;
+		} else if (!strcmp(optname, "live-worker-threads")) {
+			unsigned long v;
+
+			errno = 0;
+			v = strtoul(arg, NULL, 0);
+			if (errno != 0 || !isdigit((unsigned char) arg[0]) ||
+					v == 0) {
+				ERR("Wrong value in --live-worker-threads parameter: %s", arg);
+				ret = -1;
+				goto end;
+			}
+			if (v > DEFAULT_RELAYD_MAX_WORKER_THREADS) {
+				ERR("Worker thread count in --live-worker-threads parameter exceeds the maximum (%d): %s",
+						DEFAULT_RELAYD_MAX_WORKER_THREADS, arg);
+				ret = -1;
+				goto end;
+			}
+			opt_live_worker_threads = (unsigned int) v;
+		} else if (!strcmp(optname, "live-packet-cache-size")) {
+			if (utils_parse_size_suffix(arg,
+					&opt_live_packet_cache_size) < 0) {
+				ERR("Wrong value in --live-packet-cache-size parameter: %s", arg);
+				ret = -1;
+				goto end;
+			}
+		} else if (!strcmp(optname, "async-output-threads")) {
+			unsigned long v;
+
+			errno = 0;
+			v = strtoul(arg, NULL, 0);
+			if (errno != 0 || !isdigit((unsigned char) arg[0])) {
+				ERR("Wrong value in --async-output-threads parameter: %s", arg);
+				ret = -1;
+				goto end;
+			}
+			if (v > DEFAULT_RELAYD_MAX_ASYNC_OUTPUT_THREADS) {
+				ERR("Thread count in --async-output-threads parameter exceeds the maximum (%d): %s",
+						DEFAULT_RELAYD_MAX_ASYNC_OUTPUT_THREADS, arg);
+				ret = -1;
+				goto end;
+			}
+			opt_async_output_threads = (unsigned int) v;
+		} else if (!strcmp(optname, "stream-write-buffer-size")) {
+			if (utils_parse_size_suffix(arg,
+					&opt_stream_write_buffer_size) < 0) {
+				ERR("Wrong value in --stream-write-buffer-size parameter: %s", arg);
+				ret = -1;
+				goto end;
+			}
+		} else if (!strcmp(optname, "trace-file-preallocation")) {
+			if (utils_parse_size_suffix(arg,
+					&opt_trace_file_preallocation_size) < 0) {
+				ERR("Wrong value in --trace-file-preallocation parameter: %s", arg);
+				ret = -1;
+				goto end;
+			}
+		} else if (!strcmp(optname, "data-receive-mode")) {
+			if (!strcmp(arg, "copy")) {
+				opt_data_receive_mode =
+						RELAYD_DATA_RECEIVE_MODE_COPY;
+			} else if (!strcmp(arg, "splice")) {
+				opt_data_receive_mode =
+						RELAYD_DATA_RECEIVE_MODE_SPLICE;
+			} else if (!strcmp(arg, "batch")) {
+				opt_data_receive_mode =
+						RELAYD_DATA_RECEIVE_MODE_BATCH;
+			} else {
+				ERR("Wrong value in --data-receive-mode parameter: %s", arg);
+				ret = -1;
+				goto end;
+			}
 		} else {
 			fprintf(stderr, "unknown option %s", optname);
 			if (arg) {
@@ -715,6 +829,13 @@ static void relayd_cleanup(void)
 		(void) fd_tracker_util_pipe_close(
 				the_fd_tracker, thread_quit_pipe);
 	}
+	relay_worker_pool_destroy(&relay_worker_pool);
+	relay_packet_cache_log_stats();
+	relay_write_buffer_log_stats();
+	if (the_async_writer) {
+		/* Performs the writes that are still pending. */
+		fs_handle_async_writer_destroy(the_async_writer);
+	}
 	if (sessiond_trace_chunk_registry) {
 		sessiond_trace_chunk_registry_destroy(
 				sessiond_trace_chunk_registry);
@@ -1317,18 +1438,9 @@ static void *relay_thread_dispatcher(void *data)
 				break;
 			}
 			new_conn = caa_container_of(node, struct relay_connection, qnode);
-
-			DBG("Dispatching request waiting on sock %d", new_conn->sock->fd);
-
-			/*
-			 * Inform worker thread of the new request. This
-			 * call is blocking so we can be assured that
-			 * the data will be read at some point in time
-			 * or wait to the end of the world :)
-			 */
-			ret = lttng_write(relay_conn_pipe[1], &new_conn, sizeof(new_conn));
+			ret = relay_worker_pool_dispatch(&relay_worker_pool,
+					new_conn);
 			if (ret < 0) {
-				PERROR("write connection pipe");
 				connection_put(new_conn);
 				goto error;
 			}
@@ -1524,6 +1636,7 @@ static void publish_connection_local_streams(struct relay_connection *conn)
 		uatomic_set(&session->new_streams, 1);
 	}
 	pthread_mutex_unlock(&session->lock);
+	session_notify_live_viewer(session);
 }
 
 static int conform_channel_path(char *channel_path)
@@ -2092,6 +2205,17 @@ static int relay_data_pending(const struct lttcomm_relayd_hdr *recv_hdr,
 
 	pthread_mutex_lock(&stream->lock);
 
+	/*
+	 * The session daemon considers the data written once it is no longer
+	 * pending; it must not linger in the stream's write buffer.
+	 */
+	if (stream_flush_write_buffer(stream)) {
+		ret = -1;
+		pthread_mutex_unlock(&stream->lock);
+		stream_put(stream);
+		goto end;
+	}
+
 	if (session_streams_have_index(session)) {
 		/*
 		 * Ensure that both the index and stream data have been
@@ -3186,6 +3310,14 @@ static int relay_get_configuration(const struct lttcomm_relayd_hdr *recv_hdr,
 	if (opt_allow_clear) {
 		result_flags |= LTTCOMM_RELAYD_CONFIGURATION_FLAG_CLEAR_ALLOWED;
 	}
+	if (lttng_compression_algorithm_is_supported(
+			LTTNG_COMPRESSION_ALGORITHM_LZ4)) {
+		result_flags |= LTTCOMM_RELAYD_CONFIGURATION_FLAG_COMPRESSION_LZ4;
+	}
+	if (lttng_compression_algorithm_is_supported(
+			LTTNG_COMPRESSION_ALGORITHM_ZSTD)) {
+		result_flags |= LTTCOMM_RELAYD_CONFIGURATION_FLAG_COMPRESSION_ZSTD;
+	}
 	ret = 0;
 reply:
 	reply = (typeof(reply)){
@@ -3486,7 +3618,74 @@ static enum relay_connection_status relay_process_control(
 	return status;
 }
 
-static enum relay_connection_status relay_process_data_receive_header(
+/*
+ * Prepare the reception of the payload of a compressed packet in the
+ * connection's compressed payload buffer.
+ */
+static int relay_data_connection_prepare_compressed_packet(
+		struct relay_connection *conn,
+		const struct lttcomm_relayd_data_hdr *header)
+{
+	int ret;
+	struct lttng_compression_context **context =
+			&conn->protocol.data.decompression_context;
+
+	if (!lttng_compression_algorithm_is_supported(header->compression)) {
+		ERR("Received data packet compressed with an unsupported algorithm (%" PRIu32 ") on fd %i",
+				header->compression, conn->sock->fd);
+		ret = -1;
+		goto end;
+	}
+
+	/*
+	 * The consumer daemon only sends compressed packets smaller than their
+	 * uncompressed form. Bound the sizes announced by the peer before
+	 * allocating the buffers of the packet.
+	 */
+	if (header->uncompressed_size == 0 ||
+			header->uncompressed_size >
+				DEFAULT_NETWORK_RELAYD_COMPRESSED_PACKET_MAX_SIZE ||
+			header->data_size >= header->uncompressed_size) {
+		ERR("Received compressed data packet of invalid size on fd %i: data_size = %" PRIu32 ", uncompressed_size = %" PRIu32 ", maximal size = %d",
+				conn->sock->fd, header->data_size,
+				header->uncompressed_size,
+				DEFAULT_NETWORK_RELAYD_COMPRESSED_PACKET_MAX_SIZE);
+		ret = -1;
+		goto end;
+	}
+
+	if (*context && lttng_compression_context_get_algorithm(*context) !=
+			header->compression) {
+		lttng_compression_context_destroy(*context);
+		*context = NULL;
+	}
+	if (!*context) {
+		*context = lttng_compression_context_create(
+				header->compression);
+		if (!*context) {
+			ret = -1;
+			goto end;
+		}
+	}
+
+	/* The payload is received at its offset in the buffer. */
+	ret = lttng_dynamic_buffer_set_size(
+			&conn->protocol.data.compressed_payload,
+			header->data_size);
+	if (ret) {
+		ERR("Failed to allocate reception buffer of %" PRIu32 " bytes for compressed packet",
+				header->data_size);
+		goto end;
+	}
+end:
+	return ret;
+}
+
+/*
+ * Decode the data header held in the connection's header reception buffer
+ * and prepare the reception of its payload.
+ */
+static enum relay_connection_status relay_data_connection_process_header(
 		struct relay_connection *conn)
 {
 	int ret;
@@ -3496,11 +3695,86 @@ static enum relay_connection_status relay_process_data_receive_header(
 	struct lttcomm_relayd_data_hdr header;
 	struct relay_stream *stream;
 
+	assert(state->left_to_receive == 0);
+
+	/* Transition to next state: receiving the payload. */
+	conn->protocol.data.state_id = DATA_CONNECTION_STATE_RECEIVE_PAYLOAD;
+
+	memcpy(&header, state->header_reception_buffer, sizeof(header));
+	header.compression = be32toh(header.compression);
+	header.uncompressed_size = be32toh(header.uncompressed_size);
+	header.stream_id = be64toh(header.stream_id);
+	header.data_size = be32toh(header.data_size);
+	header.net_seq_num = be64toh(header.net_seq_num);
+	header.padding_size = be32toh(header.padding_size);
+	memcpy(&conn->protocol.data.state.receive_payload.header, &header, sizeof(header));
+
+	conn->protocol.data.state.receive_payload.left_to_receive =
+			header.data_size;
+	conn->protocol.data.state.receive_payload.received = 0;
+	conn->protocol.data.state.receive_payload.rotate_index = false;
+
+	DBG("Received data connection header on fd %i: compression = %s, uncompressed_size = %" PRIu32 ", stream_id = %" PRIu64 ", data_size = %" PRIu32 ", net_seq_num = %" PRIu64 ", padding_size = %" PRIu32,
+			conn->sock->fd,
+			lttng_compression_algorithm_str(header.compression),
+			header.uncompressed_size, header.stream_id,
+			header.data_size, header.net_seq_num,
+			header.padding_size);
+
+	if (header.compression != LTTNG_COMPRESSION_ALGORITHM_NONE) {
+		/*
+		 * The packet is initialized once its size is known, after its
+		 * decompression.
+		 */
+		ret = relay_data_connection_prepare_compressed_packet(conn,
+				&header);
+		if (ret) {
+			/* Protocol error. */
+			status = RELAY_CONNECTION_STATUS_ERROR;
+		}
+		goto end;
+	}
+
+	stream = stream_get_by_id(header.stream_id);
+	if (!stream) {
+		DBG("relay_process_data_receive_payload: Cannot find stream %" PRIu64,
+				header.stream_id);
+		/* Protocol error. */
+		status = RELAY_CONNECTION_STATUS_ERROR;
+		goto end;
+	}
+
+	pthread_mutex_lock(&stream->lock);
+	/* Prepare stream for the reception of a new packet. */
+	ret = stream_init_packet(stream, header.data_size,
+			&conn->protocol.data.state.receive_payload.rotate_index);
+	pthread_mutex_unlock(&stream->lock);
+	if (ret) {
+		ERR("Failed to rotate stream output file");
+		status = RELAY_CONNECTION_STATUS_ERROR;
+		goto end_stream_unlock;
+	}
+
+end_stream_unlock:
+	stream_put(stream);
+end:
+	return status;
+}
+
+static enum relay_connection_status relay_process_data_receive_header(
+		struct relay_connection *conn)
+{
+	int ret;
+	enum relay_connection_status status = RELAY_CONNECTION_STATUS_OK;
+	struct data_connection_state_receive_header *state =
+			&conn->protocol.data.state.receive_header;
+
 	assert(state->left_to_receive != 0);
 
 	ret = conn->sock->ops->recvmsg(conn->sock,
 			state->header_reception_buffer + state->received,
 			state->left_to_receive, MSG_DONTWAIT);
+	conn->protocol.data.stats.recv_calls++;
 	if (ret < 0) {
 		if (errno != EAGAIN && errno != EWOULDBLOCK) {
 			PERROR("Unable to receive data header on sock %d", conn->sock->fd);
@@ -3531,51 +3805,73 @@ static enum relay_connection_status relay_process_data_receive_header(
 		goto end;
 	}
 
-	/* Transition to next state: receiving the payload. */
-	conn->protocol.data.state_id = DATA_CONNECTION_STATE_RECEIVE_PAYLOAD;
+	status = relay_data_connection_process_header(conn);
+end:
+	return status;
+}
 
-	memcpy(&header, state->header_reception_buffer, sizeof(header));
-	header.circuit_id = be64toh(header.circuit_id);
-	header.stream_id = be64toh(header.stream_id);
-	header.data_size = be32toh(header.data_size);
-	header.net_seq_num = be64toh(header.net_seq_num);
-	header.padding_size = be32toh(header.padding_size);
-	memcpy(&conn->protocol.data.state.receive_payload.header, &header, sizeof(header));
+/*
+ * Write the padding of a packet whose payload was entirely written to the
+ * stream's file (unless `padding_written` is set), update the stream's
+ * index and reset the connection's protocol state to RECEIVE_HEADER.
+ *
+ * Called with the stream's lock held.
+ */
+static int relay_data_connection_complete_packet(struct relay_connection *conn,
+		struct relay_stream *stream, bool padding_written,
+		bool *new_stream)
+{
+	int ret;
+	bool index_flushed = false;
+	struct data_connection_state_receive_payload *state =
+			&conn->protocol.data.state.receive_payload;
+	struct relay_session *session = stream->trace->session;
 
-	conn->protocol.data.state.receive_payload.left_to_receive =
-			header.data_size;
-	conn->protocol.data.state.receive_payload.received = 0;
-	conn->protocol.data.state.receive_payload.rotate_index = false;
+	assert(state->left_to_receive == 0);
 
-	DBG("Received data connection header on fd %i: circuit_id = %" PRIu64 ", stream_id = %" PRIu64 ", data_size = %" PRIu32 ", net_seq_num = %" PRIu64 ", padding_size = %" PRIu32,
-			conn->sock->fd, header.circuit_id,
-			header.stream_id, header.data_size,
-			header.net_seq_num, header.padding_size);
+	if (!padding_written) {
+		ret = stream_write(stream, NULL, state->header.padding_size);
+		if (ret) {
+			goto end;
+		}
+		if (state->header.padding_size) {
+			conn->protocol.data.stats.write_calls++;
+		}
+	}
 
-	stream = stream_get_by_id(header.stream_id);
-	if (!stream) {
-		DBG("relay_process_data_receive_payload: Cannot find stream %" PRIu64,
-				header.stream_id);
-		/* Protocol error. */
-		status = RELAY_CONNECTION_STATUS_ERROR;
-		goto end;
+	if (session_streams_have_index(session)) {
+		ret = stream_update_index(stream, state->header.net_seq_num,
+				state->rotate_index, &index_flushed,
+				state->header.data_size + state->header.padding_size);
+		if (ret < 0) {
+			ERR("Failed to update index: stream %" PRIu64 " net_seq_num %" PRIu64 " ret %d",
+					stream->stream_handle,
+					state->header.net_seq_num, ret);
+			goto end;
+		}
 	}
 
-	pthread_mutex_lock(&stream->lock);
-	/* Prepare stream for the reception of a new packet. */
-	ret = stream_init_packet(stream, header.data_size,
-			&conn->protocol.data.state.receive_payload.rotate_index);
-	pthread_mutex_unlock(&stream->lock);
+	if (stream->prev_data_seq == -1ULL) {
+		*new_stream = true;
+	}
+
+	ret = stream_complete_packet(stream, state->header.data_size +
+			state->header.padding_size, state->header.net_seq_num,
+			index_flushed);
 	if (ret) {
-		ERR("Failed to rotate stream output file");
-		status = RELAY_CONNECTION_STATUS_ERROR;
-		goto end_stream_unlock;
+		goto end;
 	}
+	conn->protocol.data.stats.packets++;
 
-end_stream_unlock:
-	stream_put(stream);
+	/*
+	 * Resetting the protocol state (to RECEIVE_HEADER) will trash the
+	 * contents of *state which are aliased (union) to the same location as
+	 * the new state. Don't use it beyond this point.
+	 */
+	connection_reset_protocol_state(conn);
+	state = NULL;
 end:
-	return status;
+	return ret;
 }
 
 static enum relay_connection_status relay_process_data_receive_payload(
@@ -3589,7 +3885,7 @@ static enum relay_connection_status relay_process_data_receive_payload(
 	const size_t chunk_size = RECV_DATA_BUFFER_SIZE;
 	char data_buffer[chunk_size];
 	bool partial_recv = false;
-	bool new_stream = false, close_requested = false, index_flushed = false;
+	bool new_stream = false, close_requested = false;
 	uint64_t left_to_receive = state->left_to_receive;
 	struct relay_session *session;
 
@@ -3616,6 +3912,50 @@ static enum relay_connection_status relay_process_data_receive_payload(
 		}
 	}
 
+	/*
+	 * When splicing, the size of the "chunk" received on any iteration is
+	 * bounded by:
+	 *   - the data left to receive,
+	 *   - the data immediately available on the socket,
+	 *   - the capacity of the connection's splice pipe.
+	 */
+	while (left_to_receive > 0 && connection_uses_splice(conn)) {
+		bool splice_supported;
+		ssize_t spliced;
+
+		spliced = stream_splice_from_socket(stream, conn->sock->fd,
+				conn->protocol.data.splice_pipe,
+				left_to_receive, &splice_supported);
+		conn->protocol.data.stats.recv_calls++;
+		conn->protocol.data.stats.write_calls++;
+		if (!splice_supported) {
+			WARN("Data connection socket %d falling back to the reception of payloads by copy: splice is not supported by the socket or the file system",
+					conn->sock->fd);
+			connection_disable_splice(conn);
+		}
+		if (spliced < 0) {
+			if (!splice_supported) {
+				/* No data was consumed, use the copy path. */
+				break;
+			}
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				status = RELAY_CONNECTION_STATUS_ERROR;
+			}
+			goto end_stream_unlock;
+		} else if (spliced == 0) {
+			DBG3("No more data ready for consumption on data socket of stream id %" PRIu64,
+					state->header.stream_id);
+			status = RELAY_CONNECTION_STATUS_CLOSED;
+			/* Don't fall through to the copy path. */
+			partial_recv = true;
+			break;
+		}
+
+		left_to_receive -= spliced;
+		state->received += spliced;
+		state->left_to_receive = left_to_receive;
+	}
+
 	/*
 	 * The size of the "chunk" received on any iteration is bounded by:
 	 *   - the data left to receive,
@@ -3628,6 +3968,7 @@ static enum relay_connection_status relay_process_data_receive_payload(
 
 		ret = conn->sock->ops->recvmsg(conn->sock, data_buffer,
 				recv_size, MSG_DONTWAIT);
+		conn->protocol.data.stats.recv_calls++;
 		if (ret < 0) {
 			if (errno != EAGAIN && errno != EWOULDBLOCK) {
 				PERROR("Socket %d error", conn->sock->fd);
@@ -3654,6 +3995,7 @@ static enum relay_connection_status relay_process_data_receive_payload(
 		assert(packet_chunk.data);
 
 		ret = stream_write(stream, &packet_chunk, 0);
+		conn->protocol.data.stats.write_calls++;
 		if (ret) {
 			ERR("Relay error writing data to file");
 			status = RELAY_CONNECTION_STATUS_ERROR;
@@ -3676,49 +4018,295 @@ static enum relay_connection_status relay_process_data_receive_payload(
 		goto end_stream_unlock;
 	}
 
-	ret = stream_write(stream, NULL, state->header.padding_size);
+	ret = relay_data_connection_complete_packet(conn, stream, false,
+			&new_stream);
 	if (ret) {
 		status = RELAY_CONNECTION_STATUS_ERROR;
 		goto end_stream_unlock;
 	}
+	state = NULL;
 
-	if (session_streams_have_index(session)) {
-		ret = stream_update_index(stream, state->header.net_seq_num,
-				state->rotate_index, &index_flushed,
-				state->header.data_size + state->header.padding_size);
-		if (ret < 0) {
-			ERR("Failed to update index: stream %" PRIu64 " net_seq_num %" PRIu64 " ret %d",
-					stream->stream_handle,
-					state->header.net_seq_num, ret);
+end_stream_unlock:
+	close_requested = stream->close_requested;
+	pthread_mutex_unlock(&stream->lock);
+	if (close_requested && left_to_receive == 0) {
+		try_stream_close(stream);
+	}
+
+	if (new_stream) {
+		pthread_mutex_lock(&session->lock);
+		uatomic_set(&session->new_streams, 1);
+		pthread_mutex_unlock(&session->lock);
+	}
+
+	stream_put(stream);
+end:
+	return status;
+}
+
+/*
+ * Decompress the payload of a compressed packet once it has been entirely
+ * received, write it to its stream's file along with its padding and
+ * complete the packet.
+ *
+ * The stream's file and index only ever see the uncompressed packet.
+ */
+static enum relay_connection_status relay_data_connection_complete_compressed_packet(
+		struct relay_connection *conn)
+{
+	int ret;
+	enum relay_connection_status status = RELAY_CONNECTION_STATUS_OK;
+	struct relay_stream *stream;
+	struct data_connection_state_receive_payload *state =
+			&conn->protocol.data.state.receive_payload;
+	const struct lttng_dynamic_buffer *compressed =
+			&conn->protocol.data.compressed_payload;
+	struct lttng_dynamic_buffer *decompressed =
+			&conn->protocol.data.decompressed_payload;
+	struct lttng_buffer_view packet;
+	bool new_stream = false, close_requested = false;
+	struct relay_session *session;
+
+	assert(state->left_to_receive == 0);
+
+	/* Bounded on the reception of the header. */
+	assert(state->header.uncompressed_size <=
+			DEFAULT_NETWORK_RELAYD_COMPRESSED_PACKET_MAX_SIZE);
+	ret = lttng_dynamic_buffer_set_size(decompressed,
+			state->header.uncompressed_size);
+	if (ret) {
+		ERR("Failed to allocate decompression buffer of %" PRIu32 " bytes",
+				state->header.uncompressed_size);
+		status = RELAY_CONNECTION_STATUS_ERROR;
+		goto end;
+	}
+
+	ret = lttng_compression_context_decompress(
+			conn->protocol.data.decompression_context,
+			compressed->data, compressed->size,
+			decompressed->data, decompressed->size);
+	if (ret) {
+		ERR("Failed to decompress packet of stream id %" PRIu64 ", net_seq_num %" PRIu64,
+				state->header.stream_id,
+				state->header.net_seq_num);
+		status = RELAY_CONNECTION_STATUS_ERROR;
+		goto end;
+	}
+
+	stream = stream_get_by_id(state->header.stream_id);
+	if (!stream) {
+		/* Protocol error. */
+		ERR("relay_data_connection_complete_compressed_packet: cannot find stream %" PRIu64,
+				state->header.stream_id);
+		status = RELAY_CONNECTION_STATUS_ERROR;
+		goto end;
+	}
+
+	pthread_mutex_lock(&stream->lock);
+	session = stream->trace->session;
+	if (!conn->session) {
+		ret = connection_set_session(conn, session);
+		if (ret) {
 			status = RELAY_CONNECTION_STATUS_ERROR;
 			goto end_stream_unlock;
 		}
 	}
 
-	if (stream->prev_data_seq == -1ULL) {
-		new_stream = true;
+	/* From here on, the packet is handled in uncompressed terms. */
+	state->header.data_size = state->header.uncompressed_size;
+	ret = stream_init_packet(stream, state->header.data_size,
+			&state->rotate_index);
+	if (ret) {
+		ERR("Failed to rotate stream output file");
+		status = RELAY_CONNECTION_STATUS_ERROR;
+		goto end_stream_unlock;
 	}
 
-	ret = stream_complete_packet(stream, state->header.data_size +
-			state->header.padding_size, state->header.net_seq_num,
-			index_flushed);
+	packet = lttng_buffer_view_from_dynamic_buffer(decompressed, 0,
+			decompressed->size);
+	ret = stream_write(stream, &packet, state->header.padding_size);
 	if (ret) {
+		ERR("Relay error writing data to file");
 		status = RELAY_CONNECTION_STATUS_ERROR;
 		goto end_stream_unlock;
 	}
+	conn->protocol.data.stats.write_calls++;
 
-	/*
-	 * Resetting the protocol state (to RECEIVE_HEADER) will trash the
-	 * contents of *state which are aliased (union) to the same location as
-	 * the new state. Don't use it beyond this point.
-	 */
-	connection_reset_protocol_state(conn);
+	ret = relay_data_connection_complete_packet(conn, stream, true,
+			&new_stream);
+	if (ret) {
+		status = RELAY_CONNECTION_STATUS_ERROR;
+		goto end_stream_unlock;
+	}
 	state = NULL;
 
 end_stream_unlock:
 	close_requested = stream->close_requested;
 	pthread_mutex_unlock(&stream->lock);
-	if (close_requested && left_to_receive == 0) {
+	if (close_requested) {
+		try_stream_close(stream);
+	}
+
+	if (new_stream) {
+		pthread_mutex_lock(&session->lock);
+		uatomic_set(&session->new_streams, 1);
+		pthread_mutex_unlock(&session->lock);
+	}
+
+	stream_put(stream);
+end:
+	return status;
+}
+
+/*
+ * Receive the payload of a compressed packet in the connection's compressed
+ * payload buffer.
+ */
+static enum relay_connection_status relay_process_data_receive_compressed_payload(
+		struct relay_connection *conn)
+{
+	ssize_t ret;
+	enum relay_connection_status status = RELAY_CONNECTION_STATUS_OK;
+	struct data_connection_state_receive_payload *state =
+			&conn->protocol.data.state.receive_payload;
+	struct lttng_dynamic_buffer *compressed =
+			&conn->protocol.data.compressed_payload;
+
+	if (state->left_to_receive > 0) {
+		ret = conn->sock->ops->recvmsg(conn->sock,
+				compressed->data + state->received,
+				state->left_to_receive, MSG_DONTWAIT);
+		conn->protocol.data.stats.recv_calls++;
+		if (ret < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				PERROR("Socket %d error", conn->sock->fd);
+				status = RELAY_CONNECTION_STATUS_ERROR;
+			}
+			goto end;
+		} else if (ret == 0) {
+			/* Orderly shutdown. Not necessary to print an error. */
+			DBG("Socket %d performed an orderly shutdown (received EOF)", conn->sock->fd);
+			status = RELAY_CONNECTION_STATUS_CLOSED;
+			goto end;
+		}
+
+		state->received += ret;
+		state->left_to_receive -= ret;
+		if (state->left_to_receive > 0) {
+			DBG3("Partial receive of compressed packet of stream id %" PRIu64 ", %" PRIu64 " bytes received, %" PRIu64 " bytes left to receive",
+					state->header.stream_id,
+					state->received,
+					state->left_to_receive);
+			goto end;
+		}
+	}
+
+	status = relay_data_connection_complete_compressed_packet(conn);
+end:
+	return status;
+}
+
+/*
+ * Copy the part of the current compressed packet's payload that was received
+ * in the connection's batch buffer to its compressed payload buffer.
+ */
+static enum relay_connection_status relay_process_data_batch_compressed_payload(
+		struct relay_connection *conn,
+		const struct lttng_buffer_view *payload)
+{
+	enum relay_connection_status status = RELAY_CONNECTION_STATUS_OK;
+	struct data_connection_state_receive_payload *state =
+			&conn->protocol.data.state.receive_payload;
+
+	assert(payload->size <= state->left_to_receive);
+
+	memcpy(conn->protocol.data.compressed_payload.data + state->received,
+			payload->data, payload->size);
+	state->received += payload->size;
+	state->left_to_receive -= payload->size;
+	if (state->left_to_receive > 0) {
+		DBG3("Partial receive of compressed packet of stream id %" PRIu64 ", %" PRIu64 " bytes received, %" PRIu64 " bytes left to receive",
+				state->header.stream_id, state->received,
+				state->left_to_receive);
+		goto end;
+	}
+
+	status = relay_data_connection_complete_compressed_packet(conn);
+end:
+	return status;
+}
+
+/*
+ * Write the part of the current packet's payload that was received in the
+ * connection's batch buffer. The payload's last part and the packet's
+ * padding are written with a single call.
+ */
+static enum relay_connection_status relay_process_data_batch_payload(
+		struct relay_connection *conn,
+		const struct lttng_buffer_view *payload)
+{
+	int ret;
+	enum relay_connection_status status = RELAY_CONNECTION_STATUS_OK;
+	struct relay_stream *stream;
+	struct data_connection_state_receive_payload *state =
+			&conn->protocol.data.state.receive_payload;
+	const bool packet_complete = payload->size == state->left_to_receive;
+	bool new_stream = false, close_requested = false;
+	struct relay_session *session;
+
+	assert(payload->size <= state->left_to_receive);
+
+	stream = stream_get_by_id(state->header.stream_id);
+	if (!stream) {
+		/* Protocol error. */
+		ERR("relay_process_data_batch_payload: cannot find stream %" PRIu64,
+				state->header.stream_id);
+		status = RELAY_CONNECTION_STATUS_ERROR;
+		goto end;
+	}
+
+	pthread_mutex_lock(&stream->lock);
+	session = stream->trace->session;
+	if (!conn->session) {
+		ret = connection_set_session(conn, session);
+		if (ret) {
+			status = RELAY_CONNECTION_STATUS_ERROR;
+			goto end_stream_unlock;
+		}
+	}
+
+	ret = stream_write(stream, payload,
+			packet_complete ? state->header.padding_size : 0);
+	if (ret) {
+		ERR("Relay error writing data to file");
+		status = RELAY_CONNECTION_STATUS_ERROR;
+		goto end_stream_unlock;
+	}
+	if (payload->size || (packet_complete && state->header.padding_size)) {
+		conn->protocol.data.stats.write_calls++;
+	}
+
+	state->received += payload->size;
+	state->left_to_receive -= payload->size;
+	if (!packet_complete) {
+		DBG3("Partial receive on data connection of stream id %" PRIu64 ", %" PRIu64 " bytes received, %" PRIu64 " bytes left to receive",
+				state->header.stream_id, state->received,
+				state->left_to_receive);
+		goto end_stream_unlock;
+	}
+
+	ret = relay_data_connection_complete_packet(conn, stream, true,
+			&new_stream);
+	if (ret) {
+		status = RELAY_CONNECTION_STATUS_ERROR;
+		goto end_stream_unlock;
+	}
+	state = NULL;
+
+end_stream_unlock:
+	close_requested = stream->close_requested;
+	pthread_mutex_unlock(&stream->lock);
+	if (close_requested && packet_complete) {
 		try_stream_close(stream);
 	}
 
@@ -3733,6 +4321,100 @@ end:
 	return status;
 }
 
+/*
+ * Receive as much data as is available on the socket of a data connection
+ * in its batch buffer using a single call, and process every header and
+ * payload it contains.
+ *
+ * The buffer is always consumed entirely: a partially received header is
+ * kept in the header reception buffer and a partially received payload is
+ * written immediately.
+ */
+static enum relay_connection_status relay_process_data_batch(
+		struct relay_connection *conn)
+{
+	ssize_t ret;
+	size_t offset = 0, len;
+	enum relay_connection_status status = RELAY_CONNECTION_STATUS_OK;
+	const struct data_connection_batch_buffer *buffer =
+			&conn->protocol.data.batch_buffer;
+
+	ret = conn->sock->ops->recvmsg(conn->sock, buffer->data,
+			buffer->capacity, MSG_DONTWAIT);
+	conn->protocol.data.stats.recv_calls++;
+	if (ret < 0) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK) {
+			PERROR("Socket %d error", conn->sock->fd);
+			status = RELAY_CONNECTION_STATUS_ERROR;
+		}
+		goto end;
+	} else if (ret == 0) {
+		/* Orderly shutdown. Not necessary to print an error. */
+		DBG("Socket %d performed an orderly shutdown (received EOF)", conn->sock->fd);
+		status = RELAY_CONNECTION_STATUS_CLOSED;
+		goto end;
+	}
+	len = ret;
+
+	DBG3("Received %zu bytes on data connection socket %d", len,
+			conn->sock->fd);
+
+	/*
+	 * A packet with an empty payload is completed as soon as its header
+	 * is processed.
+	 */
+	while (status == RELAY_CONNECTION_STATUS_OK && (offset < len ||
+			(conn->protocol.data.state_id ==
+					DATA_CONNECTION_STATE_RECEIVE_PAYLOAD &&
+			conn->protocol.data.state.receive_payload.left_to_receive == 0))) {
+		const size_t available = len - offset;
+
+		switch (conn->protocol.data.state_id) {
+		case DATA_CONNECTION_STATE_RECEIVE_HEADER:
+		{
+			struct data_connection_state_receive_header *state =
+					&conn->protocol.data.state.receive_header;
+			const size_t header_len =
+					min(available, state->left_to_receive);
+
+			memcpy(state->header_reception_buffer + state->received,
+					buffer->data + offset, header_len);
+			offset += header_len;
+			state->received += header_len;
+			state->left_to_receive -= header_len;
+			if (state->left_to_receive == 0) {
+				status = relay_data_connection_process_header(
+						conn);
+			}
+			break;
+		}
+		case DATA_CONNECTION_STATE_RECEIVE_PAYLOAD:
+		{
+			const struct lttng_buffer_view payload =
+					lttng_buffer_view_init(buffer->data,
+						offset,
+						min(available, conn->protocol.data.state.receive_payload.left_to_receive));
+
+			offset += payload.size;
+			if (conn->protocol.data.state.receive_payload.header.compression !=
+					LTTNG_COMPRESSION_ALGORITHM_NONE) {
+				status = relay_process_data_batch_compressed_payload(
+						conn, &payload);
+			} else {
+				status = relay_process_data_batch_payload(conn,
+						&payload);
+			}
+			break;
+		}
+		default:
+			ERR("Unexpected data connection communication state.");
+			abort();
+		}
+	}
+end:
+	return status;
+}
+
 /*
  * relay_process_data: Process the data received on the data socket
  */
@@ -3741,18 +4423,29 @@ static enum relay_connection_status relay_process_data(
 {
 	enum relay_connection_status status;
 
+	if (connection_uses_batch_reception(conn)) {
+		status = relay_process_data_batch(conn);
+		goto end;
+	}
+
 	switch (conn->protocol.data.state_id) {
 	case DATA_CONNECTION_STATE_RECEIVE_HEADER:
 		status = relay_process_data_receive_header(conn);
 		break;
 	case DATA_CONNECTION_STATE_RECEIVE_PAYLOAD:
-		status = relay_process_data_receive_payload(conn);
+		if (conn->protocol.data.state.receive_payload.header.compression !=
+				LTTNG_COMPRESSION_ALGORITHM_NONE) {
+			status = relay_process_data_receive_compressed_payload(
+					conn);
+		} else {
+			status = relay_process_data_receive_payload(conn);
+		}
 		break;
 	default:
 		ERR("Unexpected data connection communication state.");
 		abort();
 	}
-
+end:
 	return status;
 }
 
@@ -3769,7 +4462,8 @@ static void cleanup_connection_pollfd(struct lttng_poll_event *events, int pollf
 	}
 }
 
-static void relay_thread_close_connection(struct lttng_poll_event *events,
+static void relay_thread_close_connection(struct relay_worker *worker,
+		struct lttng_poll_event *events,
 		int pollfd, struct relay_connection *conn)
 {
 	const char *type_str;
@@ -3792,7 +4486,9 @@ static void relay_thread_close_connection(struct lttng_poll_event *events,
 	}
 	cleanup_connection_pollfd(events, pollfd);
 	connection_put(conn);
-	DBG("%s connection closed with %d", type_str, pollfd);
+	uatomic_dec(&worker->connection_count);
+	DBG("%s connection closed with %d by worker %u", type_str, pollfd,
+			worker->id);
 }
 
 /*
@@ -3806,8 +4502,9 @@ static void *relay_thread_worker(void *data)
 	struct lttng_ht *relay_connections_ht;
 	struct lttng_ht_iter iter;
 	struct relay_connection *destroy_conn = NULL;
+	struct relay_worker *worker = data;
 
-	DBG("[thread] Relay worker started");
+	DBG("[thread] Relay worker %u started", worker->id);
 
 	rcu_register_thread();
 
@@ -3830,7 +4527,7 @@ static void *relay_thread_worker(void *data)
 		goto error_poll_create;
 	}
 
-	ret = lttng_poll_add(&events, relay_conn_pipe[0], LPOLLIN | LPOLLRDHUP);
+	ret = lttng_poll_add(&events, worker->conn_pipe[0], LPOLLIN | LPOLLRDHUP);
 	if (ret < 0) {
 		goto error;
 	}
@@ -3878,11 +4575,11 @@ restart:
 			}
 
 			/* Inspect the relay conn pipe for new connection */
-			if (pollfd == relay_conn_pipe[0]) {
+			if (pollfd == worker->conn_pipe[0]) {
 				if (revents & LPOLLIN) {
 					struct relay_connection *conn;
 
-					ret = lttng_read(relay_conn_pipe[0], &conn, sizeof(conn));
+					ret = lttng_read(worker->conn_pipe[0], &conn, sizeof(conn));
 					if (ret < 0) {
 						goto error;
 					}
@@ -3894,7 +4591,22 @@ restart:
 						goto error;
 					}
 					connection_ht_add(relay_connections_ht, conn);
-					DBG("Connection socket %d added", conn->sock->fd);
+					DBG("Connection socket %d added to worker %u",
+							conn->sock->fd, worker->id);
+					if (conn->type == RELAY_DATA &&
+							opt_data_receive_mode == RELAYD_DATA_RECEIVE_MODE_SPLICE &&
+							connection_enable_splice(conn)) {
+						WARN("Failed to enable splicing on data connection socket %d, falling back to the reception of payloads by copy",
+								conn->sock->fd);
+						connection_disable_splice(conn);
+					}
+					if (conn->type == RELAY_DATA &&
+							opt_data_receive_mode == RELAYD_DATA_RECEIVE_MODE_BATCH &&
+							connection_enable_batch_reception(conn,
+								DEFAULT_RELAYD_BATCH_RECEIVE_BUFFER_SIZE)) {
+						WARN("Failed to enable batch reception on data connection socket %d, falling back to the reception of payloads by copy",
+								conn->sock->fd);
+					}
 				} else if (revents & (LPOLLERR | LPOLLHUP | LPOLLRDHUP)) {
 					ERR("Relay connection pipe error");
 					goto error;
@@ -3948,13 +4660,13 @@ restart:
 						}
 
 						/* Clear the connection on error or close. */
-						relay_thread_close_connection(&events,
+						relay_thread_close_connection(worker, &events,
 								pollfd,
 								ctrl_conn);
 					}
 					seen_control = 1;
 				} else if (revents & (LPOLLERR | LPOLLHUP | LPOLLRDHUP)) {
-					relay_thread_close_connection(&events,
+					relay_thread_close_connection(worker, &events,
 							pollfd, ctrl_conn);
 					if (last_seen_data_fd == pollfd) {
 						last_seen_data_fd = last_notdel_data_fd;
@@ -4006,7 +4718,7 @@ restart:
 			}
 
 			/* Skip the command pipe. It's handled in the first loop. */
-			if (pollfd == relay_conn_pipe[0]) {
+			if (pollfd == worker->conn_pipe[0]) {
 				continue;
 			}
 
@@ -4045,7 +4757,7 @@ restart:
 					if (status == RELAY_CONNECTION_STATUS_ERROR) {
 						session_abort(data_conn->session);
 					}
-					relay_thread_close_connection(&events, pollfd,
+					relay_thread_close_connection(worker, &events, pollfd,
 							data_conn);
 					/*
 					 * Every goto restart call sets the last seen fd where
@@ -4059,7 +4771,7 @@ restart:
 					goto restart;
 				}
 			} else if (revents & (LPOLLERR | LPOLLHUP | LPOLLRDHUP)) {
-				relay_thread_close_connection(&events, pollfd,
+				relay_thread_close_connection(worker, &events, pollfd,
 						data_conn);
 			} else {
 				ERR("Unknown poll events %u for data sock %d",
@@ -4089,7 +4801,7 @@ error:
 		 * No need to grab another ref, because we own
 		 * destroy_conn.
 		 */
-		relay_thread_close_connection(&events, destroy_conn->sock->fd,
+		relay_thread_close_connection(worker, &events, destroy_conn->sock->fd,
 				destroy_conn);
 	}
 	rcu_read_unlock();
@@ -4098,13 +4810,10 @@ error:
 error_poll_create:
 	lttng_ht_destroy(relay_connections_ht);
 relay_connections_ht_error:
-	/* Close relay conn pipes */
-	(void) fd_tracker_util_pipe_close(the_fd_tracker,
-			relay_conn_pipe);
 	if (err) {
 		DBG("Thread exited with error");
 	}
-	DBG("Worker thread cleanup complete");
+	DBG("Worker thread %u cleanup complete", worker->id);
 error_testpoint:
 	if (err) {
 		health_error();
@@ -4116,16 +4825,6 @@ error_testpoint:
 	return NULL;
 }
 
-/*
- * Create the relay command pipe to wake thread_manage_apps.
- * Closed in cleanup().
- */
-static int create_relay_conn_pipe(void)
-{
-	return fd_tracker_util_pipe_open_cloexec(the_fd_tracker,
-			"Relayd connection pipe", relay_conn_pipe);
-}
-
 static int stdio_open(void *data, int *fds)
 {
 	fds[0] = fileno(stdout);
@@ -4269,6 +4968,19 @@ int main(int argc, char **argv)
 		goto exit_options;
 	}
 
+	relay_packet_cache_set_max_size(opt_live_packet_cache_size);
+	relay_write_buffer_set_size(opt_stream_write_buffer_size);
+
+	if (opt_async_output_threads > 0) {
+		the_async_writer = fs_handle_async_writer_create(
+				opt_async_output_threads,
+				DEFAULT_RELAYD_ASYNC_OUTPUT_MAX_PENDING_SIZE);
+		if (!the_async_writer) {
+			retval = -1;
+			goto exit_options;
+		}
+	}
+
 	/* Initialize thread health monitoring */
 	health_relayd = health_app_create(NR_HEALTH_RELAYD_TYPES);
 	if (!health_relayd) {
@@ -4283,8 +4995,9 @@ int main(int argc, char **argv)
 		goto exit_options;
 	}
 
-	/* Setup the thread apps communication pipe. */
-	if (create_relay_conn_pipe()) {
+	/* Setup the worker threads' communication pipes. */
+	if (relay_worker_pool_create(&relay_worker_pool, "Relayd worker",
+			opt_worker_threads, sizeof(struct relay_worker))) {
 		retval = -1;
 		goto exit_options;
 	}
@@ -4343,13 +5056,12 @@ int main(int argc, char **argv)
 		goto exit_dispatcher_thread;
 	}
 
-	/* Setup the worker thread */
-	ret = pthread_create(&worker_thread, default_pthread_attr(),
-			relay_thread_worker, NULL);
+	/* Setup the worker threads */
+	ret = relay_worker_pool_launch(&relay_worker_pool, relay_thread_worker);
 	if (ret) {
-		errno = ret;
-		PERROR("pthread_create worker");
 		retval = -1;
+		/* Stop the worker threads that were already launched. */
+		lttng_relay_stop_threads();
 		goto exit_worker_thread;
 	}
 
@@ -4363,7 +5075,7 @@ int main(int argc, char **argv)
 		goto exit_listener_thread;
 	}
 
-	ret = relayd_live_create(live_uri);
+	ret = relayd_live_create(live_uri, opt_live_worker_threads);
 	if (ret) {
 		ERR("Starting live viewer threads");
 		retval = -1;
@@ -4389,14 +5101,11 @@ exit_live:
 	}
 
 exit_listener_thread:
-	ret = pthread_join(worker_thread, &status);
-	if (ret) {
-		errno = ret;
-		PERROR("pthread_join worker_thread");
+exit_worker_thread:
+	if (relay_worker_pool_join(&relay_worker_pool)) {
 		retval = -1;
 	}
 
-exit_worker_thread:
 	ret = pthread_join(dispatcher_thread, &status);
 	if (ret) {
 		errno = ret;
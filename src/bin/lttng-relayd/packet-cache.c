@@ -0,0 +1,306 @@
+/*
+ * Copyright (C) 2020 EfficiOS Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ */
+
+#define _LGPL_SOURCE
+#include <stdbool.h>
+#include <string.h>
+#include <urcu/uatomic.h>
+
+#include <common/common.h>
+
+#include "packet-cache.h"
+
+/*
+ * Maximal number of packets cached per stream. The live viewers read the
+ * packets shortly after their indexes are received: only the most recent
+ * packets are worth keeping.
+ */
+#define PACKET_CACHE_MAX_STREAM_PACKETS	16
+
+/* Maximal size of the packets cached by all streams; 0 disables the cache. */
+static uint64_t max_cached_size;
+/* Size of the packets held by all caches and viewers. */
+static unsigned long cached_size;
+
+static struct {
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long insertions;
+	unsigned long evictions;
+	/* Packets not cached because the memory cap was reached. */
+	unsigned long drops;
+} stats;
+
+void relay_packet_cache_set_max_size(uint64_t size)
+{
+	max_cached_size = size;
+}
+
+void relay_packet_cache_log_stats(void)
+{
+	const unsigned long hits = uatomic_read(&stats.hits);
+	const unsigned long misses = uatomic_read(&stats.misses);
+
+	if (!max_cached_size) {
+		return;
+	}
+
+	DBG("Live packet cache: %lu hits, %lu misses (%.1f%% hit rate), %lu insertions, %lu evictions, %lu packets dropped by the %" PRIu64 " bytes cap",
+			hits, misses,
+			hits + misses ? 100.0 * hits / (hits + misses) : 0.0,
+			uatomic_read(&stats.insertions),
+			uatomic_read(&stats.evictions),
+			uatomic_read(&stats.drops), max_cached_size);
+}
+
+/*
+ * Account for `size` more bytes of cached packets unless it would exceed the
+ * cap. The caches of all streams are filled concurrently by the workers.
+ */
+static bool reserve_cached_size(size_t size)
+{
+	unsigned long old_size, cur_size = uatomic_read(&cached_size);
+
+	do {
+		old_size = cur_size;
+		if (old_size + size > max_cached_size) {
+			return false;
+		}
+		cur_size = uatomic_cmpxchg(&cached_size, old_size,
+				old_size + size);
+	} while (cur_size != old_size);
+
+	return true;
+}
+
+static void entry_release(struct urcu_ref *ref)
+{
+	struct relay_packet_cache_entry *entry = caa_container_of(ref,
+			struct relay_packet_cache_entry, ref);
+
+	uatomic_sub(&cached_size, entry->size);
+	free(entry->data);
+	free(entry);
+}
+
+void relay_packet_cache_entry_put(struct relay_packet_cache_entry *entry)
+{
+	urcu_ref_put(&entry->ref, entry_release);
+}
+
+static void evict_oldest_entry(struct relay_packet_cache *cache)
+{
+	struct relay_packet_cache_entry *entry = cds_list_first_entry(
+			&cache->entries, struct relay_packet_cache_entry, node);
+
+	cds_list_del(&entry->node);
+	cache->entry_count--;
+	uatomic_inc(&stats.evictions);
+	relay_packet_cache_entry_put(entry);
+}
+
+static void drop_entries(struct relay_packet_cache *cache)
+{
+	struct relay_packet_cache_entry *entry, *tmp;
+
+	cds_list_for_each_entry_safe(entry, tmp, &cache->entries, node) {
+		cds_list_del(&entry->node);
+		relay_packet_cache_entry_put(entry);
+	}
+	cache->entry_count = 0;
+}
+
+void relay_packet_cache_init(struct relay_packet_cache *cache)
+{
+	memset(cache, 0, sizeof(*cache));
+	CDS_INIT_LIST_HEAD(&cache->entries);
+	lttng_dynamic_buffer_init(&cache->staging);
+}
+
+void relay_packet_cache_fini(struct relay_packet_cache *cache)
+{
+	relay_packet_cache_reset(cache);
+	lttng_dynamic_buffer_reset(&cache->staging);
+}
+
+void relay_packet_cache_reset(struct relay_packet_cache *cache)
+{
+	drop_entries(cache);
+	cache->file_set = false;
+	cache->staging_valid = false;
+}
+
+void relay_packet_cache_set_file(struct relay_packet_cache *cache, int fd)
+{
+	struct stat file_stat;
+
+	relay_packet_cache_reset(cache);
+	if (!max_cached_size) {
+		return;
+	}
+
+	if (fstat(fd, &file_stat)) {
+		PERROR("Failed to stat trace file, its packets will not be cached");
+		return;
+	}
+
+	cache->file_dev = file_stat.st_dev;
+	cache->file_ino = file_stat.st_ino;
+	cache->file_set = true;
+}
+
+void relay_packet_cache_begin_packet(struct relay_packet_cache *cache)
+{
+	if (!cache->file_set) {
+		return;
+	}
+
+	/* Keeps the staging buffer's storage. */
+	(void) lttng_dynamic_buffer_set_size(&cache->staging, 0);
+	cache->staging_valid = true;
+}
+
+void relay_packet_cache_append(struct relay_packet_cache *cache,
+		const void *data, size_t len)
+{
+	int ret;
+
+	if (!cache->staging_valid || len == 0) {
+		return;
+	}
+
+	if (data) {
+		ret = lttng_dynamic_buffer_append(&cache->staging, data, len);
+	} else {
+		/* The buffer's new bytes are zeroed. */
+		ret = lttng_dynamic_buffer_set_size(&cache->staging,
+				cache->staging.size + len);
+	}
+	if (ret) {
+		DBG("Failed to stage packet data, the packet will not be cached");
+		cache->staging_valid = false;
+	}
+}
+
+void relay_packet_cache_abort_packet(struct relay_packet_cache *cache)
+{
+	cache->staging_valid = false;
+}
+
+void relay_packet_cache_commit_packet(struct relay_packet_cache *cache,
+		uint64_t offset, size_t size)
+{
+	struct relay_packet_cache_entry *entry;
+
+	if (!cache->staging_valid || cache->staging.size != size ||
+			size == 0) {
+		goto end;
+	}
+
+	while (cache->entry_count >= PACKET_CACHE_MAX_STREAM_PACKETS) {
+		evict_oldest_entry(cache);
+	}
+	while (!reserve_cached_size(size)) {
+		if (cache->entry_count == 0) {
+			uatomic_inc(&stats.drops);
+			goto end;
+		}
+		evict_oldest_entry(cache);
+	}
+
+	entry = zmalloc(sizeof(*entry));
+	if (!entry) {
+		PERROR("packet cache entry zmalloc");
+		uatomic_sub(&cached_size, size);
+		goto end;
+	}
+
+	urcu_ref_init(&entry->ref);
+	entry->offset = offset;
+	entry->size = size;
+	/* Steal the staged data; the next packet is staged in a new buffer. */
+	entry->data = cache->staging.data;
+	lttng_dynamic_buffer_init(&cache->staging);
+
+	cds_list_add_tail(&entry->node, &cache->entries);
+	cache->entry_count++;
+	uatomic_inc(&stats.insertions);
+end:
+	cache->staging_valid = false;
+}
+
+static bool cache_holds_file(const struct relay_packet_cache *cache,
+		const struct stat *file_stat)
+{
+	return cache->file_set && cache->file_dev == file_stat->st_dev &&
+			cache->file_ino == file_stat->st_ino;
+}
+
+struct relay_packet_cache_entry *relay_packet_cache_get(
+		struct relay_packet_cache *cache, const struct stat *file_stat,
+		uint64_t offset, size_t len)
+{
+	struct relay_packet_cache_entry *entry, *found = NULL;
+
+	if (!cache_holds_file(cache, file_stat)) {
+		goto end;
+	}
+
+	/* The most recent packets are the most likely to be requested. */
+	cds_list_for_each_entry_reverse(entry, &cache->entries, node) {
+		if (entry->offset == offset) {
+			if (len <= entry->size) {
+				urcu_ref_get(&entry->ref);
+				found = entry;
+			}
+			break;
+		} else if (entry->offset < offset) {
+			break;
+		}
+	}
+end:
+	uatomic_inc(found ? &stats.hits : &stats.misses);
+	return found;
+}
+
+int relay_packet_cache_read(struct relay_packet_cache *cache,
+		const struct stat *file_stat, uint64_t offset, size_t len,
+		void *dst)
+{
+	int ret = -1;
+	char *pos = dst;
+	struct relay_packet_cache_entry *entry;
+
+	if (!cache_holds_file(cache, file_stat)) {
+		goto end;
+	}
+
+	cds_list_for_each_entry(entry, &cache->entries, node) {
+		size_t entry_offset, copy_len;
+
+		if (entry->offset + entry->size <= offset) {
+			continue;
+		} else if (entry->offset > offset) {
+			/* The range is not cached contiguously. */
+			break;
+		}
+
+		entry_offset = offset - entry->offset;
+		copy_len = min(len, entry->size - entry_offset);
+		memcpy(pos, entry->data + entry_offset, copy_len);
+		pos += copy_len;
+		offset += copy_len;
+		len -= copy_len;
+		if (len == 0) {
+			ret = 0;
+			break;
+		}
+	}
+end:
+	uatomic_inc(ret ? &stats.misses : &stats.hits);
+	return ret;
+}
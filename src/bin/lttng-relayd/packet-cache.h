@@ -0,0 +1,136 @@
+#ifndef _PACKET_CACHE_H
+#define _PACKET_CACHE_H
+
+/*
+ * Copyright (C) 2020 EfficiOS Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <urcu/list.h>
+#include <urcu/ref.h>
+
+#include <common/dynamic-buffer.h>
+
+/*
+ * A packet received by the relay daemon, kept in memory so that the live
+ * viewers do not have to read it back from its trace file.
+ *
+ * An entry is immutable once published. A viewer holds a reference to it
+ * while the packet is sent, which allows the stream to evict it
+ * concurrently.
+ */
+struct relay_packet_cache_entry {
+	struct urcu_ref ref;
+	/* Member of the `entries` list of the cache. */
+	struct cds_list_head node;
+	/* Offset of the packet in its trace file. */
+	uint64_t offset;
+	size_t size;
+	char *data;
+};
+
+/*
+ * Cache of the most recently received packets of a live stream.
+ *
+ * The cached packets all belong to the trace file currently written by the
+ * stream; they are identified by their offset in that file. The viewers read
+ * the trace files through their own file descriptors: the device and inode
+ * of the file are used to make sure a viewer reads the same file.
+ *
+ * Protected by the lock of the stream owning the cache.
+ */
+struct relay_packet_cache {
+	/* The packets are only cached when the file's identity is known. */
+	bool file_set;
+	dev_t file_dev;
+	ino_t file_ino;
+	/* Ordered by increasing offset. */
+	struct cds_list_head entries;
+	unsigned int entry_count;
+	/*
+	 * Packet being received. The packets are received in parts and only
+	 * cached once complete.
+	 */
+	struct lttng_dynamic_buffer staging;
+	bool staging_valid;
+};
+
+/*
+ * Set the maximal amount of memory, in bytes, used by the packets cached by
+ * all streams. The cache is disabled when `size` is 0.
+ *
+ * Must be called before any stream is created.
+ */
+void relay_packet_cache_set_max_size(uint64_t size);
+
+/*
+ * Log the hit and miss counts of the packet caches. The relay daemon has no
+ * statistics interface: they are only logged at the debug level, on exit.
+ */
+void relay_packet_cache_log_stats(void);
+
+void relay_packet_cache_init(struct relay_packet_cache *cache);
+void relay_packet_cache_fini(struct relay_packet_cache *cache);
+
+/*
+ * Drop the cached packets and start caching the packets written to the file
+ * open on `fd`.
+ */
+void relay_packet_cache_set_file(struct relay_packet_cache *cache, int fd);
+
+/*
+ * Drop the cached packets and stop caching packets. Must be called when the
+ * trace file is closed since its inode may then be reused.
+ */
+void relay_packet_cache_reset(struct relay_packet_cache *cache);
+
+/* Start staging a new packet. */
+void relay_packet_cache_begin_packet(struct relay_packet_cache *cache);
+
+/* Append packet data, or `len` bytes of padding if `data` is NULL. */
+void relay_packet_cache_append(struct relay_packet_cache *cache,
+		const void *data, size_t len);
+
+/*
+ * The packet being received is not staged in full (e.g. its data did not
+ * go through the relay daemon's memory); it will not be cached.
+ */
+void relay_packet_cache_abort_packet(struct relay_packet_cache *cache);
+
+/*
+ * Cache the staged packet which was written at `offset` in the trace file.
+ * The packet is not cached if `size` bytes were not staged.
+ */
+void relay_packet_cache_commit_packet(struct relay_packet_cache *cache,
+		uint64_t offset, size_t size);
+
+/*
+ * Get a reference to the cached packet starting at `offset` in the file
+ * described by `file_stat` if it holds at least `len` bytes.
+ *
+ * Returns NULL on a cache miss.
+ */
+struct relay_packet_cache_entry *relay_packet_cache_get(
+		struct relay_packet_cache *cache, const struct stat *file_stat,
+		uint64_t offset, size_t len);
+
+void relay_packet_cache_entry_put(struct relay_packet_cache_entry *entry);
+
+/*
+ * Copy `len` bytes, starting at `offset` in the file described by
+ * `file_stat`, from contiguous cached packets.
+ *
+ * Returns 0 on success, -1 on a cache miss.
+ */
+int relay_packet_cache_read(struct relay_packet_cache *cache,
+		const struct stat *file_stat, uint64_t offset, size_t len,
+		void *dst);
+
+#endif /* _PACKET_CACHE_H */
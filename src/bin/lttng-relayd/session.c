@@ -15,6 +15,7 @@
 #include <common/utils.h>
 #include <common/uuid.h>
 #include <urcu/rculist.h>
+#include <urcu/uatomic.h>
 
 #include <sys/stat.h>
 
@@ -325,6 +326,7 @@ struct relay_session *session_create(const char *session_name,
 	CDS_INIT_LIST_HEAD(&session->recv_list);
 	pthread_mutex_init(&session->lock, NULL);
 	pthread_mutex_init(&session->recv_list_lock, NULL);
+	session->viewer_wake_fd = -1;
 
 	if (lttng_strncpy(session->session_name, session_name,
 			sizeof(session->session_name))) {
@@ -552,6 +554,7 @@ int session_close(struct relay_session *session)
 			session->id, session->connection_closed);
 	session->connection_closed = true;
 	pthread_mutex_unlock(&session->lock);
+	session_notify_live_viewer(session);
 
 	rcu_read_lock();
 	cds_lfht_for_each_entry(session->ctf_traces_ht->ht,
@@ -576,6 +579,41 @@ rcu_unlock:
 	return ret;
 }
 
+/*
+ * Wake up the live viewer of a session if it is waiting for new data.
+ */
+void session_notify_live_viewer(struct relay_session *session)
+{
+	int wake_fd;
+	const char wake = 0;
+
+	if (!session->live_timer) {
+		return;
+	}
+
+	/*
+	 * Implies a full memory barrier: the live worker either sees the new
+	 * sequence number when it starts waiting or its wake-up pipe is seen
+	 * here.
+	 */
+	(void) uatomic_add_return(&session->viewer_new_data_seq, 1);
+	wake_fd = uatomic_read(&session->viewer_wake_fd);
+	if (wake_fd < 0 ||
+			uatomic_cmpxchg(&session->viewer_wake_pending, 0, 1)) {
+		return;
+	}
+
+	/*
+	 * The pipe is non-blocking: if it is full, the worker is bound to
+	 * check the session anyway.
+	 */
+	if (lttng_write(wake_fd, &wake, sizeof(wake)) != sizeof(wake) &&
+			errno != EAGAIN) {
+		PERROR("Failed to wake up the live viewer of session %" PRIu64,
+				session->id);
+	}
+}
+
 int session_abort(struct relay_session *session)
 {
 	int ret = 0;
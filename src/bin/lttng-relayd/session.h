@@ -117,6 +117,22 @@ struct relay_session {
 	 */
 	unsigned long new_streams;
 
+	/*
+	 * Incremented, with uatomic, whenever new data may be available to
+	 * the live viewer: an index, a live beacon or new streams were
+	 * received, or a stream was closed.
+	 */
+	unsigned long viewer_new_data_seq;
+	/*
+	 * Write end of the wake-up pipe of the live worker holding a
+	 * LTTNG_VIEWER_WAIT_NEW_DATA request of the session's viewer, -1 when
+	 * the viewer is not waiting. viewer_wake_pending is set once the
+	 * worker has been woken up, so that it is only woken up once until it
+	 * checks the session again. Both are accessed with uatomic.
+	 */
+	int viewer_wake_fd;
+	int viewer_wake_pending;
+
 	/*
 	 * Node in the global session hash table.
 	 */
@@ -154,6 +170,7 @@ bool session_get(struct relay_session *session);
 void session_put(struct relay_session *session);
 
 int session_close(struct relay_session *session);
+void session_notify_live_viewer(struct relay_session *session);
 int session_abort(struct relay_session *session);
 
 void print_sessions(void);
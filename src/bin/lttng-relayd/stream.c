@@ -73,6 +73,104 @@ static void stream_complete_rotation(struct relay_stream *stream)
 	stream->ongoing_rotation = (typeof(stream->ongoing_rotation)) {};
 }
 
+/*
+ * Write the data buffered by the stream to its data file.
+ *
+ * Return 0 on success, a negative value on error.
+ */
+int stream_flush_write_buffer(struct relay_stream *stream)
+{
+	int ret = 0;
+
+	ASSERT_LOCKED(stream->lock);
+
+	if (!stream->file) {
+		goto end;
+	}
+
+	ret = relay_write_buffer_flush(&stream->write_buffer, stream->file);
+	if (ret) {
+		PERROR("Failed to write buffered data to stream file of stream %" PRIu64,
+				stream->stream_handle);
+		ret = -1;
+	}
+end:
+	return ret;
+}
+
+/*
+ * Allocate the storage of the stream's data file ahead of the write of a
+ * `packet_size` bytes packet.
+ */
+static void stream_preallocate_data_file(struct relay_stream *stream,
+		size_t packet_size)
+{
+	int fd;
+	const uint64_t size = stream->tracefile_size_current + packet_size;
+
+	if (!opt_trace_file_preallocation_size || stream->is_metadata ||
+			stream->file_preallocation_failed ||
+			size <= stream->file_allocated_size) {
+		return;
+	}
+
+	fd = fs_handle_get_fd(stream->file);
+	if (fd < 0) {
+		return;
+	}
+
+	if (utils_preallocate_stream_file(fd, size,
+			opt_trace_file_preallocation_size,
+			stream->tracefile_size,
+			&stream->file_allocated_size)) {
+		PERROR("Failed to preallocate data file of stream %" PRIu64 ", it will grow with its writes",
+				stream->stream_handle);
+		stream->file_preallocation_failed = true;
+	}
+	fs_handle_put_fd(stream->file);
+}
+
+/*
+ * Release the storage allocated past the end of the stream's data file.
+ */
+static void stream_release_data_file_preallocation(struct relay_stream *stream)
+{
+	int fd;
+
+	if (!stream->file_allocated_size) {
+		return;
+	}
+
+	fd = fs_handle_get_fd(stream->file);
+	if (fd < 0) {
+		return;
+	}
+
+	(void) utils_release_stream_file_preallocation(fd,
+			&stream->file_allocated_size);
+	fs_handle_put_fd(stream->file);
+}
+
+/*
+ * Close the stream's data file. Its cached packets are dropped since the
+ * inode of the file may be reused once it is closed.
+ */
+static int stream_close_data_file(struct relay_stream *stream)
+{
+	int ret = 0;
+
+	relay_packet_cache_reset(&stream->packet_cache);
+	if (stream->file) {
+		ret = stream_flush_write_buffer(stream);
+		stream_release_data_file_preallocation(stream);
+		if (fs_handle_close(stream->file)) {
+			ret = -1;
+		}
+		stream->file = NULL;
+	}
+	return ret;
+}
+
 static int stream_create_data_output_file_from_trace_chunk(
 		struct relay_stream *stream,
 		struct lttng_trace_chunk *trace_chunk,
@@ -125,6 +223,43 @@ static int stream_create_data_output_file_from_trace_chunk(
 		ret = -1;
 		goto end;
 	}
+	stream->file_allocated_size = 0;
+	stream->file_preallocation_failed = false;
+
+	/*
+	 * Live viewers read the data described by the indexes as soon as
+	 * they are written; the data must be in the file by then.
+	 */
+	if (the_async_writer && !stream->trace->session->live_timer) {
+		struct fs_handle *async_file = fs_handle_async_create(
+				the_async_writer, *out_file);
+
+		if (!async_file) {
+			ERR("Failed to create asynchronous handle for stream file \"%s\"",
+					stream->channel_name);
+			fs_handle_close(*out_file);
+			*out_file = NULL;
+			ret = -1;
+			goto end;
+		}
+		*out_file = async_file;
+		/* Extending the file would wait for the queued writes. */
+		relay_write_buffer_set_sparse_padding(&stream->write_buffer,
+				false);
+	} else if (stream->trace->session->live_timer) {
+		const int fd = fs_handle_get_fd(*out_file);
+
+		/* The packets are cached as they are written. */
+		if (fd >= 0) {
+			relay_packet_cache_set_file(&stream->packet_cache, fd);
+			fs_handle_put_fd(*out_file);
+		}
+		relay_write_buffer_set_sparse_padding(&stream->write_buffer,
+				true);
+	} else {
+		relay_write_buffer_set_sparse_padding(&stream->write_buffer,
+				true);
+	}
 end:
 	return ret;
 }
@@ -136,10 +271,7 @@ static int stream_rotate_data_file(struct relay_stream *stream)
 	DBG("Rotating stream %" PRIu64 " data file with size %" PRIu64,
 			stream->stream_handle, stream->tracefile_size_current);
 
-	if (stream->file) {
-		fs_handle_close(stream->file);
-		stream->file = NULL;
-	}
+	(void) stream_close_data_file(stream);
 
 	stream->tracefile_wrapped_around = false;
 	stream->tracefile_current_index = 0;
@@ -225,8 +357,15 @@ static int rotate_truncate_stream(struct relay_stream *stream)
 	 * to the new file.
 	 */
 	assert(stream->file);
+	/* The misplaced data is read back from the previous file. */
+	ret = stream_flush_write_buffer(stream);
+	if (ret) {
+		goto end;
+	}
 	previous_stream_file = stream->file;
 	stream->file = NULL;
+	/* The previous file is about to be truncated. */
+	relay_packet_cache_reset(&stream->packet_cache);
 
 	assert(!stream->is_metadata);
 	assert(stream->tracefile_size_current >
@@ -553,10 +692,7 @@ static int stream_set_trace_chunk(struct relay_stream *stream,
 	assert(acquired_reference);
 	stream->trace_chunk = chunk;
 
-	if (stream->file) {
-		fs_handle_close(stream->file);
-		stream->file = NULL;
-	}
+	(void) stream_close_data_file(stream);
 	ret = stream_create_data_output_file_from_trace_chunk(stream, chunk,
 			false, &stream->file);
 end:
@@ -592,9 +728,17 @@ struct relay_stream *stream_create(struct ctf_trace *trace,
 	stream->tracefile_count = tracefile_count;
 	stream->path_name = path_name;
 	stream->channel_name = channel_name;
+	stream->is_metadata = !strcmp(stream->channel_name,
+			DEFAULT_METADATA_NAME);
 	stream->beacon_ts_end = -1ULL;
 	lttng_ht_node_init_u64(&stream->node, stream->stream_handle);
 	pthread_mutex_init(&stream->lock, NULL);
+	relay_packet_cache_init(&stream->packet_cache);
+	/*
+	 * The live viewers read the metadata up to the amount received; it is
+	 * written as soon as it is received.
+	 */
+	relay_write_buffer_init(&stream->write_buffer, !stream->is_metadata);
 	urcu_ref_init(&stream->ref);
 	ctf_trace_get(trace);
 	stream->trace = trace;
@@ -635,8 +779,6 @@ struct relay_stream *stream_create(struct ctf_trace *trace,
 		goto end;
 	}
 
-	stream->is_metadata = !strcmp(stream->channel_name,
-			DEFAULT_METADATA_NAME);
 	stream->in_recv_list = true;
 
 	/*
@@ -661,10 +803,7 @@ struct relay_stream *stream_create(struct ctf_trace *trace,
 
 end:
 	if (ret) {
-		if (stream->file) {
-		        fs_handle_close(stream->file);
-			stream->file = NULL;
-		}
+		(void) stream_close_data_file(stream);
 		stream_put(stream);
 		stream = NULL;
 	}
@@ -786,10 +925,9 @@ static void stream_release(struct urcu_ref *ref)
 
 	stream_unpublish(stream);
 
-	if (stream->file) {
-		fs_handle_close(stream->file);
-		stream->file = NULL;
-	}
+	(void) stream_close_data_file(stream);
+	relay_packet_cache_fini(&stream->packet_cache);
+	relay_write_buffer_fini(&stream->write_buffer);
 	if (stream->index_file) {
 		lttng_index_file_put(stream->index_file);
 		stream->index_file = NULL;
@@ -968,10 +1106,7 @@ void try_stream_close(struct relay_stream *stream)
 	 */
 
 	/* Put stream fd before put chunk. */
-	if (stream->file) {
-		fs_handle_close(stream->file);
-		stream->file = NULL;
-	}
+	(void) stream_close_data_file(stream);
 	if (stream->index_file) {
 		lttng_index_file_put(stream->index_file);
 		stream->index_file = NULL;
@@ -979,6 +1114,7 @@ void try_stream_close(struct relay_stream *stream)
 	lttng_trace_chunk_put(stream->trace_chunk);
 	stream->trace_chunk = NULL;
 	pthread_mutex_unlock(&stream->lock);
+	session_notify_live_viewer(session);
 	DBG("Succeeded in closing stream %" PRIu64, stream->stream_handle);
 	stream_put(stream);
 }
@@ -1024,10 +1160,7 @@ int stream_init_packet(struct relay_stream *stream, size_t packet_size,
 		tracefile_array_file_rotate(stream->tfa, TRACEFILE_ROTATE_WRITE);
 		stream->tracefile_current_index = new_file_index;
 
-		if (stream->file) {
-		        fs_handle_close(stream->file);
-			stream->file = NULL;
-		}
+		(void) stream_close_data_file(stream);
 		ret = stream_create_data_output_file_from_trace_chunk(stream,
 				stream->trace_chunk, false, &stream->file);
 		if (ret) {
@@ -1048,6 +1181,10 @@ int stream_init_packet(struct relay_stream *stream, size_t packet_size,
 		*file_rotated = false;
 	}
 end:
+	if (!ret) {
+		stream_preallocate_data_file(stream, packet_size);
+		relay_packet_cache_begin_packet(&stream->packet_cache);
+	}
 	return ret;
 }
 
@@ -1056,13 +1193,8 @@ int stream_write(struct relay_stream *stream,
 		const struct lttng_buffer_view *packet, size_t padding_len)
 {
 	int ret = 0;
-	ssize_t write_ret;
-	size_t padding_to_write = padding_len;
-	char padding_buffer[FILE_IO_STACK_BUFFER_SIZE];
 
 	ASSERT_LOCKED(stream->lock);
-	memset(padding_buffer, 0,
-			min(sizeof(padding_buffer), padding_to_write));
 
 	if (!stream->file || !stream->trace_chunk) {
 		ERR("Protocol error: received a packet for a stream that doesn't have a current trace chunk: stream_id = %" PRIu64 ", channel_name = %s",
@@ -1070,39 +1202,40 @@ int stream_write(struct relay_stream *stream,
 		ret = -1;
 		goto end;
 	}
-	if (packet) {
-		write_ret = fs_handle_write(
-				stream->file, packet->data, packet->size);
-		if (write_ret != packet->size) {
-			PERROR("Failed to write to stream file of %sstream %" PRIu64,
-					stream->is_metadata ? "metadata " : "",
-					stream->stream_handle);
-			ret = -1;
-			goto end;
-		}
-	}
-
-	while (padding_to_write > 0) {
-		const size_t padding_to_write_this_pass =
-				min(padding_to_write, sizeof(padding_buffer));
 
-		write_ret = fs_handle_write(stream->file, padding_buffer,
-				padding_to_write_this_pass);
-		if (write_ret != padding_to_write_this_pass) {
-			PERROR("Failed to write padding to file of %sstream %" PRIu64,
-					stream->is_metadata ? "metadata " : "",
-					stream->stream_handle);
-			ret = -1;
-			goto end;
-		}
-		padding_to_write -= padding_to_write_this_pass;
+	ret = relay_write_buffer_write(&stream->write_buffer, stream->file,
+			packet ? packet->data : NULL,
+			packet ? packet->size : 0, padding_len);
+	if (ret) {
+		PERROR("Failed to write to stream file of %sstream %" PRIu64,
+				stream->is_metadata ? "metadata " : "",
+				stream->stream_handle);
+		ret = -1;
+		goto end;
 	}
 
-	if (stream->is_metadata) {
+	if (!stream->is_metadata) {
+		relay_packet_cache_append(&stream->packet_cache,
+				packet ? packet->data : NULL,
+				packet ? packet->size : 0);
+		relay_packet_cache_append(&stream->packet_cache, NULL,
+				padding_len);
+	} else {
 		size_t recv_len;
 
 		recv_len = packet ? packet->size : 0;
 		recv_len += padding_len;
+
+		/* Each metadata write is cached as a packet. */
+		relay_packet_cache_begin_packet(&stream->packet_cache);
+		relay_packet_cache_append(&stream->packet_cache,
+				packet ? packet->data : NULL,
+				packet ? packet->size : 0);
+		relay_packet_cache_append(&stream->packet_cache, NULL,
+				padding_len);
+		relay_packet_cache_commit_packet(&stream->packet_cache,
+				stream->metadata_received, recv_len);
+
 		stream->metadata_received += recv_len;
 		if (recv_len) {
 			stream->no_new_metadata_notified = false;
@@ -1117,6 +1250,173 @@ end:
 	return ret;
 }
 
+/*
+ * Drain `len` bytes from the read end of a splice pipe to the stream's file
+ * by copying them through user space.
+ */
+static int stream_write_from_pipe(struct relay_stream *stream,
+		int pipe_read_fd, size_t len)
+{
+	int ret = 0;
+	char buffer[FILE_IO_STACK_BUFFER_SIZE];
+
+	while (len > 0) {
+		ssize_t read_ret;
+		struct lttng_buffer_view packet_chunk;
+
+		read_ret = lttng_read(pipe_read_fd, buffer,
+				min(len, sizeof(buffer)));
+		if (read_ret <= 0) {
+			PERROR("Failed to read from splice pipe of stream %" PRIu64,
+					stream->stream_handle);
+			ret = -1;
+			goto end;
+		}
+
+		packet_chunk = lttng_buffer_view_init(buffer, 0, read_ret);
+		ret = stream_write(stream, &packet_chunk, 0);
+		if (ret) {
+			goto end;
+		}
+		len -= read_ret;
+	}
+end:
+	return ret;
+}
+
+/*
+ * Write up to `len` bytes of packet data, received on `sock_fd`, to the
+ * stream's file. The data is moved through `splice_pipe` and never copied
+ * to user space. Note that the packet is not necessarily complete.
+ *
+ * `sock_fd` must be in non-blocking mode and the splice pipe must be empty.
+ *
+ * Returns the number of bytes written to the stream file or 0 if the peer
+ * performed an orderly shutdown. A negative value is returned on error, with
+ * errno set to EAGAIN if no data is available on the socket.
+ *
+ * `splice_supported` is set to false if either the socket or the stream file
+ * does not support splice(2); the caller must then fall back to
+ * stream_write(). In that case, the data that could have been moved out of
+ * the socket has been written to the stream file by copy.
+ */
+ssize_t stream_splice_from_socket(struct relay_stream *stream, int sock_fd,
+		int *splice_pipe, size_t len, bool *splice_supported)
+{
+	int fd;
+	ssize_t ret, spliced_in, left_to_write;
+
+	ASSERT_LOCKED(stream->lock);
+	*splice_supported = true;
+
+	if (!stream->file || !stream->trace_chunk) {
+		ERR("Protocol error: received a packet for a stream that doesn't have a current trace chunk: stream_id = %" PRIu64 ", channel_name = %s",
+				stream->stream_handle, stream->channel_name);
+		ret = -1;
+		goto end;
+	}
+
+	spliced_in = splice(sock_fd, NULL, splice_pipe[1], NULL, len,
+			SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+	if (spliced_in > 0) {
+		/*
+		 * The data does not go through user space and can't be
+		 * cached. The metadata is cached as a contiguous range: stop
+		 * caching it altogether.
+		 */
+		if (stream->is_metadata) {
+			relay_packet_cache_reset(&stream->packet_cache);
+		} else {
+			relay_packet_cache_abort_packet(&stream->packet_cache);
+		}
+	}
+	if (spliced_in < 0) {
+		if (errno == EINVAL) {
+			*splice_supported = false;
+		} else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+			PERROR("Failed to splice data from socket %d of stream %" PRIu64,
+					sock_fd, stream->stream_handle);
+		}
+		ret = -1;
+		goto end;
+	} else if (spliced_in == 0) {
+		ret = 0;
+		goto end;
+	}
+
+	/* The spliced data must follow the buffered data in the file. */
+	ret = stream_flush_write_buffer(stream);
+	if (ret) {
+		goto end;
+	}
+
+	fd = fs_handle_get_fd(stream->file);
+	if (fd < 0) {
+		ERR("Failed to get file descriptor of stream %" PRIu64 " file",
+				stream->stream_handle);
+		ret = -1;
+		goto end;
+	}
+
+	left_to_write = spliced_in;
+	while (left_to_write > 0) {
+		ret = splice(splice_pipe[0], NULL, fd, NULL, left_to_write,
+				SPLICE_F_MOVE);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		left_to_write -= ret;
+	}
+	fs_handle_put_fd(stream->file);
+
+	if (left_to_write > 0) {
+		if (errno != EINVAL) {
+			PERROR("Failed to splice data to file of stream %" PRIu64,
+					stream->stream_handle);
+			ret = -1;
+			goto end;
+		}
+
+		/* The file system does not support splice(2). */
+		*splice_supported = false;
+		ret = stream_write_from_pipe(stream, splice_pipe[0],
+				left_to_write);
+		if (ret) {
+			ret = -1;
+			goto end;
+		}
+	}
+
+	/* stream_write() accounts for the metadata it writes by copy. */
+	if (stream->is_metadata && spliced_in > left_to_write) {
+		stream->metadata_received += spliced_in - left_to_write;
+		stream->no_new_metadata_notified = false;
+	}
+
+	DBG("Spliced to %sstream %" PRIu64 ": data_length = %zd",
+			stream->is_metadata ? "metadata " : "",
+			stream->stream_handle, spliced_in);
+	ret = spliced_in;
+end:
+	return ret;
+}
+
+/*
+ * The live viewers read the data described by an index as soon as it is
+ * written: the data must be in the file before its index is flushed.
+ */
+static int stream_flush_live_data(struct relay_stream *stream)
+{
+	if (!stream->trace->session->live_timer) {
+		return 0;
+	}
+
+	return stream_flush_write_buffer(stream);
+}
+
 /*
  * Update index after receiving a packet for a data stream.
  *
@@ -1170,6 +1470,14 @@ int stream_update_index(struct relay_stream *stream, uint64_t net_seq_num,
 		goto end;
 	}
 
+	ret = stream_flush_live_data(stream);
+	if (ret) {
+		/* Put self-ref for this index due to error. */
+		relay_index_put(index);
+		index = NULL;
+		goto end;
+	}
+
 	ret = relay_index_try_flush(index);
 	if (ret == 0) {
 		tracefile_array_file_rotate(stream->tfa, TRACEFILE_ROTATE_READ);
@@ -1178,6 +1486,7 @@ int stream_update_index(struct relay_stream *stream, uint64_t net_seq_num,
 		LTTNG_OPTIONAL_SET(&stream->received_packet_seq_num,
 			be64toh(index->index_data.packet_seq_num));
 		*flushed = true;
+		session_notify_live_viewer(stream->trace->session);
 	} else if (ret > 0) {
 		index->total_size = total_size;
 		/* No flush. */
@@ -1203,6 +1512,11 @@ int stream_complete_packet(struct relay_stream *stream, size_t packet_total_size
 
 	ASSERT_LOCKED(stream->lock);
 
+	if (!stream->is_metadata) {
+		relay_packet_cache_commit_packet(&stream->packet_cache,
+				stream->tracefile_size_current,
+				packet_total_size);
+	}
 	stream->tracefile_size_current += packet_total_size;
 	if (index_flushed) {
 		stream->pos_after_last_complete_data_index =
@@ -1243,6 +1557,7 @@ int stream_add_index(struct relay_stream *stream,
 		if (stream->index_received_seqcount > 0
 				&& stream->indexes_in_flight == 0) {
 			stream->beacon_ts_end = index_info->timestamp_end;
+			session_notify_live_viewer(stream->trace->session);
 		}
 		ret = 0;
 		goto end;
@@ -1268,6 +1583,11 @@ int stream_add_index(struct relay_stream *stream,
 		ret = -1;
 		goto end;
 	}
+	ret = stream_flush_live_data(stream);
+	if (ret) {
+		relay_index_put(index);
+		goto end;
+	}
 	ret = relay_index_try_flush(index);
 	if (ret == 0) {
 		tracefile_array_file_rotate(stream->tfa, TRACEFILE_ROTATE_READ);
@@ -1277,6 +1597,7 @@ int stream_add_index(struct relay_stream *stream,
 		stream->prev_index_seq = index_info->net_seq_num;
 		LTTNG_OPTIONAL_SET(&stream->received_packet_seq_num,
 				index_info->packet_seq_num);
+		session_notify_live_viewer(stream->trace->session);
 
 		ret = try_rotate_stream_index(stream);
 		if (ret < 0) {
@@ -1328,16 +1649,9 @@ int stream_reset_file(struct relay_stream *stream)
 {
 	ASSERT_LOCKED(stream->lock);
 
-	if (stream->file) {
-		int ret;
-
-		ret = fs_handle_close(stream->file);
-		if (ret) {
-			ERR("Failed to close stream file handle: channel name = \"%s\", id = %" PRIu64,
-					stream->channel_name,
-					stream->stream_handle);
-		}
-		stream->file = NULL;
+	if (stream_close_data_file(stream)) {
+		ERR("Failed to close stream file handle: channel name = \"%s\", id = %" PRIu64,
+				stream->channel_name, stream->stream_handle);
 	}
 
 	DBG("%s: reset tracefile_size_current for stream %" PRIu64 " was %" PRIu64,
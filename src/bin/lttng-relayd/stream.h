@@ -20,8 +20,10 @@
 #include <common/optional.h>
 #include <common/buffer-view.h>
 
+#include "packet-cache.h"
 #include "session.h"
 #include "tracefile-array.h"
+#include "write-buffer.h"
 
 struct lttcomm_relayd_index;
 
@@ -69,6 +71,14 @@ struct relay_stream {
 	uint64_t last_net_seq_num;
 
 	struct fs_handle *file;
+	/* Recently received packets of `file`, served to the live viewers. */
+	struct relay_packet_cache packet_cache;
+	/* Data written to `file` but not yet passed to the file system. */
+	struct relay_write_buffer write_buffer;
+	/* Storage allocated ahead of the writes to `file`, in bytes. */
+	uint64_t file_allocated_size;
+	/* The storage of `file` can't be allocated ahead of its writes. */
+	bool file_preallocation_failed;
 	/* index file on which to write the index data. */
 	struct lttng_index_file *index_file;
 
@@ -198,6 +208,9 @@ int stream_init_packet(struct relay_stream *stream, size_t packet_size,
 		bool *file_rotated);
 int stream_write(struct relay_stream *stream,
 		const struct lttng_buffer_view *packet, size_t padding_len);
+int stream_flush_write_buffer(struct relay_stream *stream);
+ssize_t stream_splice_from_socket(struct relay_stream *stream, int sock_fd,
+		int *splice_pipe, size_t len, bool *splice_supported);
 /* Called after the reception of a complete data packet. */
 int stream_update_index(struct relay_stream *stream, uint64_t net_seq_num,
 		bool rotate_index, bool *flushed, uint64_t total_size);
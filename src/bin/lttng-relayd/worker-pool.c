@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2020 EfficiOS Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ */
+
+#define _LGPL_SOURCE
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <urcu/uatomic.h>
+
+#include <common/common.h>
+#include <common/defaults.h>
+#include <common/fd-tracker/utils.h>
+#include <common/utils.h>
+
+#include "connection.h"
+#include "lttng-relayd.h"
+#include "worker-pool.h"
+
+int relay_worker_pool_create(struct relay_worker_pool *pool, const char *name,
+		unsigned int count, size_t worker_size)
+{
+	int ret = 0;
+	unsigned int i;
+
+	assert(worker_size >= sizeof(struct relay_worker));
+
+	pool->name = name;
+	pool->worker_count = 0;
+	pool->launched_count = 0;
+	pool->workers = zmalloc(sizeof(*pool->workers) * count);
+	if (!pool->workers) {
+		PERROR("Failed to allocate %s threads", name);
+		ret = -1;
+		goto end;
+	}
+
+	for (i = 0; i < count; i++) {
+		struct relay_worker *worker;
+		char *pipe_name = NULL;
+
+		worker = zmalloc(worker_size);
+		if (!worker) {
+			PERROR("Failed to allocate %s %u", name, i);
+			ret = -1;
+			goto end;
+		}
+		worker->id = i;
+		worker->conn_pipe[0] = worker->conn_pipe[1] = -1;
+
+		ret = asprintf(&pipe_name, "%s %u connection pipe", name, i);
+		if (ret < 0) {
+			PERROR("Failed to format %s connection pipe name", name);
+			free(worker);
+			ret = -1;
+			goto end;
+		}
+
+		ret = fd_tracker_util_pipe_open_cloexec(the_fd_tracker,
+				pipe_name, worker->conn_pipe);
+		free(pipe_name);
+		if (ret) {
+			free(worker);
+			goto end;
+		}
+		/* The worker is accounted for as soon as it holds a pipe. */
+		pool->workers[pool->worker_count++] = worker;
+	}
+end:
+	return ret;
+}
+
+void relay_worker_pool_destroy(struct relay_worker_pool *pool)
+{
+	unsigned int i;
+
+	for (i = 0; i < pool->worker_count; i++) {
+		(void) fd_tracker_util_pipe_close(the_fd_tracker,
+				pool->workers[i]->conn_pipe);
+		free(pool->workers[i]);
+	}
+	free(pool->workers);
+	pool->workers = NULL;
+	pool->worker_count = 0;
+}
+
+int relay_worker_pool_launch(struct relay_worker_pool *pool,
+		void *(*thread_fn)(void *))
+{
+	int ret = 0;
+
+	DBG("Launching %u %s thread(s)", pool->worker_count, pool->name);
+	while (pool->launched_count < pool->worker_count) {
+		struct relay_worker *worker =
+				pool->workers[pool->launched_count];
+
+		ret = pthread_create(&worker->thread, default_pthread_attr(),
+				thread_fn, worker);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_create %s", pool->name);
+			ret = -1;
+			goto end;
+		}
+		pool->launched_count++;
+	}
+end:
+	return ret;
+}
+
+int relay_worker_pool_join(struct relay_worker_pool *pool)
+{
+	int ret, retval = 0;
+	unsigned int i;
+	void *status;
+
+	for (i = 0; i < pool->launched_count; i++) {
+		ret = pthread_join(pool->workers[i]->thread, &status);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_join %s", pool->name);
+			retval = -1;
+		}
+	}
+	pool->launched_count = 0;
+
+	return retval;
+}
+
+/*
+ * Select the worker thread that will own a new connection: the one currently
+ * owning the fewest connections.
+ *
+ * The consumer daemons' control and data connections are dispatched
+ * independently: this spreads the data connections, which carry most of the
+ * load, across all workers.
+ */
+static struct relay_worker *relay_worker_pool_select(
+		struct relay_worker_pool *pool)
+{
+	unsigned int i;
+	struct relay_worker *selected_worker = pool->workers[0];
+	unsigned long selected_count =
+			uatomic_read(&selected_worker->connection_count);
+
+	for (i = 1; i < pool->worker_count; i++) {
+		const unsigned long count =
+				uatomic_read(&pool->workers[i]->connection_count);
+
+		if (count < selected_count) {
+			selected_worker = pool->workers[i];
+			selected_count = count;
+		}
+	}
+
+	return selected_worker;
+}
+
+int relay_worker_pool_dispatch(struct relay_worker_pool *pool,
+		struct relay_connection *conn)
+{
+	int ret = 0;
+	ssize_t write_ret;
+	struct relay_worker *worker = relay_worker_pool_select(pool);
+
+	DBG("Dispatching connection on sock %d to %s %u", conn->sock->fd,
+			pool->name, worker->id);
+
+	/*
+	 * The connection is accounted for before it is handed to the worker
+	 * so that back-to-back connections are not all assigned to the same
+	 * worker.
+	 */
+	uatomic_inc(&worker->connection_count);
+
+	/*
+	 * Inform worker thread of the new request. This call is blocking so we
+	 * can be assured that the data will be read at some point in time or
+	 * wait to the end of the world :)
+	 */
+	write_ret = lttng_write(worker->conn_pipe[1], &conn, sizeof(conn));
+	if (write_ret < 0) {
+		PERROR("write %s connection pipe", pool->name);
+		uatomic_dec(&worker->connection_count);
+		ret = -1;
+	}
+
+	return ret;
+}
@@ -0,0 +1,79 @@
+#ifndef _RELAY_WORKER_POOL_H
+#define _RELAY_WORKER_POOL_H
+
+/*
+ * Copyright (C) 2020 EfficiOS Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ */
+
+#include <pthread.h>
+#include <stddef.h>
+
+struct relay_connection;
+
+/*
+ * Worker thread servicing a subset of the connections of a dispatcher.
+ *
+ * A connection is handed to a single worker by the dispatcher and remains
+ * owned by that worker for its whole lifetime. This preserves the ordering
+ * of the commands and packets received on a given connection while allowing
+ * the connections to be serviced in parallel.
+ *
+ * A worker needing more state embeds this structure as its first member.
+ */
+struct relay_worker {
+	unsigned int id;
+	pthread_t thread;
+	/*
+	 * This pipe is used to inform the worker thread that a connection is
+	 * queued and ready to be processed.
+	 */
+	int conn_pipe[2];
+	/*
+	 * Number of connections currently owned by the worker. Decremented by
+	 * the worker when it closes a connection.
+	 */
+	unsigned long connection_count;
+};
+
+struct relay_worker_pool {
+	/* Name of the workers, used to name their pipes and in the logs. */
+	const char *name;
+	struct relay_worker **workers;
+	/* Number of workers holding a connection pipe. */
+	unsigned int worker_count;
+	/* Number of worker threads launched and not joined yet. */
+	unsigned int launched_count;
+};
+
+/*
+ * Allocate `count` workers of `worker_size` bytes and create the connection
+ * pipes through which the dispatcher hands them new connections.
+ *
+ * The pool must be destroyed with relay_worker_pool_destroy(), even on error.
+ */
+int relay_worker_pool_create(struct relay_worker_pool *pool, const char *name,
+		unsigned int count, size_t worker_size);
+void relay_worker_pool_destroy(struct relay_worker_pool *pool);
+
+/*
+ * Launch a thread running `thread_fn` for each worker, which receives its
+ * struct relay_worker as argument.
+ *
+ * On error, the threads already launched keep running: the caller must stop
+ * them and call relay_worker_pool_join().
+ */
+int relay_worker_pool_launch(struct relay_worker_pool *pool,
+		void *(*thread_fn)(void *));
+int relay_worker_pool_join(struct relay_worker_pool *pool);
+
+/*
+ * Hand a connection to the worker currently owning the fewest connections.
+ * The caller keeps its reference to the connection on error.
+ */
+int relay_worker_pool_dispatch(struct relay_worker_pool *pool,
+		struct relay_connection *conn);
+
+#endif /* _RELAY_WORKER_POOL_H */
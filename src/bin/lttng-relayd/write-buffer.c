@@ -0,0 +1,306 @@
+/*
+ * Copyright (C) 2020 EfficiOS Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ */
+
+#define _LGPL_SOURCE
+#include <string.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <urcu/uatomic.h>
+
+#include <common/common.h>
+#include <common/compat/time.h>
+#include <common/fs-handle.h>
+#include <common/time.h>
+
+#include "write-buffer.h"
+
+/*
+ * The buffered data is written when new data is appended more than this
+ * delay after the oldest buffered data.
+ */
+#define WRITE_BUFFER_MAX_DELAY_NS	NSEC_PER_SEC
+/*
+ * Minimal size of the paddings skipped by extending the file. Smaller
+ * paddings are cheaper to write than to skip.
+ */
+#define WRITE_BUFFER_SPARSE_PADDING_MIN	65536
+/* Zeroes written per iovec by the unbuffered writes of padding. */
+#define WRITE_BUFFER_PADDING_CHUNK_SIZE	65536
+/* Maximal number of padding iovecs per unbuffered write. */
+#define WRITE_BUFFER_MAX_PADDING_IOV	16
+
+/* Capacity of the write buffer of each stream; 0 disables the buffers. */
+static size_t buffer_size;
+
+static const char zeroes[WRITE_BUFFER_PADDING_CHUNK_SIZE];
+
+static struct {
+	/* Writes requested by the streams. */
+	unsigned long writes;
+	/* Writes performed on the files. */
+	unsigned long file_writes;
+	unsigned long stale_flushes;
+	unsigned long sparse_paddings;
+	unsigned long sparse_padding_failures;
+} stats;
+
+void relay_write_buffer_set_size(uint64_t size)
+{
+	buffer_size = (size_t) size;
+}
+
+void relay_write_buffer_log_stats(void)
+{
+	const unsigned long writes = uatomic_read(&stats.writes);
+	const unsigned long file_writes = uatomic_read(&stats.file_writes);
+
+	if (!buffer_size) {
+		return;
+	}
+
+	DBG("Stream write buffers: %lu writes performed as %lu file writes (%.1f%% saved), %lu stale buffer flushes, %lu paddings skipped, %lu paddings written after failing to extend the file",
+			writes, file_writes,
+			writes && file_writes < writes ?
+				100.0 * (writes - file_writes) / writes : 0.0,
+			uatomic_read(&stats.stale_flushes),
+			uatomic_read(&stats.sparse_paddings),
+			uatomic_read(&stats.sparse_padding_failures));
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	if (lttng_clock_gettime(CLOCK_MONOTONIC, &ts)) {
+		PERROR("clock_gettime");
+		return 0;
+	}
+	return (uint64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+void relay_write_buffer_init(struct relay_write_buffer *buffer,
+		bool buffered)
+{
+	memset(buffer, 0, sizeof(*buffer));
+	buffer->capacity = buffered ? buffer_size : 0;
+	lttng_dynamic_buffer_init(&buffer->data);
+}
+
+void relay_write_buffer_fini(struct relay_write_buffer *buffer)
+{
+	lttng_dynamic_buffer_reset(&buffer->data);
+}
+
+void relay_write_buffer_set_sparse_padding(struct relay_write_buffer *buffer,
+		bool sparse_padding)
+{
+	buffer->sparse_padding = sparse_padding && buffer->capacity > 0;
+}
+
+/*
+ * Write data followed by padding to `file` using a single writev(2) unless
+ * the padding exceeds WRITE_BUFFER_MAX_PADDING_IOV chunks of zeroes.
+ */
+static int write_unbuffered(struct fs_handle *file, const void *data,
+		size_t len, size_t padding_len)
+{
+	int ret = 0;
+	bool data_written = len == 0;
+
+	while (!data_written || padding_len > 0) {
+		struct iovec iov[1 + WRITE_BUFFER_MAX_PADDING_IOV];
+		int iovcnt = 0;
+		size_t write_len = 0;
+		ssize_t write_ret;
+
+		if (!data_written) {
+			iov[iovcnt].iov_base = (void *) data;
+			iov[iovcnt].iov_len = len;
+			write_len += len;
+			iovcnt++;
+			data_written = true;
+		}
+
+		while (padding_len > 0 && iovcnt < (int) ARRAY_SIZE(iov)) {
+			const size_t padding_len_this_pass =
+					min(padding_len, sizeof(zeroes));
+
+			iov[iovcnt].iov_base = (void *) zeroes;
+			iov[iovcnt].iov_len = padding_len_this_pass;
+			write_len += padding_len_this_pass;
+			iovcnt++;
+			padding_len -= padding_len_this_pass;
+		}
+
+		write_ret = fs_handle_writev(file, iov, iovcnt);
+		uatomic_inc(&stats.file_writes);
+		if (write_ret != (ssize_t) write_len) {
+			ret = -1;
+			goto end;
+		}
+	}
+end:
+	return ret;
+}
+
+int relay_write_buffer_flush(struct relay_write_buffer *buffer,
+		struct fs_handle *file)
+{
+	int ret = 0;
+	ssize_t write_ret;
+
+	if (buffer->data.size == 0) {
+		goto end;
+	}
+
+	write_ret = fs_handle_write(file, buffer->data.data,
+			buffer->data.size);
+	uatomic_inc(&stats.file_writes);
+	if (write_ret != (ssize_t) buffer->data.size) {
+		ret = -1;
+	}
+
+	/* Keeps the buffer's storage. */
+	(void) lttng_dynamic_buffer_set_size(&buffer->data, 0);
+end:
+	return ret;
+}
+
+static int buffer_write(struct relay_write_buffer *buffer,
+		struct fs_handle *file, const void *data, size_t len,
+		size_t padding_len)
+{
+	int ret = 0;
+	const size_t write_len = len + padding_len;
+
+	if (write_len == 0) {
+		goto end;
+	}
+
+	if (buffer->data.size + write_len > buffer->capacity) {
+		ret = relay_write_buffer_flush(buffer, file);
+		if (ret) {
+			goto end;
+		}
+
+		if (write_len >= buffer->capacity) {
+			/* Buffering would not save a write. */
+			ret = write_unbuffered(file, data, len, padding_len);
+			goto end;
+		}
+	}
+
+	if (buffer->data.size == 0) {
+		buffer->oldest_append_ns = now_ns();
+	}
+
+	if (len) {
+		ret = lttng_dynamic_buffer_append(&buffer->data, data, len);
+		if (ret) {
+			ERR("Failed to append %zu bytes to stream write buffer",
+					len);
+			goto end;
+		}
+	}
+
+	if (padding_len) {
+		/* The buffer's new bytes are zeroed. */
+		ret = lttng_dynamic_buffer_set_size(&buffer->data,
+				buffer->data.size + padding_len);
+		if (ret) {
+			ERR("Failed to append %zu bytes of padding to stream write buffer",
+					padding_len);
+			goto end;
+		}
+	}
+end:
+	return ret;
+}
+
+/*
+ * Skip `padding_len` bytes of padding by extending the file; the skipped
+ * range reads as zeroes and, on most file systems, is not allocated.
+ *
+ * Returns 0 if the padding was skipped, 1 if it must be written, and -1 on
+ * error.
+ */
+static int skip_padding(struct fs_handle *file, size_t padding_len)
+{
+	int ret;
+	off_t end_offset;
+
+	end_offset = fs_handle_seek(file, (off_t) padding_len, SEEK_CUR);
+	if (end_offset < 0) {
+		PERROR("Failed to seek past padding of %zu bytes", padding_len);
+		ret = 1;
+		goto end;
+	}
+
+	ret = fs_handle_truncate(file, end_offset);
+	if (ret) {
+		PERROR("Failed to extend file to offset %" PRIu64 " to skip padding",
+				(uint64_t) end_offset);
+		if (fs_handle_seek(file, -(off_t) padding_len, SEEK_CUR) < 0) {
+			PERROR("Failed to seek back after failing to skip padding");
+			ret = -1;
+			goto end;
+		}
+		ret = 1;
+		goto end;
+	}
+end:
+	return ret;
+}
+
+int relay_write_buffer_write(struct relay_write_buffer *buffer,
+		struct fs_handle *file, const void *data, size_t len,
+		size_t padding_len)
+{
+	int ret;
+
+	uatomic_inc(&stats.writes);
+
+	if (buffer->data.size > 0 && now_ns() - buffer->oldest_append_ns >=
+			WRITE_BUFFER_MAX_DELAY_NS) {
+		uatomic_inc(&stats.stale_flushes);
+		ret = relay_write_buffer_flush(buffer, file);
+		if (ret) {
+			goto end;
+		}
+	}
+
+	if (buffer->sparse_padding &&
+			padding_len >= WRITE_BUFFER_SPARSE_PADDING_MIN) {
+		ret = buffer_write(buffer, file, data, len, 0);
+		if (ret) {
+			goto end;
+		}
+
+		/* The padding must follow the buffered data in the file. */
+		ret = relay_write_buffer_flush(buffer, file);
+		if (ret) {
+			goto end;
+		}
+
+		ret = skip_padding(file, padding_len);
+		if (ret <= 0) {
+			if (ret == 0) {
+				uatomic_inc(&stats.sparse_paddings);
+			}
+			goto end;
+		}
+
+		uatomic_inc(&stats.sparse_padding_failures);
+		data = NULL;
+		len = 0;
+	}
+
+	ret = buffer_write(buffer, file, data, len, padding_len);
+end:
+	return ret;
+}
@@ -0,0 +1,90 @@
+#ifndef _WRITE_BUFFER_H
+#define _WRITE_BUFFER_H
+
+/*
+ * Copyright (C) 2020 EfficiOS Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <common/dynamic-buffer.h>
+
+struct fs_handle;
+
+/*
+ * Buffer coalescing the small writes performed on the trace file of a
+ * stream.
+ *
+ * The packets are received in parts and padded separately; buffering them
+ * turns these writes into a few large writes. The buffered data is written
+ * to the file when the buffer is full, when it has been held for too long
+ * or when the owner of the buffer flushes it explicitly (e.g. before the
+ * index of the data is published or before the file is closed).
+ *
+ * Protected by the lock of the stream owning the buffer.
+ */
+struct relay_write_buffer {
+	/* 0 if the writes are not buffered. */
+	size_t capacity;
+	struct lttng_dynamic_buffer data;
+	/* Time at which the oldest buffered data was appended. */
+	uint64_t oldest_append_ns;
+	/*
+	 * Large paddings are skipped by extending the file rather than
+	 * written as zeroes. This requires synchronous operations on the file.
+	 */
+	bool sparse_padding;
+};
+
+/*
+ * Set the size, in bytes, of the write buffer of each stream. The buffers are
+ * disabled when `size` is 0.
+ *
+ * Must be called before any stream is created.
+ */
+void relay_write_buffer_set_size(uint64_t size);
+
+/* Log the number of writes saved by the write buffers. */
+void relay_write_buffer_log_stats(void);
+
+/*
+ * Initialize a write buffer. The writes of a buffer initialized with
+ * `buffered` set to false are performed immediately.
+ */
+void relay_write_buffer_init(struct relay_write_buffer *buffer,
+		bool buffered);
+void relay_write_buffer_fini(struct relay_write_buffer *buffer);
+
+/*
+ * Set whether the paddings written through `buffer` may be skipped by
+ * extending the file. Only the paddings of buffered writes are skipped.
+ */
+void relay_write_buffer_set_sparse_padding(struct relay_write_buffer *buffer,
+		bool sparse_padding);
+
+/*
+ * Write `len` bytes of data followed by `padding_len` bytes of padding
+ * (zeroes) to `file`. The data is buffered, when enabled, and written to the
+ * file once the buffer is full or stale.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int relay_write_buffer_write(struct relay_write_buffer *buffer,
+		struct fs_handle *file, const void *data, size_t len,
+		size_t padding_len);
+
+/*
+ * Write the buffered data to `file`.
+ *
+ * Returns 0 on success, -1 on error. The buffered data is dropped in both
+ * cases.
+ */
+int relay_write_buffer_flush(struct relay_write_buffer *buffer,
+		struct fs_handle *file);
+
+#endif /* _WRITE_BUFFER_H */
@@ -4106,9 +4106,7 @@ int ust_regenerate_metadata(struct ltt_ust_session *usess)
 		registry = session_reg->reg.ust;
 
 		pthread_mutex_lock(&registry->lock);
-		registry->metadata_len_sent = 0;
-		memset(registry->metadata, 0, registry->metadata_alloc_len);
-		registry->metadata_len = 0;
+		ust_registry_session_reset_metadata(registry);
 		registry->metadata_version++;
 		if (registry->metadata_fd > 0) {
 			/* Clear the metadata file's content. */
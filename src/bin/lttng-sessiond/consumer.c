@@ -1446,11 +1446,16 @@ end:
  * Send metadata string to consumer.
  * RCU read-side lock must be held to guarantee existence of socket.
  *
+ * If `from_shm` is set, the consumer reads the metadata from its mapping of
+ * the registry's metadata memory file rather than receiving `metadata_str`.
+ * The memory file is sent to the consumer when `shm_fd` is valid.
+ *
  * Return 0 on success else a negative value.
  */
 int consumer_push_metadata(struct consumer_socket *socket,
 		uint64_t metadata_key, char *metadata_str, size_t len,
-		size_t target_offset, uint64_t version)
+		size_t target_offset, uint64_t version, bool from_shm,
+		int shm_fd)
 {
 	int ret;
 	struct lttcomm_consumer_msg msg;
@@ -1467,6 +1472,8 @@ int consumer_push_metadata(struct consumer_socket *socket,
 	msg.u.push_metadata.target_offset = target_offset;
 	msg.u.push_metadata.len = len;
 	msg.u.push_metadata.version = version;
+	msg.u.push_metadata.from_shm = from_shm;
+	msg.u.push_metadata.shm_fd_follows = from_shm && shm_fd >= 0;
 
 	health_code_update();
 	ret = consumer_send_msg(socket, &msg);
@@ -1474,12 +1481,20 @@ int consumer_push_metadata(struct consumer_socket *socket,
 		goto end;
 	}
 
-	DBG3("Consumer pushing metadata on sock %d of len %zu", *socket->fd_ptr,
-			len);
-
-	ret = consumer_socket_send(socket, metadata_str, len);
-	if (ret < 0) {
+	if (msg.u.push_metadata.shm_fd_follows) {
+		DBG3("Consumer pushing metadata memory file %d on sock %d",
+				shm_fd, *socket->fd_ptr);
+		/* Receives the status reply. */
+		ret = consumer_send_fds(socket, &shm_fd, 1);
 		goto end;
+	} else if (!from_shm) {
+		DBG3("Consumer pushing metadata on sock %d of len %zu",
+				*socket->fd_ptr, len);
+
+		ret = consumer_socket_send(socket, metadata_str, len);
+		if (ret < 0) {
+			goto end;
+		}
 	}
 
 	health_code_update();
@@ -287,7 +287,8 @@ int consumer_setup_metadata(struct consumer_socket *socket,
 		uint64_t metadata_key);
 int consumer_push_metadata(struct consumer_socket *socket,
 		uint64_t metadata_key, char *metadata_str, size_t len,
-		size_t target_offset, uint64_t version);
+		size_t target_offset, uint64_t version, bool from_shm,
+		int shm_fd);
 int consumer_flush_channel(struct consumer_socket *socket, uint64_t key);
 int consumer_clear_quiescent_channel(struct consumer_socket *socket, uint64_t key);
 int consumer_get_discarded_events(uint64_t session_id, uint64_t channel_key,
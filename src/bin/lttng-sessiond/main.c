@@ -54,6 +54,7 @@
 #include "shm.h"
 #include "lttng-ust-ctl.h"
 #include "ust-consumer.h"
+#include "ust-metadata-cache.h"
 #include "utils.h"
 #include "fd-limit.h"
 #include "health-sessiond.h"
@@ -319,6 +320,7 @@ static void sessiond_cleanup(void)
 	DBG("Closing all UST sockets");
 	ust_app_clean_list();
 	buffer_reg_destroy_registries();
+	ust_metadata_cache_log_stats();
 
 	close_consumer_sockets();
 
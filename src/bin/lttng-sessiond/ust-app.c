@@ -549,6 +549,11 @@ int ust_app_release_object(struct ust_app *app, struct lttng_ust_object_data *da
  * Must be called with the ust app session lock held.
  * Must be called with the registry lock held.
  *
+ * When the metadata of the registry is backed by a memory file, the consumer
+ * reads it from its mapping of the file and only the offset and length of the
+ * metadata are pushed. The file is sent along the first push to a metadata
+ * channel.
+ *
  * On success, return the len of metadata pushed or else a negative value.
  * Returning a -EPIPE return value means we could not send the metadata,
  * but it can be caused by recoverable errors (e.g. the application has
@@ -557,11 +562,12 @@ int ust_app_release_object(struct ust_app *app, struct lttng_ust_object_data *da
 ssize_t ust_app_push_metadata(struct ust_registry_session *registry,
 		struct consumer_socket *socket, int send_zero_data)
 {
-	int ret;
+	int ret, shm_fd = -1;
 	char *metadata_str = NULL;
 	size_t len, offset, new_metadata_len_sent;
 	ssize_t ret_val;
 	uint64_t metadata_key, metadata_version;
+	bool from_shm;
 
 	assert(registry);
 	assert(socket);
@@ -580,6 +586,7 @@ ssize_t ust_app_push_metadata(struct ust_registry_session *registry,
 	len = registry->metadata_len - registry->metadata_len_sent;
 	new_metadata_len_sent = registry->metadata_len;
 	metadata_version = registry->metadata_version;
+	from_shm = registry->metadata_shm_fd >= 0;
 	if (len == 0) {
 		DBG3("No metadata to push for metadata key %" PRIu64,
 				registry->metadata_key);
@@ -591,6 +598,22 @@ ssize_t ust_app_push_metadata(struct ust_registry_session *registry,
 		goto end;
 	}
 
+	if (from_shm) {
+		if (registry->metadata_shm_key != metadata_key) {
+			/*
+			 * The file is duplicated since it may be replaced
+			 * while the registry lock is released below.
+			 */
+			shm_fd = dup(registry->metadata_shm_fd);
+			if (shm_fd < 0) {
+				PERROR("dup metadata memory file");
+				ret_val = -errno;
+				goto error;
+			}
+		}
+		goto push_data;
+	}
+
 	/* Allocate only what we have to send. */
 	metadata_str = zmalloc(len);
 	if (!metadata_str) {
@@ -616,7 +639,8 @@ push_data:
 	 * different bidirectionnal communication sockets.
 	 */
 	ret = consumer_push_metadata(socket, metadata_key,
-			metadata_str, len, offset, metadata_version);
+			metadata_str, len, offset, metadata_version, from_shm,
+			shm_fd);
 	pthread_mutex_lock(&registry->lock);
 	if (ret < 0) {
 		/*
@@ -657,8 +681,16 @@ push_data:
 		registry->metadata_len_sent =
 			max_t(size_t, registry->metadata_len_sent,
 				new_metadata_len_sent);
+		/* The file is replaced when the metadata is regenerated. */
+		if (shm_fd >= 0 &&
+				registry->metadata_version == metadata_version) {
+			registry->metadata_shm_key = metadata_key;
+		}
 	}
 	free(metadata_str);
+	if (shm_fd >= 0 && close(shm_fd)) {
+		PERROR("close metadata memory file");
+	}
 	return len;
 
 end:
@@ -675,6 +707,9 @@ error:
 	}
 error_push:
 	free(metadata_str);
+	if (shm_fd >= 0 && close(shm_fd)) {
+		PERROR("close metadata memory file");
+	}
 	return ret_val;
 }
 
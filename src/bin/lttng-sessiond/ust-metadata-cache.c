@@ -0,0 +1,381 @@
+/*
+ * Copyright (C) 2020 EfficiOS Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ */
+
+#define _LGPL_SOURCE
+#include <assert.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+#include <urcu/ref.h>
+#include <urcu/uatomic.h>
+
+#include <common/common.h>
+#include <common/hashtable/utils.h>
+
+#include "ust-field-utils.h"
+#include "ust-metadata-cache.h"
+
+struct ust_metadata_fragment {
+	/* Key. */
+	char name[LTTNG_UST_SYM_NAME_LEN];
+	uint32_t event_id;
+	uint32_t chan_id;
+	int byte_order;
+	int loglevel_value;
+	char *model_emf_uri;
+	size_t nr_fields;
+	struct ustctl_field *fields;
+
+	/* Metadata describing the event. */
+	char *data;
+	size_t len;
+
+	/* Protected by the cache lock. */
+	struct urcu_ref ref;
+	struct cds_lfht_node node;
+	/* For delayed reclaim. */
+	struct rcu_head rcu_head;
+};
+
+struct fragment_key {
+	int byte_order;
+	const struct ust_registry_channel *chan;
+	const struct ust_registry_event *event;
+};
+
+static struct {
+	/* Protects the hash table and the references to the fragments. */
+	pthread_mutex_t lock;
+	/* Created on first use. */
+	struct lttng_ht *ht;
+	unsigned long fragments;
+	uint64_t size;
+} cache = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static struct {
+	unsigned long hits;
+	unsigned long misses;
+	/* Events with enumeration fields. */
+	unsigned long unshareable;
+} stats;
+
+static int ht_match_fragment(struct cds_lfht_node *node, const void *_key)
+{
+	const struct fragment_key *key = _key;
+	const struct ust_registry_event *event = key->event;
+	const struct ust_metadata_fragment *fragment;
+	size_t i;
+
+	fragment = caa_container_of(node, struct ust_metadata_fragment, node);
+
+	if (fragment->event_id != (uint32_t) event->id ||
+			fragment->chan_id != key->chan->chan_id ||
+			fragment->byte_order != key->byte_order ||
+			fragment->loglevel_value != event->loglevel_value ||
+			fragment->nr_fields != event->nr_fields) {
+		goto no_match;
+	}
+
+	if (strncmp(fragment->name, event->name, sizeof(fragment->name))) {
+		goto no_match;
+	}
+
+	if (!fragment->model_emf_uri != !event->model_emf_uri) {
+		goto no_match;
+	} else if (fragment->model_emf_uri &&
+			strcmp(fragment->model_emf_uri, event->model_emf_uri)) {
+		goto no_match;
+	}
+
+	for (i = 0; i < fragment->nr_fields; i++) {
+		if (!match_ustctl_field(&fragment->fields[i],
+				&event->fields[i])) {
+			goto no_match;
+		}
+	}
+
+	/* Match */
+	return 1;
+
+no_match:
+	return 0;
+}
+
+static unsigned long hash_fragment(const struct fragment_key *key,
+		unsigned long seed)
+{
+	uint64_t hashed_key;
+
+	hashed_key = (uint64_t) hash_key_str(key->event->name, seed);
+	hashed_key ^= ((uint64_t) key->chan->chan_id << 32) |
+			(uint32_t) key->event->id;
+	return hash_key_u64(&hashed_key, seed);
+}
+
+/*
+ * The declaration of enumeration fields depends on the enumerations
+ * registered in the session.
+ */
+static bool event_is_shareable(const struct ust_registry_event *event)
+{
+	size_t i;
+
+	for (i = 0; i < event->nr_fields; i++) {
+		switch (event->fields[i].type.atype) {
+		case ustctl_atype_enum:
+		case ustctl_atype_enum_nestable:
+			return false;
+		default:
+			break;
+		}
+	}
+	return true;
+}
+
+static void destroy_fragment(struct ust_metadata_fragment *fragment)
+{
+	if (!fragment) {
+		return;
+	}
+
+	free(fragment->model_emf_uri);
+	free(fragment->fields);
+	free(fragment->data);
+	free(fragment);
+}
+
+static void destroy_fragment_rcu(struct rcu_head *head)
+{
+	struct ust_metadata_fragment *fragment = caa_container_of(head,
+			struct ust_metadata_fragment, rcu_head);
+
+	destroy_fragment(fragment);
+}
+
+static struct ust_metadata_fragment *create_fragment(
+		const struct fragment_key *key, const char *data, size_t len)
+{
+	const struct ust_registry_event *event = key->event;
+	struct ust_metadata_fragment *fragment;
+
+	fragment = zmalloc(sizeof(*fragment));
+	if (!fragment) {
+		PERROR("zmalloc ust metadata fragment");
+		goto error;
+	}
+
+	strncpy(fragment->name, event->name, sizeof(fragment->name));
+	fragment->name[sizeof(fragment->name) - 1] = '\0';
+	fragment->event_id = event->id;
+	fragment->chan_id = key->chan->chan_id;
+	fragment->byte_order = key->byte_order;
+	fragment->loglevel_value = event->loglevel_value;
+	fragment->nr_fields = event->nr_fields;
+	fragment->len = len;
+	urcu_ref_init(&fragment->ref);
+	cds_lfht_node_init(&fragment->node);
+
+	if (event->model_emf_uri) {
+		fragment->model_emf_uri = strdup(event->model_emf_uri);
+		if (!fragment->model_emf_uri) {
+			PERROR("strdup ust metadata fragment model EMF URI");
+			goto error;
+		}
+	}
+
+	if (event->nr_fields) {
+		fragment->fields = zmalloc(event->nr_fields *
+				sizeof(*fragment->fields));
+		if (!fragment->fields) {
+			PERROR("zmalloc ust metadata fragment fields");
+			goto error;
+		}
+		memcpy(fragment->fields, event->fields,
+				event->nr_fields * sizeof(*fragment->fields));
+	}
+
+	fragment->data = zmalloc(len);
+	if (!fragment->data) {
+		PERROR("zmalloc ust metadata fragment data");
+		goto error;
+	}
+	memcpy(fragment->data, data, len);
+
+	return fragment;
+
+error:
+	destroy_fragment(fragment);
+	return NULL;
+}
+
+/* Called with the cache lock held. */
+static struct lttng_ht *get_ht(void)
+{
+	if (!cache.ht) {
+		cache.ht = lttng_ht_new(0, LTTNG_HT_TYPE_U64);
+		if (!cache.ht) {
+			ERR("Failed to create ust metadata cache hash table");
+		}
+	}
+	return cache.ht;
+}
+
+struct ust_metadata_fragment *ust_metadata_cache_lookup(int byte_order,
+		const struct ust_registry_channel *chan,
+		const struct ust_registry_event *event)
+{
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+	struct ust_metadata_fragment *fragment = NULL;
+	struct lttng_ht *ht;
+	const struct fragment_key key = {
+		.byte_order = byte_order,
+		.chan = chan,
+		.event = event,
+	};
+
+	if (!event_is_shareable(event)) {
+		uatomic_inc(&stats.unshareable);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&cache.lock);
+	ht = get_ht();
+	if (!ht) {
+		goto end;
+	}
+
+	rcu_read_lock();
+	cds_lfht_lookup(ht->ht, hash_fragment(&key, lttng_ht_seed),
+			ht_match_fragment, &key, &iter);
+	node = cds_lfht_iter_get_node(&iter);
+	if (node) {
+		fragment = caa_container_of(node,
+				struct ust_metadata_fragment, node);
+		urcu_ref_get(&fragment->ref);
+	}
+	rcu_read_unlock();
+end:
+	pthread_mutex_unlock(&cache.lock);
+	if (fragment) {
+		uatomic_inc(&stats.hits);
+		DBG3("UST metadata cache hit for event %s, id: %u, chan_id: %u",
+				event->name, event->id, chan->chan_id);
+	} else {
+		uatomic_inc(&stats.misses);
+	}
+	return fragment;
+}
+
+struct ust_metadata_fragment *ust_metadata_cache_add(int byte_order,
+		const struct ust_registry_channel *chan,
+		const struct ust_registry_event *event,
+		const char *data, size_t len)
+{
+	struct cds_lfht_node *node;
+	struct ust_metadata_fragment *fragment;
+	struct lttng_ht *ht;
+	const struct fragment_key key = {
+		.byte_order = byte_order,
+		.chan = chan,
+		.event = event,
+	};
+
+	if (!event_is_shareable(event)) {
+		return NULL;
+	}
+
+	fragment = create_fragment(&key, data, len);
+	if (!fragment) {
+		return NULL;
+	}
+
+	pthread_mutex_lock(&cache.lock);
+	ht = get_ht();
+	if (!ht) {
+		pthread_mutex_unlock(&cache.lock);
+		destroy_fragment(fragment);
+		return NULL;
+	}
+
+	rcu_read_lock();
+	node = cds_lfht_add_unique(ht->ht, hash_fragment(&key, lttng_ht_seed),
+			ht_match_fragment, &key, &fragment->node);
+	if (node != &fragment->node) {
+		/* Added by another session since the lookup. */
+		destroy_fragment(fragment);
+		fragment = caa_container_of(node,
+				struct ust_metadata_fragment, node);
+		urcu_ref_get(&fragment->ref);
+	} else {
+		cache.fragments++;
+		cache.size += len;
+	}
+	rcu_read_unlock();
+	pthread_mutex_unlock(&cache.lock);
+	return fragment;
+}
+
+/* Called with the cache lock held. */
+static void release_fragment(struct urcu_ref *ref)
+{
+	struct ust_metadata_fragment *fragment = caa_container_of(ref,
+			struct ust_metadata_fragment, ref);
+	int ret;
+
+	rcu_read_lock();
+	ret = cds_lfht_del(cache.ht->ht, &fragment->node);
+	assert(!ret);
+	rcu_read_unlock();
+	cache.fragments--;
+	cache.size -= fragment->len;
+	call_rcu(&fragment->rcu_head, destroy_fragment_rcu);
+}
+
+void ust_metadata_fragment_put(struct ust_metadata_fragment *fragment)
+{
+	if (!fragment) {
+		return;
+	}
+
+	pthread_mutex_lock(&cache.lock);
+	urcu_ref_put(&fragment->ref, release_fragment);
+	pthread_mutex_unlock(&cache.lock);
+}
+
+const char *ust_metadata_fragment_get_data(
+		const struct ust_metadata_fragment *fragment)
+{
+	return fragment->data;
+}
+
+size_t ust_metadata_fragment_get_len(
+		const struct ust_metadata_fragment *fragment)
+{
+	return fragment->len;
+}
+
+void ust_metadata_cache_log_stats(void)
+{
+	const unsigned long hits = uatomic_read(&stats.hits);
+	const unsigned long misses = uatomic_read(&stats.misses);
+	unsigned long fragments;
+	uint64_t size;
+
+	pthread_mutex_lock(&cache.lock);
+	fragments = cache.fragments;
+	size = cache.size;
+	pthread_mutex_unlock(&cache.lock);
+
+	DBG("UST metadata cache: %lu hits, %lu misses (%.1f%% hit rate), %lu unshareable events, %lu fragments cached (%" PRIu64 " bytes)",
+			hits, misses,
+			hits + misses ? 100.0 * hits / (hits + misses) : 0.0,
+			uatomic_read(&stats.unshareable), fragments, size);
+}
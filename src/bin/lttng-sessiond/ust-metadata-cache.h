@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2020 EfficiOS Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ */
+
+#ifndef LTTNG_UST_METADATA_CACHE_H
+#define LTTNG_UST_METADATA_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ust-registry.h"
+
+/*
+ * Cache of the metadata fragments (TSDL) describing the events of the
+ * per-PID registry sessions.
+ *
+ * The instances of a binary register the same events, in the same order,
+ * with their own registry session. The fragment describing an event is
+ * rendered once, by the first session registering it, and copied by the
+ * other sessions rather than rendered again.
+ *
+ * Fragments are shared by content: they are keyed on everything their text
+ * depends on, that is the event's name, id, stream id, log level, model EMF
+ * URI and field descriptions, and the session's byte order. Events with
+ * enumeration fields are not shared since their declaration depends on the
+ * enumerations registered in each session.
+ *
+ * The events hold a reference to their fragment, released when they are
+ * destroyed.
+ */
+struct ust_metadata_fragment;
+
+#ifdef HAVE_LIBLTTNG_UST_CTL
+
+/*
+ * Return a reference to the fragment describing `event` in a session of
+ * byte order `byte_order`, or NULL if it is not in the cache or can't be
+ * shared.
+ */
+struct ust_metadata_fragment *ust_metadata_cache_lookup(int byte_order,
+		const struct ust_registry_channel *chan,
+		const struct ust_registry_event *event);
+
+/*
+ * Add the `len` bytes of `data` rendered for `event` to the cache.
+ *
+ * Return a reference to the fragment describing `event`, which may have
+ * been added concurrently, or NULL if it can't be shared.
+ */
+struct ust_metadata_fragment *ust_metadata_cache_add(int byte_order,
+		const struct ust_registry_channel *chan,
+		const struct ust_registry_event *event,
+		const char *data, size_t len);
+
+/* Release a reference to a fragment. NULL is accepted. */
+void ust_metadata_fragment_put(struct ust_metadata_fragment *fragment);
+
+const char *ust_metadata_fragment_get_data(
+		const struct ust_metadata_fragment *fragment);
+size_t ust_metadata_fragment_get_len(
+		const struct ust_metadata_fragment *fragment);
+
+/* Log the hit rate and size of the cache. */
+void ust_metadata_cache_log_stats(void);
+
+#else /* HAVE_LIBLTTNG_UST_CTL */
+
+static inline
+void ust_metadata_fragment_put(struct ust_metadata_fragment *fragment)
+{}
+
+static inline
+void ust_metadata_cache_log_stats(void)
+{}
+
+#endif /* HAVE_LIBLTTNG_UST_CTL */
+
+#endif /* LTTNG_UST_METADATA_CACHE_H */
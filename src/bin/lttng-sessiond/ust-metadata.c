@@ -14,17 +14,21 @@
 #include <unistd.h>
 #include <inttypes.h>
 #include <common/common.h>
+#include <common/compat/mman.h>
 #include <common/time.h>
 
 #include "ust-registry.h"
 #include "ust-clock.h"
 #include "ust-app.h"
+#include "ust-metadata-cache.h"
 
 #ifndef max_t
 #define max_t(type, a, b)	((type) ((a) > (b) ? (a) : (b)))
 #endif
 
 #define NR_CLOCK_OFFSET_SAMPLES		10
+/* Space ensured at the end of the metadata array before formatting. */
+#define METADATA_PRINTF_MIN_SPACE	256
 
 struct offset_sample {
 	int64_t offset;			/* correlation offset */
@@ -79,15 +83,47 @@ int get_count_order(unsigned int count)
 }
 
 /*
- * Returns offset where to write in metadata array, or negative error value on error.
+ * Grow the metadata memory file to `new_alloc_len` bytes and map it again.
+ * The new bytes of the file are zeroed.
+ *
+ * Returns 0 on success, or negative error value on error.
  */
 static
-ssize_t metadata_reserve(struct ust_registry_session *session, size_t len)
+int metadata_shm_grow(struct ust_registry_session *session,
+		size_t new_alloc_len)
 {
-	size_t new_len = session->metadata_len + len;
-	size_t new_alloc_len = new_len;
+	char *newptr;
+
+	if (ftruncate(session->metadata_shm_fd, new_alloc_len)) {
+		PERROR("ftruncate metadata memory file");
+		return -ENOMEM;
+	}
+	newptr = mmap(NULL, new_alloc_len, PROT_READ | PROT_WRITE, MAP_SHARED,
+			session->metadata_shm_fd, 0);
+	if (newptr == MAP_FAILED) {
+		PERROR("mmap metadata memory file");
+		return -ENOMEM;
+	}
+	if (session->metadata && munmap(session->metadata,
+			session->metadata_alloc_len)) {
+		PERROR("munmap metadata memory file");
+	}
+	session->metadata = newptr;
+	session->metadata_alloc_len = new_alloc_len;
+	return 0;
+}
+
+/*
+ * Ensure `len` bytes can be appended to the metadata array without
+ * reallocating it.
+ *
+ * Returns 0 on success, or negative error value on error.
+ */
+static
+int metadata_ensure_space(struct ust_registry_session *session, size_t len)
+{
+	size_t new_alloc_len = session->metadata_len + len;
 	size_t old_alloc_len = session->metadata_alloc_len;
-	ssize_t ret;
 
 	if (new_alloc_len > (UINT32_MAX >> 1))
 		return -EINVAL;
@@ -99,6 +135,9 @@ ssize_t metadata_reserve(struct ust_registry_session *session, size_t len)
 
 		new_alloc_len =
 			max_t(size_t, 1U << get_count_order(new_alloc_len), old_alloc_len << 1);
+		if (session->metadata_shm_fd >= 0) {
+			return metadata_shm_grow(session, new_alloc_len);
+		}
 		newptr = realloc(session->metadata, new_alloc_len);
 		if (!newptr)
 			return -ENOMEM;
@@ -107,83 +146,145 @@ ssize_t metadata_reserve(struct ust_registry_session *session, size_t len)
 		memset(&session->metadata[old_alloc_len], 0, new_alloc_len - old_alloc_len);
 		session->metadata_alloc_len = new_alloc_len;
 	}
+	return 0;
+}
+
+/*
+ * Returns offset where to write in metadata array, or negative error value on error.
+ */
+static
+ssize_t metadata_reserve(struct ust_registry_session *session, size_t len)
+{
+	ssize_t ret;
+
+	ret = metadata_ensure_space(session, len);
+	if (ret)
+		return ret;
 	ret = session->metadata_len;
 	session->metadata_len += len;
 	return ret;
 }
 
+/*
+ * Append the metadata generated since offset `start` to the metadata file.
+ *
+ * The statedump functions generate their metadata directly in the metadata
+ * array and write it to the file once they are done, rather than once per
+ * fragment.
+ */
 static
-int metadata_file_append(struct ust_registry_session *session,
-		const char *str, size_t len)
+int metadata_file_append(struct ust_registry_session *session, size_t start)
 {
 	ssize_t written;
+	const size_t len = session->metadata_len - start;
 
-	if (session->metadata_fd < 0) {
+	if (session->metadata_fd < 0 || len == 0) {
 		return 0;
 	}
 	/* Write to metadata file */
-	written = lttng_write(session->metadata_fd, str, len);
+	written = lttng_write(session->metadata_fd, &session->metadata[start],
+			len);
 	if (written != len) {
+		PERROR("Error appending to metadata file");
 		return -1;
 	}
 	return 0;
 }
 
+/*
+ * Append the metadata generated since `start` to the metadata file and
+ * return the status of the statedump.
+ */
+static
+int metadata_statedump_end(struct ust_registry_session *session, size_t start,
+		int ret)
+{
+	if (metadata_file_append(session, start) && !ret) {
+		ret = -1;
+	}
+	return ret;
+}
+
+static
+int metadata_append(struct ust_registry_session *session, const char *str,
+		size_t len)
+{
+	ssize_t offset;
+
+	offset = metadata_reserve(session, len);
+	if (offset < 0) {
+		return offset;
+	}
+	memcpy(&session->metadata[offset], str, len);
+	return 0;
+}
+
 /*
  * We have exclusive access to our metadata buffer (protected by the
  * ust_lock), so we can do racy operations such as looking for
  * remaining space left in packet and write, since mutual exclusion
  * protects us from concurrent writes.
+ *
+ * The fragment is formatted in place, at the end of the metadata array;
+ * the array is only grown, and the fragment formatted again, when the
+ * fragment does not fit in the space left.
  */
 static
 int lttng_metadata_printf(struct ust_registry_session *session,
 		const char *fmt, ...)
 {
-	char *str = NULL;
-	size_t len;
 	va_list ap;
-	ssize_t offset;
-	int ret;
+	int ret, len;
+
+	/* Most fragments fit in this space and are formatted once. */
+	ret = metadata_ensure_space(session, METADATA_PRINTF_MIN_SPACE);
+	if (ret) {
+		return ret;
+	}
 
 	va_start(ap, fmt);
-	ret = vasprintf(&str, fmt, ap);
+	len = vsnprintf(&session->metadata[session->metadata_len],
+			session->metadata_alloc_len - session->metadata_len,
+			fmt, ap);
 	va_end(ap);
-	if (ret < 0)
+	if (len < 0) {
 		return -ENOMEM;
-
-	len = strlen(str);
-	offset = metadata_reserve(session, len);
-	if (offset < 0) {
-		ret = offset;
-		goto end;
 	}
-	memcpy(&session->metadata[offset], str, len);
-	ret = metadata_file_append(session, str, len);
-	if (ret) {
-		PERROR("Error appending to metadata file");
-		goto end;
+
+	/* Room for the terminating null byte written by vsnprintf. */
+	if (session->metadata_len + len >= session->metadata_alloc_len) {
+		ret = metadata_ensure_space(session, (size_t) len + 1);
+		if (ret) {
+			return ret;
+		}
+
+		va_start(ap, fmt);
+		len = vsnprintf(&session->metadata[session->metadata_len],
+				session->metadata_alloc_len -
+					session->metadata_len,
+				fmt, ap);
+		va_end(ap);
+		if (len < 0) {
+			return -ENOMEM;
+		}
 	}
-	DBG3("Append to metadata: \"%s\"", str);
-	ret = 0;
 
-end:
-	free(str);
-	return ret;
+	DBG3("Append to metadata: \"%.*s\"", len,
+			&session->metadata[session->metadata_len]);
+	session->metadata_len += len;
+	return 0;
 }
 
 static
 int print_tabs(struct ust_registry_session *session, size_t nesting)
 {
-	size_t i;
-
-	for (i = 0; i < nesting; i++) {
-		int ret;
+	ssize_t offset;
 
-		ret = lttng_metadata_printf(session, "	");
-		if (ret) {
-			return ret;
-		}
+	offset = metadata_reserve(session, nesting);
+	if (offset < 0) {
+		return offset;
 	}
+	memset(&session->metadata[offset], '\t', nesting);
 	return 0;
 }
 
@@ -209,36 +310,39 @@ static
 int print_escaped_ctf_string(struct ust_registry_session *session, const char *string)
 {
 	int ret = 0;
-	size_t i;
-	char cur;
 
-	i = 0;
-	cur = string[i];
-	while (cur != '\0') {
-		switch (cur) {
+	while (*string != '\0') {
+		/* Copy the run of characters which need no escaping at once. */
+		const size_t run_len = strcspn(string, "\n\\\"");
+
+		ret = metadata_append(session, string, run_len);
+		if (ret) {
+			goto end;
+		}
+		string += run_len;
+
+		switch (*string) {
+		case '\0':
+			goto end;
 		case '\n':
-			ret = lttng_metadata_printf(session, "%s", "\\n");
+			ret = metadata_append(session, "\\n", 2);
 			break;
-		case '\\':
-		case '"':
-			ret = lttng_metadata_printf(session, "%c", '\\');
+		default:
+			/* Escape '\\' and '"'. */
+			ret = metadata_append(session, "\\", 1);
 			if (ret) {
-				goto error;
+				goto end;
 			}
-			/* We still print the current char */
-			/* Fallthrough */
-		default:
-			ret = lttng_metadata_printf(session, "%c", cur);
+			ret = metadata_append(session, string, 1);
 			break;
 		}
 
 		if (ret) {
-			goto error;
+			goto end;
 		}
-
-		cur = string[++i];
+		string++;
 	}
-error:
+end:
 	return ret;
 }
 
@@ -873,11 +977,32 @@ int ust_metadata_event_statedump(struct ust_registry_session *session,
 		struct ust_registry_event *event)
 {
 	int ret = 0;
+	size_t start;
 
 	/* Don't dump metadata events */
 	if (chan->chan_id == -1U)
 		return 0;
 
+	start = session->metadata_len;
+
+	if (session->share_metadata_fragments && !event->metadata_fragment) {
+		event->metadata_fragment = ust_metadata_cache_lookup(
+				session->byte_order, chan, event);
+	}
+	if (event->metadata_fragment) {
+		/* Rendered by another session. */
+		ret = metadata_append(session,
+				ust_metadata_fragment_get_data(
+					event->metadata_fragment),
+				ust_metadata_fragment_get_len(
+					event->metadata_fragment));
+		if (ret) {
+			goto end;
+		}
+		event->metadata_dumped = 1;
+		goto end;
+	}
+
 	ret = lttng_metadata_printf(session,
 		"event {\n"
 		"	name = \"%s\";\n"
@@ -926,8 +1051,15 @@ int ust_metadata_event_statedump(struct ust_registry_session *session,
 	}
 	event->metadata_dumped = 1;
 
+	if (session->share_metadata_fragments) {
+		event->metadata_fragment = ust_metadata_cache_add(
+				session->byte_order, chan, event,
+				&session->metadata[start],
+				session->metadata_len - start);
+	}
+
 end:
-	return ret;
+	return metadata_statedump_end(session, start, ret);
 }
 
 /*
@@ -937,6 +1069,7 @@ int ust_metadata_channel_statedump(struct ust_registry_session *session,
 		struct ust_registry_channel *chan)
 {
 	int ret = 0;
+	size_t start;
 
 	/* Don't dump metadata events */
 	if (chan->chan_id == -1U)
@@ -945,6 +1078,7 @@ int ust_metadata_channel_statedump(struct ust_registry_session *session,
 	if (!chan->header_type)
 		return -EINVAL;
 
+	start = session->metadata_len;
 	ret = lttng_metadata_printf(session,
 		"stream {\n"
 		"	id = %u;\n"
@@ -985,7 +1119,7 @@ int ust_metadata_channel_statedump(struct ust_registry_session *session,
 	chan->metadata_dumped = 1;
 
 end:
-	return ret;
+	return metadata_statedump_end(session, start, ret);
 }
 
 static
@@ -1211,9 +1345,11 @@ int ust_metadata_session_statedump(struct ust_registry_session *session,
 	char uuid_s[LTTNG_UUID_STR_LEN],
 		clock_uuid_s[LTTNG_UUID_STR_LEN];
 	int ret = 0;
+	size_t start;
 
 	assert(session);
 
+	start = session->metadata_len;
 	lttng_uuid_to_str(session->uuid, uuid_s);
 
 	/* For crash ABI */
@@ -1369,5 +1505,5 @@ int ust_metadata_session_statedump(struct ust_registry_session *session,
 	}
 
 end:
-	return ret;
+	return metadata_statedump_end(session, start, ret);
 }
@@ -10,12 +10,14 @@
 #include <inttypes.h>
 
 #include <common/common.h>
+#include <common/compat/mman.h>
 #include <common/hashtable/utils.h>
 #include <lttng/lttng.h>
 
 #include "ust-registry.h"
 #include "ust-app.h"
 #include "ust-field-utils.h"
+#include "ust-metadata-cache.h"
 #include "utils.h"
 #include "lttng-sessiond.h"
 #include "notification-thread-commands.h"
@@ -333,6 +335,7 @@ static void destroy_event(struct ust_registry_event *event)
 		return;
 	}
 
+	ust_metadata_fragment_put(event->metadata_fragment);
 	free(event->fields);
 	free(event->model_emf_uri);
 	free(event->signature);
@@ -860,6 +863,69 @@ end:
 	return;
 }
 
+/*
+ * Create the memory file backing the metadata of a session.
+ *
+ * Return a file descriptor, or -1 if the metadata must be allocated on the
+ * heap.
+ */
+static int create_metadata_shm(void)
+{
+	int fd;
+
+	fd = lttng_memfd_create("lttng-ust-metadata");
+	if (fd < 0) {
+		DBG("Failed to create metadata memory file, metadata will be copied to the consumer: %s",
+				strerror(errno));
+	}
+	return fd;
+}
+
+/* Release the metadata buffer of a session and its backing file. */
+static void destroy_metadata(struct ust_registry_session *session)
+{
+	if (session->metadata_shm_fd < 0) {
+		free(session->metadata);
+		goto end;
+	}
+
+	if (session->metadata && munmap(session->metadata,
+			session->metadata_alloc_len)) {
+		PERROR("munmap metadata");
+	}
+	if (close(session->metadata_shm_fd)) {
+		PERROR("close metadata memory file");
+	}
+	session->metadata_shm_fd = -1;
+end:
+	session->metadata = NULL;
+	session->metadata_alloc_len = 0;
+}
+
+/*
+ * Discard the metadata of a session before it is generated again.
+ *
+ * The memory file shared with the consumer is replaced rather than
+ * overwritten: pushes of the previous version of the metadata may still be
+ * in flight and the consumer reads them from its mapping of the file.
+ *
+ * Should be called with session registry mutex held.
+ */
+void ust_registry_session_reset_metadata(struct ust_registry_session *session)
+{
+	assert(session);
+
+	if (session->metadata_shm_fd < 0) {
+		memset(session->metadata, 0, session->metadata_alloc_len);
+	} else {
+		destroy_metadata(session);
+		session->metadata_shm_fd = create_metadata_shm();
+		session->metadata_shm_key = 0;
+	}
+	session->metadata_len = 0;
+	session->metadata_len_sent = 0;
+}
+
 /*
  * Initialize registry with default values and set the newly allocated session
  * pointer to sessionp.
@@ -905,6 +971,7 @@ int ust_registry_session_init(struct ust_registry_session **sessionp,
 	session->long_alignment = long_alignment;
 	session->byte_order = byte_order;
 	session->metadata_fd = -1;
+	session->metadata_shm_fd = create_metadata_shm();
 	session->uid = euid;
 	session->gid = egid;
 	session->next_enum_id = 0;
@@ -967,6 +1034,11 @@ int ust_registry_session_init(struct ust_registry_session **sessionp,
 
 	session->tracing_id = tracing_id;
 	session->tracing_uid = tracing_uid;
+	/*
+	 * The instances of a binary traced with per-PID buffers register the
+	 * same events.
+	 */
+	session->share_metadata_fragments = app != NULL;
 
 	pthread_mutex_lock(&session->lock);
 	ret = ust_metadata_session_statedump(session, app, major, minor);
@@ -1020,7 +1092,7 @@ void ust_registry_session_destroy(struct ust_registry_session *reg)
 		ht_cleanup_push(reg->channels);
 	}
 
-	free(reg->metadata);
+	destroy_metadata(reg);
 	if (reg->metadata_fd >= 0) {
 		ret = close(reg->metadata_fd);
 		if (ret) {
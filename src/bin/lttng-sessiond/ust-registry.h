@@ -9,6 +9,7 @@
 #define LTTNG_UST_REGISTRY_H
 
 #include <pthread.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 #include <common/hashtable/hashtable.h>
@@ -20,6 +21,7 @@
 #define CTF_SPEC_MINOR	8
 
 struct ust_app;
+struct ust_metadata_fragment;
 
 struct ust_registry_session {
 	/*
@@ -60,6 +62,15 @@ struct ust_registry_session {
 	size_t metadata_len_sent;
 	/* Current version of the metadata. */
 	uint64_t metadata_version;
+	/*
+	 * Memory file backing the generated metadata, which is then mapped
+	 * rather than allocated on the heap; -1 if unsupported. The file is
+	 * shared with the consumer so that pushing metadata only sends its
+	 * offset and length.
+	 */
+	int metadata_shm_fd;
+	/* Key of the consumer metadata channel which received metadata_shm_fd. */
+	uint64_t metadata_shm_key;
 
 	/*
 	 * Those fields are only used when a session is created with
@@ -125,6 +136,12 @@ struct ust_registry_session {
 	/* The id of the parent session */
 	uint64_t tracing_id;
 	uid_t tracing_uid;
+
+	/*
+	 * Share the metadata fragments of the events with the other sessions
+	 * (per-PID sessions only).
+	 */
+	bool share_metadata_fragments;
 };
 
 struct ust_registry_channel {
@@ -183,6 +200,11 @@ struct ust_registry_event {
 	 * registration. 0 means no, 1 yes.
 	 */
 	unsigned int metadata_dumped;
+	/*
+	 * Shared metadata fragment describing this event; NULL if the metadata
+	 * of the event is not shared. See ust-metadata-cache.h.
+	 */
+	struct ust_metadata_fragment *metadata_fragment;
 	/*
 	 * Node in the ust-registry hash table. The event name is used to
 	 * initialize the node and the event_name/signature for the match function.
@@ -289,6 +311,7 @@ int ust_registry_session_init(struct ust_registry_session **sessionp,
 		uint64_t tracing_id,
 		uid_t tracing_uid);
 void ust_registry_session_destroy(struct ust_registry_session *session);
+void ust_registry_session_reset_metadata(struct ust_registry_session *session);
 
 int ust_registry_create_event(struct ust_registry_session *session,
 		uint64_t chan_key, int session_objd, int channel_objd, char *name,
@@ -363,6 +386,9 @@ static inline
 void ust_registry_session_destroy(struct ust_registry_session *session)
 {}
 static inline
+void ust_registry_session_reset_metadata(struct ust_registry_session *session)
+{}
+static inline
 int ust_registry_create_event(struct ust_registry_session *session,
 		uint64_t chan_key, int session_objd, int channel_objd, char *name,
 		char *sig, size_t nr_fields, struct ustctl_field *fields,
@@ -59,6 +59,38 @@ static inline ssize_t splice(int fd_in, loff_t *off_in, int fd_out, loff_t *off_
 }
 #endif
 
+#ifdef __linux__
+#include <sys/sendfile.h>
+
+static inline ssize_t lttng_sendfile(int out_fd, int in_fd, off_t *offset,
+		size_t count)
+{
+	return sendfile(out_fd, in_fd, offset, count);
+}
+#else
+/* The callers fall back to copying the data through user space. */
+static inline ssize_t lttng_sendfile(int out_fd, int in_fd, off_t *offset,
+		size_t count)
+{
+	errno = ENOSYS;
+	return -1;
+}
+#endif /* __linux__ */
+
+#ifdef __linux__
+/* Allocate the storage of a file range without changing the file's size. */
+static inline int lttng_fallocate_keep_size(int fd, off_t offset, off_t len)
+{
+	return fallocate(fd, FALLOC_FL_KEEP_SIZE, offset, len);
+}
+#else
+static inline int lttng_fallocate_keep_size(int fd, off_t offset, off_t len)
+{
+	errno = ENOSYS;
+	return -1;
+}
+#endif /* __linux__ */
+
 #ifdef __FreeBSD__
 #define POSIX_FADV_DONTNEED 0
 
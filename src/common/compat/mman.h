@@ -8,10 +8,32 @@
 #ifndef _COMPAT_MMAN_H
 #define _COMPAT_MMAN_H
 
+#include <errno.h>
 #include <sys/mman.h>
 
 #ifdef __linux__
 
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC	0x0001U
+#endif
+
+/*
+ * Create an anonymous file backed by memory. Returns a file descriptor, or -1
+ * on error (ENOSYS if the kernel does not support it).
+ */
+static inline int lttng_memfd_create(const char *name)
+{
+#ifdef SYS_memfd_create
+	return (int) syscall(SYS_memfd_create, name, MFD_CLOEXEC);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
 #elif defined(__FreeBSD__)
 
 #define MAP_GROWSDOWN 0
@@ -25,4 +47,12 @@
 #error "Please add support for your OS."
 #endif /* __linux__ */
 
+#ifndef __linux__
+static inline int lttng_memfd_create(const char *name)
+{
+	errno = ENOSYS;
+	return -1;
+}
+#endif /* __linux__ */
+
 #endif /* _COMPAT_MMAN_H */
@@ -19,6 +19,11 @@
 # endif
 #endif
 
+/* Hint that more data follows; only an optimization where supported. */
+#ifndef MSG_MORE
+# define MSG_MORE 0
+#endif
+
 #if defined(MSG_NOSIGNAL)
 static inline
 ssize_t lttng_recvmsg_nosigpipe(int sockfd, struct msghdr *msg)
@@ -0,0 +1,287 @@
+/*
+ * Copyright (C) 2020 EfficiOS Inc.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ */
+
+#include <assert.h>
+#include <limits.h>
+#include <string.h>
+
+#include <common/common.h>
+#include <common/compression.h>
+
+#ifdef HAVE_LIBLZ4
+#include <lz4.h>
+#endif
+#ifdef HAVE_LIBZSTD
+#include <zstd.h>
+#endif
+
+/*
+ * The data is compressed on the fly, the fastest level is favored over the
+ * compression ratio.
+ */
+#define ZSTD_COMPRESSION_LEVEL	1
+
+struct lttng_compression_context {
+	enum lttng_compression_algorithm algorithm;
+#ifdef HAVE_LIBZSTD
+	/* Allocated on first use. */
+	ZSTD_CCtx *zstd_cctx;
+	ZSTD_DCtx *zstd_dctx;
+#endif
+};
+
+LTTNG_HIDDEN
+int lttng_compression_algorithm_from_string(const char *str,
+		enum lttng_compression_algorithm *algorithm)
+{
+	int ret = 0;
+
+	if (!strcmp(str, "none")) {
+		*algorithm = LTTNG_COMPRESSION_ALGORITHM_NONE;
+	} else if (!strcmp(str, "lz4")) {
+		*algorithm = LTTNG_COMPRESSION_ALGORITHM_LZ4;
+	} else if (!strcmp(str, "zstd")) {
+		*algorithm = LTTNG_COMPRESSION_ALGORITHM_ZSTD;
+	} else {
+		ret = -1;
+	}
+
+	return ret;
+}
+
+LTTNG_HIDDEN
+const char *lttng_compression_algorithm_str(
+		enum lttng_compression_algorithm algorithm)
+{
+	switch (algorithm) {
+	case LTTNG_COMPRESSION_ALGORITHM_NONE:
+		return "none";
+	case LTTNG_COMPRESSION_ALGORITHM_LZ4:
+		return "lz4";
+	case LTTNG_COMPRESSION_ALGORITHM_ZSTD:
+		return "zstd";
+	default:
+		return "unknown";
+	}
+}
+
+LTTNG_HIDDEN
+bool lttng_compression_algorithm_is_supported(
+		enum lttng_compression_algorithm algorithm)
+{
+	switch (algorithm) {
+	case LTTNG_COMPRESSION_ALGORITHM_NONE:
+		return true;
+#ifdef HAVE_LIBLZ4
+	case LTTNG_COMPRESSION_ALGORITHM_LZ4:
+		return true;
+#endif
+#ifdef HAVE_LIBZSTD
+	case LTTNG_COMPRESSION_ALGORITHM_ZSTD:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+LTTNG_HIDDEN
+size_t lttng_compression_bound(enum lttng_compression_algorithm algorithm,
+		size_t len)
+{
+	switch (algorithm) {
+#ifdef HAVE_LIBLZ4
+	case LTTNG_COMPRESSION_ALGORITHM_LZ4:
+		return len > LZ4_MAX_INPUT_SIZE ? 0 : LZ4_compressBound(len);
+#endif
+#ifdef HAVE_LIBZSTD
+	case LTTNG_COMPRESSION_ALGORITHM_ZSTD:
+		return ZSTD_compressBound(len);
+#endif
+	default:
+		return len;
+	}
+}
+
+LTTNG_HIDDEN
+struct lttng_compression_context *lttng_compression_context_create(
+		enum lttng_compression_algorithm algorithm)
+{
+	struct lttng_compression_context *context = NULL;
+
+	if (algorithm == LTTNG_COMPRESSION_ALGORITHM_NONE ||
+			!lttng_compression_algorithm_is_supported(algorithm)) {
+		ERR("Compression algorithm \"%s\" is not supported by this build",
+				lttng_compression_algorithm_str(algorithm));
+		goto end;
+	}
+
+	context = zmalloc(sizeof(*context));
+	if (!context) {
+		PERROR("Failed to allocate compression context");
+		goto end;
+	}
+	context->algorithm = algorithm;
+end:
+	return context;
+}
+
+LTTNG_HIDDEN
+void lttng_compression_context_destroy(
+		struct lttng_compression_context *context)
+{
+	if (!context) {
+		return;
+	}
+
+#ifdef HAVE_LIBZSTD
+	ZSTD_freeCCtx(context->zstd_cctx);
+	ZSTD_freeDCtx(context->zstd_dctx);
+#endif
+	free(context);
+}
+
+LTTNG_HIDDEN
+enum lttng_compression_algorithm lttng_compression_context_get_algorithm(
+		const struct lttng_compression_context *context)
+{
+	return context->algorithm;
+}
+
+LTTNG_HIDDEN
+ssize_t lttng_compression_context_compress(
+		struct lttng_compression_context *context,
+		const void *src, size_t src_len,
+		void *dst, size_t dst_capacity)
+{
+	ssize_t ret = -1;
+
+	switch (context->algorithm) {
+#ifdef HAVE_LIBLZ4
+	case LTTNG_COMPRESSION_ALGORITHM_LZ4:
+	{
+		int compressed_len;
+
+		if (src_len > LZ4_MAX_INPUT_SIZE) {
+			ERR("Cannot compress %zu bytes with LZ4", src_len);
+			goto end;
+		}
+
+		compressed_len = LZ4_compress_default(src, dst, (int) src_len,
+				(int) min_t(size_t, dst_capacity, INT_MAX));
+		if (compressed_len <= 0) {
+			DBG("LZ4 compression of %zu bytes failed", src_len);
+			goto end;
+		}
+		ret = compressed_len;
+		break;
+	}
+#endif
+#ifdef HAVE_LIBZSTD
+	case LTTNG_COMPRESSION_ALGORITHM_ZSTD:
+	{
+		size_t compressed_len;
+
+		if (!context->zstd_cctx) {
+			context->zstd_cctx = ZSTD_createCCtx();
+			if (!context->zstd_cctx) {
+				ERR("Failed to allocate zstd compression context");
+				goto end;
+			}
+		}
+
+		compressed_len = ZSTD_compressCCtx(context->zstd_cctx, dst,
+				dst_capacity, src, src_len,
+				ZSTD_COMPRESSION_LEVEL);
+		if (ZSTD_isError(compressed_len)) {
+			DBG("zstd compression of %zu bytes failed: %s", src_len,
+					ZSTD_getErrorName(compressed_len));
+			goto end;
+		}
+		ret = compressed_len;
+		break;
+	}
+#endif
+	default:
+		ERR("Unsupported compression algorithm \"%s\"",
+				lttng_compression_algorithm_str(
+					context->algorithm));
+		goto end;
+	}
+end:
+	return ret;
+}
+
+LTTNG_HIDDEN
+int lttng_compression_context_decompress(
+		struct lttng_compression_context *context,
+		const void *src, size_t src_len,
+		void *dst, size_t dst_len)
+{
+	int ret = -1;
+
+	switch (context->algorithm) {
+#ifdef HAVE_LIBLZ4
+	case LTTNG_COMPRESSION_ALGORITHM_LZ4:
+	{
+		int decompressed_len;
+
+		if (src_len > INT_MAX || dst_len > INT_MAX) {
+			ERR("Cannot decompress %zu bytes to %zu bytes with LZ4",
+					src_len, dst_len);
+			goto end;
+		}
+
+		decompressed_len = LZ4_decompress_safe(src, dst, (int) src_len,
+				(int) dst_len);
+		if (decompressed_len < 0 ||
+				(size_t) decompressed_len != dst_len) {
+			ERR("LZ4 decompression failed: expected %zu bytes, got %d",
+					dst_len, decompressed_len);
+			goto end;
+		}
+		ret = 0;
+		break;
+	}
+#endif
+#ifdef HAVE_LIBZSTD
+	case LTTNG_COMPRESSION_ALGORITHM_ZSTD:
+	{
+		size_t decompressed_len;
+
+		if (!context->zstd_dctx) {
+			context->zstd_dctx = ZSTD_createDCtx();
+			if (!context->zstd_dctx) {
+				ERR("Failed to allocate zstd decompression context");
+				goto end;
+			}
+		}
+
+		decompressed_len = ZSTD_decompressDCtx(context->zstd_dctx, dst,
+				dst_len, src, src_len);
+		if (ZSTD_isError(decompressed_len)) {
+			ERR("zstd decompression failed: %s",
+					ZSTD_getErrorName(decompressed_len));
+			goto end;
+		} else if (decompressed_len != dst_len) {
+			ERR("zstd decompression failed: expected %zu bytes, got %zu",
+					dst_len, decompressed_len);
+			goto end;
+		}
+		ret = 0;
+		break;
+	}
+#endif
+	default:
+		ERR("Unsupported compression algorithm \"%s\"",
+				lttng_compression_algorithm_str(
+					context->algorithm));
+		goto end;
+	}
+end:
+	return ret;
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2020 EfficiOS Inc.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ */
+
+#ifndef LTTNG_COMPRESSION_H
+#define LTTNG_COMPRESSION_H
+
+#include <common/macros.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/*
+ * The values of this enumeration are part of the relay daemon protocol: they
+ * identify the compression of the data packets.
+ */
+enum lttng_compression_algorithm {
+	LTTNG_COMPRESSION_ALGORITHM_NONE = 0,
+	LTTNG_COMPRESSION_ALGORITHM_LZ4 = 1,
+	LTTNG_COMPRESSION_ALGORITHM_ZSTD = 2,
+};
+
+struct lttng_compression_context;
+
+/*
+ * Parse an algorithm name ("none", "lz4" or "zstd").
+ *
+ * Returns 0 on success, -1 if the name is unknown.
+ */
+LTTNG_HIDDEN
+int lttng_compression_algorithm_from_string(const char *str,
+		enum lttng_compression_algorithm *algorithm);
+
+LTTNG_HIDDEN
+const char *lttng_compression_algorithm_str(
+		enum lttng_compression_algorithm algorithm);
+
+/*
+ * Returns true if this build supports an algorithm. No compression is always
+ * supported.
+ */
+LTTNG_HIDDEN
+bool lttng_compression_algorithm_is_supported(
+		enum lttng_compression_algorithm algorithm);
+
+/*
+ * Maximal size of `len` bytes once compressed with an algorithm. A buffer of
+ * this size always has room for the compressed data.
+ */
+LTTNG_HIDDEN
+size_t lttng_compression_bound(enum lttng_compression_algorithm algorithm,
+		size_t len);
+
+/*
+ * A compression context holds the state an algorithm reuses from a call to
+ * the next. A context must not be used by several threads at once.
+ *
+ * Returns a new context on success, NULL if the algorithm is not supported
+ * or on allocation failure.
+ */
+LTTNG_HIDDEN
+struct lttng_compression_context *lttng_compression_context_create(
+		enum lttng_compression_algorithm algorithm);
+
+LTTNG_HIDDEN
+void lttng_compression_context_destroy(
+		struct lttng_compression_context *context);
+
+LTTNG_HIDDEN
+enum lttng_compression_algorithm lttng_compression_context_get_algorithm(
+		const struct lttng_compression_context *context);
+
+/*
+ * Compress `src_len` bytes in `dst`.
+ *
+ * Returns the size of the compressed data on success, -1 on error (including
+ * when `dst_capacity` is too small).
+ */
+LTTNG_HIDDEN
+ssize_t lttng_compression_context_compress(
+		struct lttng_compression_context *context,
+		const void *src, size_t src_len,
+		void *dst, size_t dst_capacity);
+
+/*
+ * Decompress `src_len` bytes in `dst`, which must be exactly the size of the
+ * decompressed data.
+ *
+ * Returns 0 on success, -1 if the data is corrupted or does not decompress to
+ * `dst_len` bytes.
+ */
+LTTNG_HIDDEN
+int lttng_compression_context_decompress(
+		struct lttng_compression_context *context,
+		const void *src, size_t src_len,
+		void *dst, size_t dst_len);
+
+#endif /* LTTNG_COMPRESSION_H */
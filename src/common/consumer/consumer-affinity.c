@@ -0,0 +1,384 @@
+/*
+ * Copyright (C) 2020 EfficiOS Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ */
+
+#include <assert.h>
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <common/common.h>
+#include <common/consumer/consumer-affinity.h>
+
+#define SYSFS_NODE_PATH	"/sys/devices/system/node"
+
+/*
+ * Parse a CPU list (e.g. "0-3,8,10-11") and set the node of the CPUs it
+ * contains. The CPUs beyond `cpu_count` are ignored.
+ *
+ * Returns 0 on success, -1 if the list is malformed.
+ */
+static int parse_node_cpulist(const char *list, int node, int *cpu_nodes,
+		unsigned int cpu_count)
+{
+	int ret = 0;
+	const char *pos = list;
+
+	while (*pos != '\0' && *pos != '\n') {
+		char *end;
+		unsigned long first, last, cpu;
+
+		errno = 0;
+		first = strtoul(pos, &end, 10);
+		if (errno || end == pos) {
+			ret = -1;
+			goto end;
+		}
+		last = first;
+		pos = end;
+		if (*pos == '-') {
+			pos++;
+			last = strtoul(pos, &end, 10);
+			if (errno || end == pos || last < first) {
+				ret = -1;
+				goto end;
+			}
+			pos = end;
+		}
+		if (*pos == ',') {
+			pos++;
+		}
+
+		for (cpu = first; cpu <= last && cpu < cpu_count; cpu++) {
+			cpu_nodes[cpu] = node;
+		}
+	}
+end:
+	return ret;
+}
+
+static int read_node_cpulist(int node, int *cpu_nodes, unsigned int cpu_count)
+{
+	int ret;
+	char path[PATH_MAX];
+	char *line = NULL;
+	size_t line_len = 0;
+	FILE *file;
+
+	ret = snprintf(path, sizeof(path), SYSFS_NODE_PATH "/node%d/cpulist",
+			node);
+	if (ret < 0 || ret >= sizeof(path)) {
+		ret = -1;
+		goto end;
+	}
+
+	file = fopen(path, "r");
+	if (!file) {
+		PERROR("Failed to open %s", path);
+		ret = -1;
+		goto end;
+	}
+
+	if (getline(&line, &line_len, file) < 0) {
+		PERROR("Failed to read %s", path);
+		ret = -1;
+		goto end_close;
+	}
+
+	ret = parse_node_cpulist(line, node, cpu_nodes, cpu_count);
+	if (ret) {
+		ERR("Malformed CPU list in %s: %s", path, line);
+	}
+end_close:
+	free(line);
+	if (fclose(file)) {
+		PERROR("Failed to close %s", path);
+	}
+end:
+	return ret;
+}
+
+/*
+ * Get the NUMA node of each CPU. The CPUs are all considered to belong to
+ * node 0 when the system does not expose its NUMA topology.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+static int get_cpu_nodes(int *cpu_nodes, unsigned int cpu_count)
+{
+	int ret = 0;
+	unsigned int cpu;
+	DIR *dir;
+	struct dirent *entry;
+
+	for (cpu = 0; cpu < cpu_count; cpu++) {
+		cpu_nodes[cpu] = 0;
+	}
+
+	dir = opendir(SYSFS_NODE_PATH);
+	if (!dir) {
+		DBG("NUMA topology not available, assuming a single node");
+		goto end;
+	}
+
+	while ((entry = readdir(dir))) {
+		int node;
+		char trailing;
+
+		if (sscanf(entry->d_name, "node%d%c", &node, &trailing) != 1 ||
+				node < 0) {
+			continue;
+		}
+
+		ret = read_node_cpulist(node, cpu_nodes, cpu_count);
+		if (ret) {
+			break;
+		}
+	}
+
+	if (closedir(dir)) {
+		PERROR("Failed to close %s", SYSFS_NODE_PATH);
+	}
+end:
+	return ret;
+}
+
+static int data_thread_add_cpu(struct lttng_consumer_data_thread *thread,
+		unsigned int cpu, unsigned int cpu_count)
+{
+	int ret = 0;
+
+	if (!thread->cpuset) {
+		thread->cpuset = CPU_ALLOC(cpu_count);
+		if (!thread->cpuset) {
+			PERROR("Failed to allocate CPU set of data thread %u",
+					thread->id);
+			ret = -1;
+			goto end;
+		}
+		thread->cpuset_size = CPU_ALLOC_SIZE(cpu_count);
+		CPU_ZERO_S(thread->cpuset_size, thread->cpuset);
+	}
+
+	CPU_SET_S(cpu, thread->cpuset_size, thread->cpuset);
+end:
+	return ret;
+}
+
+/*
+ * Each data thread consumes the streams of the CPUs it is pinned to.
+ */
+static int configure_cpu_affinity(struct lttng_consumer_local_data *ctx)
+{
+	int ret = 0;
+	unsigned int cpu;
+
+	for (cpu = 0; cpu < ctx->cpu_count; cpu++) {
+		const unsigned int thread = cpu % ctx->data_thread_count;
+
+		ctx->cpu_data_threads[cpu] = thread;
+		ret = data_thread_add_cpu(&ctx->data_threads[thread], cpu,
+				ctx->cpu_count);
+		if (ret) {
+			goto end;
+		}
+	}
+end:
+	return ret;
+}
+
+/*
+ * The data threads are spread over the NUMA nodes. Each thread is pinned to
+ * the CPUs of its node and consumes the streams of some of them. When there
+ * are fewer threads than nodes, the CPUs of the nodes without a thread are
+ * spread over the threads by CPU number.
+ */
+static int configure_node_affinity(struct lttng_consumer_local_data *ctx)
+{
+	int ret;
+	unsigned int cpu, node_count = 0, i;
+	int *cpu_nodes = NULL, *node_ids = NULL;
+	unsigned int *cpu_ranks = NULL, *node_cpu_counts = NULL;
+	const unsigned int thread_count = ctx->data_thread_count;
+
+	cpu_nodes = zmalloc(sizeof(*cpu_nodes) * ctx->cpu_count);
+	node_ids = zmalloc(sizeof(*node_ids) * ctx->cpu_count);
+	cpu_ranks = zmalloc(sizeof(*cpu_ranks) * ctx->cpu_count);
+	node_cpu_counts = zmalloc(sizeof(*node_cpu_counts) * ctx->cpu_count);
+	if (!cpu_nodes || !node_ids || !cpu_ranks || !node_cpu_counts) {
+		PERROR("Failed to allocate NUMA topology");
+		ret = -1;
+		goto end;
+	}
+
+	ret = get_cpu_nodes(cpu_nodes, ctx->cpu_count);
+	if (ret) {
+		goto end;
+	}
+
+	/*
+	 * Number the nodes having CPUs from 0 and rank the CPUs within their
+	 * node.
+	 */
+	for (cpu = 0; cpu < ctx->cpu_count; cpu++) {
+		for (i = 0; i < node_count; i++) {
+			if (node_ids[i] == cpu_nodes[cpu]) {
+				break;
+			}
+		}
+		if (i == node_count) {
+			node_ids[node_count++] = cpu_nodes[cpu];
+		}
+		cpu_nodes[cpu] = i;
+		cpu_ranks[cpu] = node_cpu_counts[i]++;
+	}
+
+	/* Thread `t` belongs to node `t % node_count`. */
+	for (cpu = 0; cpu < ctx->cpu_count; cpu++) {
+		const unsigned int node = cpu_nodes[cpu];
+		const unsigned int node_thread_count = thread_count > node ?
+				(thread_count - node - 1) / node_count + 1 : 0;
+		unsigned int thread;
+
+		if (node_thread_count == 0) {
+			ctx->cpu_data_threads[cpu] = cpu % thread_count;
+			continue;
+		}
+
+		thread = node + (cpu_ranks[cpu] % node_thread_count) *
+				node_count;
+		ctx->cpu_data_threads[cpu] = thread;
+	}
+
+	for (i = 0; i < thread_count; i++) {
+		const unsigned int node = i % node_count;
+
+		for (cpu = 0; cpu < ctx->cpu_count; cpu++) {
+			if (cpu_nodes[cpu] != node) {
+				continue;
+			}
+			ret = data_thread_add_cpu(&ctx->data_threads[i], cpu,
+					ctx->cpu_count);
+			if (ret) {
+				goto end;
+			}
+		}
+		DBG("Data thread %u pinned to NUMA node %d", i,
+				node_ids[node]);
+	}
+end:
+	free(cpu_nodes);
+	free(node_ids);
+	free(cpu_ranks);
+	free(node_cpu_counts);
+	return ret;
+}
+
+int consumer_data_thread_affinity_from_string(const char *str,
+		enum consumer_data_thread_affinity *affinity)
+{
+	int ret = 0;
+
+	if (!strcmp(str, "none")) {
+		*affinity = CONSUMER_DATA_THREAD_AFFINITY_NONE;
+	} else if (!strcmp(str, "cpu")) {
+		*affinity = CONSUMER_DATA_THREAD_AFFINITY_CPU;
+	} else if (!strcmp(str, "node")) {
+		*affinity = CONSUMER_DATA_THREAD_AFFINITY_NODE;
+	} else {
+		ret = -1;
+	}
+
+	return ret;
+}
+
+int consumer_affinity_configure(struct lttng_consumer_local_data *ctx,
+		enum consumer_data_thread_affinity affinity)
+{
+	int ret = 0;
+	long cpu_count;
+
+	assert(!ctx->cpu_data_threads);
+
+	if (affinity == CONSUMER_DATA_THREAD_AFFINITY_NONE) {
+		goto end;
+	}
+
+	cpu_count = sysconf(_SC_NPROCESSORS_CONF);
+	if (cpu_count <= 0) {
+		PERROR("Failed to get the number of CPUs");
+		ret = -1;
+		goto end;
+	}
+
+	ctx->cpu_data_threads = zmalloc(sizeof(*ctx->cpu_data_threads) *
+			cpu_count);
+	if (!ctx->cpu_data_threads) {
+		PERROR("Failed to allocate the data threads of the CPUs");
+		ret = -1;
+		goto end;
+	}
+	ctx->cpu_count = cpu_count;
+
+	switch (affinity) {
+	case CONSUMER_DATA_THREAD_AFFINITY_CPU:
+		ret = configure_cpu_affinity(ctx);
+		break;
+	case CONSUMER_DATA_THREAD_AFFINITY_NODE:
+		ret = configure_node_affinity(ctx);
+		break;
+	default:
+		abort();
+	}
+
+	if (ret) {
+		consumer_affinity_fini(ctx);
+	}
+end:
+	return ret;
+}
+
+void consumer_affinity_fini(struct lttng_consumer_local_data *ctx)
+{
+	unsigned int i;
+
+	for (i = 0; i < ctx->data_thread_count; i++) {
+		CPU_FREE(ctx->data_threads[i].cpuset);
+		ctx->data_threads[i].cpuset = NULL;
+	}
+	free(ctx->cpu_data_threads);
+	ctx->cpu_data_threads = NULL;
+	ctx->cpu_count = 0;
+}
+
+void consumer_affinity_apply(const struct lttng_consumer_data_thread *thread)
+{
+	int ret;
+
+	if (!thread->cpuset) {
+		goto end;
+	}
+
+	ret = pthread_setaffinity_np(pthread_self(), thread->cpuset_size,
+			thread->cpuset);
+	if (ret) {
+		errno = ret;
+		PERROR("Failed to set the CPU affinity of data thread %u",
+				thread->id);
+		WARN("Data thread %u runs on any CPU", thread->id);
+		goto end;
+	}
+
+	DBG("Data thread %u pinned to %d CPU(s)", thread->id,
+			CPU_COUNT_S(thread->cpuset_size, thread->cpuset));
+end:
+	return;
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2020 EfficiOS Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ */
+
+#ifndef CONSUMER_AFFINITY_H
+#define CONSUMER_AFFINITY_H
+
+#include <common/consumer/consumer.h>
+
+enum consumer_data_thread_affinity {
+	/* The data threads may run on any CPU. */
+	CONSUMER_DATA_THREAD_AFFINITY_NONE,
+	/*
+	 * Each data thread is pinned to the CPUs of the per-CPU buffers it
+	 * consumes.
+	 */
+	CONSUMER_DATA_THREAD_AFFINITY_CPU,
+	/*
+	 * Each data thread is pinned to a NUMA node and consumes the per-CPU
+	 * buffers of that node's CPUs.
+	 */
+	CONSUMER_DATA_THREAD_AFFINITY_NODE,
+};
+
+/*
+ * Parse an affinity name ("none", "cpu" or "node").
+ *
+ * Returns 0 on success, -1 if the name is unknown.
+ */
+int consumer_data_thread_affinity_from_string(const char *str,
+		enum consumer_data_thread_affinity *affinity);
+
+/*
+ * Compute the CPUs on which each data thread of a context runs and the data
+ * thread consuming the streams of each CPU.
+ *
+ * Must be called before the data threads are launched.
+ *
+ * Returns 0 on success, a negative value on error.
+ */
+int consumer_affinity_configure(struct lttng_consumer_local_data *ctx,
+		enum consumer_data_thread_affinity affinity);
+
+/*
+ * Release the affinity configuration of a context.
+ */
+void consumer_affinity_fini(struct lttng_consumer_local_data *ctx);
+
+/*
+ * Pin the calling thread to the CPUs of a data thread, if any.
+ *
+ * A failure only results in a warning since the thread remains functional.
+ */
+void consumer_affinity_apply(const struct lttng_consumer_data_thread *thread);
+
+#endif /* CONSUMER_AFFINITY_H */
@@ -11,11 +11,13 @@
 #include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <inttypes.h>
 
 #include <common/common.h>
+#include <common/compat/mman.h>
 #include <common/utils.h>
 #include <common/sessiond-comm/sessiond-comm.h>
 #include <common/ust-consumer/ust-consumer.h>
@@ -26,47 +28,89 @@
 extern struct lttng_consumer_global_data consumer_data;
 
 /*
- * Extend the allocated size of the metadata cache. Called only from
- * lttng_ustconsumer_write_metadata_cache.
+ * Make room for `size` bytes of metadata in the cache by allocating the
+ * missing chunks. The chunks already allocated are left untouched.
+ *
+ * The chunks are not zeroed: the cache never holds data past its max offset
+ * (see metadata_cache_fill()).
  *
  * Return 0 on success, a negative value on error.
  */
-static int extend_metadata_cache(struct lttng_consumer_channel *channel,
-		unsigned int size)
+static int metadata_cache_reserve(struct consumer_metadata_cache *cache,
+		uint64_t size)
 {
 	int ret = 0;
-	char *tmp_data_ptr;
-	unsigned int new_size, old_size;
-
-	assert(channel);
-	assert(channel->metadata_cache);
+	const uint64_t chunk_count = (size + DEFAULT_METADATA_CACHE_CHUNK_SIZE - 1) /
+			DEFAULT_METADATA_CACHE_CHUNK_SIZE;
 
-	old_size = channel->metadata_cache->cache_alloc_size;
-	new_size = max_t(unsigned int, old_size + size, old_size << 1);
-	DBG("Extending metadata cache to %u", new_size);
-	tmp_data_ptr = realloc(channel->metadata_cache->data, new_size);
-	if (!tmp_data_ptr) {
-		ERR("Reallocating metadata cache");
-		free(channel->metadata_cache->data);
-		ret = -1;
+	if (chunk_count <= cache->chunk_count) {
 		goto end;
 	}
-	/* Zero newly allocated memory */
-	memset(tmp_data_ptr + old_size, 0, new_size - old_size);
-	channel->metadata_cache->data = tmp_data_ptr;
-	channel->metadata_cache->cache_alloc_size = new_size;
 
+	if (chunk_count > cache->chunk_capacity) {
+		char **chunks;
+		const uint64_t capacity = max_t(uint64_t, chunk_count,
+				cache->chunk_capacity << 1);
+
+		chunks = realloc(cache->chunks, capacity * sizeof(*chunks));
+		if (!chunks) {
+			PERROR("realloc metadata cache chunk array");
+			ret = -1;
+			goto end;
+		}
+		cache->chunks = chunks;
+		cache->chunk_capacity = capacity;
+	}
+
+	while (cache->chunk_count < chunk_count) {
+		char *chunk = malloc(DEFAULT_METADATA_CACHE_CHUNK_SIZE);
+
+		if (!chunk) {
+			PERROR("malloc metadata cache chunk");
+			ret = -1;
+			goto end;
+		}
+		cache->chunks[cache->chunk_count++] = chunk;
+	}
+	DBG("Extended metadata cache to %" PRIu64 " chunks of %d bytes",
+			cache->chunk_count, DEFAULT_METADATA_CACHE_CHUNK_SIZE);
 end:
 	return ret;
 }
 
 /*
- * Reset the metadata cache.
+ * Copy `len` bytes of `data` at `offset` in the cache, or zero them if `data`
+ * is NULL. The chunks holding them must be allocated.
+ */
+static void metadata_cache_fill(struct consumer_metadata_cache *cache,
+		uint64_t offset, const char *data, uint64_t len)
+{
+	while (len) {
+		const uint64_t chunk_offset =
+				offset % DEFAULT_METADATA_CACHE_CHUNK_SIZE;
+		const uint64_t copy_len = min_t(uint64_t, len,
+				DEFAULT_METADATA_CACHE_CHUNK_SIZE - chunk_offset);
+		char *dst = cache->chunks[offset /
+				DEFAULT_METADATA_CACHE_CHUNK_SIZE] + chunk_offset;
+
+		if (data) {
+			memcpy(dst, data, copy_len);
+			data += copy_len;
+		} else {
+			memset(dst, 0, copy_len);
+		}
+		offset += copy_len;
+		len -= copy_len;
+	}
+}
+
+/*
+ * Reset the metadata cache. The chunks are kept to hold the metadata of the
+ * next version.
  */
 static
 void metadata_cache_reset(struct consumer_metadata_cache *cache)
 {
-	memset(cache->data, 0, cache->cache_alloc_size);
 	cache->max_offset = 0;
 }
 
@@ -157,16 +201,18 @@ int consumer_metadata_cache_write(struct lttng_consumer_channel *channel,
 
 	DBG("Writing %u bytes from offset %u in metadata cache", len, offset);
 
-	if (offset + len > cache->cache_alloc_size) {
-		ret = extend_metadata_cache(channel,
-				len - cache->cache_alloc_size + offset);
-		if (ret < 0) {
-			ERR("Extending metadata cache");
-			goto end;
-		}
+	ret = metadata_cache_reserve(cache, (uint64_t) offset + len);
+	if (ret < 0) {
+		ERR("Extending metadata cache");
+		goto end;
 	}
 
-	memcpy(cache->data + offset, data, len);
+	if (offset > cache->max_offset) {
+		/* Don't expose the metadata of a previous version. */
+		metadata_cache_fill(cache, cache->max_offset, NULL,
+				offset - cache->max_offset);
+	}
+	metadata_cache_fill(cache, offset, data, len);
 	if (offset + len > cache->max_offset) {
 		cache->max_offset = offset + len;
 		ret = consumer_metadata_wakeup_pipe(channel);
@@ -176,8 +222,156 @@ end:
 	return ret;
 }
 
+static
+void metadata_cache_release_shm(struct consumer_metadata_cache *cache)
+{
+	if (cache->shm_data && munmap((void *) cache->shm_data,
+			cache->shm_size)) {
+		PERROR("munmap metadata memory file");
+	}
+	if (cache->shm_fd >= 0 && close(cache->shm_fd)) {
+		PERROR("close metadata memory file");
+	}
+	cache->shm_fd = -1;
+	cache->shm_data = NULL;
+	cache->shm_size = 0;
+}
+
+/*
+ * Map the metadata memory file so that at least `size` bytes are readable.
+ * The file only grows; it is mapped again, whole, when the metadata outgrows
+ * the current mapping.
+ *
+ * Return 0 on success, a negative value on error.
+ */
+static
+int metadata_cache_map_shm(struct consumer_metadata_cache *cache,
+		uint64_t size)
+{
+	int ret = 0;
+	struct stat statbuf;
+	void *data;
+
+	if (size <= cache->shm_size) {
+		goto end;
+	}
+
+	ret = fstat(cache->shm_fd, &statbuf);
+	if (ret) {
+		PERROR("fstat metadata memory file");
+		goto end;
+	}
+	if ((uint64_t) statbuf.st_size < size) {
+		ERR("Metadata memory file holds %" PRIu64 " bytes, expected at least %" PRIu64,
+				(uint64_t) statbuf.st_size, size);
+		ret = -1;
+		goto end;
+	}
+
+	data = mmap(NULL, statbuf.st_size, PROT_READ, MAP_SHARED,
+			cache->shm_fd, 0);
+	if (data == MAP_FAILED) {
+		PERROR("mmap metadata memory file");
+		ret = -1;
+		goto end;
+	}
+	if (cache->shm_data && munmap((void *) cache->shm_data,
+			cache->shm_size)) {
+		PERROR("munmap metadata memory file");
+	}
+	cache->shm_data = data;
+	cache->shm_size = statbuf.st_size;
+end:
+	return ret;
+}
+
 /*
- * Create the metadata cache, original allocated size: max_sb_size
+ * Replace the memory file from which the metadata of `version` is read. The
+ * cache owns `shm_fd` on return. The metadata cache lock MUST be acquired.
+ */
+void consumer_metadata_cache_set_shm(struct lttng_consumer_channel *channel,
+		int shm_fd, uint64_t version)
+{
+	struct consumer_metadata_cache *cache;
+
+	assert(channel);
+	assert(channel->metadata_cache);
+	assert(shm_fd >= 0);
+
+	cache = channel->metadata_cache;
+	DBG("Reading metadata version %" PRIu64 " from memory file %d",
+			version, shm_fd);
+	metadata_cache_release_shm(cache);
+	cache->shm_fd = shm_fd;
+	cache->shm_version = version;
+}
+
+/*
+ * Write the metadata found at `offset` in the memory file to the cache. The
+ * metadata cache lock MUST be acquired.
+ *
+ * Return 0 on success, 1 if the metadata was pushed from a memory file
+ * which has since been replaced, and a negative value on error.
+ */
+int consumer_metadata_cache_write_from_shm(
+		struct lttng_consumer_channel *channel,
+		unsigned int offset, unsigned int len, uint64_t version)
+{
+	int ret;
+	struct consumer_metadata_cache *cache;
+
+	assert(channel);
+	assert(channel->metadata_cache);
+
+	cache = channel->metadata_cache;
+	if (cache->shm_fd < 0) {
+		ERR("Metadata pushed from a memory file which was not received");
+		ret = -1;
+		goto end;
+	}
+
+	if (cache->shm_version != version) {
+		/* The metadata was regenerated since this push. */
+		DBG("Ignoring push of metadata version %" PRIu64 " (memory file holds version %" PRIu64 ")",
+				version, cache->shm_version);
+		ret = 1;
+		goto end;
+	}
+
+	ret = metadata_cache_map_shm(cache, (uint64_t) offset + len);
+	if (ret) {
+		goto end;
+	}
+
+	ret = consumer_metadata_cache_write(channel, offset, len, version,
+			cache->shm_data + offset);
+end:
+	return ret;
+}
+
+/*
+ * Return the address of the metadata found at `offset` in the cache and set
+ * `len` to the number of bytes readable from there without crossing the end
+ * of a chunk. `offset` must be below the max offset of the cache. The
+ * metadata cache lock MUST be acquired.
+ */
+const char *consumer_metadata_cache_get_data(
+		const struct consumer_metadata_cache *cache,
+		uint64_t offset, uint64_t *len)
+{
+	const uint64_t chunk_offset = offset % DEFAULT_METADATA_CACHE_CHUNK_SIZE;
+
+	assert(cache);
+	assert(offset < cache->max_offset);
+
+	*len = min_t(uint64_t, cache->max_offset - offset,
+			DEFAULT_METADATA_CACHE_CHUNK_SIZE - chunk_offset);
+	return cache->chunks[offset / DEFAULT_METADATA_CACHE_CHUNK_SIZE] +
+			chunk_offset;
+}
+
+/*
+ * Create the metadata cache. Its chunks are allocated as metadata is written.
  *
  * Return 0 on success, a negative value on error.
  */
@@ -200,22 +394,11 @@ int consumer_metadata_cache_allocate(struct lttng_consumer_channel *channel)
 		goto end_free_cache;
 	}
 
-	channel->metadata_cache->cache_alloc_size = DEFAULT_METADATA_CACHE_SIZE;
-	channel->metadata_cache->data = zmalloc(
-			channel->metadata_cache->cache_alloc_size * sizeof(char));
-	if (!channel->metadata_cache->data) {
-		PERROR("zmalloc metadata cache data");
-		ret = -1;
-		goto end_free_mutex;
-	}
-	DBG("Allocated metadata cache of %" PRIu64 " bytes",
-			channel->metadata_cache->cache_alloc_size);
+	channel->metadata_cache->shm_fd = -1;
 
 	ret = 0;
 	goto end;
 
-end_free_mutex:
-	pthread_mutex_destroy(&channel->metadata_cache->lock);
 end_free_cache:
 	free(channel->metadata_cache);
 end:
@@ -227,6 +410,8 @@ end:
  */
 void consumer_metadata_cache_destroy(struct lttng_consumer_channel *channel)
 {
+	uint64_t i;
+
 	if (!channel || !channel->metadata_cache) {
 		return;
 	}
@@ -234,7 +419,11 @@ void consumer_metadata_cache_destroy(struct lttng_consumer_channel *channel)
 	DBG("Destroying metadata cache");
 
 	pthread_mutex_destroy(&channel->metadata_cache->lock);
-	free(channel->metadata_cache->data);
+	metadata_cache_release_shm(channel->metadata_cache);
+	for (i = 0; i < channel->metadata_cache->chunk_count; i++) {
+		free(channel->metadata_cache->chunks[i]);
+	}
+	free(channel->metadata_cache->chunks);
 	free(channel->metadata_cache);
 }
 
@@ -12,8 +12,17 @@
 #include <common/consumer/consumer.h>
 
 struct consumer_metadata_cache {
-	char *data;
-	uint64_t cache_alloc_size;
+	/*
+	 * The metadata is held in chunks of DEFAULT_METADATA_CACHE_CHUNK_SIZE
+	 * bytes, allocated as the cache grows. Growing the cache never moves
+	 * the cached metadata; it is read through
+	 * consumer_metadata_cache_get_data().
+	 */
+	char **chunks;
+	/* Number of chunks allocated. */
+	uint64_t chunk_count;
+	/* Number of chunk addresses `chunks` can hold. */
+	uint64_t chunk_capacity;
 	/*
 	 * Current version of the metadata cache.
 	 */
@@ -23,7 +32,8 @@ struct consumer_metadata_cache {
 	 *
 	 * With the total_bytes_written it allows us to keep track of when the
 	 * cache contains contiguous metadata ready to be sent to the RB.
-	 * All cached data is contiguous.
+	 * All cached data is contiguous; the chunks hold no data past this
+	 * offset.
 	 */
 	uint64_t max_offset;
 	/*
@@ -33,11 +43,30 @@ struct consumer_metadata_cache {
 	 * This is nested INSIDE the consumer_data lock.
 	 */
 	pthread_mutex_t lock;
+	/*
+	 * Memory file holding the metadata generated by the session daemon,
+	 * from which the pushed metadata is read; -1 if the metadata is
+	 * received on the socket.
+	 */
+	int shm_fd;
+	/* Read-only mapping of the memory file. */
+	const char *shm_data;
+	uint64_t shm_size;
+	/* Version of the metadata held by the memory file. */
+	uint64_t shm_version;
 };
 
 int consumer_metadata_cache_write(struct lttng_consumer_channel *channel,
 		unsigned int offset, unsigned int len, uint64_t version,
 		const char *data);
+void consumer_metadata_cache_set_shm(struct lttng_consumer_channel *channel,
+		int shm_fd, uint64_t version);
+int consumer_metadata_cache_write_from_shm(
+		struct lttng_consumer_channel *channel,
+		unsigned int offset, unsigned int len, uint64_t version);
+const char *consumer_metadata_cache_get_data(
+		const struct consumer_metadata_cache *cache,
+		uint64_t offset, uint64_t *len);
 int consumer_metadata_cache_allocate(struct lttng_consumer_channel *channel);
 void consumer_metadata_cache_destroy(struct lttng_consumer_channel *channel);
 int consumer_metadata_cache_flushed(struct lttng_consumer_channel *channel,
@@ -644,6 +644,7 @@ struct lttng_consumer_stream *consumer_stream_create(
 	stream->output_written = 0;
 	stream->net_seq_idx = relayd_id;
 	stream->session_id = session_id;
+	stream->cpu = cpu;
 	stream->monitor = monitor;
 	stream->endpoint_status = CONSUMER_ENDPOINT_ACTIVE;
 	stream->index_file = NULL;
@@ -869,6 +870,7 @@ void consumer_stream_close(struct lttng_consumer_stream *stream)
 
 	/* Close output fd. Could be a socket or local file at this point. */
 	if (stream->out_fd >= 0) {
+		consumer_stream_release_output_file_preallocation(stream);
 		ret = close(stream->out_fd);
 		if (ret) {
 			PERROR("close");
@@ -938,6 +940,9 @@ void consumer_stream_delete(struct lttng_consumer_stream *stream,
 		/* Decrement the stream count of the global consumer data. */
 		assert(consumer_data.stream_count > 0);
 		consumer_data.stream_count--;
+		if (stream->data_thread) {
+			uatomic_dec(&stream->data_thread->stream_count);
+		}
 	}
 }
 
@@ -1042,9 +1047,6 @@ void consumer_stream_destroy(struct lttng_consumer_stream *stream,
 			/* Update channel's refcount of the stream. */
 			free_chan = unref_channel(stream);
 
-			/* Indicates that the consumer data state MUST be updated after this. */
-			consumer_data.need_update = 1;
-
 			pthread_mutex_unlock(&stream->lock);
 			pthread_mutex_unlock(&stream->chan->lock);
 			pthread_mutex_unlock(&consumer_data.lock);
@@ -1143,6 +1145,7 @@ int consumer_stream_create_output_files(struct lttng_consumer_stream *stream,
 	}
 
 	if (stream->out_fd >= 0) {
+		consumer_stream_release_output_file_preallocation(stream);
 		ret = close(stream->out_fd);
 		if (ret < 0) {
 			PERROR("Failed to close stream file \"%s\"",
@@ -1160,6 +1163,8 @@ int consumer_stream_create_output_files(struct lttng_consumer_stream *stream,
 		ret = -1;
 		goto end;
 	}
+	stream->out_fd_allocated_size = 0;
+	stream->out_fd_preallocation_failed = false;
 
 	if (!stream->metadata_flag && (create_index || stream->index_file)) {
 		if (stream->index_file) {
@@ -1186,6 +1191,41 @@ end:
 	return ret;
 }
 
+void consumer_stream_preallocate_output_file(
+		struct lttng_consumer_stream *stream, uint64_t size)
+{
+	/*
+	 * The snapshot files are written at once and the metadata files may
+	 * be truncated when the metadata is regenerated.
+	 */
+	if (!consumer_data.trace_file_preallocation_size ||
+			stream->metadata_flag || !stream->chan->monitor ||
+			stream->out_fd_preallocation_failed ||
+			size <= stream->out_fd_allocated_size) {
+		return;
+	}
+
+	if (utils_preallocate_stream_file(stream->out_fd, size,
+			consumer_data.trace_file_preallocation_size,
+			stream->chan->tracefile_size,
+			&stream->out_fd_allocated_size)) {
+		PERROR("Failed to preallocate output file of stream \"%s\", it will grow with its writes",
+				stream->name);
+		stream->out_fd_preallocation_failed = true;
+	}
+}
+
+void consumer_stream_release_output_file_preallocation(
+		struct lttng_consumer_stream *stream)
+{
+	if (!stream->out_fd_allocated_size) {
+		return;
+	}
+
+	(void) utils_release_stream_file_preallocation(stream->out_fd,
+			&stream->out_fd_allocated_size);
+}
+
 int consumer_stream_rotate_output_files(struct lttng_consumer_stream *stream)
 {
 	int ret;
@@ -99,6 +99,23 @@ int consumer_stream_sync_metadata(struct lttng_consumer_local_data *ctx,
 int consumer_stream_create_output_files(struct lttng_consumer_stream *stream,
 		bool create_index);
 
+/*
+ * Allocate the storage of the output file of a local stream so that it may
+ * grow to `size` bytes, if enabled. The file is written normally if its
+ * storage can't be allocated.
+ *
+ * This must be called with the stream's lock held.
+ */
+void consumer_stream_preallocate_output_file(
+		struct lttng_consumer_stream *stream, uint64_t size);
+
+/*
+ * Release the storage allocated past the end of the output file of a local
+ * stream. Must be called before the file is closed.
+ */
+void consumer_stream_release_output_file_preallocation(
+		struct lttng_consumer_stream *stream);
+
 /*
  * Rotate the output files of a local stream. This will change the
  * active output files of both the binary and index in accordance
@@ -35,6 +35,7 @@
 #include <common/relayd/relayd.h>
 #include <common/ust-consumer/ust-consumer.h>
 #include <common/consumer/consumer-timer.h>
+#include <common/consumer/consumer-affinity.h>
 #include <common/consumer/consumer.h>
 #include <common/consumer/consumer-stream.h>
 #include <common/consumer/consumer-testpoint.h>
@@ -44,10 +45,10 @@
 #include <common/trace-chunk-registry.h>
 #include <common/string-utils/format.h>
 #include <common/dynamic-array.h>
+#include <common/hashtable/utils.h>
 
 struct lttng_consumer_global_data consumer_data = {
 	.stream_count = 0,
-	.need_update = 1,
 	.type = LTTNG_CONSUMER_UNKNOWN,
 };
 
@@ -110,6 +111,18 @@ static void notify_thread_lttng_pipe(struct lttng_pipe *pipe)
 	(void) lttng_pipe_write(pipe, &null_stream, sizeof(null_stream));
 }
 
+/*
+ * Wake up all the data threads with a NULL stream.
+ */
+static void notify_data_threads(struct lttng_consumer_local_data *ctx)
+{
+	unsigned int i;
+
+	for (i = 0; i < ctx->data_thread_count; i++) {
+		notify_thread_lttng_pipe(ctx->data_threads[i].data_pipe);
+	}
+}
+
 static void notify_health_quit_pipe(int *pipe)
 {
 	ssize_t ret;
@@ -334,6 +347,7 @@ static void free_relayd_rcu(struct rcu_head *head)
 	(void) relayd_close(&relayd->data_sock);
 
 	pthread_mutex_destroy(&relayd->ctrl_sock_mutex);
+	pthread_mutex_destroy(&relayd->data_sock_mutex);
 	free(relayd);
 }
 
@@ -513,7 +527,7 @@ void lttng_consumer_cleanup_relayd(struct consumer_relayd_sock_pair *relayd)
 	 * memory barrier ordering the updates of the end point status from the
 	 * read of this status which happens AFTER receiving this notify.
 	 */
-	notify_thread_lttng_pipe(relayd->ctx->consumer_data_pipe);
+	notify_data_threads(relayd->ctx);
 	notify_thread_lttng_pipe(relayd->ctx->consumer_metadata_pipe);
 }
 
@@ -617,7 +631,9 @@ void consumer_add_data_stream(struct lttng_consumer_stream *stream)
 
 	/* Update consumer data once the node is inserted. */
 	consumer_data.stream_count++;
-	consumer_data.need_update = 1;
+	if (stream->data_thread) {
+		uatomic_inc(&stream->data_thread->stream_count);
+	}
 
 	rcu_read_unlock();
 	pthread_mutex_unlock(&stream->lock);
@@ -626,6 +642,34 @@ void consumer_add_data_stream(struct lttng_consumer_stream *stream)
 	pthread_mutex_unlock(&consumer_data.lock);
 }
 
+/*
+ * Select the data thread that consumes a data stream.
+ *
+ * The per-cpu streams are assigned by cpu so that the streams of a given cpu
+ * are all consumed by the same thread, whatever their channel. When the data
+ * threads are pinned, that thread runs on or near the stream's cpu. The other
+ * streams are assigned by hash of their key.
+ */
+struct lttng_consumer_data_thread *consumer_select_data_thread(
+		struct lttng_consumer_local_data *ctx,
+		const struct lttng_consumer_stream *stream)
+{
+	unsigned long index;
+
+	assert(ctx->data_thread_count > 0);
+
+	if (stream->cpu >= 0 && ctx->cpu_data_threads &&
+			(unsigned int) stream->cpu < ctx->cpu_count) {
+		index = ctx->cpu_data_threads[stream->cpu];
+	} else if (stream->cpu >= 0) {
+		index = stream->cpu;
+	} else {
+		index = hash_key_u64(&stream->key, lttng_ht_seed);
+	}
+
+	return &ctx->data_threads[index % ctx->data_thread_count];
+}
+
 /*
  * Add relayd socket to global consumer data hashtable. RCU read side lock MUST
  * be acquired before calling this.
@@ -676,6 +720,7 @@ static struct consumer_relayd_sock_pair *consumer_allocate_relayd_sock_pair(
 	obj->data_sock.sock.fd = -1;
 	lttng_ht_node_init_u64(&obj->node, obj->net_seq_idx);
 	pthread_mutex_init(&obj->ctrl_sock_mutex, NULL);
+	pthread_mutex_init(&obj->data_sock_mutex, NULL);
 
 error:
 	return obj;
@@ -816,6 +861,28 @@ void close_relayd_stream(struct lttng_consumer_stream *stream)
 	rcu_read_unlock();
 }
 
+static void populate_relayd_data_hdr(const struct lttng_consumer_stream *stream,
+		size_t data_size, unsigned long padding,
+		struct lttcomm_relayd_data_hdr *data_hdr)
+{
+	memset(data_hdr, 0, sizeof(*data_hdr));
+
+	/* Set header with stream information */
+	data_hdr->stream_id = htobe64(stream->relayd_stream_id);
+	data_hdr->data_size = htobe32(data_size);
+	data_hdr->padding_size = htobe32(padding);
+
+	/*
+	 * Note that net_seq_num below is assigned with the *current* value of
+	 * next_net_seq_num and only after that the next_net_seq_num will be
+	 * increment. This is why when issuing a command on the relayd using
+	 * this next value, 1 should always be substracted in order to compare
+	 * the last seen sequence number on the relayd side to the last sent.
+	 */
+	data_hdr->net_seq_num = htobe64(stream->next_net_seq_num);
+	/* Other fields are zeroed previously */
+}
+
 /*
  * Handle stream for relayd transmission if the stream applies for network
  * streaming where the net sequence index is set.
@@ -833,9 +900,6 @@ static int write_relayd_stream_header(struct lttng_consumer_stream *stream,
 	assert(stream);
 	assert(relayd);
 
-	/* Reset data header */
-	memset(&data_hdr, 0, sizeof(data_hdr));
-
 	if (stream->metadata_flag) {
 		/* Caller MUST acquire the relayd control socket lock */
 		ret = relayd_send_metadata(&relayd->control_sock, data_size);
@@ -846,20 +910,7 @@ static int write_relayd_stream_header(struct lttng_consumer_stream *stream,
 		/* Metadata are always sent on the control socket. */
 		outfd = relayd->control_sock.sock.fd;
 	} else {
-		/* Set header with stream information */
-		data_hdr.stream_id = htobe64(stream->relayd_stream_id);
-		data_hdr.data_size = htobe32(data_size);
-		data_hdr.padding_size = htobe32(padding);
-
-		/*
-		 * Note that net_seq_num below is assigned with the *current* value of
-		 * next_net_seq_num and only after that the next_net_seq_num will be
-		 * increment. This is why when issuing a command on the relayd using
-		 * this next value, 1 should always be substracted in order to compare
-		 * the last seen sequence number on the relayd side to the last sent.
-		 */
-		data_hdr.net_seq_num = htobe64(stream->next_net_seq_num);
-		/* Other fields are zeroed previously */
+		populate_relayd_data_hdr(stream, data_size, padding, &data_hdr);
 
 		ret = relayd_send_data_hdr(&relayd->data_sock, &data_hdr,
 				sizeof(data_hdr));
@@ -1116,70 +1167,6 @@ int consumer_add_channel(struct lttng_consumer_channel *channel,
 	return 0;
 }
 
-/*
- * Allocate the pollfd structure and the local view of the out fds to avoid
- * doing a lookup in the linked list and concurrency issues when writing is
- * needed. Called with consumer_data.lock held.
- *
- * Returns the number of fds in the structures.
- */
-static int update_poll_array(struct lttng_consumer_local_data *ctx,
-		struct pollfd **pollfd, struct lttng_consumer_stream **local_stream,
-		struct lttng_ht *ht, int *nb_inactive_fd)
-{
-	int i = 0;
-	struct lttng_ht_iter iter;
-	struct lttng_consumer_stream *stream;
-
-	assert(ctx);
-	assert(ht);
-	assert(pollfd);
-	assert(local_stream);
-
-	DBG("Updating poll fd array");
-	*nb_inactive_fd = 0;
-	rcu_read_lock();
-	cds_lfht_for_each_entry(ht->ht, &iter.iter, stream, node.node) {
-		/*
-		 * Only active streams with an active end point can be added to the
-		 * poll set and local stream storage of the thread.
-		 *
-		 * There is a potential race here for endpoint_status to be updated
-		 * just after the check. However, this is OK since the stream(s) will
-		 * be deleted once the thread is notified that the end point state has
-		 * changed where this function will be called back again.
-		 *
-		 * We track the number of inactive FDs because they still need to be
-		 * closed by the polling thread after a wakeup on the data_pipe or
-		 * metadata_pipe.
-		 */
-		if (stream->endpoint_status == CONSUMER_ENDPOINT_INACTIVE) {
-			(*nb_inactive_fd)++;
-			continue;
-		}
-		/*
-		 * This clobbers way too much the debug output. Uncomment that if you
-		 * need it for debugging purposes.
-		 */
-		(*pollfd)[i].fd = stream->wait_fd;
-		(*pollfd)[i].events = POLLIN | POLLPRI;
-		local_stream[i] = stream;
-		i++;
-	}
-	rcu_read_unlock();
-
-	/*
-	 * Insert the consumer_data_pipe at the end of the array and don't
-	 * increment i so nb_fd is the number of real FD.
-	 */
-	(*pollfd)[i].fd = lttng_pipe_get_readfd(ctx->consumer_data_pipe);
-	(*pollfd)[i].events = POLLIN | POLLPRI;
-
-	(*pollfd)[i + 1].fd = lttng_pipe_get_readfd(ctx->consumer_wakeup_pipe);
-	(*pollfd)[i + 1].events = POLLIN | POLLPRI;
-	return i;
-}
-
 /*
  * Poll on the should_quit pipe and the command socket return -1 on
  * error, 1 if should exit, 0 if data is available on the command socket
@@ -1362,7 +1349,7 @@ void lttng_consumer_sync_trace_file(struct lttng_consumer_stream *stream,
 /*
  * Initialise the necessary environnement :
  * - create a new context
- * - create the poll_pipe
+ * - create the data and wakeup pipes of each data thread
  * - create the should_quit pipe (for signal handler)
  * - create the thread pipe (for splice)
  *
@@ -1371,6 +1358,9 @@ void lttng_consumer_sync_trace_file(struct lttng_consumer_stream *stream,
  * kernctl_get_next_subbuf, read the data with mmap or splice depending on the
  * buffer configuration and then kernctl_put_next_subbuf at the end.
  *
+ * The data streams are spread over `data_thread_count` data threads, each
+ * of which must be launched with consumer_thread_data_poll().
+ *
  * Returns a pointer to the new context or NULL on error.
  */
 struct lttng_consumer_local_data *lttng_consumer_create(
@@ -1379,11 +1369,14 @@ struct lttng_consumer_local_data *lttng_consumer_create(
 			struct lttng_consumer_local_data *ctx, bool locked_by_caller),
 		int (*recv_channel)(struct lttng_consumer_channel *channel),
 		int (*recv_stream)(struct lttng_consumer_stream *stream),
-		int (*update_stream)(uint64_t stream_key, uint32_t state))
+		int (*update_stream)(uint64_t stream_key, uint32_t state),
+		unsigned int data_thread_count)
 {
 	int ret;
+	unsigned int i;
 	struct lttng_consumer_local_data *ctx;
 
+	assert(data_thread_count > 0);
 	assert(consumer_data.type == LTTNG_CONSUMER_UNKNOWN ||
 		consumer_data.type == type);
 	consumer_data.type = type;
@@ -1403,20 +1396,37 @@ struct lttng_consumer_local_data *lttng_consumer_create(
 	ctx->on_recv_stream = recv_stream;
 	ctx->on_update_stream = update_stream;
 
-	ctx->consumer_data_pipe = lttng_pipe_open(0);
-	if (!ctx->consumer_data_pipe) {
-		goto error_poll_pipe;
+	ctx->data_threads = zmalloc(sizeof(*ctx->data_threads) *
+			data_thread_count);
+	if (!ctx->data_threads) {
+		PERROR("allocating data threads");
+		goto error_data_threads;
 	}
 
-	ctx->consumer_wakeup_pipe = lttng_pipe_open(0);
-	if (!ctx->consumer_wakeup_pipe) {
-		goto error_wakeup_pipe;
+	for (; ctx->data_thread_count < data_thread_count;
+			ctx->data_thread_count++) {
+		struct lttng_consumer_data_thread *thread =
+				&ctx->data_threads[ctx->data_thread_count];
+
+		thread->id = ctx->data_thread_count;
+		thread->ctx = ctx;
+		thread->data_pipe = lttng_pipe_open(0);
+		if (!thread->data_pipe) {
+			goto error_data_pipes;
+		}
+
+		thread->wakeup_pipe = lttng_pipe_open(0);
+		if (!thread->wakeup_pipe) {
+			lttng_pipe_destroy(thread->data_pipe);
+			goto error_data_pipes;
+		}
 	}
+	ctx->data_threads_running = data_thread_count;
 
 	ret = pipe(ctx->consumer_should_quit);
 	if (ret < 0) {
 		PERROR("Error creating recv pipe");
-		goto error_quit_pipe;
+		goto error_data_pipes;
 	}
 
 	ret = pipe(ctx->consumer_channel_pipe);
@@ -1438,11 +1448,13 @@ error_metadata_pipe:
 	utils_close_pipe(ctx->consumer_channel_pipe);
 error_channel_pipe:
 	utils_close_pipe(ctx->consumer_should_quit);
-error_quit_pipe:
-	lttng_pipe_destroy(ctx->consumer_wakeup_pipe);
-error_wakeup_pipe:
-	lttng_pipe_destroy(ctx->consumer_data_pipe);
-error_poll_pipe:
+error_data_pipes:
+	for (i = 0; i < ctx->data_thread_count; i++) {
+		lttng_pipe_destroy(ctx->data_threads[i].data_pipe);
+		lttng_pipe_destroy(ctx->data_threads[i].wakeup_pipe);
+	}
+	free(ctx->data_threads);
+error_data_threads:
 	free(ctx);
 error:
 	return NULL;
@@ -1505,6 +1517,7 @@ static void destroy_metadata_stream_ht(struct lttng_ht *ht)
 void lttng_consumer_destroy(struct lttng_consumer_local_data *ctx)
 {
 	int ret;
+	unsigned int i;
 
 	DBG("Consumer destroying it. Closing everything.");
 
@@ -1524,9 +1537,13 @@ void lttng_consumer_destroy(struct lttng_consumer_local_data *ctx)
 		PERROR("close");
 	}
 	utils_close_pipe(ctx->consumer_channel_pipe);
-	lttng_pipe_destroy(ctx->consumer_data_pipe);
+	consumer_affinity_fini(ctx);
+	for (i = 0; i < ctx->data_thread_count; i++) {
+		lttng_pipe_destroy(ctx->data_threads[i].data_pipe);
+		lttng_pipe_destroy(ctx->data_threads[i].wakeup_pipe);
+	}
+	free(ctx->data_threads);
 	lttng_pipe_destroy(ctx->consumer_metadata_pipe);
-	lttng_pipe_destroy(ctx->consumer_wakeup_pipe);
 	utils_close_pipe(ctx->consumer_should_quit);
 
 	unlink(ctx->consumer_command_sock_path);
@@ -1571,6 +1588,182 @@ end:
 	return (int) ret;
 }
 
+/*
+ * Compress a data packet's payload in the compression buffer of a data
+ * thread.
+ *
+ * Returns the size of the compressed payload, 0 if the payload must be sent
+ * as is since it does not shrink once compressed or is larger than what the
+ * relayd accepts compressed.
+ */
+static size_t compress_relayd_payload(
+		struct lttng_consumer_compression *compression,
+		const char *payload, size_t payload_len)
+{
+	ssize_t ret;
+
+	if (payload_len < 2 ||
+			payload_len > DEFAULT_NETWORK_RELAYD_COMPRESSED_PACKET_MAX_SIZE) {
+		return 0;
+	}
+
+	/* The compression fails if the payload does not shrink. */
+	if (lttng_dynamic_buffer_set_size(&compression->buffer,
+			payload_len - 1)) {
+		return 0;
+	}
+
+	ret = lttng_compression_context_compress(compression->context, payload,
+			payload_len, compression->buffer.data,
+			compression->buffer.size);
+	return ret > 0 ? ret : 0;
+}
+
+/*
+ * Send a packet to the relayd along with its header(s), directly from the
+ * sub-buffer, in a single sendmsg() call whenever the socket buffer has room
+ * for it.
+ *
+ * The stream is flagged with `zerocopy_pending` if the sub-buffer was sent with
+ * zero-copy: it must then be held until the completion of the send. The
+ * header, on the stack, is always copied by the kernel.
+ *
+ * The caller must hold the relayd control socket lock for a metadata stream
+ * and the data socket lock otherwise.
+ *
+ * Returns 0 on success, a negative errno value on error.
+ */
+static int send_relayd_packet(struct lttng_consumer_stream *stream,
+		struct consumer_relayd_sock_pair *relayd,
+		const char *payload, size_t payload_len, unsigned long padding)
+{
+	int ret;
+
+	if (stream->metadata_flag) {
+		struct lttcomm_relayd_metadata_payload metadata_hdr;
+
+		memset(&metadata_hdr, 0, sizeof(metadata_hdr));
+		metadata_hdr.stream_id = htobe64(stream->relayd_stream_id);
+		metadata_hdr.padding_size = htobe32(padding);
+
+		/* Metadata are always sent on the control socket. */
+		ret = relayd_send_metadata_packet(&relayd->control_sock,
+				&metadata_hdr, payload, payload_len);
+	} else {
+		struct lttcomm_relayd_data_hdr data_hdr;
+		size_t compressed_len = 0;
+
+		if (relayd->compression != LTTNG_COMPRESSION_ALGORITHM_NONE &&
+				stream->compression) {
+			compressed_len = compress_relayd_payload(
+					stream->compression, payload,
+					payload_len);
+		}
+
+		populate_relayd_data_hdr(stream, payload_len, padding,
+				&data_hdr);
+		if (compressed_len) {
+			/* The relayd indexes the packet in uncompressed terms. */
+			data_hdr.compression = htobe32(relayd->compression);
+			data_hdr.uncompressed_size = htobe32(payload_len);
+			data_hdr.data_size = htobe32(compressed_len);
+			payload = stream->compression->buffer.data;
+			payload_len = compressed_len;
+		}
+
+		/*
+		 * A compressed payload is overwritten by the next compression:
+		 * only the sub-buffer can be held until a zero-copy send
+		 * completes.
+		 */
+		ret = relayd_send_data_packet(&relayd->data_sock, &data_hdr,
+				payload, payload_len,
+				&relayd->data_sock_zerocopy,
+				stream->zerocopy && !compressed_len ?
+					&stream->zerocopy_id : NULL);
+		if (ret >= 0) {
+			stream->zerocopy_pending = ret == 1;
+			++stream->next_net_seq_num;
+			ret = 0;
+		}
+	}
+
+	return ret;
+}
+
+/*
+ * Write the sub-buffers accumulated in the write batch of a stream to its
+ * local trace file.
+ *
+ * Returns 0 on success, a negative errno value on error.
+ */
+int lttng_consumer_flush_write_batch(struct lttng_consumer_stream *stream)
+{
+	int ret = 0;
+	ssize_t written;
+	struct lttng_dynamic_buffer *batch = stream->write_batch;
+	off_t batch_offset;
+
+	if (!batch || batch->size == 0) {
+		goto end;
+	}
+
+	/* `out_fd_offset` already accounts for the accumulated data. */
+	batch_offset = stream->out_fd_offset - batch->size;
+	written = lttng_write(stream->out_fd, batch->data, batch->size);
+	if (written < 0 || (size_t) written != batch->size) {
+		ret = written < 0 ? -errno : -EIO;
+		PERROR("Failed to write the %zu bytes accumulated for stream %" PRIu64,
+				batch->size, stream->key);
+		goto end;
+	}
+	DBG("Consumer write batch flushed %zu bytes of stream %" PRIu64,
+			batch->size, stream->key);
+
+	/* This won't block, but will start writeout asynchronously */
+	lttng_sync_file_range(stream->out_fd, batch_offset, batch->size,
+			SYNC_FILE_RANGE_WRITE);
+	lttng_consumer_sync_trace_file(stream, batch_offset);
+end:
+	/* The data is dropped on error, like a failed direct write. */
+	if (batch) {
+		(void) lttng_dynamic_buffer_set_size(batch, 0);
+	}
+	return ret;
+}
+
+/*
+ * Accumulate a sub-buffer in the write batch of a stream, flushing the batch
+ * first if it is full.
+ *
+ * Returns `len` on success, a negative errno value on error.
+ */
+static ssize_t write_batch_append(struct lttng_consumer_stream *stream,
+		const char *data, size_t len)
+{
+	ssize_t ret;
+
+	if (stream->write_batch->size + len >
+			DEFAULT_CONSUMERD_WRITE_BATCH_SIZE) {
+		ret = lttng_consumer_flush_write_batch(stream);
+		if (ret) {
+			goto end;
+		}
+	}
+
+	ret = lttng_dynamic_buffer_append(stream->write_batch, data, len);
+	if (ret) {
+		ret = -ENOMEM;
+		goto end;
+	}
+
+	stream->out_fd_offset += len;
+	stream->output_written += len;
+	ret = len;
+end:
+	return ret;
+}
+
 /*
  * Mmap the ring buffer, read it and write the data to the tracefile. This is a
  * core function for writing trace buffers to either the local filesystem or
@@ -1612,8 +1805,6 @@ ssize_t lttng_consumer_on_read_subbuffer_mmap(
 
 	/* Handle stream on the relayd if the output is on the network */
 	if (relayd) {
-		unsigned long netlen = subbuf_content_size;
-
 		/*
 		 * Lock the control socket for the complete duration of the function
 		 * since from this point on we will use the socket.
@@ -1631,27 +1822,26 @@ ssize_t lttng_consumer_on_read_subbuffer_mmap(
 				}
 				stream->reset_metadata_flag = 0;
 			}
-			netlen += sizeof(struct lttcomm_relayd_metadata_payload);
+		} else {
+			/*
+			 * The data socket is shared by the data threads. Hold it
+			 * from the header up to the end of the payload.
+			 */
+			pthread_mutex_lock(&relayd->data_sock_mutex);
 		}
 
-		ret = write_relayd_stream_header(stream, netlen, padding, relayd);
+		ret = send_relayd_packet(stream, relayd, buffer->data,
+				subbuf_content_size, padding);
 		if (ret < 0) {
+			if (ret == -EPIPE) {
+				DBG("Consumer mmap send detected relayd hang up");
+			}
 			relayd_hang_up = 1;
 			goto write_error;
 		}
-		/* Use the returned socket. */
-		outfd = ret;
-
-		/* Write metadata stream id before payload */
-		if (stream->metadata_flag) {
-			ret = write_relayd_metadata_id(outfd, stream, padding);
-			if (ret < 0) {
-				relayd_hang_up = 1;
-				goto write_error;
-			}
-		}
-
-		write_len = subbuf_content_size;
+		ret = subbuf_content_size;
+		stream->output_written += ret;
+		goto end;
 	} else {
 		/* No streaming; we have to write the full padding. */
 		if (stream->metadata_flag && stream->reset_metadata_flag) {
@@ -1669,6 +1859,10 @@ ssize_t lttng_consumer_on_read_subbuffer_mmap(
 		if (stream->chan->tracefile_size > 0 &&
 				(stream->tracefile_size_current + buffer->size) >
 				stream->chan->tracefile_size) {
+			ret = lttng_consumer_flush_write_batch(stream);
+			if (ret) {
+				goto end;
+			}
 			ret = consumer_stream_rotate_output_files(stream);
 			if (ret) {
 				goto end;
@@ -1676,8 +1870,23 @@ ssize_t lttng_consumer_on_read_subbuffer_mmap(
 			outfd = stream->out_fd;
 			orig_offset = 0;
 		}
+		consumer_stream_preallocate_output_file(stream,
+				stream->tracefile_size_current + buffer->size);
 		stream->tracefile_size_current += buffer->size;
 		write_len = buffer->size;
+
+		if (stream->write_batch && write_len <=
+				DEFAULT_CONSUMERD_WRITE_BATCH_SIZE / 2) {
+			ret = write_batch_append(stream, buffer->data,
+					write_len);
+			goto end;
+		}
+
+		/* Preserve the order of the data already accumulated. */
+		ret = lttng_consumer_flush_write_batch(stream);
+		if (ret) {
+			goto end;
+		}
 	}
 
 	/*
@@ -1694,34 +1903,17 @@ ssize_t lttng_consumer_on_read_subbuffer_mmap(
 		if (ret < 0) {
 			ret = -errno;
 		}
-		relayd_hang_up = 1;
-
-		/* Socket operation failed. We consider the relayd dead */
-		if (errno == EPIPE) {
-			/*
-			 * This is possible if the fd is closed on the other side
-			 * (outfd) or any write problem. It can be verbose a bit for a
-			 * normal execution if for instance the relayd is stopped
-			 * abruptly. This can happen so set this to a DBG statement.
-			 */
-			DBG("Consumer mmap write detected relayd hang up");
-		} else {
-			/* Unhandled error, print it and stop function right now. */
-			PERROR("Error in write mmap (ret %zd != write_len %zu)", ret,
-					write_len);
-		}
-		goto write_error;
+		PERROR("Error in write mmap (ret %zd != write_len %zu)", ret,
+				write_len);
+		goto end;
 	}
 	stream->output_written += ret;
 
-	/* This call is useless on a socket so better save a syscall. */
-	if (!relayd) {
-		/* This won't block, but will start writeout asynchronously */
-		lttng_sync_file_range(outfd, stream->out_fd_offset, write_len,
-				SYNC_FILE_RANGE_WRITE);
-		stream->out_fd_offset += write_len;
-		lttng_consumer_sync_trace_file(stream, orig_offset);
-	}
+	/* This won't block, but will start writeout asynchronously */
+	lttng_sync_file_range(outfd, stream->out_fd_offset, write_len,
+			SYNC_FILE_RANGE_WRITE);
+	stream->out_fd_offset += write_len;
+	lttng_consumer_sync_trace_file(stream, orig_offset);
 
 write_error:
 	/*
@@ -1734,9 +1926,10 @@ write_error:
 	}
 
 end:
-	/* Unlock only if ctrl socket used */
 	if (relayd && stream->metadata_flag) {
 		pthread_mutex_unlock(&relayd->ctrl_sock_mutex);
+	} else if (relayd) {
+		pthread_mutex_unlock(&relayd->data_sock_mutex);
 	}
 
 	rcu_read_unlock();
@@ -1820,6 +2013,9 @@ ssize_t lttng_consumer_on_read_subbuffer_splice(
 			}
 
 			total_len += sizeof(struct lttcomm_relayd_metadata_payload);
+		} else {
+			/* See lttng_consumer_on_read_subbuffer_mmap(). */
+			pthread_mutex_lock(&relayd->data_sock_mutex);
 		}
 
 		ret = write_relayd_stream_header(stream, total_len, padding, relayd);
@@ -1856,6 +2052,8 @@ ssize_t lttng_consumer_on_read_subbuffer_splice(
 			outfd = stream->out_fd;
 			orig_offset = 0;
 		}
+		consumer_stream_preallocate_output_file(stream,
+				stream->tracefile_size_current + len);
 		stream->tracefile_size_current += len;
 	}
 
@@ -1956,6 +2154,8 @@ splice_error:
 end:
 	if (relayd && stream->metadata_flag) {
 		pthread_mutex_unlock(&relayd->ctrl_sock_mutex);
+	} else if (relayd) {
+		pthread_mutex_unlock(&relayd->data_sock_mutex);
 	}
 
 	rcu_read_unlock();
@@ -2226,9 +2426,162 @@ void consumer_add_metadata_stream(struct lttng_consumer_stream *stream)
 }
 
 /*
- * Delete data stream that are flagged for deletion (endpoint_status).
+ * State of a file descriptor of the data thread's poll set, indexed by fd.
+ */
+struct data_poll_fd_state {
+	struct lttng_consumer_stream *stream;
+	/* Events to handle during the current pass. */
+	uint32_t revents;
+	/* Set when the fd is part of the current pass. */
+	bool in_pass;
+	/*
+	 * Set while the stream holds a sub-buffer until the completion of its
+	 * zero-copy send. The fd is removed from the poll set in the meantime.
+	 */
+	bool pinned;
+};
+
+/*
+ * Only the data streams that are part of a pass of the data thread are
+ * visited: those whose wait fd is ready and those flagged as still having
+ * data after the previous pass.
+ */
+struct data_poll_set {
+	struct lttng_consumer_data_thread *thread;
+	struct lttng_poll_event events;
+	/* Array of struct data_poll_fd_state indexed by fd. */
+	struct lttng_dynamic_array fd_states;
+	/* Array of the fds (int) that are part of the current pass. */
+	struct lttng_dynamic_array pass_fds;
+	/* Number of pinned fds, polled for their completion with a timeout. */
+	unsigned int pinned_count;
+};
+
+static struct data_poll_fd_state *data_poll_get_fd_state(
+		struct data_poll_set *set, int fd)
+{
+	assert(fd >= 0);
+	assert(fd < lttng_dynamic_array_get_count(&set->fd_states));
+
+	return lttng_dynamic_array_get_element(&set->fd_states, fd);
+}
+
+static int data_poll_add_stream(struct data_poll_set *set,
+		struct lttng_consumer_stream *stream)
+{
+	int ret;
+	struct data_poll_fd_state *state;
+
+	if (stream->wait_fd >= lttng_dynamic_array_get_count(&set->fd_states)) {
+		ret = lttng_dynamic_array_set_count(&set->fd_states,
+				stream->wait_fd + 1);
+		if (ret) {
+			ERR("Failed to grow the data thread's fd state array to %d elements",
+					stream->wait_fd + 1);
+			goto end;
+		}
+	}
+
+	state = data_poll_get_fd_state(set, stream->wait_fd);
+	assert(!state->stream);
+	ret = lttng_poll_add(&set->events, stream->wait_fd,
+			LPOLLIN | LPOLLPRI);
+	if (ret) {
+		goto end;
+	}
+	state->stream = stream;
+	DBG("Added data stream %d to the poll set of data thread %u (%lu streams)",
+			stream->wait_fd, set->thread->id,
+			uatomic_read(&set->thread->stream_count));
+end:
+	return ret;
+}
+
+/*
+ * Remove a stream from the data thread's poll set and destroy it.
+ */
+static void data_poll_del_stream(struct data_poll_set *set,
+		struct lttng_consumer_stream *stream)
+{
+	struct data_poll_fd_state *state =
+			data_poll_get_fd_state(set, stream->wait_fd);
+
+	assert(state->stream == stream);
+	/* The fd is skipped if it is part of the current pass. */
+	state->stream = NULL;
+	if (state->pinned) {
+		state->pinned = false;
+		set->pinned_count--;
+	} else {
+		(void) lttng_poll_del(&set->events, stream->wait_fd);
+	}
+	consumer_del_stream(stream, data_ht);
+}
+
+/*
+ * Start a new pass of the data thread from the events returned by the last
+ * wait on its poll set. The streams flagged as still having data after the
+ * previous pass and the pinned ones are part of the new one, whatever their
+ * events.
+ */
+static int data_poll_start_pass(struct data_poll_set *set, int nb_events)
+{
+	int ret = 0, i;
+	size_t kept_fd_count = 0, fd_count, j;
+
+	fd_count = lttng_dynamic_array_get_count(&set->pass_fds);
+	for (j = 0; j < fd_count; j++) {
+		const int fd = *(int *) lttng_dynamic_array_get_element(
+				&set->pass_fds, j);
+		struct data_poll_fd_state *state =
+				data_poll_get_fd_state(set, fd);
+
+		state->revents = 0;
+		if (!state->stream ||
+				(!state->stream->has_data && !state->pinned)) {
+			state->in_pass = false;
+			continue;
+		}
+		*(int *) lttng_dynamic_array_get_element(&set->pass_fds,
+				kept_fd_count++) = fd;
+	}
+	ret = lttng_dynamic_array_set_count(&set->pass_fds, kept_fd_count);
+	if (ret) {
+		goto end;
+	}
+
+	for (i = 0; i < nb_events; i++) {
+		const int fd = LTTNG_POLL_GETFD(&set->events, i);
+		struct data_poll_fd_state *state;
+
+		if (fd == lttng_pipe_get_readfd(set->thread->data_pipe) ||
+				fd == lttng_pipe_get_readfd(set->thread->wakeup_pipe)) {
+			continue;
+		}
+
+		state = data_poll_get_fd_state(set, fd);
+		if (!state->stream) {
+			continue;
+		}
+		state->revents |= LTTNG_POLL_GETEV(&set->events, i);
+		if (state->in_pass) {
+			continue;
+		}
+		ret = lttng_dynamic_array_add_element(&set->pass_fds, &fd);
+		if (ret) {
+			goto end;
+		}
+		state->in_pass = true;
+	}
+end:
+	return ret;
+}
+
+/*
+ * Delete the data streams of the thread that are flagged for deletion
+ * (endpoint_status).
  */
-static void validate_endpoint_status_data_stream(void)
+static void validate_endpoint_status_data_stream(struct data_poll_set *set)
 {
 	struct lttng_ht_iter iter;
 	struct lttng_consumer_stream *stream;
@@ -2237,12 +2590,23 @@ static void validate_endpoint_status_data_stream(void)
 
 	rcu_read_lock();
 	cds_lfht_for_each_entry(data_ht->ht, &iter.iter, stream, node.node) {
+		/* The streams of the other data threads are left to them. */
+		if (stream->data_thread != set->thread) {
+			continue;
+		}
 		/* Validate delete flag of the stream */
 		if (stream->endpoint_status == CONSUMER_ENDPOINT_ACTIVE) {
 			continue;
 		}
 		/* Delete it right now */
-		consumer_del_stream(stream, data_ht);
+		if (stream->wait_fd >= 0 &&
+				stream->wait_fd < lttng_dynamic_array_get_count(&set->fd_states) &&
+				data_poll_get_fd_state(set, stream->wait_fd)->stream == stream) {
+			data_poll_del_stream(set, stream);
+		} else {
+			/* The stream was not received by the data thread yet. */
+			consumer_del_stream(stream, data_ht);
+		}
 	}
 	rcu_read_unlock();
 }
@@ -2493,23 +2857,143 @@ error_testpoint:
 	return NULL;
 }
 
+/*
+ * Consume the ready sub-buffers of a stream, up to its drain budget, so that
+ * a burst of sub-buffers does not cost a poll round-trip per sub-buffer.
+ *
+ * The budget bounds the time spent on a stream before the other ready
+ * streams are serviced. It grows while the stream still has data once its
+ * budget is spent and shrinks when the stream runs out of data early.
+ *
+ * The stream is locked for the whole drain. The sub-buffers written to a
+ * local trace file are accumulated in the thread's write batch, which is
+ * flushed before the stream is unlocked.
+ *
+ * Returns the number of bytes consumed if any, else the result of the last
+ * read (0, -EAGAIN, -ENODATA or an error).
+ */
+static ssize_t data_thread_drain_stream(
+		struct lttng_consumer_data_thread *thread,
+		struct lttng_consumer_stream *stream)
+{
+	int flush_ret;
+	ssize_t ret, consumed = 0;
+	unsigned int count = 0;
+	struct lttng_consumer_local_data *ctx = thread->ctx;
+
+	if (stream->drain_budget == 0) {
+		stream->drain_budget = 1;
+	}
+
+	stream->read_subbuffer_ops.lock(stream);
+	if (stream->net_seq_idx == (uint64_t) -1ULL) {
+		stream->write_batch = &thread->write_batch;
+	} else {
+		stream->zerocopy = true;
+		if (thread->compression.context) {
+			stream->compression = &thread->compression;
+		}
+	}
+
+	/*
+	 * The next sub-buffer can't be read before the completion of the
+	 * zero-copy send of the current one.
+	 */
+	do {
+		ret = ctx->on_buffer_ready(stream, ctx, true);
+		if (ret > 0) {
+			consumed += ret;
+		}
+	} while (ret > 0 && ++count < stream->drain_budget &&
+			!stream->zerocopy_pending);
+
+	flush_ret = lttng_consumer_flush_write_batch(stream);
+	stream->write_batch = NULL;
+	stream->compression = NULL;
+	stream->zerocopy = false;
+	stream->read_subbuffer_ops.unlock(stream);
+
+	if (ret > 0 && stream->drain_budget <
+			DEFAULT_CONSUMERD_DRAIN_MAX_SUBBUFFERS) {
+		stream->drain_budget *= 2;
+	} else if (ret <= 0 && count < stream->drain_budget / 2) {
+		stream->drain_budget /= 2;
+	}
+
+	thread->consumed_bytes += consumed;
+	if (ret < 0 && ret != -EAGAIN && ret != -ENODATA) {
+		goto end;
+	}
+	if (flush_ret) {
+		ret = flush_ret;
+		goto end;
+	}
+	if (consumed > 0) {
+		ret = consumed;
+	}
+end:
+	return ret;
+}
+
+/*
+ * Drain a stream of the current pass and remove its wait fd from the poll set
+ * while it holds a sub-buffer until the completion of its zero-copy send: the
+ * wait fd may stay ready in the meantime and the stream is part of every pass
+ * until the completion is received. Parking the fd with no requested events
+ * would not do, since a hang up of the producer would still be reported by
+ * every wait.
+ *
+ * Returns the result of data_thread_drain_stream().
+ */
+static ssize_t data_poll_drain_stream(struct data_poll_set *set,
+		struct data_poll_fd_state *state)
+{
+	int ret;
+	ssize_t len;
+	struct lttng_consumer_stream *stream = state->stream;
+
+	len = data_thread_drain_stream(set->thread, stream);
+	if (stream->zerocopy_pending == state->pinned) {
+		goto end;
+	}
+
+	if (stream->zerocopy_pending) {
+		ret = lttng_poll_del(&set->events, stream->wait_fd);
+	} else {
+		ret = lttng_poll_add(&set->events, stream->wait_fd,
+				LPOLLIN | LPOLLPRI);
+	}
+	if (ret < 0) {
+		ERR("Failed to update the events of data stream %d",
+				stream->wait_fd);
+		len = ret;
+		goto end;
+	}
+	state->pinned = stream->zerocopy_pending;
+	if (state->pinned) {
+		set->pinned_count++;
+	} else {
+		set->pinned_count--;
+	}
+end:
+	return len;
+}
+
 /*
  * This thread polls the fds in the set to consume the data and write
  * it to tracefile if necessary.
+ *
+ * `data` is the struct lttng_consumer_data_thread of the thread; its data
+ * streams are received through its data pipe.
  */
 void *consumer_thread_data_poll(void *data)
 {
-	int num_rdy, num_hup, high_prio, ret, i, err = -1;
-	struct pollfd *pollfd = NULL;
-	/* local view of the streams */
-	struct lttng_consumer_stream **local_stream = NULL, *new_stream = NULL;
-	/* local view of consumer_data.fds_count */
-	int nb_fd = 0;
-	/* 2 for the consumer_data_pipe and wake up pipe */
-	const int nb_pipes_fd = 2;
-	/* Number of FDs with CONSUMER_ENDPOINT_INACTIVE but still open. */
-	int nb_inactive_fd = 0;
-	struct lttng_consumer_local_data *ctx = data;
+	int num_rdy, high_prio, ret, i, err = -1;
+	size_t pass_fd_count;
+	struct data_poll_set set;
+	struct lttng_consumer_stream *new_stream = NULL;
+	struct lttng_consumer_data_thread *thread = data;
+	struct lttng_consumer_local_data *ctx = thread->ctx;
 	ssize_t len;
 
 	rcu_register_thread();
@@ -2522,75 +3006,76 @@ void *consumer_thread_data_poll(void *data)
 
 	health_code_update();
 
-	local_stream = zmalloc(sizeof(struct lttng_consumer_stream *));
-	if (local_stream == NULL) {
-		PERROR("local_stream malloc");
+	/*
+	 * Pin the thread before allocating its poll set so that its memory is
+	 * allocated on the thread's NUMA node.
+	 */
+	consumer_affinity_apply(thread);
+
+	set.thread = thread;
+	set.pinned_count = 0;
+	lttng_dynamic_buffer_init(&thread->write_batch);
+	lttng_dynamic_buffer_init(&thread->compression.buffer);
+	if (ctx->relayd_compression != LTTNG_COMPRESSION_ALGORITHM_NONE) {
+		thread->compression.context = lttng_compression_context_create(
+				ctx->relayd_compression);
+		if (!thread->compression.context) {
+			WARN("Data thread %u sends the data to the relay daemons uncompressed",
+					thread->id);
+		}
+	}
+	lttng_dynamic_array_init(&set.fd_states,
+			sizeof(struct data_poll_fd_state), NULL);
+	lttng_dynamic_array_init(&set.pass_fds, sizeof(int), NULL);
+
+	/* 2 for the data pipe and wake up pipe */
+	ret = lttng_poll_create(&set.events, 2, LTTNG_CLOEXEC);
+	if (ret < 0) {
+		ERR("Poll set creation failed");
+		goto end_poll;
+	}
+
+	ret = lttng_poll_add(&set.events,
+			lttng_pipe_get_readfd(thread->data_pipe),
+			LPOLLIN | LPOLLPRI);
+	if (ret < 0) {
+		goto end;
+	}
+
+	ret = lttng_poll_add(&set.events,
+			lttng_pipe_get_readfd(thread->wakeup_pipe),
+			LPOLLIN | LPOLLPRI);
+	if (ret < 0) {
 		goto end;
 	}
 
 	while (1) {
+		bool data_pipe_ready = false, wakeup_pipe_ready = false;
+
 		health_code_update();
 
 		high_prio = 0;
-		num_hup = 0;
-
-		/*
-		 * the fds set has been updated, we need to update our
-		 * local array as well
-		 */
-		pthread_mutex_lock(&consumer_data.lock);
-		if (consumer_data.need_update) {
-			free(pollfd);
-			pollfd = NULL;
-
-			free(local_stream);
-			local_stream = NULL;
-
-			/* Allocate for all fds */
-			pollfd = zmalloc((consumer_data.stream_count + nb_pipes_fd) * sizeof(struct pollfd));
-			if (pollfd == NULL) {
-				PERROR("pollfd malloc");
-				pthread_mutex_unlock(&consumer_data.lock);
-				goto end;
-			}
-
-			local_stream = zmalloc((consumer_data.stream_count + nb_pipes_fd) *
-					sizeof(struct lttng_consumer_stream *));
-			if (local_stream == NULL) {
-				PERROR("local_stream malloc");
-				pthread_mutex_unlock(&consumer_data.lock);
-				goto end;
-			}
-			ret = update_poll_array(ctx, &pollfd, local_stream,
-					data_ht, &nb_inactive_fd);
-			if (ret < 0) {
-				ERR("Error in allocating pollfd or local_outfds");
-				lttng_consumer_send_error(ctx, LTTCOMM_CONSUMERD_POLL_ERROR);
-				pthread_mutex_unlock(&consumer_data.lock);
-				goto end;
-			}
-			nb_fd = ret;
-			consumer_data.need_update = 0;
-		}
-		pthread_mutex_unlock(&consumer_data.lock);
 
 		/* No FDs and consumer_quit, consumer_cleanup the thread */
-		if (nb_fd == 0 && nb_inactive_fd == 0 &&
+		if (uatomic_read(&thread->stream_count) == 0 &&
 				CMM_LOAD_SHARED(consumer_quit) == 1) {
 			err = 0;	/* All is OK */
 			goto end;
 		}
-		/* poll on the array of fds */
+		/* poll on the set of fds */
 	restart:
-		DBG("polling on %d fd", nb_fd + nb_pipes_fd);
+		DBG("Data thread %u polling on %u fd", thread->id,
+				LTTNG_POLL_GETNB(&set.events));
 		if (testpoint(consumerd_thread_data_poll)) {
 			goto end;
 		}
 		health_poll_entry();
-		num_rdy = poll(pollfd, nb_fd + nb_pipes_fd, -1);
+		num_rdy = lttng_poll_wait(&set.events, set.pinned_count ?
+				DEFAULT_CONSUMERD_RELAYD_ZEROCOPY_POLL_TIMEOUT :
+				-1);
 		health_poll_exit();
 		DBG("poll num_rdy : %d", num_rdy);
-		if (num_rdy == -1) {
+		if (num_rdy < 0) {
 			/*
 			 * Restart interrupted system call.
 			 */
@@ -2600,7 +3085,7 @@ void *consumer_thread_data_poll(void *data)
 			PERROR("Poll error");
 			lttng_consumer_send_error(ctx, LTTCOMM_CONSUMERD_POLL_ERROR);
 			goto end;
-		} else if (num_rdy == 0) {
+		} else if (num_rdy == 0 && set.pinned_count == 0) {
 			DBG("Polling thread timed out");
 			goto end;
 		}
@@ -2611,16 +3096,30 @@ void *consumer_thread_data_poll(void *data)
 			goto restart;
 		}
 
+		for (i = 0; i < num_rdy; i++) {
+			const int fd = LTTNG_POLL_GETFD(&set.events, i);
+			const uint32_t revents = LTTNG_POLL_GETEV(&set.events, i);
+
+			if (!(revents & (LPOLLIN | LPOLLPRI))) {
+				continue;
+			}
+			if (fd == lttng_pipe_get_readfd(thread->data_pipe)) {
+				data_pipe_ready = true;
+			} else if (fd == lttng_pipe_get_readfd(thread->wakeup_pipe)) {
+				wakeup_pipe_ready = true;
+			}
+		}
+
 		/*
-		 * If the consumer_data_pipe triggered poll go directly to the
-		 * beginning of the loop to update the array. We want to prioritize
-		 * array update over low-priority reads.
+		 * If the data pipe triggered poll go directly to the
+		 * beginning of the loop to update the poll set. We want to
+		 * prioritize poll set updates over low-priority reads.
 		 */
-		if (pollfd[nb_fd].revents & (POLLIN | POLLPRI)) {
+		if (data_pipe_ready) {
 			ssize_t pipe_readlen;
 
-			DBG("consumer_data_pipe wake up");
-			pipe_readlen = lttng_pipe_read(ctx->consumer_data_pipe,
+			DBG("Data thread %u data pipe wake up", thread->id);
+			pipe_readlen = lttng_pipe_read(thread->data_pipe,
 					&new_stream, sizeof(new_stream));
 			if (pipe_readlen < sizeof(new_stream)) {
 				PERROR("Consumer data pipe");
@@ -2634,46 +3133,66 @@ void *consumer_thread_data_poll(void *data)
 			 * waking us up to test it.
 			 */
 			if (new_stream == NULL) {
-				validate_endpoint_status_data_stream();
+				validate_endpoint_status_data_stream(&set);
 				continue;
 			}
 
+			ret = data_poll_add_stream(&set, new_stream);
+			if (ret) {
+				ERR("Failed to add data stream %d to poll set",
+						new_stream->wait_fd);
+				lttng_consumer_send_error(ctx, LTTCOMM_CONSUMERD_POLL_ERROR);
+				goto end;
+			}
+
 			/* Continue to update the local streams and handle prio ones */
 			continue;
 		}
 
 		/* Handle wakeup pipe. */
-		if (pollfd[nb_fd + 1].revents & (POLLIN | POLLPRI)) {
+		if (wakeup_pipe_ready) {
 			char dummy;
 			ssize_t pipe_readlen;
 
-			pipe_readlen = lttng_pipe_read(ctx->consumer_wakeup_pipe, &dummy,
+			pipe_readlen = lttng_pipe_read(thread->wakeup_pipe, &dummy,
 					sizeof(dummy));
 			if (pipe_readlen < 0) {
 				PERROR("Consumer data wakeup pipe");
 			}
 			/* We've been awakened to handle stream(s). */
-			ctx->has_wakeup = 0;
+			thread->has_wakeup = 0;
 		}
 
+		ret = data_poll_start_pass(&set, num_rdy);
+		if (ret) {
+			ERR("Failed to prepare the data thread's pass over its ready streams");
+			lttng_consumer_send_error(ctx, LTTCOMM_CONSUMERD_POLL_ERROR);
+			goto end;
+		}
+		pass_fd_count = lttng_dynamic_array_get_count(&set.pass_fds);
+
 		/* Take care of high priority channels first. */
-		for (i = 0; i < nb_fd; i++) {
+		for (i = 0; i < pass_fd_count; i++) {
+			const int fd = *(int *) lttng_dynamic_array_get_element(
+					&set.pass_fds, i);
+			struct data_poll_fd_state *state =
+					data_poll_get_fd_state(&set, fd);
+
 			health_code_update();
 
-			if (local_stream[i] == NULL) {
+			if (state->stream == NULL) {
 				continue;
 			}
-			if (pollfd[i].revents & POLLPRI) {
-				DBG("Urgent read on fd %d", pollfd[i].fd);
+			if (state->revents & LPOLLPRI) {
+				DBG("Urgent read on fd %d", fd);
 				high_prio = 1;
-				len = ctx->on_buffer_ready(local_stream[i], ctx, false);
+				len = data_poll_drain_stream(&set, state);
 				/* it's ok to have an unavailable sub-buffer */
 				if (len < 0 && len != -EAGAIN && len != -ENODATA) {
 					/* Clean the stream and free it. */
-					consumer_del_stream(local_stream[i], data_ht);
-					local_stream[i] = NULL;
+					data_poll_del_stream(&set, state->stream);
 				} else if (len > 0) {
-					local_stream[i]->data_read = 1;
+					state->stream->data_read = 1;
 				}
 			}
 		}
@@ -2687,93 +3206,102 @@ void *consumer_thread_data_poll(void *data)
 		}
 
 		/* Take care of low priority channels. */
-		for (i = 0; i < nb_fd; i++) {
+		for (i = 0; i < pass_fd_count; i++) {
+			const int fd = *(int *) lttng_dynamic_array_get_element(
+					&set.pass_fds, i);
+			struct data_poll_fd_state *state =
+					data_poll_get_fd_state(&set, fd);
+
 			health_code_update();
 
-			if (local_stream[i] == NULL) {
+			if (state->stream == NULL) {
 				continue;
 			}
-			if ((pollfd[i].revents & POLLIN) ||
-					local_stream[i]->hangup_flush_done ||
-					local_stream[i]->has_data) {
-				DBG("Normal read on fd %d", pollfd[i].fd);
-				len = ctx->on_buffer_ready(local_stream[i], ctx, false);
+			if ((state->revents & LPOLLIN) ||
+					state->stream->hangup_flush_done ||
+					state->stream->has_data ||
+					state->pinned) {
+				DBG("Normal read on fd %d", fd);
+				len = data_poll_drain_stream(&set, state);
 				/* it's ok to have an unavailable sub-buffer */
 				if (len < 0 && len != -EAGAIN && len != -ENODATA) {
 					/* Clean the stream and free it. */
-					consumer_del_stream(local_stream[i], data_ht);
-					local_stream[i] = NULL;
+					data_poll_del_stream(&set, state->stream);
 				} else if (len > 0) {
-					local_stream[i]->data_read = 1;
+					state->stream->data_read = 1;
 				}
 			}
 		}
 
 		/* Handle hangup and errors */
-		for (i = 0; i < nb_fd; i++) {
+		for (i = 0; i < pass_fd_count; i++) {
+			const int fd = *(int *) lttng_dynamic_array_get_element(
+					&set.pass_fds, i);
+			struct data_poll_fd_state *state =
+					data_poll_get_fd_state(&set, fd);
+
 			health_code_update();
 
-			if (local_stream[i] == NULL) {
+			if (state->stream == NULL) {
 				continue;
 			}
-			if (!local_stream[i]->hangup_flush_done
-					&& (pollfd[i].revents & (POLLHUP | POLLERR | POLLNVAL))
+			if (!state->stream->hangup_flush_done
+					&& (state->revents & (LPOLLHUP | LPOLLERR))
 					&& (consumer_data.type == LTTNG_CONSUMER32_UST
 						|| consumer_data.type == LTTNG_CONSUMER64_UST)) {
 				DBG("fd %d is hup|err|nval. Attempting flush and read.",
-						pollfd[i].fd);
-				lttng_ustconsumer_on_stream_hangup(local_stream[i]);
+						fd);
+				lttng_ustconsumer_on_stream_hangup(state->stream);
 				/* Attempt read again, for the data we just flushed. */
-				local_stream[i]->data_read = 1;
+				state->stream->data_read = 1;
 			}
 			/*
 			 * If the poll flag is HUP/ERR/NVAL and we have
 			 * read no data in this pass, we can remove the
 			 * stream from its hash table.
 			 */
-			if ((pollfd[i].revents & POLLHUP)) {
-				DBG("Polling fd %d tells it has hung up.", pollfd[i].fd);
-				if (!local_stream[i]->data_read) {
-					consumer_del_stream(local_stream[i], data_ht);
-					local_stream[i] = NULL;
-					num_hup++;
-				}
-			} else if (pollfd[i].revents & POLLERR) {
-				ERR("Error returned in polling fd %d.", pollfd[i].fd);
-				if (!local_stream[i]->data_read) {
-					consumer_del_stream(local_stream[i], data_ht);
-					local_stream[i] = NULL;
-					num_hup++;
+			if ((state->revents & LPOLLHUP)) {
+				DBG("Polling fd %d tells it has hung up.", fd);
+				if (!state->stream->data_read && !state->pinned) {
+					data_poll_del_stream(&set, state->stream);
 				}
-			} else if (pollfd[i].revents & POLLNVAL) {
-				ERR("Polling fd %d tells fd is not open.", pollfd[i].fd);
-				if (!local_stream[i]->data_read) {
-					consumer_del_stream(local_stream[i], data_ht);
-					local_stream[i] = NULL;
-					num_hup++;
+			} else if (state->revents & LPOLLERR) {
+				ERR("Error returned in polling fd %d.", fd);
+				if (!state->stream->data_read && !state->pinned) {
+					data_poll_del_stream(&set, state->stream);
 				}
 			}
-			if (local_stream[i] != NULL) {
-				local_stream[i]->data_read = 0;
+			if (state->stream != NULL) {
+				state->stream->data_read = 0;
 			}
 		}
 	}
 	/* All is OK */
 	err = 0;
 end:
-	DBG("polling thread exiting");
-	free(pollfd);
-	free(local_stream);
+	DBG("Data thread %u exiting: %lu streams, %" PRIu64 " bytes consumed",
+			thread->id, uatomic_read(&thread->stream_count),
+			thread->consumed_bytes);
+	lttng_poll_clean(&set.events);
+end_poll:
+	lttng_dynamic_array_reset(&set.fd_states);
+	lttng_dynamic_array_reset(&set.pass_fds);
+	lttng_dynamic_buffer_reset(&thread->write_batch);
+	lttng_dynamic_buffer_reset(&thread->compression.buffer);
+	lttng_compression_context_destroy(thread->compression.context);
+	thread->compression.context = NULL;
 
 	/*
-	 * Close the write side of the pipe so epoll_wait() in
-	 * consumer_thread_metadata_poll can catch it. The thread is monitoring the
-	 * read side of the pipe. If we close them both, epoll_wait strangely does
-	 * not return and could create a endless wait period if the pipe is the
-	 * only tracked fd in the poll set. The thread will take care of closing
-	 * the read side.
+	 * Once the last data thread exits, close the write side of the pipe so
+	 * epoll_wait() in consumer_thread_metadata_poll can catch it. The thread
+	 * is monitoring the read side of the pipe. If we close them both,
+	 * epoll_wait strangely does not return and could create a endless wait
+	 * period if the pipe is the only tracked fd in the poll set. The thread
+	 * will take care of closing the read side.
 	 */
-	(void) lttng_pipe_write_close(ctx->consumer_metadata_pipe);
+	if (uatomic_sub_return(&ctx->data_threads_running, 1) == 0) {
+		(void) lttng_pipe_write_close(ctx->consumer_metadata_pipe);
+	}
 
 error_testpoint:
 	if (err) {
@@ -3276,10 +3804,10 @@ end:
 	CMM_STORE_SHARED(consumer_quit, 1);
 
 	/*
-	 * Notify the data poll thread to poll back again and test the
+	 * Notify the data poll threads to poll back again and test the
 	 * consumer_quit state that we just set so to quit gracefully.
 	 */
-	notify_thread_lttng_pipe(ctx->consumer_data_pipe);
+	notify_data_threads(ctx);
 
 	notify_channel_pipe(ctx, NULL, -1, CONSUMER_CHANNEL_QUIT);
 
@@ -3333,12 +3861,100 @@ end:
 	return ret;
 }
 
+/*
+ * Put a consumed sub-buffer and check whether the stream is ready to be
+ * rotated now that its consumed position moved.
+ *
+ * Returns 0 on success, a negative value on error.
+ */
+static int complete_subbuffer_consumption(struct lttng_consumer_stream *stream,
+		struct stream_subbuffer *subbuffer,
+		struct lttng_consumer_local_data *ctx)
+{
+	int ret;
+
+	ret = stream->read_subbuffer_ops.put_next_subbuffer(stream, subbuffer);
+	if (ret) {
+		goto end;
+	}
+
+	ret = post_consume(stream, subbuffer, ctx);
+	if (ret) {
+		goto end;
+	}
+
+	/*
+	 * After extracting the packet, we check if the stream is now ready to
+	 * be rotated and perform the action immediately.
+	 */
+	ret = lttng_consumer_stream_is_rotate_ready(stream);
+	if (ret == 1) {
+		ret = lttng_consumer_rotate_stream(ctx, stream);
+		if (ret < 0) {
+			ERR("Stream rotation error after consuming data");
+			goto end;
+		}
+	} else if (ret < 0) {
+		ERR("Failed to check if stream was ready to rotate after consuming data");
+		goto end;
+	}
+	ret = 0;
+end:
+	return ret;
+}
+
+/*
+ * Complete the consumption of the sub-buffer held by a stream until the
+ * completion of its zero-copy send, if the kernel reported it. The
+ * completions are reaped without blocking.
+ *
+ * Returns 0 on success, -EAGAIN if the send is not completed yet, a negative
+ * value on error.
+ */
+static int complete_zerocopy_subbuffer(struct lttng_consumer_stream *stream,
+		struct lttng_consumer_local_data *ctx)
+{
+	int ret = 0;
+	struct consumer_relayd_sock_pair *relayd;
+
+	rcu_read_lock();
+	relayd = consumer_find_relayd(stream->net_seq_idx);
+	/* A closed socket no longer references the payload. */
+	if (relayd) {
+		bool completed;
+
+		pthread_mutex_lock(&relayd->data_sock_mutex);
+		ret = relayd_reap_zerocopy_completions(&relayd->data_sock,
+				&relayd->data_sock_zerocopy);
+		completed = relayd_zerocopy_completed(
+				&relayd->data_sock_zerocopy,
+				stream->zerocopy_id);
+		pthread_mutex_unlock(&relayd->data_sock_mutex);
+		if (ret) {
+			/* The relayd hang up is handled by the next send. */
+			ERR("Failed to reap the zero-copy completions of stream %" PRIu64,
+					stream->key);
+		} else if (!completed) {
+			ret = -EAGAIN;
+			goto end;
+		}
+	}
+
+	stream->zerocopy_pending = false;
+	if (complete_subbuffer_consumption(stream, &stream->zerocopy_subbuffer,
+			ctx)) {
+		ret = -1;
+	}
+end:
+	rcu_read_unlock();
+	return ret;
+}
+
 ssize_t lttng_consumer_read_subbuffer(struct lttng_consumer_stream *stream,
 		struct lttng_consumer_local_data *ctx,
 		bool locked_by_caller)
 {
 	ssize_t ret, written_bytes = 0;
-	int rotation_ret;
 	struct stream_subbuffer subbuffer = {};
 
 	if (!locked_by_caller) {
@@ -3352,6 +3968,13 @@ ssize_t lttng_consumer_read_subbuffer(struct lttng_consumer_stream *stream,
 		}
 	}
 
+	if (stream->zerocopy_pending) {
+		ret = complete_zerocopy_subbuffer(stream, ctx);
+		if (ret) {
+			goto end;
+		}
+	}
+
 	/*
 	 * If the stream was flagged to be ready for rotation before we extract
 	 * the next packet, rotate it now.
@@ -3389,38 +4012,22 @@ ssize_t lttng_consumer_read_subbuffer(struct lttng_consumer_stream *stream,
 		goto error_put_subbuf;
 	}
 
-	ret = stream->read_subbuffer_ops.put_next_subbuffer(stream, &subbuffer);
-	if (ret) {
+	if (stream->zerocopy_pending) {
+		/*
+		 * The kernel references the sub-buffer until the completion of
+		 * its send. Checking for more data would need the next
+		 * sub-buffer.
+		 */
+		stream->zerocopy_subbuffer = subbuffer;
+		ret = written_bytes;
 		goto end;
 	}
 
-	ret = post_consume(stream, &subbuffer, ctx);
+	ret = complete_subbuffer_consumption(stream, &subbuffer, ctx);
 	if (ret) {
 		goto end;
 	}
 
-	/*
-	 * After extracting the packet, we check if the stream is now ready to
-	 * be rotated and perform the action immediately.
-	 *
-	 * Don't overwrite `ret` as callers expect the number of bytes
-	 * consumed to be returned on success.
-	 */
-	rotation_ret = lttng_consumer_stream_is_rotate_ready(stream);
-	if (rotation_ret == 1) {
-		rotation_ret = lttng_consumer_rotate_stream(ctx, stream);
-		if (rotation_ret < 0) {
-			ret = rotation_ret;
-			ERR("Stream rotation error after consuming data");
-			goto end;
-		}
-
-	} else if (rotation_ret < 0) {
-		ret = rotation_ret;
-		ERR("Failed to check if stream was ready to rotate after consuming data");
-		goto end;
-	}
-
 sleep_stream:
 	if (stream->read_subbuffer_ops.on_sleep) {
 		stream->read_subbuffer_ops.on_sleep(stream, ctx);
@@ -3505,6 +4112,50 @@ error:
 	return -1;
 }
 
+/*
+ * Get the compression of the data packets sent to a relayd: the one requested
+ * for the consumer, if the relayd supports it.
+ */
+static enum lttng_compression_algorithm negotiate_relayd_compression(
+		struct lttcomm_relayd_sock *control_sock,
+		enum lttng_compression_algorithm requested)
+{
+	int ret;
+	uint64_t result_flags, required_flag;
+	enum lttng_compression_algorithm compression =
+			LTTNG_COMPRESSION_ALGORITHM_NONE;
+
+	switch (requested) {
+	case LTTNG_COMPRESSION_ALGORITHM_NONE:
+		goto end;
+	case LTTNG_COMPRESSION_ALGORITHM_LZ4:
+		required_flag = LTTCOMM_RELAYD_CONFIGURATION_FLAG_COMPRESSION_LZ4;
+		break;
+	case LTTNG_COMPRESSION_ALGORITHM_ZSTD:
+		required_flag = LTTCOMM_RELAYD_CONFIGURATION_FLAG_COMPRESSION_ZSTD;
+		break;
+	default:
+		abort();
+	}
+
+	ret = relayd_get_configuration(control_sock, 0, &result_flags);
+	if (ret) {
+		WARN("Failed to get the relay daemon's configuration, sending the data uncompressed");
+		goto end;
+	}
+	if (!(result_flags & required_flag)) {
+		WARN("The relay daemon does not support %s compression, sending the data uncompressed",
+				lttng_compression_algorithm_str(requested));
+		goto end;
+	}
+
+	compression = requested;
+	DBG("Data sent to the relay daemon with %s compression",
+			lttng_compression_algorithm_str(compression));
+end:
+	return compression;
+}
+
 /*
  * Process the ADD_RELAYD command receive by a consumer.
  *
@@ -3614,6 +4265,8 @@ error:
 		relayd->control_sock.minor = relayd_sock->minor;
 
 		relayd->relayd_session_id = relayd_session_id;
+		relayd->compression = negotiate_relayd_compression(
+				&relayd->control_sock, ctx->relayd_compression);
 
 		break;
 	case LTTNG_STREAM_DATA:
@@ -3639,6 +4292,11 @@ error:
 		/* Assign version values. */
 		relayd->data_sock.major = relayd_sock->major;
 		relayd->data_sock.minor = relayd_sock->minor;
+		/* The data is sent with copies if zero-copy is unavailable. */
+		if (ctx->relayd_zerocopy) {
+			(void) relayd_enable_zerocopy(&relayd->data_sock,
+					&relayd->data_sock_zerocopy);
+		}
 		break;
 	default:
 		ERR("Unknown relayd socket type (%d)", sock_type);
@@ -4507,6 +5165,7 @@ int rotate_local_stream(struct lttng_consumer_local_data *ctx,
 	stream->tracefile_count_current = 0;
 
 	if (stream->out_fd >= 0) {
+		consumer_stream_release_output_file_preallocation(stream);
 		ret = close(stream->out_fd);
 		if (ret) {
 			PERROR("Failed to close stream out_fd of channel \"%s\"",
@@ -4542,6 +5201,12 @@ int lttng_consumer_rotate_stream(struct lttng_consumer_local_data *ctx,
 
 	DBG("Consumer rotate stream %" PRIu64, stream->key);
 
+	/* The accumulated data belongs to the current chunk's files. */
+	ret = lttng_consumer_flush_write_batch(stream);
+	if (ret) {
+		goto error;
+	}
+
 	/*
 	 * Update the stream's 'current' chunk to the session's (channel)
 	 * now-current chunk.
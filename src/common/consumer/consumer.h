@@ -13,6 +13,7 @@
 
 #include <limits.h>
 #include <poll.h>
+#include <sched.h>
 #include <unistd.h>
 #include <urcu/list.h>
 
@@ -28,6 +29,9 @@
 #include <common/credentials.h>
 #include <common/buffer-view.h>
 #include <common/dynamic-array.h>
+#include <common/dynamic-buffer.h>
+#include <common/compression.h>
+#include <common/relayd/relayd.h>
 
 struct lttng_consumer_local_data;
 
@@ -539,12 +543,18 @@ struct lttng_consumer_stream {
 	enum consumer_endpoint_status endpoint_status;
 	/* Stream name. Format is: <channel_name>_<cpu_number> */
 	char name[LTTNG_SYMBOL_NAME_LEN];
+	/* CPU of the stream's buffer. */
+	int cpu;
 	/* Internal state of libustctl. */
 	struct ustctl_consumer_stream *ustream;
 	struct cds_list_head send_node;
 	/* On-disk circular buffer */
 	uint64_t tracefile_size_current;
 	uint64_t tracefile_count_current;
+	/* Storage allocated ahead of the writes to `out_fd`, in bytes. */
+	uint64_t out_fd_allocated_size;
+	/* The storage of `out_fd` can't be allocated ahead of its writes. */
+	bool out_fd_preallocation_failed;
 	/*
 	 * Monitor or not the streams of this channel meaning this indicates if the
 	 * streams should be sent to the data/metadata thread or added to the no
@@ -619,6 +629,49 @@ struct lttng_consumer_stream {
 
 	/* Indicate if the stream still has some data to be read. */
 	unsigned int has_data:1;
+	/*
+	 * Data thread consuming the stream, set before the stream is sent to
+	 * it. NULL for metadata streams.
+	 */
+	struct lttng_consumer_data_thread *data_thread;
+	/*
+	 * Number of sub-buffers the data thread consumes when the stream is
+	 * ready. Adjusted after every drain, see data_thread_drain_stream().
+	 */
+	unsigned int drain_budget;
+	/*
+	 * Set while a data thread drains the stream: the sub-buffers written
+	 * to the stream's local trace file through mmap are accumulated in
+	 * this buffer. `out_fd_offset` accounts for the accumulated data.
+	 *
+	 * Protected by the stream lock.
+	 */
+	struct lttng_dynamic_buffer *write_batch;
+	/*
+	 * Set while a data thread drains the stream: the packets sent to the
+	 * relayd are compressed with the thread's compression state.
+	 *
+	 * Protected by the stream lock.
+	 */
+	struct lttng_consumer_compression *compression;
+	/*
+	 * Set while a data thread drains the stream: the packets sent to the
+	 * relayd may be sent with zero-copy, their sub-buffer being held until
+	 * the completion of the send.
+	 *
+	 * Protected by the stream lock.
+	 */
+	bool zerocopy;
+	/*
+	 * Sub-buffer held until the kernel no longer references it, once the
+	 * completion of its zero-copy send `zerocopy_id` is received. Its
+	 * consumption is completed by the next read of the stream after that.
+	 *
+	 * Protected by the stream lock.
+	 */
+	bool zerocopy_pending;
+	uint32_t zerocopy_id;
+	struct stream_subbuffer zerocopy_subbuffer;
 	/*
 	 * Inform the consumer or relay to reset the metadata
 	 * file before writing in it (regeneration).
@@ -676,11 +729,22 @@ struct consumer_relayd_sock_pair {
 	struct lttcomm_relayd_sock control_sock;
 
 	/*
-	 * We don't need a mutex at this point since we only splice or write single
-	 * large chunk of data with a header appended at the begining. Moreover,
-	 * this socket is for now only used in a single thread.
+	 * Serialize the packets sent by the data threads over the data socket,
+	 * from the data header to the end of the payload.
+	 *
+	 * This is nested INSIDE the stream lock.
 	 */
+	pthread_mutex_t data_sock_mutex;
+
+	/* Data socket. Only data packets are sent over it. */
 	struct lttcomm_relayd_sock data_sock;
+	/* Protected by data_sock_mutex. */
+	struct relayd_zerocopy data_sock_zerocopy;
+	/*
+	 * Compression of the data packets, negotiated with the relayd when
+	 * the control socket is received.
+	 */
+	enum lttng_compression_algorithm compression;
 	struct lttng_ht_node_u64 node;
 
 	/* Session id on both sides for the sockets. */
@@ -753,8 +817,51 @@ struct lttng_consumer_local_data {
 	char *consumer_command_sock_path;
 	/* communication with splice */
 	int consumer_channel_pipe[2];
+	/* Data stream poll threads, the data streams are spread over them. */
+	struct lttng_consumer_data_thread *data_threads;
+	unsigned int data_thread_count;
+	/* Number of data threads that have not exited yet. */
+	unsigned int data_threads_running;
+	/*
+	 * Index of the data thread consuming the streams of each CPU, NULL
+	 * when the streams are spread by CPU number.
+	 */
+	unsigned int *cpu_data_threads;
+	unsigned int cpu_count;
+	/* Send the data packets to the relay daemons with MSG_ZEROCOPY. */
+	bool relayd_zerocopy;
+	/* Compression of the data packets sent to the relay daemons. */
+	enum lttng_compression_algorithm relayd_compression;
+
+	/* to let the signal handler wake up the fd receiver thread */
+	int consumer_should_quit[2];
+	/* Metadata poll thread pipe. Transfer metadata stream to it */
+	struct lttng_pipe *consumer_metadata_pipe;
+	/*
+	 * Pipe used by the channel monitoring timers to provide state samples
+	 * to the session daemon (write-only).
+	 */
+	int channel_monitor_pipe;
+	LTTNG_OPTIONAL(lttng_uuid) sessiond_uuid;
+};
+
+/* State with which a data thread compresses the packets sent to a relayd. */
+struct lttng_consumer_compression {
+	struct lttng_compression_context *context;
+	/* Compressed payload of the packet being sent. */
+	struct lttng_dynamic_buffer buffer;
+};
+
+/*
+ * Data stream poll thread. Each data stream is consumed by a single data
+ * thread, selected when the stream is sent to the data threads.
+ */
+struct lttng_consumer_data_thread {
+	/* Index of the thread in the context's data thread array. */
+	unsigned int id;
+	struct lttng_consumer_local_data *ctx;
 	/* Data stream poll thread pipe. To transfer data stream to the thread */
-	struct lttng_pipe *consumer_data_pipe;
+	struct lttng_pipe *data_pipe;
 
 	/*
 	 * Data thread use that pipe to catch wakeup from read subbuffer that
@@ -764,20 +871,27 @@ struct lttng_consumer_local_data {
 	 *
 	 * Both pipes (read/write) are owned and used inside the data thread.
 	 */
-	struct lttng_pipe *consumer_wakeup_pipe;
+	struct lttng_pipe *wakeup_pipe;
 	/* Indicate if the wakeup thread has been notified. */
 	unsigned int has_wakeup:1;
 
-	/* to let the signal handler wake up the fd receiver thread */
-	int consumer_should_quit[2];
-	/* Metadata poll thread pipe. Transfer metadata stream to it */
-	struct lttng_pipe *consumer_metadata_pipe;
 	/*
-	 * Pipe used by the channel monitoring timers to provide state samples
-	 * to the session daemon (write-only).
+	 * Number of data streams assigned to the thread, including those that
+	 * have not been received from its data pipe yet. Accessed atomically.
 	 */
-	int channel_monitor_pipe;
-	LTTNG_OPTIONAL(lttng_uuid) sessiond_uuid;
+	unsigned long stream_count;
+	/*
+	 * Number of bytes consumed by the thread. Only used by the thread and
+	 * only logged, at the debug level, when the thread exits.
+	 */
+	uint64_t consumed_bytes;
+	/* CPUs to which the thread is pinned, NULL if it is not pinned. */
+	cpu_set_t *cpuset;
+	size_t cpuset_size;
+	/* Sub-buffers drained from a stream, not yet written to its file. */
+	struct lttng_dynamic_buffer write_batch;
+	/* Context is NULL when the packets are sent uncompressed. */
+	struct lttng_consumer_compression compression;
 };
 
 /*
@@ -804,11 +918,6 @@ struct lttng_consumer_global_data {
 	struct lttng_ht *channel_ht;
 	/* Channel hash table indexed by session id. */
 	struct lttng_ht *channels_by_session_id_ht;
-	/*
-	 * Flag specifying if the local array of FDs needs update in the
-	 * poll function. Protected by consumer_data.lock.
-	 */
-	unsigned int need_update;
 	enum lttng_consumer_type type;
 
 	/*
@@ -835,6 +944,13 @@ struct lttng_consumer_global_data {
 	 * Trace chunk registry indexed by (session_id, chunk_id).
 	 */
 	struct lttng_trace_chunk_registry *chunk_registry;
+
+	/*
+	 * Steps in which the storage of the local trace files is allocated
+	 * ahead of their writes, in bytes (0: disabled). Set before any
+	 * stream is created.
+	 */
+	uint64_t trace_file_preallocation_size;
 };
 
 /*
@@ -971,12 +1087,14 @@ struct lttng_consumer_local_data *lttng_consumer_create(
 			bool locked_by_caller),
 		int (*recv_channel)(struct lttng_consumer_channel *channel),
 		int (*recv_stream)(struct lttng_consumer_stream *stream),
-		int (*update_stream)(uint64_t sessiond_key, uint32_t state));
+		int (*update_stream)(uint64_t sessiond_key, uint32_t state),
+		unsigned int data_thread_count);
 void lttng_consumer_destroy(struct lttng_consumer_local_data *ctx);
 ssize_t lttng_consumer_on_read_subbuffer_mmap(
 		struct lttng_consumer_stream *stream,
 		const struct lttng_buffer_view *buffer,
 		unsigned long padding);
+int lttng_consumer_flush_write_batch(struct lttng_consumer_stream *stream);
 ssize_t lttng_consumer_on_read_subbuffer_splice(
 		struct lttng_consumer_local_data *ctx,
 		struct lttng_consumer_stream *stream, unsigned long len,
@@ -1017,6 +1135,9 @@ unsigned long consumer_get_consume_start_pos(unsigned long consumed_pos,
 		unsigned long produced_pos, uint64_t nb_packets_per_stream,
 		uint64_t max_sb_size);
 void consumer_add_data_stream(struct lttng_consumer_stream *stream);
+struct lttng_consumer_data_thread *consumer_select_data_thread(
+		struct lttng_consumer_local_data *ctx,
+		const struct lttng_consumer_stream *stream);
 void consumer_del_stream_for_data(struct lttng_consumer_stream *stream);
 void consumer_add_metadata_stream(struct lttng_consumer_stream *stream);
 void consumer_del_stream_for_metadata(struct lttng_consumer_stream *stream);
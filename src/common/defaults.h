@@ -79,6 +79,40 @@
 #define DEFAULT_USTCONSUMERD32_CMD_SOCK_PATH    DEFAULT_USTCONSUMERD32_PATH "/command"
 #define DEFAULT_USTCONSUMERD32_ERR_SOCK_PATH    DEFAULT_USTCONSUMERD32_PATH "/error"
 
+/* Number of threads consuming the data streams of a consumer daemon. */
+#define DEFAULT_CONSUMERD_DATA_THREADS          1
+#define DEFAULT_CONSUMERD_MAX_DATA_THREADS      256
+#define DEFAULT_CONSUMERD_DATA_THREADS_ENV      "LTTNG_CONSUMERD_DATA_THREADS"
+#define DEFAULT_CONSUMERD_DATA_THREAD_AFFINITY_ENV "LTTNG_CONSUMERD_DATA_THREAD_AFFINITY"
+
+/*
+ * Maximal number of sub-buffers a data thread consumes from a stream before
+ * servicing the other ready streams.
+ */
+#define DEFAULT_CONSUMERD_DRAIN_MAX_SUBBUFFERS  64
+
+/*
+ * Size of the buffer in which a data thread accumulates the sub-buffers it
+ * drains from a stream before writing them to the stream's trace file.
+ * Sub-buffers larger than half of this size are written directly.
+ */
+#define DEFAULT_CONSUMERD_WRITE_BATCH_SIZE      (256 * 1024)
+
+/*
+ * Minimal payload size of the data packets sent to a relay daemon with
+ * MSG_ZEROCOPY. Pinning the pages of smaller packets costs more than copying
+ * them.
+ */
+#define DEFAULT_CONSUMERD_RELAYD_ZEROCOPY_MIN_SIZE (64 * 1024)
+/*
+ * Poll timeout, in ms, of a data thread while streams hold sub-buffers until
+ * the completion of their zero-copy send to a relay daemon.
+ */
+#define DEFAULT_CONSUMERD_RELAYD_ZEROCOPY_POLL_TIMEOUT 1
+#define DEFAULT_CONSUMERD_RELAYD_ZEROCOPY_ENV   "LTTNG_CONSUMERD_RELAYD_ZEROCOPY"
+#define DEFAULT_CONSUMERD_RELAYD_COMPRESSION_ENV "LTTNG_CONSUMERD_RELAYD_COMPRESSION"
+#define DEFAULT_CONSUMERD_TRACE_FILE_PREALLOCATION_ENV "LTTNG_CONSUMERD_TRACE_FILE_PREALLOCATION"
+
 /* Relayd path */
 #define DEFAULT_RELAYD_RUNDIR			"%s"
 #define DEFAULT_RELAYD_PATH			DEFAULT_RELAYD_RUNDIR "/relayd"
@@ -98,6 +132,40 @@
  */
 #define DEFAULT_RELAYD_FD_POOL_SIZE_RESERVE	10
 
+/* Number of threads servicing the relay daemon's control and data connections. */
+#define DEFAULT_RELAYD_WORKER_THREADS		1
+#define DEFAULT_RELAYD_MAX_WORKER_THREADS	256
+
+/* Number of threads servicing the relay daemon's live viewer connections. */
+#define DEFAULT_RELAYD_LIVE_WORKER_THREADS	1
+
+/* Memory used to cache the packets recently received for the live viewers. */
+#define DEFAULT_RELAYD_LIVE_PACKET_CACHE_SIZE	(64 * 1024 * 1024)
+
+/* Size of the pipes used to splice the data connections' payloads. */
+#define DEFAULT_RELAYD_SPLICE_PIPE_SIZE		(1024 * 1024)
+
+/* Size of the data connections' reception buffers in batch mode. */
+#define DEFAULT_RELAYD_BATCH_RECEIVE_BUFFER_SIZE	(1024 * 1024)
+
+/*
+ * Number of threads writing the trace files asynchronously (0: the trace
+ * files are written by the worker threads) and maximal size of the data
+ * they may have pending.
+ */
+#define DEFAULT_RELAYD_ASYNC_OUTPUT_THREADS	0
+#define DEFAULT_RELAYD_MAX_ASYNC_OUTPUT_THREADS	64
+#define DEFAULT_RELAYD_ASYNC_OUTPUT_MAX_PENDING_SIZE	(64 * 1024 * 1024)
+
+/* Size of the buffer coalescing the writes of each stream (0: disabled). */
+#define DEFAULT_RELAYD_STREAM_WRITE_BUFFER_SIZE	0
+
+/*
+ * Steps in which the storage of the trace files is allocated ahead of their
+ * writes (0: disabled).
+ */
+#define DEFAULT_RELAYD_TRACE_FILE_PREALLOCATION_SIZE	0
+
 /* Default lttng run directory */
 #define DEFAULT_LTTNG_HOME_ENV_VAR              "LTTNG_HOME"
 #define DEFAULT_LTTNG_FALLBACK_HOME_ENV_VAR	"HOME"
@@ -209,7 +277,7 @@
 /* Metadata channel defaults. */
 #define DEFAULT_METADATA_SUBBUF_SIZE    CONFIG_DEFAULT_METADATA_SUBBUF_SIZE
 #define DEFAULT_METADATA_SUBBUF_NUM     CONFIG_DEFAULT_METADATA_SUBBUF_NUM
-#define DEFAULT_METADATA_CACHE_SIZE     CONFIG_DEFAULT_METADATA_CACHE_SIZE
+#define DEFAULT_METADATA_CACHE_CHUNK_SIZE CONFIG_DEFAULT_METADATA_CACHE_CHUNK_SIZE
 #define DEFAULT_METADATA_SWITCH_TIMER	0
 #define DEFAULT_METADATA_READ_TIMER	0
 #define DEFAULT_METADATA_OVERWRITE 	0
@@ -309,6 +377,13 @@
 
 #define DEFAULT_NETWORK_RELAYD_CTRL_MAX_PAYLOAD_SIZE CONFIG_DEFAULT_NETWORK_RELAYD_CTRL_MAX_PAYLOAD_SIZE
 
+/*
+ * Maximum uncompressed size of a compressed data packet. The relay daemon
+ * allocates the reception and decompression buffers of a packet from the
+ * sizes announced by its header.
+ */
+#define DEFAULT_NETWORK_RELAYD_COMPRESSED_PACKET_MAX_SIZE	(64 * 1024 * 1024)
+
 /*
  * Default receiving and sending timeout for an application socket.
  */
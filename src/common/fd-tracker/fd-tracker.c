@@ -8,6 +8,7 @@
 #include <urcu.h>
 #include <urcu/list.h>
 #include <urcu/rculfhash.h>
+#include <urcu/uatomic.h>
 
 #include <fcntl.h>
 #include <inttypes.h>
@@ -16,6 +17,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <common/compat/time.h>
 #include <common/defaults.h>
 #include <common/error.h>
 #include <common/fs-handle-internal.h>
@@ -23,10 +25,35 @@
 #include <common/hashtable/utils.h>
 #include <common/macros.h>
 #include <common/optional.h>
+#include <common/time.h>
 
 #include "fd-tracker.h"
 #include "inode.h"
 
+/*
+ * Number of handles suspended at once when the capacity is reached, which
+ * leaves room for the next few handles restored or opened.
+ */
+#define SUSPEND_BATCH_SIZE 8
+
+/*
+ * A restore is "early" when the handle was suspended about as many restores
+ * ago as there are suspendable handles in excess of the capacity. This is
+ * the restore distance of every handle when N handles are accessed in turn
+ * (e.g. round-robin writes to many streams) with at most `capacity` of them
+ * active, whereas random or skewed accesses yield widely spread distances.
+ * The distance may be off by up to a suspension batch and CYCLIC_TOLERANCE()
+ * bounds the deviation accepted for a given expected distance.
+ *
+ * The tracker switches to a most-recently-restored eviction policy when
+ * CYCLIC_ENTER_THRESHOLD of the last 64 restores were early, and back to
+ * LRU when CYCLIC_EXIT_THRESHOLD or fewer were.
+ */
+#define CYCLIC_ENTER_THRESHOLD 48
+#define CYCLIC_EXIT_THRESHOLD 16
+#define CYCLIC_TOLERANCE(distance) \
+	max_t(uint64_t, SUSPEND_BATCH_SIZE / 2, (distance) / 8)
+
 /* Tracker lock must be taken by the user. */
 #define TRACKED_COUNT(tracker)                                 \
 	(tracker->count.suspendable.active +                   \
@@ -58,18 +85,36 @@ struct fd_tracker {
 		unsigned int unsuspendable;
 	} count;
 	unsigned int capacity;
+	/* Updated atomically: the fast path does not take the tracker's lock. */
 	struct {
-		uint64_t uses;
-		uint64_t misses;
+		unsigned long uses;
+		unsigned long misses;
 		/* Failures to suspend or restore fs handles. */
-		uint64_t errors;
+		unsigned long errors;
 	} stats;
+	/* Protected by the tracker's lock. */
+	struct {
+		/* Incremented on every restore. */
+		uint64_t seq;
+		/* One bit per recent restore, set if that restore was early. */
+		uint64_t early_history;
+		/* Evict the most recently restored handles. */
+		bool cyclic;
+		uint64_t early_count;
+		uint64_t batch_suspensions;
+		uint64_t total_ns;
+		uint64_t max_ns;
+	} restore;
 	/*
-	 * The head of the active_handles list is always the least recently
-	 * used active handle. When an handle is used, it is removed from the
-	 * list and added to the end. When a file has to be suspended, the
-	 * first element in the list is "popped", suspended, and added to the
-	 * list of suspended handles.
+	 * The active handles are reclaimed following an approximate LRU
+	 * policy (CLOCK, or "second chance"). Using an active handle only sets
+	 * its `referenced` flag, which does not require the tracker's lock.
+	 *
+	 * When a file has to be suspended, the handles are examined from the
+	 * head of the active_handles list. A referenced handle has its flag
+	 * cleared and is moved to the end of the list; the first handle that
+	 * was not referenced since it was last examined is suspended and added
+	 * to the list of suspended handles.
 	 */
 	struct cds_list_head active_handles;
 	struct cds_list_head suspended_handles;
@@ -110,6 +155,16 @@ struct fs_handle_tracked {
 	bool in_use;
 	/* Offset to which the file should be restored. */
 	off_t offset;
+	/* Value of the tracker's restore sequence number at suspension. */
+	uint64_t suspend_seq;
+	/* Cost of the restores of this handle. */
+	struct {
+		uint64_t count;
+		uint64_t total_ns;
+		uint64_t max_ns;
+	} restore;
+	/* Used since it was last examined by the reclaim (atomic access). */
+	int referenced;
 	struct cds_list_head handles_list_node;
 };
 
@@ -153,6 +208,7 @@ static void fd_tracker_untrack(
 		struct fd_tracker *tracker, struct fs_handle_tracked *handle);
 static int fd_tracker_suspend_handles(
 		struct fd_tracker *tracker, unsigned int count);
+static int fd_tracker_make_room(struct fd_tracker *tracker);
 static int fd_tracker_restore_handle(
 		struct fd_tracker *tracker, struct fs_handle_tracked *handle);
 
@@ -218,6 +274,14 @@ static void fs_handle_tracked_log(struct fs_handle_tracked *handle)
 	} else {
 		DBG_NO_LOC("    %s [suspended]", path);
 	}
+	if (handle->restore.count) {
+		DBG_NO_LOC("      restores: %" PRIu64 ", %.1f us average, %.1f us max",
+				handle->restore.count,
+				(double) handle->restore.total_ns /
+						handle->restore.count /
+						NSEC_PER_USEC,
+				(double) handle->restore.max_ns / NSEC_PER_USEC);
+	}
 	pthread_mutex_unlock(&handle->lock);
 }
 
@@ -274,9 +338,10 @@ static int fs_handle_tracked_suspend(struct fs_handle_tracked *handle)
 	DBG("Suspended filesystem handle to %s (fd %i) at position %" PRId64,
 			path, handle->fd, handle->offset);
 	handle->fd = -1;
+	handle->suspend_seq = handle->tracker->restore.seq;
 end:
 	if (ret) {
-		handle->tracker->stats.errors++;
+		uatomic_inc(&handle->tracker->stats.errors);
 	}
 	pthread_mutex_unlock(&handle->lock);
 	return ret;
@@ -412,13 +477,27 @@ void fd_tracker_log(struct fd_tracker *tracker)
 	struct fs_handle_tracked *handle;
 	struct unsuspendable_fd *unsuspendable_fd;
 	struct cds_lfht_iter iter;
+	const unsigned long uses = uatomic_read(&tracker->stats.uses);
+	const unsigned long misses = uatomic_read(&tracker->stats.misses);
 
 	pthread_mutex_lock(&tracker->lock);
 	DBG_NO_LOC("File descriptor tracker");
 	DBG_NO_LOC("  Stats:");
-	DBG_NO_LOC("    uses:            %" PRIu64, tracker->stats.uses);
-	DBG_NO_LOC("    misses:          %" PRIu64, tracker->stats.misses);
-	DBG_NO_LOC("    errors:          %" PRIu64, tracker->stats.errors);
+	DBG_NO_LOC("    uses:            %lu", uses);
+	DBG_NO_LOC("    misses:          %lu (%.1f%%)", misses,
+			uses ? 100.0 * misses / uses : 0.0);
+	DBG_NO_LOC("    errors:          %lu", uatomic_read(&tracker->stats.errors));
+	DBG_NO_LOC("    early restores:  %" PRIu64, tracker->restore.early_count);
+	DBG_NO_LOC("    restore latency: %.1f us average, %.1f us max",
+			tracker->restore.seq ?
+				(double) tracker->restore.total_ns /
+					tracker->restore.seq / NSEC_PER_USEC :
+				0.0,
+			(double) tracker->restore.max_ns / NSEC_PER_USEC);
+	DBG_NO_LOC("    batch suspends:  %" PRIu64,
+			tracker->restore.batch_suspensions);
+	DBG_NO_LOC("    eviction policy: %s", tracker->restore.cyclic ?
+			"most recently restored (cyclic access)" : "LRU");
 	DBG_NO_LOC("  Tracked:           %u", TRACKED_COUNT(tracker));
 	DBG_NO_LOC("    active:          %u", ACTIVE_COUNT(tracker));
 	DBG_NO_LOC("      suspendable:   %u", SUSPENDABLE_COUNT(tracker));
@@ -510,7 +589,7 @@ struct fs_handle *fd_tracker_open_fs_handle(struct fd_tracker *tracker,
 	pthread_mutex_lock(&tracker->lock);
 	if (ACTIVE_COUNT(tracker) == tracker->capacity) {
 		if (tracker->count.suspendable.active > 0) {
-			ret = fd_tracker_suspend_handles(tracker, 1);
+			ret = fd_tracker_make_room(tracker);
 			if (ret) {
 				goto end;
 			}
@@ -587,26 +666,149 @@ static int fd_tracker_suspend_handles(
 		struct fd_tracker *tracker, unsigned int count)
 {
 	unsigned int left_to_close = count;
-	unsigned int attempts_left = tracker->count.suspendable.active;
-	struct fs_handle_tracked *handle, *tmp;
+	/* Every handle may be given a second chance once. */
+	unsigned int attempts_left = 2 * tracker->count.suspendable.active;
 
-	cds_list_for_each_entry_safe(handle, tmp, &tracker->active_handles,
-			handles_list_node) {
+	while (left_to_close > 0 && attempts_left > 0 &&
+			!cds_list_empty(&tracker->active_handles)) {
 		int ret;
+		struct fs_handle_tracked *handle = cds_list_first_entry(
+				&tracker->active_handles,
+				struct fs_handle_tracked, handles_list_node);
 
+		attempts_left--;
 		fd_tracker_untrack(tracker, handle);
+		if (uatomic_xchg(&handle->referenced, 0)) {
+			/* Used recently, move it to the end of the list. */
+			fd_tracker_track(tracker, handle);
+			continue;
+		}
+
 		ret = fs_handle_tracked_suspend(handle);
 		fd_tracker_track(tracker, handle);
 		if (!ret) {
 			left_to_close--;
 		}
+	}
+	return left_to_close ? -EMFILE : 0;
+}
+
+/*
+ * Suspend the most recently restored active handle that is not in use and
+ * was not used since it was restored or last examined.
+ *
+ * Caller must hold the tracker's lock.
+ */
+static int fd_tracker_suspend_most_recent_handle(struct fd_tracker *tracker)
+{
+	struct cds_list_head *node = tracker->active_handles.prev;
+	/* Every handle may be given a second chance once. */
+	unsigned int attempts_left = 2 * tracker->count.suspendable.active;
+
+	/* The restored handles are added at the end of the list. */
+	while (attempts_left > 0 &&
+			!cds_list_empty(&tracker->active_handles)) {
+		struct fs_handle_tracked *handle;
+		int ret;
+
+		if (node == &tracker->active_handles) {
+			node = node->prev;
+		}
+		handle = cds_list_entry(node, struct fs_handle_tracked,
+				handles_list_node);
+		node = node->prev;
 		attempts_left--;
+		if (uatomic_xchg(&handle->referenced, 0)) {
+			/* Used again since it was restored, keep it active. */
+			continue;
+		}
 
-		if (left_to_close == 0 || attempts_left == 0) {
-			break;
+		fd_tracker_untrack(tracker, handle);
+		ret = fs_handle_tracked_suspend(handle);
+		fd_tracker_track(tracker, handle);
+		if (!ret) {
+			return 0;
 		}
 	}
-	return left_to_close ? -EMFILE : 0;
+	return -EMFILE;
+}
+
+/*
+ * Suspend handles to make room for one file descriptor.
+ *
+ * Caller must hold the tracker's lock.
+ */
+static int fd_tracker_make_room(struct fd_tracker *tracker)
+{
+	int ret;
+	unsigned int batch_size;
+
+	if (tracker->restore.cyclic) {
+		/*
+		 * Keep a stable set of handles active and cycle the other
+		 * handles through the remaining capacity.
+		 */
+		ret = fd_tracker_suspend_most_recent_handle(tracker);
+		goto end;
+	}
+
+	batch_size = min_t(unsigned int, SUSPEND_BATCH_SIZE,
+			tracker->count.suspendable.active);
+	ret = fd_tracker_suspend_handles(tracker, batch_size);
+	if (ret && ACTIVE_COUNT(tracker) < tracker->capacity) {
+		/* Part of the batch was suspended, which is enough. */
+		ret = 0;
+	}
+	if (!ret && batch_size > 1) {
+		tracker->restore.batch_suspensions++;
+	}
+end:
+	return ret;
+}
+
+/*
+ * Record whether a restore is early and switch the eviction policy when
+ * the access pattern changes.
+ *
+ * Caller must hold the tracker's lock.
+ */
+static void fd_tracker_account_restore(struct fd_tracker *tracker,
+		const struct fs_handle_tracked *handle)
+{
+	/* The handle being restored is not tracked at this point. */
+	const uint64_t suspendable_count = SUSPENDABLE_COUNT(tracker) + 1;
+	const uint64_t unsuspendable_count = UNSUSPENDABLE_COUNT(tracker);
+	const uint64_t distance = tracker->restore.seq - handle->suspend_seq;
+	uint64_t cyclic_distance;
+	bool early = false;
+	unsigned int early_restores;
+
+	if (suspendable_count + unsuspendable_count > tracker->capacity) {
+		cyclic_distance = suspendable_count + unsuspendable_count -
+				tracker->capacity;
+		early = distance + CYCLIC_TOLERANCE(cyclic_distance) >=
+						cyclic_distance &&
+				distance <= cyclic_distance +
+						CYCLIC_TOLERANCE(cyclic_distance);
+	}
+
+	tracker->restore.seq++;
+	tracker->restore.early_history =
+			(tracker->restore.early_history << 1) | early;
+	if (early) {
+		tracker->restore.early_count++;
+	}
+
+	early_restores = __builtin_popcountll(tracker->restore.early_history);
+	if (!tracker->restore.cyclic &&
+			early_restores >= CYCLIC_ENTER_THRESHOLD) {
+		DBG("Cyclic file access pattern detected, evicting the most recently restored handles");
+		tracker->restore.cyclic = true;
+	} else if (tracker->restore.cyclic &&
+			early_restores <= CYCLIC_EXIT_THRESHOLD) {
+		DBG("Cyclic file access pattern ended, evicting the least recently used handles");
+		tracker->restore.cyclic = false;
+	}
 }
 
 LTTNG_HIDDEN
@@ -807,15 +1009,33 @@ static int fd_tracker_restore_handle(
 		struct fd_tracker *tracker, struct fs_handle_tracked *handle)
 {
 	int ret;
+	struct timespec begin_ts, end_ts;
 
 	fd_tracker_untrack(tracker, handle);
+	fd_tracker_account_restore(tracker, handle);
 	if (ACTIVE_COUNT(tracker) >= tracker->capacity) {
-		ret = fd_tracker_suspend_handles(tracker, 1);
+		ret = fd_tracker_make_room(tracker);
 		if (ret) {
 			goto end;
 		}
 	}
+
+	(void) lttng_clock_gettime(CLOCK_MONOTONIC, &begin_ts);
 	ret = fs_handle_tracked_restore(handle);
+	if (!lttng_clock_gettime(CLOCK_MONOTONIC, &end_ts)) {
+		const uint64_t restore_ns =
+				(uint64_t) (end_ts.tv_sec - begin_ts.tv_sec) *
+						NSEC_PER_SEC +
+				end_ts.tv_nsec - begin_ts.tv_nsec;
+
+		tracker->restore.total_ns += restore_ns;
+		tracker->restore.max_ns = max(tracker->restore.max_ns,
+				restore_ns);
+		handle->restore.count++;
+		handle->restore.total_ns += restore_ns;
+		handle->restore.max_ns = max(handle->restore.max_ns,
+				restore_ns);
+	}
 end:
 	fd_tracker_track(tracker, handle);
 	return ret ? ret : handle->fd;
@@ -827,39 +1047,52 @@ static int fs_handle_tracked_get_fd(struct fs_handle *_handle)
 	struct fs_handle_tracked *handle =
 			container_of(_handle, struct fs_handle_tracked, parent);
 
+	uatomic_inc(&handle->tracker->stats.uses);
+
 	/*
-	 * TODO This should be optimized as it is a fairly hot path.
-	 * The fd-tracker's lock should only be taken when a fs_handle is
-	 * restored (slow path). On the fast path (fs_handle is active),
-	 * the only effect on the fd_tracker is marking the handle as the
-	 * most recently used. Currently, it is done by a call to the
-	 * track/untrack helpers, but it should be done atomically.
-	 *
-	 * Note that the lock's nesting order must still be respected here.
-	 * The handle's lock nests inside the tracker's lock.
+	 * Fast path: the handle is active. Marking it as used does not
+	 * require the tracker's lock; the handle's lock prevents its
+	 * concurrent suspension.
 	 */
-	pthread_mutex_lock(&handle->tracker->lock);
 	pthread_mutex_lock(&handle->lock);
 	assert(!handle->in_use);
+	if (handle->fd >= 0) {
+		ret = handle->fd;
+		uatomic_set(&handle->referenced, 1);
+		handle->in_use = true;
+		pthread_mutex_unlock(&handle->lock);
+		goto end;
+	}
+	pthread_mutex_unlock(&handle->lock);
 
-	handle->tracker->stats.uses++;
+	/*
+	 * Slow path: the handle must be restored. The handle's lock nests
+	 * inside the tracker's lock.
+	 */
+	pthread_mutex_lock(&handle->tracker->lock);
+	pthread_mutex_lock(&handle->lock);
 	if (handle->fd >= 0) {
+		/* Restored concurrently. */
 		ret = handle->fd;
-		/* Mark as most recently used. */
-		fd_tracker_untrack(handle->tracker, handle);
-		fd_tracker_track(handle->tracker, handle);
+		uatomic_set(&handle->referenced, 1);
 	} else {
-		handle->tracker->stats.misses++;
+		/*
+		 * The restored handle is added at the end of the active list
+		 * without being marked as referenced: only its later uses
+		 * show that it is used more often than once per cycle.
+		 */
+		uatomic_inc(&handle->tracker->stats.misses);
 		ret = fd_tracker_restore_handle(handle->tracker, handle);
 		if (ret < 0) {
-			handle->tracker->stats.errors++;
-			goto end;
+			uatomic_inc(&handle->tracker->stats.errors);
+			goto end_unlock;
 		}
 	}
 	handle->in_use = true;
-end:
+end_unlock:
 	pthread_mutex_unlock(&handle->lock);
 	pthread_mutex_unlock(&handle->tracker->lock);
+end:
 	return ret;
 }
 
@@ -0,0 +1,514 @@
+/*
+ * Copyright (C) 2020 EfficiOS Inc.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+#include <urcu/list.h>
+#include <urcu/ref.h>
+
+#include <common/align.h>
+#include <common/common.h>
+#include <common/fs-handle-async.h>
+#include <common/fs-handle-internal.h>
+#include <common/fs-handle.h>
+#include <common/readwrite.h>
+
+struct fs_handle_async_writer {
+	struct urcu_ref ref;
+	pthread_mutex_t lock;
+	/* Signaled when a handle is queued or when the threads must quit. */
+	pthread_cond_t work_cond;
+	/* Signaled when queued writes complete. */
+	pthread_cond_t completion_cond;
+	/* Handles with queued writes that no thread is performing. */
+	struct cds_list_head ready_handles;
+	/*
+	 * Storage of the queued requests, allocated once. The requests are
+	 * laid out contiguously from `tail` to `head`, wrapping around at
+	 * `wrap_offset` when it is set. Their storage is released in order,
+	 * once they are written.
+	 */
+	char *ring;
+	size_t ring_size;
+	size_t head;
+	size_t tail;
+	/* End of the requests stored before the ring wrapped, 0 if none. */
+	size_t wrap_offset;
+	bool quit;
+	unsigned int thread_count;
+	pthread_t *threads;
+};
+
+struct fs_handle_async_request {
+	struct cds_list_head node;
+	/* Storage of the request in the ring, header included. */
+	size_t size;
+	size_t len;
+	/* Set once written; the storage is released in order. */
+	bool done;
+	char data[];
+};
+
+#define FS_HANDLE_ASYNC_REQUEST_ALIGN	sizeof(void *)
+
+struct fs_handle_async {
+	struct fs_handle parent;
+	struct fs_handle *handle;
+	struct fs_handle_async_writer *writer;
+	/* The following members are protected by the writer's lock. */
+	struct cds_list_head requests;
+	struct cds_list_head ready_node;
+	bool is_ready;
+	/* Set while a thread performs the handle's writes. */
+	bool is_writing;
+	/* errno of the first write that failed. */
+	int error;
+};
+
+static void fs_handle_async_writer_release(struct urcu_ref *ref)
+{
+	struct fs_handle_async_writer *writer = container_of(ref,
+			struct fs_handle_async_writer, ref);
+
+	assert(cds_list_empty(&writer->ready_handles));
+	assert(writer->head == writer->tail && !writer->wrap_offset);
+	pthread_mutex_destroy(&writer->lock);
+	pthread_cond_destroy(&writer->work_cond);
+	pthread_cond_destroy(&writer->completion_cond);
+	free(writer->threads);
+	free(writer->ring);
+	free(writer);
+}
+
+static void fs_handle_async_writer_put(struct fs_handle_async_writer *writer)
+{
+	urcu_ref_put(&writer->ref, fs_handle_async_writer_release);
+}
+
+/* Called with the writer's lock held. */
+static void fs_handle_async_set_ready(struct fs_handle_async *handle)
+{
+	if (handle->is_ready || handle->is_writing ||
+			cds_list_empty(&handle->requests)) {
+		return;
+	}
+
+	cds_list_add_tail(&handle->ready_node, &handle->writer->ready_handles);
+	handle->is_ready = true;
+	pthread_cond_signal(&handle->writer->work_cond);
+}
+
+/*
+ * Reserve the storage of a request of `len` bytes in the writer's ring.
+ *
+ * Called with the writer's lock held. Returns NULL if the ring does not have
+ * enough contiguous free space.
+ */
+static struct fs_handle_async_request *fs_handle_async_reserve_request(
+		struct fs_handle_async_writer *writer, size_t len)
+{
+	size_t offset;
+	struct fs_handle_async_request *request;
+	const size_t size = ALIGN(sizeof(*request) + len,
+			FS_HANDLE_ASYNC_REQUEST_ALIGN);
+
+	if (writer->wrap_offset) {
+		/* The free space lies between the head and the tail. */
+		if (writer->tail - writer->head < size) {
+			return NULL;
+		}
+		offset = writer->head;
+	} else if (writer->ring_size - writer->head >= size) {
+		offset = writer->head;
+	} else if (writer->tail >= size) {
+		/* Skip the end of the ring. */
+		writer->wrap_offset = writer->head;
+		offset = 0;
+	} else {
+		return NULL;
+	}
+
+	writer->head = offset + size;
+	request = (struct fs_handle_async_request *) (writer->ring + offset);
+	request->size = size;
+	request->len = len;
+	request->done = false;
+	return request;
+}
+
+/*
+ * Release the storage of the written requests at the tail of the ring.
+ *
+ * Called with the writer's lock held.
+ */
+static void fs_handle_async_release_requests(
+		struct fs_handle_async_writer *writer)
+{
+	for (;;) {
+		const struct fs_handle_async_request *request;
+
+		if (writer->wrap_offset && writer->tail == writer->wrap_offset) {
+			writer->tail = 0;
+			writer->wrap_offset = 0;
+		}
+		if (!writer->wrap_offset && writer->tail == writer->head) {
+			/* Empty: restart from the beginning of the ring. */
+			writer->head = 0;
+			writer->tail = 0;
+			break;
+		}
+
+		request = (const struct fs_handle_async_request *)
+				(writer->ring + writer->tail);
+		if (!request->done) {
+			break;
+		}
+		writer->tail += request->size;
+	}
+}
+
+static int fs_handle_async_perform_request(struct fs_handle_async *handle,
+		const struct fs_handle_async_request *request)
+{
+	int ret = 0;
+	ssize_t write_ret;
+
+	write_ret = fs_handle_write(handle->handle, request->data,
+			request->len);
+	if (write_ret < 0 || (size_t) write_ret != request->len) {
+		ret = write_ret < 0 ? errno : EIO;
+		PERROR("Failed to perform asynchronous write of %zu bytes",
+				request->len);
+	}
+
+	return ret;
+}
+
+static void *fs_handle_async_writer_thread(void *data)
+{
+	struct fs_handle_async_writer *writer = data;
+
+	pthread_mutex_lock(&writer->lock);
+	for (;;) {
+		struct fs_handle_async *handle;
+		struct fs_handle_async_request *request, *tmp;
+		struct cds_list_head requests;
+		int error;
+
+		while (cds_list_empty(&writer->ready_handles) &&
+				!writer->quit) {
+			pthread_cond_wait(&writer->work_cond, &writer->lock);
+		}
+		if (cds_list_empty(&writer->ready_handles)) {
+			/* Quit once all queued writes have been performed. */
+			break;
+		}
+
+		handle = cds_list_first_entry(&writer->ready_handles,
+				struct fs_handle_async, ready_node);
+		cds_list_del(&handle->ready_node);
+		handle->is_ready = false;
+		handle->is_writing = true;
+		CDS_INIT_LIST_HEAD(&requests);
+		cds_list_splice(&handle->requests, &requests);
+		CDS_INIT_LIST_HEAD(&handle->requests);
+		error = handle->error;
+		pthread_mutex_unlock(&writer->lock);
+
+		/*
+		 * The requests are performed in order. Once a write fails,
+		 * the following writes of the handle are discarded.
+		 */
+		cds_list_for_each_entry(request, &requests, node) {
+			if (!error) {
+				error = fs_handle_async_perform_request(handle,
+						request);
+			}
+		}
+
+		pthread_mutex_lock(&writer->lock);
+		cds_list_for_each_entry_safe(request, tmp, &requests, node) {
+			cds_list_del(&request->node);
+			request->done = true;
+		}
+		fs_handle_async_release_requests(writer);
+		handle->is_writing = false;
+		handle->error = error;
+		/* Writes may have been queued in the meantime. */
+		fs_handle_async_set_ready(handle);
+		pthread_cond_broadcast(&writer->completion_cond);
+	}
+	pthread_mutex_unlock(&writer->lock);
+
+	return NULL;
+}
+
+LTTNG_HIDDEN
+struct fs_handle_async_writer *fs_handle_async_writer_create(
+		unsigned int thread_count, size_t max_pending_bytes)
+{
+	int ret;
+	struct fs_handle_async_writer *writer;
+
+	assert(thread_count > 0);
+
+	writer = zmalloc(sizeof(*writer));
+	if (!writer) {
+		PERROR("Failed to allocate asynchronous writer");
+		goto error;
+	}
+
+	urcu_ref_init(&writer->ref);
+	pthread_mutex_init(&writer->lock, NULL);
+	pthread_cond_init(&writer->work_cond, NULL);
+	pthread_cond_init(&writer->completion_cond, NULL);
+	CDS_INIT_LIST_HEAD(&writer->ready_handles);
+
+	/* A request of up to a quarter of the ring always fits eventually. */
+	writer->ring_size = ALIGN(max_pending_bytes,
+			FS_HANDLE_ASYNC_REQUEST_ALIGN);
+	if (writer->ring_size <= 4 * sizeof(struct fs_handle_async_request)) {
+		ERR("Asynchronous writer pending size is too small: %zu bytes",
+				max_pending_bytes);
+		goto error;
+	}
+	writer->ring = malloc(writer->ring_size);
+	if (!writer->ring) {
+		PERROR("Failed to allocate asynchronous writer request storage of %zu bytes",
+				writer->ring_size);
+		goto error;
+	}
+
+	writer->threads = zmalloc(sizeof(*writer->threads) * thread_count);
+	if (!writer->threads) {
+		PERROR("Failed to allocate asynchronous writer threads");
+		goto error;
+	}
+
+	for (; writer->thread_count < thread_count; writer->thread_count++) {
+		ret = pthread_create(&writer->threads[writer->thread_count],
+				NULL, fs_handle_async_writer_thread, writer);
+		if (ret) {
+			errno = ret;
+			PERROR("Failed to launch asynchronous writer thread");
+			goto error;
+		}
+	}
+
+	DBG("Created asynchronous writer: thread count = %u, maximal pending size = %zu bytes",
+			thread_count, max_pending_bytes);
+	return writer;
+error:
+	if (writer) {
+		fs_handle_async_writer_destroy(writer);
+	}
+	return NULL;
+}
+
+LTTNG_HIDDEN
+void fs_handle_async_writer_destroy(struct fs_handle_async_writer *writer)
+{
+	unsigned int i;
+
+	pthread_mutex_lock(&writer->lock);
+	writer->quit = true;
+	pthread_cond_broadcast(&writer->work_cond);
+	pthread_mutex_unlock(&writer->lock);
+
+	for (i = 0; i < writer->thread_count; i++) {
+		int ret = pthread_join(writer->threads[i], NULL);
+
+		if (ret) {
+			errno = ret;
+			PERROR("Failed to join asynchronous writer thread");
+		}
+	}
+
+	fs_handle_async_writer_put(writer);
+}
+
+/*
+ * Wait for all the writes queued on the handle to complete.
+ *
+ * Returns the errno of the first write that failed, 0 otherwise.
+ */
+static int fs_handle_async_drain(struct fs_handle_async *handle)
+{
+	int error;
+	struct fs_handle_async_writer *writer = handle->writer;
+
+	pthread_mutex_lock(&writer->lock);
+	while (handle->is_writing || !cds_list_empty(&handle->requests)) {
+		pthread_cond_wait(&writer->completion_cond, &writer->lock);
+	}
+	error = handle->error;
+	pthread_mutex_unlock(&writer->lock);
+
+	return error;
+}
+
+static int fs_handle_async_get_fd(struct fs_handle *_handle)
+{
+	struct fs_handle_async *handle = container_of(
+			_handle, struct fs_handle_async, parent);
+
+	(void) fs_handle_async_drain(handle);
+	return fs_handle_get_fd(handle->handle);
+}
+
+static void fs_handle_async_put_fd(struct fs_handle *_handle)
+{
+	struct fs_handle_async *handle = container_of(
+			_handle, struct fs_handle_async, parent);
+
+	fs_handle_put_fd(handle->handle);
+}
+
+static int fs_handle_async_unlink(struct fs_handle *_handle)
+{
+	struct fs_handle_async *handle = container_of(
+			_handle, struct fs_handle_async, parent);
+
+	return fs_handle_unlink(handle->handle);
+}
+
+static int fs_handle_async_close(struct fs_handle *_handle)
+{
+	int ret;
+	struct fs_handle_async *handle = container_of(
+			_handle, struct fs_handle_async, parent);
+	const int error = fs_handle_async_drain(handle);
+
+	ret = fs_handle_close(handle->handle);
+	if (!ret && error) {
+		errno = error;
+		ret = -1;
+	}
+
+	fs_handle_async_writer_put(handle->writer);
+	free(handle);
+	return ret;
+}
+
+/*
+ * Copy `len` bytes of the data described by `iov`, starting at the current
+ * position (`*iov_index`, `*iov_offset`), which is advanced.
+ */
+static void copy_from_iov(char *dst, size_t len, const struct iovec *iov,
+		int *iov_index, size_t *iov_offset)
+{
+	while (len > 0) {
+		const struct iovec *src = &iov[*iov_index];
+		const size_t copy_len = min(len, src->iov_len - *iov_offset);
+
+		memcpy(dst, (const char *) src->iov_base + *iov_offset,
+				copy_len);
+		dst += copy_len;
+		len -= copy_len;
+		*iov_offset += copy_len;
+		if (*iov_offset == src->iov_len) {
+			(*iov_index)++;
+			*iov_offset = 0;
+		}
+	}
+}
+
+static ssize_t fs_handle_async_writev(struct fs_handle *_handle,
+		const struct iovec *iov, int iovcnt)
+{
+	ssize_t ret;
+	int i, iov_index = 0;
+	size_t len = 0, remaining_len, iov_offset = 0;
+	struct fs_handle_async *handle = container_of(
+			_handle, struct fs_handle_async, parent);
+	struct fs_handle_async_writer *writer = handle->writer;
+	const size_t max_request_len = writer->ring_size / 4 -
+			sizeof(struct fs_handle_async_request);
+
+	for (i = 0; i < iovcnt; i++) {
+		len += iov[i].iov_len;
+	}
+	if (len > SSIZE_MAX) {
+		ret = -1;
+		errno = EINVAL;
+		goto end;
+	}
+
+	/* Large writes are queued as several requests. */
+	for (remaining_len = len; remaining_len > 0;) {
+		const size_t request_len = min(remaining_len, max_request_len);
+		struct fs_handle_async_request *request;
+
+		pthread_mutex_lock(&writer->lock);
+		assert(!writer->quit);
+		/* Throttle the producers when the ring is full. */
+		while (handle->error == 0 &&
+				!(request = fs_handle_async_reserve_request(
+					writer, request_len))) {
+			pthread_cond_wait(&writer->completion_cond,
+					&writer->lock);
+		}
+		if (handle->error) {
+			/* Report the error of a previous write. */
+			errno = handle->error;
+			pthread_mutex_unlock(&writer->lock);
+			ret = -1;
+			goto end;
+		}
+		pthread_mutex_unlock(&writer->lock);
+
+		/*
+		 * The writer's threads only access the request once it is
+		 * queued: copy the data without holding the writer's lock.
+		 */
+		copy_from_iov(request->data, request_len, iov, &iov_index,
+				&iov_offset);
+
+		pthread_mutex_lock(&writer->lock);
+		cds_list_add_tail(&request->node, &handle->requests);
+		fs_handle_async_set_ready(handle);
+		pthread_mutex_unlock(&writer->lock);
+		remaining_len -= request_len;
+	}
+	ret = len;
+end:
+	return ret;
+}
+
+LTTNG_HIDDEN
+struct fs_handle *fs_handle_async_create(
+		struct fs_handle_async_writer *writer,
+		struct fs_handle *_handle)
+{
+	struct fs_handle_async *handle;
+
+	handle = zmalloc(sizeof(*handle));
+	if (!handle) {
+		PERROR("Failed to allocate asynchronous filesystem handle");
+		goto end;
+	}
+
+	handle->parent = (typeof(handle->parent)) {
+		.get_fd = fs_handle_async_get_fd,
+		.put_fd = fs_handle_async_put_fd,
+		.unlink = fs_handle_async_unlink,
+		.close = fs_handle_async_close,
+		.writev = fs_handle_async_writev,
+	};
+
+	urcu_ref_get(&writer->ref);
+	handle->writer = writer;
+	handle->handle = _handle;
+	CDS_INIT_LIST_HEAD(&handle->requests);
+	CDS_INIT_LIST_HEAD(&handle->ready_node);
+end:
+	return handle ? &handle->parent : NULL;
+}
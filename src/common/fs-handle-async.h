@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2020 EfficiOS Inc.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-only
+ *
+ */
+
+#ifndef FS_HANDLE_ASYNC_H
+#define FS_HANDLE_ASYNC_H
+
+#include <common/macros.h>
+#include <stddef.h>
+
+struct fs_handle;
+struct fs_handle_async_writer;
+
+/*
+ * An asynchronous writer owns a pool of threads that perform the writes
+ * queued on the fs_handles it wraps.
+ *
+ * The writes queued on a given handle are performed in order, by one thread
+ * at a time. The writes queued on different handles are performed in
+ * parallel.
+ *
+ * The writes are queued in `max_pending_bytes` of storage allocated with the
+ * writer. Writing to a handle blocks while this storage is full.
+ *
+ * Returns a new writer on success, NULL on error.
+ */
+LTTNG_HIDDEN
+struct fs_handle_async_writer *fs_handle_async_writer_create(
+		unsigned int thread_count, size_t max_pending_bytes);
+
+/*
+ * Performs the writes that are still queued and stops the writer's threads.
+ *
+ * The handles created from the writer may still be closed after its
+ * destruction. However, no write may be performed on them once the
+ * writer has been destroyed.
+ */
+LTTNG_HIDDEN
+void fs_handle_async_writer_destroy(struct fs_handle_async_writer *writer);
+
+/*
+ * Create a handle that queues the writes performed through fs_handle_write()
+ * and fs_handle_writev() on `writer` before performing them on `handle`.
+ * The data is copied to the writer's storage, without holding the writer's
+ * lock: the caller's buffers may be reused as soon as these functions return.
+ *
+ * Any other operation requiring the underlying fd (through
+ * fs_handle_get_fd()) waits for the queued writes to complete first,
+ * as does fs_handle_close().
+ *
+ * Since the writes complete out of line, their errors are reported by the
+ * next write or by fs_handle_close().
+ *
+ * Ownership of `handle` is transferred to the new handle on success.
+ * Returns NULL on error, in which case `handle` is left untouched.
+ */
+LTTNG_HIDDEN
+struct fs_handle *fs_handle_async_create(
+		struct fs_handle_async_writer *writer,
+		struct fs_handle *handle);
+
+#endif /* FS_HANDLE_ASYNC_H */
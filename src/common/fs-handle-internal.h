@@ -8,6 +8,9 @@
 #ifndef FS_HANDLE_INTERNAL_H
 #define FS_HANDLE_INTERNAL_H
 
+#include <sys/types.h>
+#include <sys/uio.h>
+
 struct fs_handle;
 
 /*
@@ -22,12 +25,19 @@ typedef int (*fs_handle_get_fd_cb)(struct fs_handle *);
 typedef void (*fs_handle_put_fd_cb)(struct fs_handle *);
 typedef int (*fs_handle_unlink_cb)(struct fs_handle *);
 typedef int (*fs_handle_close_cb)(struct fs_handle *);
+typedef ssize_t (*fs_handle_writev_cb)(struct fs_handle *,
+		const struct iovec *, int);
 
 struct fs_handle {
 	fs_handle_get_fd_cb get_fd;
 	fs_handle_put_fd_cb put_fd;
 	fs_handle_unlink_cb unlink;
 	fs_handle_close_cb close;
+	/*
+	 * Optional. Used by fs_handle_write() and fs_handle_writev() in lieu
+	 * of writing to the fd returned by get_fd().
+	 */
+	fs_handle_writev_cb writev;
 };
 
 #endif /* FS_HANDLE_INTERNAL_H */
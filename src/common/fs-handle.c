@@ -8,6 +8,7 @@
 #include <common/fs-handle-internal.h>
 #include <common/fs-handle.h>
 #include <common/readwrite.h>
+#include <errno.h>
 
 LTTNG_HIDDEN
 int fs_handle_get_fd(struct fs_handle *handle)
@@ -54,8 +55,19 @@ LTTNG_HIDDEN
 ssize_t fs_handle_write(struct fs_handle *handle, const void *buf, size_t count)
 {
 	ssize_t ret;
-	const int fd = fs_handle_get_fd(handle);
+	int fd;
+
+	if (handle->writev) {
+		const struct iovec iov = {
+			.iov_base = (void *) buf,
+			.iov_len = count,
+		};
 
+		ret = handle->writev(handle, &iov, 1);
+		goto end;
+	}
+
+	fd = fs_handle_get_fd(handle);
 	if (fd < 0) {
 		ret = -1;
 		goto end;
@@ -67,6 +79,60 @@ end:
 	return ret;
 }
 
+LTTNG_HIDDEN
+ssize_t fs_handle_writev(struct fs_handle *handle, struct iovec *iov,
+		int iovcnt)
+{
+	ssize_t ret;
+	size_t written = 0;
+	int fd;
+
+	if (handle->writev) {
+		ret = handle->writev(handle, iov, iovcnt);
+		goto end;
+	}
+
+	fd = fs_handle_get_fd(handle);
+	if (fd < 0) {
+		ret = -1;
+		goto end;
+	}
+
+	while (iovcnt > 0) {
+		size_t advance;
+
+		ret = writev(fd, iov, iovcnt);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;	/* retry operation */
+			}
+			break;
+		} else if (ret == 0) {
+			break;
+		}
+
+		written += ret;
+		advance = ret;
+		/* Skip the vectors that were completely written. */
+		while (iovcnt > 0 && advance >= iov->iov_len) {
+			advance -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (iovcnt > 0) {
+			iov->iov_base = (char *) iov->iov_base + advance;
+			iov->iov_len -= advance;
+		}
+	}
+	fs_handle_put_fd(handle);
+
+	if (written > 0 || iovcnt == 0) {
+		ret = written;
+	}
+end:
+	return ret;
+}
+
 LTTNG_HIDDEN
 int fs_handle_truncate(struct fs_handle *handle, off_t offset)
 {
@@ -10,6 +10,7 @@
 
 #include <common/macros.h>
 #include <stdio.h>
+#include <sys/uio.h>
 
 struct fs_handle;
 
@@ -65,6 +66,18 @@ ssize_t fs_handle_read(struct fs_handle *handle, void *buf, size_t count);
 LTTNG_HIDDEN
 ssize_t fs_handle_write(struct fs_handle *handle, const void *buf, size_t count);
 
+/*
+ * Write the contents of `iovcnt` vectors to the file in as few writev(2)
+ * calls as possible, handling EINTR and partial writes like
+ * lttng_write(). The vectors may be modified.
+ *
+ * Returns the total length of the vectors on success. A lower value or
+ * a negative value is returned if an error occurred.
+ */
+LTTNG_HIDDEN
+ssize_t fs_handle_writev(struct fs_handle *handle, struct iovec *iov,
+		int iovcnt);
+
 LTTNG_HIDDEN
 int fs_handle_truncate(struct fs_handle *handle, off_t offset);
 
@@ -9,6 +9,7 @@
 
 #define _LGPL_SOURCE
 #include <assert.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <fcntl.h>
@@ -271,3 +272,173 @@ void lttng_index_file_put(struct lttng_index_file *index_file)
 {
 	urcu_ref_put(&index_file->ref, lttng_index_file_release);
 }
+
+int lttng_index_file_view_map(const struct lttng_index_file *index_file,
+		struct lttng_index_file_view *view)
+{
+	int ret = 0, fd;
+	struct stat file_stat;
+	const size_t header_len = sizeof(struct ctf_packet_index_file_hdr);
+
+	assert(index_file);
+	assert(view);
+
+	memset(view, 0, sizeof(*view));
+	view->element_len = index_file->element_len;
+	view->minor = index_file->minor;
+
+	if (!index_file->file || !index_file->element_len) {
+		ret = -1;
+		goto end;
+	}
+
+	fd = fs_handle_get_fd(index_file->file);
+	if (fd < 0) {
+		ERR("Failed to get file descriptor of index file");
+		ret = -1;
+		goto end;
+	}
+
+	ret = fstat(fd, &file_stat);
+	if (ret < 0) {
+		PERROR("Failed to stat index file");
+		goto end_put_fd;
+	}
+
+	/* A partially written entry is ignored. */
+	if ((uint64_t) file_stat.st_size > header_len) {
+		view->entry_count = ((uint64_t) file_stat.st_size - header_len) /
+				index_file->element_len;
+	}
+	if (!view->entry_count) {
+		goto end_put_fd;
+	}
+
+	view->mapping_len = header_len +
+			view->entry_count * index_file->element_len;
+	view->mapping = mmap(NULL, view->mapping_len, PROT_READ, MAP_SHARED,
+			fd, 0);
+	if (view->mapping == MAP_FAILED) {
+		PERROR("Failed to map index file");
+		view->mapping = NULL;
+		view->entry_count = 0;
+		ret = -1;
+		goto end_put_fd;
+	}
+	view->entries = (const char *) view->mapping + header_len;
+
+end_put_fd:
+	/* The mapping outlives the file descriptor. */
+	fs_handle_put_fd(index_file->file);
+end:
+	return ret;
+}
+
+void lttng_index_file_view_unmap(struct lttng_index_file_view *view)
+{
+	if (view->mapping && munmap(view->mapping, view->mapping_len)) {
+		PERROR("Failed to unmap index file");
+	}
+	memset(view, 0, sizeof(*view));
+}
+
+uint64_t lttng_index_file_view_read(const struct lttng_index_file_view *view,
+		uint64_t position, struct ctf_packet_index *elements,
+		uint64_t count)
+{
+	uint64_t i;
+
+	if (position >= view->entry_count) {
+		return 0;
+	}
+
+	count = min(count, view->entry_count - position);
+	if (view->element_len == sizeof(*elements)) {
+		/* The entries have the in-memory layout: copy them at once. */
+		memcpy(elements, view->entries + position * view->element_len,
+				count * sizeof(*elements));
+		return count;
+	}
+
+	for (i = 0; i < count; i++) {
+		memset(&elements[i], 0, sizeof(elements[i]));
+		memcpy(&elements[i], view->entries +
+				(position + i) * view->element_len,
+				view->element_len);
+	}
+	return count;
+}
+
+/* Read a 64-bit field of an entry, in host byte order. */
+static uint64_t view_entry_field(const struct lttng_index_file_view *view,
+		uint64_t position, size_t field_offset)
+{
+	uint64_t value;
+
+	memcpy(&value, view->entries + position * view->element_len +
+			field_offset, sizeof(value));
+	return be64toh(value);
+}
+
+/*
+ * Find the first entry whose field at `field_offset` is greater than `value`
+ * (or greater or equal if `inclusive`), the entries being sorted by that
+ * field.
+ */
+static uint64_t view_bound(const struct lttng_index_file_view *view,
+		size_t field_offset, uint64_t value, bool inclusive)
+{
+	uint64_t low = 0, high = view->entry_count;
+
+	while (low < high) {
+		const uint64_t middle = low + (high - low) / 2;
+		const uint64_t middle_value = view_entry_field(view, middle,
+				field_offset);
+
+		if (middle_value < value ||
+				(!inclusive && middle_value == value)) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	return low;
+}
+
+int lttng_index_file_view_find_timestamp(
+		const struct lttng_index_file_view *view, uint64_t timestamp,
+		uint64_t *position)
+{
+	const uint64_t next = view_bound(view,
+			offsetof(struct ctf_packet_index, timestamp_begin),
+			timestamp, false);
+
+	if (next == 0) {
+		return -1;
+	}
+	*position = next - 1;
+	return 0;
+}
+
+int lttng_index_file_view_find_seq_num(
+		const struct lttng_index_file_view *view, uint64_t seq_num,
+		uint64_t *position)
+{
+	const size_t field_offset = offsetof(struct ctf_packet_index,
+			packet_seq_num);
+	uint64_t found;
+
+	if (view->element_len < field_offset + sizeof(uint64_t)) {
+		DBG("Index version 1.%u entries have no packet sequence number",
+				view->minor);
+		return -1;
+	}
+
+	found = view_bound(view, field_offset, seq_num, true);
+	if (found == view->entry_count ||
+			view_entry_field(view, found, field_offset) != seq_num) {
+		return -1;
+	}
+	*position = found;
+	return 0;
+}
@@ -52,4 +52,70 @@ int lttng_index_file_read(const struct lttng_index_file *index_file,
 void lttng_index_file_get(struct lttng_index_file *index_file);
 void lttng_index_file_put(struct lttng_index_file *index_file);
 
+/*
+ * Read-only view of the entries of an index file, mapped in memory.
+ *
+ * A view holds the entries present in the file when it is mapped; the
+ * entries appended afterwards are only visible once the file is mapped
+ * again. The entries are kept in the file's (big endian) format.
+ */
+struct lttng_index_file_view {
+	/* NULL when the file holds no entry. */
+	void *mapping;
+	size_t mapping_len;
+	const char *entries;
+	uint64_t entry_count;
+	uint32_t element_len;
+	uint32_t minor;
+};
+
+/*
+ * Map the entries of an index file opened with
+ * lttng_index_file_create_from_trace_chunk_read_only(). The view remains
+ * valid after the index file is released.
+ *
+ * Return 0 on success, -1 on error.
+ */
+int lttng_index_file_view_map(const struct lttng_index_file *index_file,
+		struct lttng_index_file_view *view);
+void lttng_index_file_view_unmap(struct lttng_index_file_view *view);
+
+static inline
+uint64_t lttng_index_file_view_get_count(
+		const struct lttng_index_file_view *view)
+{
+	return view->entry_count;
+}
+
+/*
+ * Copy up to `count` entries, starting at entry `position`, in `elements`.
+ * The fields absent from the file's index version are zeroed.
+ *
+ * Return the number of entries copied.
+ */
+uint64_t lttng_index_file_view_read(const struct lttng_index_file_view *view,
+		uint64_t position, struct ctf_packet_index *elements,
+		uint64_t count);
+
+/*
+ * Find the position of the last packet beginning at or before `timestamp`,
+ * that is the packet covering `timestamp` if any. The packets are expected
+ * in increasing `timestamp_begin` order.
+ *
+ * Return 0 on success, -1 if all packets begin after `timestamp`.
+ */
+int lttng_index_file_view_find_timestamp(
+		const struct lttng_index_file_view *view, uint64_t timestamp,
+		uint64_t *position);
+
+/*
+ * Find the position of the packet having sequence number `seq_num`. The
+ * sequence numbers are only present in index version 1.1 and later.
+ *
+ * Return 0 on success, -1 if no such packet is found.
+ */
+int lttng_index_file_view_find_seq_num(
+		const struct lttng_index_file_view *view, uint64_t seq_num,
+		uint64_t *position);
+
 #endif /* _INDEX_H */
@@ -776,8 +776,10 @@ int lttng_kconsumer_recv_cmd(struct lttng_consumer_local_data *ctx,
 			consumer_add_metadata_stream(new_stream);
 			stream_pipe = ctx->consumer_metadata_pipe;
 		} else {
+			new_stream->data_thread = consumer_select_data_thread(
+					ctx, new_stream);
 			consumer_add_data_stream(new_stream);
-			stream_pipe = ctx->consumer_data_pipe;
+			stream_pipe = new_stream->data_thread->data_pipe;
 		}
 
 		/* Visible to other threads */
@@ -7,11 +7,18 @@
 
 #define _LGPL_SOURCE
 #include <assert.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <inttypes.h>
+#include <netinet/in.h>
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
 
 #include <common/common.h>
 #include <common/defaults.h>
@@ -24,6 +31,11 @@
 
 #include "relayd.h"
 
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && \
+		defined(SO_EE_ORIGIN_ZEROCOPY)
+#define HAVE_RELAYD_ZEROCOPY
+#endif
+
 static
 bool relayd_supports_chunks(const struct lttcomm_relayd_sock *sock)
 {
@@ -837,6 +849,308 @@ error:
 	return ret;
 }
 
+/*
+ * Send the content of an iovec array in as few sendmsg() calls as possible,
+ * resuming after partial sends. The array is modified to track the progress
+ * of the send.
+ *
+ * The number of successful sendmsg() calls is added to `send_count` when it
+ * is not NULL.
+ *
+ * Returns 0 on success, a negative errno value on error.
+ */
+static int send_iov(struct lttcomm_relayd_sock *rsock, struct iovec *iov,
+		size_t iovcnt, int flags, unsigned int *send_count)
+{
+	int ret = 0;
+	struct msghdr msg;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = iovcnt;
+
+	while (msg.msg_iovlen > 0) {
+		ssize_t sent;
+
+		sent = sendmsg(rsock->sock.fd, &msg, flags);
+		if (sent < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			ret = -errno;
+			/* EPIPE is expected when the relayd hangs up. */
+			if (errno != EPIPE || !lttng_opt_quiet) {
+				PERROR("Failed to send relayd packet");
+			}
+			goto end;
+		}
+		if (send_count) {
+			(*send_count)++;
+		}
+
+		/* Skip the entries sent completely. */
+		while (msg.msg_iovlen > 0 && sent >= msg.msg_iov->iov_len) {
+			sent -= msg.msg_iov->iov_len;
+			msg.msg_iov++;
+			msg.msg_iovlen--;
+		}
+		if (msg.msg_iovlen > 0) {
+			msg.msg_iov->iov_base = (char *) msg.msg_iov->iov_base + sent;
+			msg.msg_iov->iov_len -= sent;
+		}
+	}
+end:
+	return ret;
+}
+
+/*
+ * Read the completion notifications queued on the error queue of a relayd data
+ * socket, without blocking, and record the sends whose pages the kernel no
+ * longer references.
+ *
+ * Zero-copy is disabled on the socket if the kernel reports that it had to
+ * copy the data anyway (e.g. loopback or a device without scatter-gather
+ * support), in which case MSG_ZEROCOPY only adds overhead.
+ *
+ * The caller must hold the data socket lock.
+ *
+ * Returns 0 on success, a negative errno value on error.
+ */
+int relayd_reap_zerocopy_completions(struct lttcomm_relayd_sock *rsock,
+		struct relayd_zerocopy *zerocopy)
+{
+	int ret = 0;
+#ifdef HAVE_RELAYD_ZEROCOPY
+
+	/* Nothing is pending. */
+	while (zerocopy->pending_id != zerocopy->next_id) {
+		ssize_t recv_ret;
+		struct msghdr msg;
+		struct cmsghdr *cmsg;
+		char control[CMSG_SPACE(sizeof(struct sock_extended_err)) +
+				CMSG_SPACE(sizeof(struct sockaddr_in6))];
+
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		/* Reading the error queue never blocks. */
+		recv_ret = recvmsg(rsock->sock.fd, &msg, MSG_ERRQUEUE);
+		if (recv_ret < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				break;
+			} else if (errno == EINTR) {
+				continue;
+			}
+			ret = -errno;
+			PERROR("Failed to read zero-copy completions of relayd data socket");
+			goto end;
+		}
+
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+				cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			const struct sock_extended_err *serr;
+
+			if (!((cmsg->cmsg_level == SOL_IP &&
+					cmsg->cmsg_type == IP_RECVERR) ||
+					(cmsg->cmsg_level == SOL_IPV6 &&
+					cmsg->cmsg_type == IPV6_RECVERR))) {
+				continue;
+			}
+
+			serr = (const struct sock_extended_err *) CMSG_DATA(cmsg);
+			if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+				continue;
+			}
+			if (serr->ee_errno != 0) {
+				ret = -serr->ee_errno;
+				ERR("Zero-copy send on relayd data socket failed: %s",
+						strerror(serr->ee_errno));
+				goto end;
+			}
+
+			if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED &&
+					zerocopy->enabled) {
+				DBG("Zero-copy sends to relayd are copied by the kernel, disabling zero-copy");
+				zerocopy->enabled = false;
+			}
+
+			/*
+			 * The notification covers the range of identifiers
+			 * [ee_info, ee_data]. TCP completes the sends in order.
+			 * The identifiers wrap around.
+			 */
+			if ((int32_t) (serr->ee_data + 1 -
+					zerocopy->pending_id) > 0) {
+				zerocopy->pending_id = serr->ee_data + 1;
+			}
+		}
+	}
+end:
+#endif /* HAVE_RELAYD_ZEROCOPY */
+	return ret;
+}
+
+/*
+ * Return whether the kernel no longer references the payload of the zero-copy
+ * send `id`, as of the last reaping of the completions.
+ */
+bool relayd_zerocopy_completed(const struct relayd_zerocopy *zerocopy,
+		uint32_t id)
+{
+	return (int32_t) (id - zerocopy->pending_id) < 0;
+}
+
+/*
+ * Send a data packet, header and payload, with a single sendmsg() call
+ * whenever the socket buffer has room for it.
+ *
+ * When zero-copy is enabled on the socket, the payload is large enough and
+ * `zerocopy_id` is not NULL, the payload is sent with MSG_ZEROCOPY. The
+ * kernel references the pages of every buffer of a zero-copy send after it
+ * returns, so the header is then copied by a separate send with MSG_MORE
+ * and only the payload is sent with MSG_ZEROCOPY. The caller must leave the
+ * payload untouched until relayd_zerocopy_completed() reports the completion
+ * of the send `*zerocopy_id`; the header may be released on return. The
+ * completions already received are reaped before sending, without blocking.
+ *
+ * `zerocopy` may be NULL.
+ *
+ * Returns 0 if the payload was copied, 1 if it was sent with zero-copy, a
+ * negative errno value on error.
+ */
+int relayd_send_data_packet(struct lttcomm_relayd_sock *rsock,
+		const struct lttcomm_relayd_data_hdr *hdr,
+		const void *payload, size_t payload_len,
+		struct relayd_zerocopy *zerocopy, uint32_t *zerocopy_id)
+{
+	int ret, flags = 0;
+	unsigned int send_count = 0;
+	struct iovec iov[] = {
+		{ .iov_base = (void *) hdr, .iov_len = sizeof(*hdr) },
+		{ .iov_base = (void *) payload, .iov_len = payload_len },
+	};
+
+	/* Code flow error. Safety net. */
+	assert(rsock);
+	assert(hdr);
+
+	if (rsock->sock.fd < 0) {
+		return -ECONNRESET;
+	}
+
+#ifdef HAVE_RELAYD_ZEROCOPY
+	if (zerocopy) {
+		ret = relayd_reap_zerocopy_completions(rsock, zerocopy);
+		if (ret) {
+			goto end;
+		}
+		if (zerocopy->enabled && zerocopy_id &&
+				payload_len >= DEFAULT_CONSUMERD_RELAYD_ZEROCOPY_MIN_SIZE) {
+			flags |= MSG_ZEROCOPY;
+		}
+	}
+#endif
+
+	DBG3("Relayd sending data packet of size %zu%s", payload_len,
+			flags ? " with zero-copy" : "");
+
+#ifdef HAVE_RELAYD_ZEROCOPY
+	if (flags) {
+		/* Copy the header: only the payload may outlive this call. */
+		ret = send_iov(rsock, &iov[0], 1, MSG_MORE, NULL);
+		if (ret) {
+			goto end;
+		}
+		ret = send_iov(rsock, &iov[1], 1, flags, &send_count);
+		/* Each successful send is assigned an identifier. */
+		*zerocopy_id = zerocopy->next_id + send_count - 1;
+		zerocopy->next_id += send_count;
+		/*
+		 * The socket is unusable after an error; its buffers are
+		 * released when it is closed.
+		 */
+		if (ret == 0) {
+			ret = 1;
+		}
+		goto end;
+	}
+#endif
+
+	ret = send_iov(rsock, iov, ARRAY_SIZE(iov), 0, NULL);
+
+#ifdef HAVE_RELAYD_ZEROCOPY
+end:
+#endif
+	return ret;
+}
+
+/*
+ * Send a metadata packet, command header, metadata header and payload, with a
+ * single sendmsg() call whenever the socket buffer has room for it.
+ *
+ * Returns 0 on success, a negative errno value on error.
+ */
+int relayd_send_metadata_packet(struct lttcomm_relayd_sock *rsock,
+		const struct lttcomm_relayd_metadata_payload *metadata_hdr,
+		const void *payload, size_t payload_len)
+{
+	struct lttcomm_relayd_hdr hdr;
+	struct iovec iov[] = {
+		{ .iov_base = &hdr, .iov_len = sizeof(hdr) },
+		{ .iov_base = (void *) metadata_hdr, .iov_len = sizeof(*metadata_hdr) },
+		{ .iov_base = (void *) payload, .iov_len = payload_len },
+	};
+
+	/* Code flow error. Safety net. */
+	assert(rsock);
+	assert(metadata_hdr);
+
+	if (rsock->sock.fd < 0) {
+		return -ECONNRESET;
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.cmd = htobe32(RELAYD_SEND_METADATA);
+	hdr.data_size = htobe64(sizeof(*metadata_hdr) + payload_len);
+
+	DBG("Relayd sending metadata packet of size %zu", payload_len);
+
+	return send_iov(rsock, iov, ARRAY_SIZE(iov), 0, NULL);
+}
+
+/*
+ * Allow the data packets sent on a socket to be sent with MSG_ZEROCOPY.
+ *
+ * Returns 0 on success, a negative errno value if the kernel does not
+ * support zero-copy sends.
+ */
+int relayd_enable_zerocopy(struct lttcomm_relayd_sock *rsock,
+		struct relayd_zerocopy *zerocopy)
+{
+	int ret;
+#ifdef HAVE_RELAYD_ZEROCOPY
+	const int enable = 1;
+
+	ret = setsockopt(rsock->sock.fd, SOL_SOCKET, SO_ZEROCOPY, &enable,
+			sizeof(enable));
+	if (ret) {
+		ret = -errno;
+		PERROR("Failed to enable zero-copy on relayd data socket");
+		goto end;
+	}
+	zerocopy->enabled = true;
+	zerocopy->next_id = 0;
+	zerocopy->pending_id = 0;
+	DBG("Zero-copy enabled on relayd data socket %d", rsock->sock.fd);
+end:
+#else
+	WARN("Zero-copy sends to relayd are not supported by this build");
+	ret = -ENOTSUP;
+#endif
+	return ret;
+}
+
 /*
  * Send close stream command to the relayd.
  */
@@ -27,6 +27,15 @@ struct relayd_stream_rotation_position {
 	uint64_t rotate_at_seq_num;
 };
 
+/* MSG_ZEROCOPY state of a relayd data socket. */
+struct relayd_zerocopy {
+	bool enabled;
+	/* Identifier of the completion notification of the next send. */
+	uint32_t next_id;
+	/* Identifier of the oldest send not known to be completed. */
+	uint32_t pending_id;
+};
+
 int relayd_connect(struct lttcomm_relayd_sock *sock);
 int relayd_close(struct lttcomm_relayd_sock *sock);
 int relayd_create_session(struct lttcomm_relayd_sock *rsock,
@@ -50,6 +59,19 @@ int relayd_start_data(struct lttcomm_relayd_sock *sock);
 int relayd_send_metadata(struct lttcomm_relayd_sock *sock, size_t len);
 int relayd_send_data_hdr(struct lttcomm_relayd_sock *sock,
 		struct lttcomm_relayd_data_hdr *hdr, size_t size);
+int relayd_send_data_packet(struct lttcomm_relayd_sock *rsock,
+		const struct lttcomm_relayd_data_hdr *hdr,
+		const void *payload, size_t payload_len,
+		struct relayd_zerocopy *zerocopy, uint32_t *zerocopy_id);
+int relayd_reap_zerocopy_completions(struct lttcomm_relayd_sock *rsock,
+		struct relayd_zerocopy *zerocopy);
+bool relayd_zerocopy_completed(const struct relayd_zerocopy *zerocopy,
+		uint32_t id);
+int relayd_send_metadata_packet(struct lttcomm_relayd_sock *rsock,
+		const struct lttcomm_relayd_metadata_payload *metadata_hdr,
+		const void *payload, size_t payload_len);
+int relayd_enable_zerocopy(struct lttcomm_relayd_sock *rsock,
+		struct relayd_zerocopy *zerocopy);
 int relayd_data_pending(struct lttcomm_relayd_sock *sock, uint64_t stream_id,
 		uint64_t last_net_seq_num);
 int relayd_quiescent_control(struct lttcomm_relayd_sock *sock,
@@ -42,8 +42,17 @@ struct lttcomm_relayd_hdr {
  * lttng-relayd data header.
  */
 struct lttcomm_relayd_data_hdr {
-	/* Circuit ID not used for now so always ignored */
-	uint64_t circuit_id;
+	/*
+	 * Compression of the payload (enum lttng_compression_algorithm).
+	 *
+	 * Along with `uncompressed_size`, this replaces the circuit ID which
+	 * was never used and always sent as 0 (no compression). A consumer
+	 * only compresses packets if the relay daemon advertises the
+	 * algorithm in its configuration flags.
+	 */
+	uint32_t compression;
+	/* Size of the payload once decompressed, 0 if not compressed. */
+	uint32_t uncompressed_size;
 	uint64_t stream_id;     /* Stream ID known by the relayd */
 	uint64_t net_seq_num;   /* Network sequence number, per stream. */
 	uint32_t data_size;     /* data size following this header */
@@ -286,6 +295,10 @@ struct lttcomm_relayd_trace_chunk_exists_reply {
 enum lttcomm_relayd_configuration_flag {
 	/* The relay daemon (2.12) is configured to allow clear operations. */
 	LTTCOMM_RELAYD_CONFIGURATION_FLAG_CLEAR_ALLOWED = (1 << 0),
+	/* The relay daemon decompresses LZ4-compressed data packets. */
+	LTTCOMM_RELAYD_CONFIGURATION_FLAG_COMPRESSION_LZ4 = (1 << 1),
+	/* The relay daemon decompresses zstd-compressed data packets. */
+	LTTCOMM_RELAYD_CONFIGURATION_FLAG_COMPRESSION_ZSTD = (1 << 2),
 };
 
 struct lttcomm_relayd_get_configuration {
@@ -623,6 +623,13 @@ struct lttcomm_consumer_msg {
 			uint64_t target_offset;	/* Offset in the consumer */
 			uint64_t len;	/* Length of metadata to be received. */
 			uint64_t version; /* Version of the metadata. */
+			/*
+			 * The metadata is read from the registry's memory
+			 * file rather than received.
+			 */
+			uint8_t from_shm;
+			/* The memory file is sent after the message. */
+			uint8_t shm_fd_follows;
 		} LTTNG_PACKED push_metadata;
 		struct {
 			uint64_t key;	/* Metadata channel key. */
@@ -189,8 +189,9 @@ static int send_stream_to_thread(struct lttng_consumer_stream *stream,
 		consumer_add_metadata_stream(stream);
 		stream_pipe = ctx->consumer_metadata_pipe;
 	} else {
+		stream->data_thread = consumer_select_data_thread(ctx, stream);
 		consumer_add_data_stream(stream);
-		stream_pipe = ctx->consumer_data_pipe;
+		stream_pipe = stream->data_thread->data_pipe;
 	}
 
 	/*
@@ -1288,12 +1289,31 @@ error_unlock:
  */
 int lttng_ustconsumer_recv_metadata(int sock, uint64_t key, uint64_t offset,
 		uint64_t len, uint64_t version,
-		struct lttng_consumer_channel *channel, int timer, int wait)
+		struct lttng_consumer_channel *channel, int timer, int wait,
+		bool from_shm, bool shm_fd_follows)
 {
-	int ret, ret_code = LTTCOMM_CONSUMERD_SUCCESS;
-	char *metadata_str;
+	int ret, ret_code = LTTCOMM_CONSUMERD_SUCCESS, shm_fd = -1;
+	char *metadata_str = NULL;
+
+	DBG("UST consumer push metadata key %" PRIu64 " of len %" PRIu64 "%s",
+			key, len, from_shm ? " from memory file" : "");
 
-	DBG("UST consumer push metadata key %" PRIu64 " of len %" PRIu64, key, len);
+	if (from_shm) {
+		if (!shm_fd_follows) {
+			goto write_cache;
+		}
+
+		health_code_update();
+
+		/* Receive the session daemon's metadata memory file. */
+		ret = lttcomm_recv_fds_unix_sock(sock, &shm_fd, 1);
+		if (ret != sizeof(shm_fd)) {
+			ERR("Failed to receive metadata memory file");
+			ret_code = ret < 0 ? ret : -1;
+			goto end;
+		}
+		goto write_cache;
+	}
 
 	metadata_str = zmalloc(len * sizeof(char));
 	if (!metadata_str) {
@@ -1312,11 +1332,20 @@ int lttng_ustconsumer_recv_metadata(int sock, uint64_t key, uint64_t offset,
 		goto end_free;
 	}
 
+write_cache:
 	health_code_update();
 
 	pthread_mutex_lock(&channel->metadata_cache->lock);
-	ret = consumer_metadata_cache_write(channel, offset, len, version,
-			metadata_str);
+	if (shm_fd >= 0) {
+		consumer_metadata_cache_set_shm(channel, shm_fd, version);
+	}
+	if (from_shm) {
+		ret = consumer_metadata_cache_write_from_shm(channel, offset,
+				len, version);
+	} else {
+		ret = consumer_metadata_cache_write(channel, offset, len,
+				version, metadata_str);
+	}
 	if (ret < 0) {
 		/* Unable to handle metadata. Notify session daemon. */
 		ret_code = LTTCOMM_CONSUMERD_ERROR_METADATA;
@@ -1330,7 +1359,8 @@ int lttng_ustconsumer_recv_metadata(int sock, uint64_t key, uint64_t offset,
 	}
 	pthread_mutex_unlock(&channel->metadata_cache->lock);
 
-	if (!wait) {
+	/* Nothing was written if the push is stale. */
+	if (!wait || ret == 1) {
 		goto end_free;
 	}
 	while (consumer_metadata_cache_flushed(channel, offset + len, timer)) {
@@ -1762,18 +1792,26 @@ end_get_channel_nosignal:
 
 		health_code_update();
 
-		/* Wait for more data. */
-		health_poll_entry();
-		ret = lttng_consumer_poll_socket(consumer_sockpoll);
-		health_poll_exit();
-		if (ret) {
-			goto error_push_metadata_fatal;
+		/*
+		 * Wait for more data, unless the metadata is read from the
+		 * memory file received previously.
+		 */
+		if (!msg.u.push_metadata.from_shm ||
+				msg.u.push_metadata.shm_fd_follows) {
+			health_poll_entry();
+			ret = lttng_consumer_poll_socket(consumer_sockpoll);
+			health_poll_exit();
+			if (ret) {
+				goto error_push_metadata_fatal;
+			}
 		}
 
 		health_code_update();
 
 		ret = lttng_ustconsumer_recv_metadata(sock, key, offset,
-				len, version, channel, 0, 1);
+				len, version, channel, 0, 1,
+				msg.u.push_metadata.from_shm,
+				msg.u.push_metadata.shm_fd_follows);
 		if (ret < 0) {
 			/* error receiving from sessiond */
 			goto error_push_metadata_fatal;
@@ -2475,6 +2513,8 @@ static
 int commit_one_metadata_packet(struct lttng_consumer_stream *stream)
 {
 	ssize_t write_len;
+	const char *metadata;
+	uint64_t metadata_len;
 	int ret;
 
 	pthread_mutex_lock(&stream->chan->metadata_cache->lock);
@@ -2515,10 +2555,14 @@ int commit_one_metadata_packet(struct lttng_consumer_stream *stream)
 		}
 	}
 
+	/*
+	 * The packet is written from a single chunk of the cache; it is closed
+	 * early when the metadata to push continues in the next chunk.
+	 */
+	metadata = consumer_metadata_cache_get_data(stream->chan->metadata_cache,
+			stream->ust_metadata_pushed, &metadata_len);
 	write_len = ustctl_write_one_packet_to_channel(stream->chan->uchan,
-			&stream->chan->metadata_cache->data[stream->ust_metadata_pushed],
-			stream->chan->metadata_cache->max_offset
-			- stream->ust_metadata_pushed);
+			metadata, metadata_len);
 	assert(write_len != 0);
 	if (write_len < 0) {
 		ERR("Writing one metadata packet");
@@ -2651,17 +2695,19 @@ static int notify_if_more_data(struct lttng_consumer_stream *stream,
 	/* This stream still has data. Flag it and wake up the data thread. */
 	stream->has_data = 1;
 
-	if (stream->monitor && !stream->hangup_flush_done && !ctx->has_wakeup) {
+	if (stream->monitor && !stream->hangup_flush_done &&
+			stream->data_thread && !stream->data_thread->has_wakeup) {
 		ssize_t writelen;
 
-		writelen = lttng_pipe_write(ctx->consumer_wakeup_pipe, "!", 1);
+		writelen = lttng_pipe_write(stream->data_thread->wakeup_pipe,
+				"!", 1);
 		if (writelen < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
 			ret = writelen;
 			goto end;
 		}
 
 		/* The wake up pipe has been notified. */
-		ctx->has_wakeup = 1;
+		stream->data_thread->has_wakeup = 1;
 	}
 	ret = 0;
 
@@ -3297,7 +3343,9 @@ int lttng_ustconsumer_request_metadata(struct lttng_consumer_local_data *ctx,
 	health_code_update();
 
 	ret = lttng_ustconsumer_recv_metadata(ctx->consumer_metadata_socket,
-			key, offset, len, version, channel, timer, wait);
+			key, offset, len, version, channel, timer, wait,
+			msg.u.push_metadata.from_shm,
+			msg.u.push_metadata.shm_fd_follows);
 	if (ret >= 0) {
 		/*
 		 * Only send the status msg if the sessiond is alive meaning a positive
@@ -50,7 +50,8 @@ void lttng_ustconsumer_close_metadata(struct lttng_consumer_channel *metadata);
 void lttng_ustconsumer_close_stream_wakeup(struct lttng_consumer_stream *stream);
 int lttng_ustconsumer_recv_metadata(int sock, uint64_t key, uint64_t offset,
 		uint64_t len, uint64_t version,
-		struct lttng_consumer_channel *channel, int timer, int wait);
+		struct lttng_consumer_channel *channel, int timer, int wait,
+		bool from_shm, bool shm_fd_follows);
 int lttng_ustconsumer_request_metadata(struct lttng_consumer_local_data *ctx,
 		struct lttng_consumer_channel *channel, int timer, int wait);
 enum sync_metadata_status lttng_ustconsumer_sync_metadata(
@@ -199,7 +200,8 @@ void lttng_ustconsumer_close_stream_wakeup(struct lttng_consumer_stream *stream)
 static inline
 int lttng_ustconsumer_recv_metadata(int sock, uint64_t key, uint64_t offset,
 		uint64_t len, uint64_t version,
-		struct lttng_consumer_channel *channel, int timer)
+		struct lttng_consumer_channel *channel, int timer, int wait,
+		bool from_shm, bool shm_fd_follows)
 {
 	return -ENOSYS;
 }
@@ -26,6 +26,7 @@
 #include <common/common.h>
 #include <common/readwrite.h>
 #include <common/runas.h>
+#include <common/compat/fcntl.h>
 #include <common/compat/getenv.h>
 #include <common/compat/string.h>
 #include <common/compat/dirent.h>
@@ -1385,6 +1386,89 @@ end:
 	return ret;
 }
 
+/*
+ * Allocate the storage of a stream file so that it may grow to `size` bytes
+ * without being extended by every write, which fragments the files written
+ * concurrently. The file's size is not changed: its readers only see the
+ * data written.
+ *
+ * The storage is allocated in multiples of `step` bytes. A file limited to
+ * `max_size` bytes (0 if unlimited) is allocated whole.
+ *
+ * `allocated_size` holds the size allocated so far; it is updated on success.
+ * Returns 0 on success, -1 if the storage could not be allocated, with errno
+ * set (e.g. to EOPNOTSUPP if the file system does not support it).
+ */
+LTTNG_HIDDEN
+int utils_preallocate_stream_file(int fd, uint64_t size, uint64_t step,
+		uint64_t max_size, uint64_t *allocated_size)
+{
+	int ret = 0;
+	uint64_t new_allocated_size;
+
+	assert(step > 0);
+
+	if (size <= *allocated_size) {
+		goto end;
+	}
+
+	if (max_size && size <= max_size) {
+		new_allocated_size = max_size;
+	} else {
+		new_allocated_size = ((size + step - 1) / step) * step;
+	}
+
+	ret = lttng_fallocate_keep_size(fd, (off_t) *allocated_size,
+			(off_t) (new_allocated_size - *allocated_size));
+	if (ret) {
+		ret = -1;
+		goto end;
+	}
+	*allocated_size = new_allocated_size;
+end:
+	return ret;
+}
+
+/*
+ * Release the storage allocated past the end of a stream file by
+ * utils_preallocate_stream_file(). Must be called once the file is
+ * complete, before it is closed.
+ */
+LTTNG_HIDDEN
+int utils_release_stream_file_preallocation(int fd, uint64_t *allocated_size)
+{
+	int ret = 0;
+	struct stat file_stat;
+
+	if (*allocated_size == 0) {
+		goto end;
+	}
+
+	ret = fstat(fd, &file_stat);
+	if (ret) {
+		PERROR("Failed to stat stream file to release its preallocated storage");
+		goto end;
+	}
+
+	if ((uint64_t) file_stat.st_size >= *allocated_size) {
+		goto end;
+	}
+
+	/*
+	 * Truncating a file to its size releases the blocks allocated past
+	 * its end, while punching a hole past the end of a file is a no-op on
+	 * some file systems (e.g. ext4).
+	 */
+	ret = ftruncate(fd, file_stat.st_size);
+	if (ret) {
+		PERROR("Failed to truncate stream file to release its preallocated storage");
+		goto end;
+	}
+end:
+	*allocated_size = 0;
+	return ret;
+}
+
 static const char *get_man_bin_path(void)
 {
 	char *env_man_path = lttng_secure_getenv(DEFAULT_MAN_BIN_PATH_ENV);
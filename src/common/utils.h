@@ -50,6 +50,9 @@ char *utils_generate_optstring(const struct option *long_options,
 int utils_create_lock_file(const char *filepath);
 int utils_recursive_rmdir(const char *path);
 int utils_truncate_stream_file(int fd, off_t length);
+int utils_preallocate_stream_file(int fd, uint64_t size, uint64_t step,
+		uint64_t max_size, uint64_t *allocated_size);
+int utils_release_stream_file_preallocation(int fd, uint64_t *allocated_size);
 int utils_show_help(int section, const char *page_name, const char *help_msg);
 int utils_get_memory_available(size_t *value);
 int utils_get_memory_total(size_t *value);
@@ -0,0 +1,317 @@
+/*
+ * Copyright (C) 2020 EfficiOS Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ */
+
+/*
+ * fd-tracker microbenchmark.
+ *
+ * Each thread opens its own tracked files and repeatedly gets and puts their
+ * file descriptors, like the relay daemon does for every packet it writes.
+ * The number of get/put pairs per second is reported.
+ *
+ * When the tracker's capacity is lower than the number of files, the handles
+ * are suspended and restored as the threads cycle through their files, which
+ * exercises the slow path. The threads cycle through their files in
+ * round-robin, the access pattern an LRU policy handles worst; --verbose logs
+ * the tracker's miss rate, restore latency and eviction policy.
+ *
+ * Typical use:
+ *   ./fd_tracker_get_fd -t 8 -f 64 -c 1024
+ *   ./fd_tracker_get_fd -t 8 -f 64 -c 256
+ */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <urcu.h>
+#include <urcu/uatomic.h>
+
+#include <common/common.h>
+#include <common/compat/directory-handle.h>
+#include <common/compat/time.h>
+#include <common/fd-tracker/fd-tracker.h>
+#include <common/fs-handle.h>
+#include <common/time.h>
+
+#define DEFAULT_THREADS			4
+#define DEFAULT_FILES_PER_THREAD	64
+#define DEFAULT_CAPACITY		1024
+#define DEFAULT_DURATION_S		5
+#define TMP_DIR_PATTERN			"/tmp/fd-tracker-bench-XXXXXX"
+#define UNLINKED_DIRECTORY_NAME		"unlinked_files"
+
+/* Required by the common libraries. */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+int lttng_opt_mi;
+
+struct bench_thread {
+	unsigned int id;
+	pthread_t thread;
+	struct fs_handle **handles;
+	uint64_t iterations;
+	int error;
+};
+
+static unsigned int opt_threads = DEFAULT_THREADS;
+static unsigned int opt_files_per_thread = DEFAULT_FILES_PER_THREAD;
+static unsigned int opt_capacity = DEFAULT_CAPACITY;
+static unsigned int opt_duration_s = DEFAULT_DURATION_S;
+
+static struct fd_tracker *tracker;
+static struct lttng_directory_handle *test_directory;
+static char test_directory_path[] = TMP_DIR_PATTERN;
+
+static int bench_ready_count;
+static int bench_start;
+static int bench_stop;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	if (lttng_clock_gettime(CLOCK_MONOTONIC, &ts)) {
+		PERROR("clock_gettime");
+		return 0;
+	}
+	return (uint64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void file_name(char *buf, size_t len, unsigned int thread_id,
+		unsigned int file_id)
+{
+	(void) snprintf(buf, len, "file-%u-%u", thread_id, file_id);
+}
+
+static int open_files(struct bench_thread *thread)
+{
+	unsigned int i;
+	mode_t mode = S_IRUSR | S_IWUSR;
+
+	thread->handles = zmalloc(opt_files_per_thread *
+			sizeof(*thread->handles));
+	if (!thread->handles) {
+		return -1;
+	}
+
+	for (i = 0; i < opt_files_per_thread; i++) {
+		char name[NAME_MAX];
+
+		file_name(name, sizeof(name), thread->id, i);
+		thread->handles[i] = fd_tracker_open_fs_handle(tracker,
+				test_directory, name,
+				O_WRONLY | O_CREAT | O_TRUNC, &mode);
+		if (!thread->handles[i]) {
+			fprintf(stderr, "Thread %u: failed to open %s\n",
+					thread->id, name);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static void close_files(struct bench_thread *thread)
+{
+	unsigned int i;
+
+	if (!thread->handles) {
+		return;
+	}
+
+	for (i = 0; i < opt_files_per_thread; i++) {
+		if (!thread->handles[i]) {
+			continue;
+		}
+		(void) fs_handle_unlink(thread->handles[i]);
+		(void) fs_handle_close(thread->handles[i]);
+	}
+	free(thread->handles);
+}
+
+static void *bench_thread(void *data)
+{
+	unsigned int file = 0;
+	struct bench_thread *thread = data;
+
+	rcu_register_thread();
+	if (open_files(thread)) {
+		thread->error = 1;
+	}
+
+	uatomic_inc(&bench_ready_count);
+	while (!uatomic_read(&bench_start)) {
+		caa_cpu_relax();
+	}
+
+	while (!thread->error && !uatomic_read(&bench_stop)) {
+		struct fs_handle *handle = thread->handles[file];
+
+		if (fs_handle_get_fd(handle) < 0) {
+			fprintf(stderr, "Thread %u: failed to get fd\n",
+					thread->id);
+			thread->error = 1;
+			break;
+		}
+		fs_handle_put_fd(handle);
+		thread->iterations++;
+		file = (file + 1) % opt_files_per_thread;
+	}
+
+	close_files(thread);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void print_usage(const char *progname)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n\n"
+			"  -t, --threads COUNT       Number of threads (default: %u)\n"
+			"  -f, --files COUNT         Number of files per thread (default: %u)\n"
+			"  -c, --capacity COUNT      Capacity of the fd tracker (default: %u)\n"
+			"  -d, --duration SECONDS    Duration of the run (default: %u)\n"
+			"  -v, --verbose             Log the fd tracker's statistics\n",
+			progname, DEFAULT_THREADS, DEFAULT_FILES_PER_THREAD,
+			DEFAULT_CAPACITY, DEFAULT_DURATION_S);
+}
+
+int main(int argc, char **argv)
+{
+	int ret = 0, opt;
+	unsigned int i, launched = 0;
+	uint64_t total_iterations = 0, begin_ns, elapsed_ns;
+	char *unlinked_directory_path = NULL;
+	struct bench_thread *threads = NULL;
+	static const struct option long_options[] = {
+		{ "threads", 1, 0, 't' },
+		{ "files", 1, 0, 'f' },
+		{ "capacity", 1, 0, 'c' },
+		{ "duration", 1, 0, 'd' },
+		{ "verbose", 0, 0, 'v' },
+		{ "help", 0, 0, 'h' },
+		{ NULL, 0, 0, 0 },
+	};
+
+	while ((opt = getopt_long(argc, argv, "t:f:c:d:vh", long_options,
+			NULL)) != -1) {
+		switch (opt) {
+		case 't':
+			opt_threads = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			opt_files_per_thread = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			opt_capacity = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			opt_duration_s = strtoul(optarg, NULL, 0);
+			break;
+		case 'v':
+			lttng_opt_quiet = 0;
+			lttng_opt_verbose = 3;
+			break;
+		case 'h':
+			print_usage(argv[0]);
+			return EXIT_SUCCESS;
+		default:
+			print_usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!opt_threads || !opt_files_per_thread || !opt_capacity ||
+			!opt_duration_s) {
+		print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	rcu_register_thread();
+
+	if (!mkdtemp(test_directory_path)) {
+		PERROR("Failed to create temporary directory");
+		ret = -1;
+		goto end;
+	}
+
+	ret = asprintf(&unlinked_directory_path, "%s/%s", test_directory_path,
+			UNLINKED_DIRECTORY_NAME);
+	if (ret < 0) {
+		unlinked_directory_path = NULL;
+		goto end;
+	}
+
+	tracker = fd_tracker_create(unlinked_directory_path, opt_capacity);
+	test_directory = lttng_directory_handle_create(test_directory_path);
+	threads = calloc(opt_threads, sizeof(*threads));
+	if (!tracker || !test_directory || !threads) {
+		fprintf(stderr, "Failed to initialize the benchmark\n");
+		ret = -1;
+		goto end;
+	}
+
+	for (i = 0; i < opt_threads; i++) {
+		threads[i].id = i;
+		ret = pthread_create(&threads[i].thread, NULL, bench_thread,
+				&threads[i]);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_create");
+			ret = -1;
+			break;
+		}
+		launched++;
+	}
+
+	while (uatomic_read(&bench_ready_count) != launched) {
+		(void) usleep(1000);
+	}
+
+	begin_ns = now_ns();
+	uatomic_set(&bench_start, 1);
+	(void) sleep(opt_duration_s);
+	uatomic_set(&bench_stop, 1);
+	elapsed_ns = now_ns() - begin_ns;
+
+	for (i = 0; i < launched; i++) {
+		(void) pthread_join(threads[i].thread, NULL);
+		if (threads[i].error) {
+			ret = -1;
+		}
+		total_iterations += threads[i].iterations;
+	}
+
+	printf("threads: %u, files: %u, capacity: %u\n", launched,
+			launched * opt_files_per_thread, opt_capacity);
+	printf("get/put: %" PRIu64 " (%.0f/s)%s\n", total_iterations,
+			(double) total_iterations /
+				((double) elapsed_ns / NSEC_PER_SEC),
+			ret ? ", with errors" : "");
+	fd_tracker_log(tracker);
+end:
+	if (tracker && fd_tracker_destroy(tracker)) {
+		ret = -1;
+	}
+	lttng_directory_handle_put(test_directory);
+	if (unlinked_directory_path) {
+		(void) rmdir(unlinked_directory_path);
+	}
+	(void) rmdir(test_directory_path);
+	free(unlinked_directory_path);
+	free(threads);
+	rcu_unregister_thread();
+	return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
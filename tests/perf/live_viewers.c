@@ -0,0 +1,1001 @@
+/*
+ * Copyright (C) 2020 EfficiOS Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ */
+
+/*
+ * Live viewer stress test.
+ *
+ * Attaches a number of synthetic live viewers to a running lttng-relayd and
+ * reports the latency percentiles of their requests. Each viewer owns a
+ * connection, creates a viewer session and attaches to one of the live
+ * sessions served by the relay daemon (a session accepts a single viewer).
+ * The attached viewers then read their streams like a live trace reader
+ * does: they get the next index of each stream, then the packet it
+ * describes, and fetch the metadata whenever the relay daemon reports new
+ * metadata. The viewers that could not attach to a session list the
+ * sessions repeatedly.
+ *
+ * The viewers wait for the think time between two rounds of requests, except
+ * for the "greedy" viewers which issue their requests back-to-back, like a
+ * reader catching up on a backlog. The latencies are only reported for the
+ * non-greedy viewers so that the impact of the greedy viewers on the others
+ * can be measured.
+ *
+ * With --batch, a viewer gets the next index of all its streams with a single
+ * LTTNG_VIEWER_GET_NEXT_INDEXES request, then the packets they describe with
+ * a single LTTNG_VIEWER_GET_PACKETS request.
+ *
+ * With --wait, a viewer which found no new index during a round asks the
+ * relay daemon to wait for new data (LTTNG_VIEWER_WAIT_NEW_DATA) instead of
+ * polling its streams again after the think time.
+ *
+ * Against a relay daemon which does not support these commands, the viewers
+ * fall back to the upstream per-stream requests and polling.
+ *
+ * Typical use:
+ *   lttng-relayd --live-worker-threads=4 &
+ *   (create a few live sessions, e.g. with `lttng create --live`)
+ *   ./live_viewers -n 64 -g 4 -d 10
+ */
+
+#define _LGPL_SOURCE
+#include <assert.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <urcu/uatomic.h>
+
+#include <bin/lttng-relayd/lttng-viewer-abi.h>
+#include <common/common.h>
+#include <common/compat/endian.h>
+#include <common/compat/time.h>
+#include <common/defaults.h>
+#include <common/time.h>
+
+#define DEFAULT_HOSTNAME		"localhost"
+#define DEFAULT_VIEWERS			64
+#define DEFAULT_GREEDY_VIEWERS		0
+#define DEFAULT_DURATION_S		5
+#define DEFAULT_THINK_TIME_US		1000
+#define DEFAULT_WAIT_TIMEOUT_MS		0
+#define MAX_PACKET_READ_SIZE		(1024 * 1024)
+
+/* Required by the common libraries. */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+int lttng_opt_mi;
+
+enum request_type {
+	REQUEST_LIST_SESSIONS,
+	REQUEST_GET_NEXT_INDEX,
+	REQUEST_GET_PACKET,
+	REQUEST_GET_METADATA,
+	REQUEST_WAIT_NEW_DATA,
+	REQUEST_GET_NEXT_INDEXES,
+	REQUEST_GET_PACKETS,
+	REQUEST_TYPE_COUNT,
+};
+
+static const char *request_type_names[] = {
+	[REQUEST_LIST_SESSIONS] = "list_sessions",
+	[REQUEST_GET_NEXT_INDEX] = "get_next_index",
+	[REQUEST_GET_PACKET] = "get_packet",
+	[REQUEST_GET_METADATA] = "get_metadata",
+	[REQUEST_WAIT_NEW_DATA] = "wait_new_data",
+	[REQUEST_GET_NEXT_INDEXES] = "get_next_indexes",
+	[REQUEST_GET_PACKETS] = "get_packets",
+};
+
+/* Latencies of the requests of a given type, in nanoseconds. */
+struct latency_samples {
+	uint64_t *values;
+	size_t count;
+	size_t capacity;
+};
+
+struct viewer_stream {
+	uint64_t id;
+	bool metadata;
+	bool hung_up;
+};
+
+struct viewer {
+	unsigned int id;
+	bool greedy;
+	bool attached;
+	/* No new index was received during the last round of requests. */
+	bool idle;
+	/* enum lttng_viewer_capability supported by the relay daemon. */
+	uint32_t capabilities;
+	uint64_t session_id;
+	pthread_t thread;
+	int sock;
+	struct viewer_stream *streams;
+	unsigned int stream_count;
+	/* Index of the metadata stream in `streams`, -1 if none. */
+	int metadata_stream;
+	char *packet_buffer;
+	/* Batched requests and replies, sized for all the streams. */
+	struct lttng_viewer_stream_index *stream_indexes;
+	struct lttng_viewer_get_packet *packet_requests;
+	struct latency_samples latencies[REQUEST_TYPE_COUNT];
+	uint64_t request_count;
+	int error;
+};
+
+static const char *opt_hostname = DEFAULT_HOSTNAME;
+static unsigned int opt_port = DEFAULT_NETWORK_VIEWER_PORT;
+static unsigned int opt_viewers = DEFAULT_VIEWERS;
+static unsigned int opt_greedy_viewers = DEFAULT_GREEDY_VIEWERS;
+static unsigned int opt_duration_s = DEFAULT_DURATION_S;
+static unsigned int opt_think_time_us = DEFAULT_THINK_TIME_US;
+/* Wait for new data instead of polling when non-zero. */
+static unsigned int opt_wait_timeout_ms = DEFAULT_WAIT_TIMEOUT_MS;
+static bool opt_batch;
+
+static int bench_ready_count;
+static int bench_start;
+static int bench_stop;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	if (lttng_clock_gettime(CLOCK_MONOTONIC, &ts)) {
+		PERROR("clock_gettime");
+		return 0;
+	}
+	return (uint64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static int add_latency(struct latency_samples *samples, uint64_t value)
+{
+	if (samples->count == samples->capacity) {
+		const size_t new_capacity = max_t(size_t, 1024,
+				samples->capacity * 2);
+		uint64_t *new_values;
+
+		new_values = realloc(samples->values,
+				new_capacity * sizeof(*new_values));
+		if (!new_values) {
+			return -1;
+		}
+		samples->values = new_values;
+		samples->capacity = new_capacity;
+	}
+
+	samples->values[samples->count++] = value;
+	return 0;
+}
+
+static ssize_t viewer_recv(struct viewer *viewer, void *buf, size_t len)
+{
+	ssize_t ret;
+	size_t copied = 0;
+
+	do {
+		ret = recv(viewer->sock, (char *) buf + copied, len - copied, 0);
+		if (ret > 0) {
+			copied += ret;
+		}
+	} while ((ret > 0 && copied < len) || (ret < 0 && errno == EINTR));
+
+	return ret > 0 ? (ssize_t) copied : -1;
+}
+
+static ssize_t viewer_send(struct viewer *viewer, const void *buf, size_t len)
+{
+	ssize_t ret;
+
+	do {
+		ret = send(viewer->sock, buf, len, MSG_NOSIGNAL);
+	} while (ret < 0 && errno == EINTR);
+
+	return ret == len ? ret : -1;
+}
+
+static int send_command(struct viewer *viewer, enum lttng_viewer_command command,
+		const void *payload, size_t payload_len)
+{
+	struct lttng_viewer_cmd cmd = {
+		.data_size = htobe64(payload_len),
+		.cmd = htobe32(command),
+		.cmd_version = htobe32(0),
+	};
+
+	if (viewer_send(viewer, &cmd, sizeof(cmd)) < 0) {
+		return -1;
+	}
+	if (payload_len && viewer_send(viewer, payload, payload_len) < 0) {
+		return -1;
+	}
+	return 0;
+}
+
+static int connect_viewer(struct viewer *viewer)
+{
+	int ret;
+	struct hostent *host;
+	struct sockaddr_in addr = {};
+
+	host = gethostbyname(opt_hostname);
+	if (!host) {
+		fprintf(stderr, "Unknown host %s\n", opt_hostname);
+		return -1;
+	}
+
+	viewer->sock = socket(AF_INET, SOCK_STREAM, 0);
+	if (viewer->sock < 0) {
+		PERROR("socket");
+		return -1;
+	}
+
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(opt_port);
+	addr.sin_addr = *((struct in_addr *) host->h_addr);
+	ret = connect(viewer->sock, (struct sockaddr *) &addr, sizeof(addr));
+	if (ret) {
+		PERROR("Failed to connect to the relay daemon's live port");
+		return -1;
+	}
+
+	return 0;
+}
+
+static int establish_session(struct viewer *viewer)
+{
+	const uint32_t capabilities =
+			(opt_batch ? LTTNG_VIEWER_CAPABILITY_BATCH : 0) |
+			(opt_wait_timeout_ms ?
+				LTTNG_VIEWER_CAPABILITY_WAIT_NEW_DATA : 0);
+	struct lttng_viewer_connect connect = {
+		.viewer_session_id = htobe64(
+				LTTNG_VIEWER_CAPABILITIES(capabilities)),
+		.major = htobe32(VERSION_MAJOR),
+		.minor = htobe32(VERSION_MINOR),
+		.type = htobe32(LTTNG_VIEWER_CLIENT_COMMAND),
+	};
+	struct lttng_viewer_create_session_response create_reply;
+
+	if (send_command(viewer, LTTNG_VIEWER_CONNECT, &connect,
+			sizeof(connect)) ||
+			viewer_recv(viewer, &connect, sizeof(connect)) < 0) {
+		fprintf(stderr, "Viewer %u: version handshake failed\n",
+				viewer->id);
+		return -1;
+	}
+
+	/* Fall back to the upstream commands the relay daemon lacks. */
+	viewer->capabilities = be32toh(connect.type) & capabilities;
+	if (viewer->capabilities != capabilities && viewer->id == 0) {
+		fprintf(stderr, "The relay daemon does not support the requested commands, falling back to per-stream%s requests\n",
+				viewer->capabilities &
+					LTTNG_VIEWER_CAPABILITY_WAIT_NEW_DATA ?
+					"" : " polling");
+	}
+
+	if (send_command(viewer, LTTNG_VIEWER_CREATE_SESSION, NULL, 0) ||
+			viewer_recv(viewer, &create_reply,
+				sizeof(create_reply)) < 0 ||
+			be32toh(create_reply.status) !=
+				LTTNG_VIEWER_CREATE_SESSION_OK) {
+		fprintf(stderr, "Viewer %u: failed to create viewer session\n",
+				viewer->id);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * List the sessions. If `session_id` is not NULL, it is set to the ID of
+ * the live session this viewer attempts to attach to, if any.
+ */
+static int list_sessions(struct viewer *viewer, uint64_t *session_id,
+		bool *found)
+{
+	uint32_t i, session_count, live_session_count = 0;
+	struct lttng_viewer_list_sessions list;
+
+	if (send_command(viewer, LTTNG_VIEWER_LIST_SESSIONS, NULL, 0) ||
+			viewer_recv(viewer, &list, sizeof(list)) < 0) {
+		return -1;
+	}
+
+	session_count = be32toh(list.sessions_count);
+	for (i = 0; i < session_count; i++) {
+		struct lttng_viewer_session session;
+
+		if (viewer_recv(viewer, &session, sizeof(session)) < 0) {
+			return -1;
+		}
+
+		if (!session_id || be32toh(session.streams) == 0) {
+			continue;
+		}
+
+		/* Viewer `n` attaches to the n-th session having streams. */
+		if (live_session_count++ == viewer->id) {
+			*session_id = be64toh(session.id);
+			*found = true;
+		}
+	}
+
+	return 0;
+}
+
+static int attach_session(struct viewer *viewer, uint64_t session_id)
+{
+	unsigned int i;
+	struct lttng_viewer_attach_session_request request = {
+		.session_id = htobe64(session_id),
+		.seek = htobe32(LTTNG_VIEWER_SEEK_LAST),
+	};
+	struct lttng_viewer_attach_session_response response;
+
+	if (send_command(viewer, LTTNG_VIEWER_ATTACH_SESSION, &request,
+			sizeof(request)) ||
+			viewer_recv(viewer, &response, sizeof(response)) < 0) {
+		return -1;
+	}
+
+	if (be32toh(response.status) != LTTNG_VIEWER_ATTACH_OK) {
+		/* Another viewer is attached, stick to listing the sessions. */
+		return 0;
+	}
+
+	viewer->attached = true;
+	viewer->session_id = session_id;
+	viewer->stream_count = be32toh(response.streams_count);
+	viewer->streams = calloc(viewer->stream_count,
+			sizeof(*viewer->streams));
+	viewer->stream_indexes = calloc(viewer->stream_count,
+			sizeof(*viewer->stream_indexes));
+	viewer->packet_requests = calloc(viewer->stream_count,
+			sizeof(*viewer->packet_requests));
+	if (!viewer->streams || !viewer->stream_indexes ||
+			!viewer->packet_requests) {
+		return -1;
+	}
+
+	for (i = 0; i < viewer->stream_count; i++) {
+		struct lttng_viewer_stream stream;
+
+		if (viewer_recv(viewer, &stream, sizeof(stream)) < 0) {
+			return -1;
+		}
+		viewer->streams[i].id = be64toh(stream.id);
+		viewer->streams[i].metadata = !!be32toh(stream.metadata_flag);
+		if (viewer->streams[i].metadata) {
+			viewer->metadata_stream = i;
+		}
+	}
+
+	return 0;
+}
+
+static int get_metadata(struct viewer *viewer)
+{
+	struct lttng_viewer_get_metadata request;
+	struct lttng_viewer_metadata_packet reply;
+	uint64_t len;
+
+	if (viewer->metadata_stream < 0) {
+		return 0;
+	}
+
+	request.stream_id = htobe64(
+			viewer->streams[viewer->metadata_stream].id);
+	if (send_command(viewer, LTTNG_VIEWER_GET_METADATA, &request,
+			sizeof(request)) ||
+			viewer_recv(viewer, &reply, sizeof(reply)) < 0) {
+		return -1;
+	}
+
+	if (be32toh(reply.status) != LTTNG_VIEWER_METADATA_OK) {
+		return 0;
+	}
+
+	/* Drain the metadata, its content does not matter here. */
+	len = be64toh(reply.len);
+	while (len > 0) {
+		const size_t chunk = min_t(uint64_t, len, MAX_PACKET_READ_SIZE);
+
+		if (viewer_recv(viewer, viewer->packet_buffer, chunk) < 0) {
+			return -1;
+		}
+		len -= chunk;
+	}
+
+	return 0;
+}
+
+/*
+ * Issue a timed request.
+ */
+#define TIMED_REQUEST(viewer, type, call)				\
+	({								\
+		const uint64_t _begin = now_ns();			\
+		int _ret = (call);					\
+									\
+		if (!_ret && !(viewer)->greedy) {			\
+			_ret = add_latency(&(viewer)->latencies[type],	\
+					now_ns() - _begin);		\
+		}							\
+		(viewer)->request_count++;				\
+		_ret;							\
+	})
+
+static int get_next_index(struct viewer *viewer, struct viewer_stream *stream,
+		struct lttng_viewer_index *index)
+{
+	struct lttng_viewer_get_next_index request = {
+		.stream_id = htobe64(stream->id),
+	};
+
+	if (send_command(viewer, LTTNG_VIEWER_GET_NEXT_INDEX, &request,
+			sizeof(request)) ||
+			viewer_recv(viewer, index, sizeof(*index)) < 0) {
+		return -1;
+	}
+
+	return 0;
+}
+
+static int get_packet(struct viewer *viewer, struct viewer_stream *stream,
+		const struct lttng_viewer_index *index)
+{
+	struct lttng_viewer_get_packet request;
+	struct lttng_viewer_trace_packet reply;
+	const uint64_t packet_size = be64toh(index->packet_size) / CHAR_BIT;
+
+	request.stream_id = htobe64(stream->id);
+	request.offset = index->offset;
+	request.len = htobe32(min_t(uint64_t, packet_size,
+			MAX_PACKET_READ_SIZE));
+	if (send_command(viewer, LTTNG_VIEWER_GET_PACKET, &request,
+			sizeof(request)) ||
+			viewer_recv(viewer, &reply, sizeof(reply)) < 0) {
+		return -1;
+	}
+
+	if (be32toh(reply.status) != LTTNG_VIEWER_GET_PACKET_OK) {
+		return 0;
+	}
+
+	if (be32toh(reply.len) > MAX_PACKET_READ_SIZE ||
+			viewer_recv(viewer, viewer->packet_buffer,
+				be32toh(reply.len)) < 0) {
+		return -1;
+	}
+
+	return 0;
+}
+
+static int wait_new_data(struct viewer *viewer)
+{
+	struct lttng_viewer_wait_new_data_request request = {
+		.session_id = htobe64(viewer->session_id),
+		.timeout_ms = htobe32(opt_wait_timeout_ms),
+	};
+	struct lttng_viewer_wait_new_data_response response;
+
+	if (send_command(viewer, LTTNG_VIEWER_WAIT_NEW_DATA, &request,
+			sizeof(request)) ||
+			viewer_recv(viewer, &response, sizeof(response)) < 0) {
+		return -1;
+	}
+
+	return be32toh(response.status) == LTTNG_VIEWER_WAIT_NEW_DATA_ERR ?
+			-1 : 0;
+}
+
+/*
+ * Read the next packet of each of the viewer's data streams.
+ *
+ * Returns 0 on success, 1 if all streams hung up, -1 on error.
+ */
+static int read_streams(struct viewer *viewer)
+{
+	int ret;
+	unsigned int i, active_streams = 0;
+
+	viewer->idle = true;
+	for (i = 0; i < viewer->stream_count; i++) {
+		struct viewer_stream *stream = &viewer->streams[i];
+		struct lttng_viewer_index index;
+
+		if (stream->metadata || stream->hung_up) {
+			continue;
+		}
+		active_streams++;
+
+		ret = TIMED_REQUEST(viewer, REQUEST_GET_NEXT_INDEX,
+				get_next_index(viewer, stream, &index));
+		if (ret) {
+			return -1;
+		}
+
+		if (be32toh(index.flags) & LTTNG_VIEWER_FLAG_NEW_METADATA) {
+			ret = TIMED_REQUEST(viewer, REQUEST_GET_METADATA,
+					get_metadata(viewer));
+			if (ret) {
+				return -1;
+			}
+		}
+
+		switch (be32toh(index.status)) {
+		case LTTNG_VIEWER_INDEX_OK:
+			viewer->idle = false;
+			ret = TIMED_REQUEST(viewer, REQUEST_GET_PACKET,
+					get_packet(viewer, stream, &index));
+			if (ret) {
+				return -1;
+			}
+			break;
+		case LTTNG_VIEWER_INDEX_HUP:
+		case LTTNG_VIEWER_INDEX_ERR:
+			stream->hung_up = true;
+			break;
+		default:
+			break;
+		}
+	}
+
+	return active_streams ? 0 : 1;
+}
+
+static struct viewer_stream *find_stream(struct viewer *viewer, uint64_t id)
+{
+	unsigned int i;
+
+	for (i = 0; i < viewer->stream_count; i++) {
+		if (viewer->streams[i].id == id) {
+			return &viewer->streams[i];
+		}
+	}
+
+	return NULL;
+}
+
+static int get_next_indexes(struct viewer *viewer, uint32_t *index_count)
+{
+	struct lttng_viewer_get_next_indexes_request request = {
+		.session_id = htobe64(viewer->session_id),
+		/* All the streams of the session. */
+		.stream_count = htobe32(0),
+	};
+	struct lttng_viewer_get_next_indexes_response response;
+
+	if (send_command(viewer, LTTNG_VIEWER_GET_NEXT_INDEXES, &request,
+			sizeof(request)) ||
+			viewer_recv(viewer, &response, sizeof(response)) < 0) {
+		return -1;
+	}
+
+	if (be32toh(response.status) != LTTNG_VIEWER_GET_NEXT_INDEXES_OK) {
+		return -1;
+	}
+
+	*index_count = be32toh(response.index_count);
+	if (*index_count > viewer->stream_count) {
+		/* New streams are not tracked by this benchmark. */
+		fprintf(stderr, "Viewer %u: unexpected index count %" PRIu32 "\n",
+				viewer->id, *index_count);
+		return -1;
+	}
+
+	if (*index_count && viewer_recv(viewer, viewer->stream_indexes,
+			*index_count * sizeof(*viewer->stream_indexes)) < 0) {
+		return -1;
+	}
+
+	return 0;
+}
+
+static int get_packets(struct viewer *viewer, uint32_t packet_count)
+{
+	uint32_t i;
+	struct lttng_viewer_get_packets_request request = {
+		.packet_count = htobe32(packet_count),
+	};
+	struct lttng_viewer_cmd cmd = {
+		.data_size = htobe64(sizeof(request) +
+				packet_count * sizeof(*viewer->packet_requests)),
+		.cmd = htobe32(LTTNG_VIEWER_GET_PACKETS),
+		.cmd_version = htobe32(0),
+	};
+
+	if (viewer_send(viewer, &cmd, sizeof(cmd)) < 0 ||
+			viewer_send(viewer, &request, sizeof(request)) < 0 ||
+			viewer_send(viewer, viewer->packet_requests,
+				packet_count * sizeof(*viewer->packet_requests)) < 0) {
+		return -1;
+	}
+
+	for (i = 0; i < packet_count; i++) {
+		struct lttng_viewer_trace_packet reply;
+
+		if (viewer_recv(viewer, &reply, sizeof(reply)) < 0) {
+			return -1;
+		}
+
+		if (be32toh(reply.status) != LTTNG_VIEWER_GET_PACKET_OK) {
+			continue;
+		}
+
+		if (be32toh(reply.len) > MAX_PACKET_READ_SIZE ||
+				viewer_recv(viewer, viewer->packet_buffer,
+					be32toh(reply.len)) < 0) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Read the next packet of each of the viewer's data streams with batched
+ * requests.
+ *
+ * Returns 0 on success, 1 if all streams hung up, -1 on error.
+ */
+static int read_streams_batched(struct viewer *viewer)
+{
+	int ret;
+	bool new_metadata = false;
+	uint32_t i, index_count, packet_count = 0;
+
+	viewer->idle = true;
+	ret = TIMED_REQUEST(viewer, REQUEST_GET_NEXT_INDEXES,
+			get_next_indexes(viewer, &index_count));
+	if (ret) {
+		return -1;
+	}
+
+	for (i = 0; i < index_count; i++) {
+		const struct lttng_viewer_stream_index *stream_index =
+				&viewer->stream_indexes[i];
+		const struct lttng_viewer_index *index = &stream_index->index;
+		struct viewer_stream *stream;
+
+		stream = find_stream(viewer, be64toh(stream_index->id));
+		if (!stream) {
+			continue;
+		}
+
+		if (be32toh(index->flags) & LTTNG_VIEWER_FLAG_NEW_METADATA) {
+			new_metadata = true;
+		}
+
+		switch (be32toh(index->status)) {
+		case LTTNG_VIEWER_INDEX_OK:
+		{
+			struct lttng_viewer_get_packet *request =
+					&viewer->packet_requests[packet_count++];
+			const uint64_t packet_size =
+					be64toh(index->packet_size) / CHAR_BIT;
+
+			viewer->idle = false;
+			request->stream_id = stream_index->id;
+			request->offset = index->offset;
+			request->len = htobe32(min_t(uint64_t, packet_size,
+					MAX_PACKET_READ_SIZE));
+			break;
+		}
+		case LTTNG_VIEWER_INDEX_HUP:
+		case LTTNG_VIEWER_INDEX_ERR:
+			stream->hung_up = true;
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (new_metadata) {
+		ret = TIMED_REQUEST(viewer, REQUEST_GET_METADATA,
+				get_metadata(viewer));
+		if (ret) {
+			return -1;
+		}
+	}
+
+	if (packet_count) {
+		ret = TIMED_REQUEST(viewer, REQUEST_GET_PACKETS,
+				get_packets(viewer, packet_count));
+		if (ret) {
+			return -1;
+		}
+	}
+
+	return index_count ? 0 : 1;
+}
+
+static void *viewer_thread(void *data)
+{
+	int ret;
+	struct viewer *viewer = data;
+	uint64_t session_id;
+	bool found = false;
+
+	viewer->metadata_stream = -1;
+	viewer->packet_buffer = zmalloc(MAX_PACKET_READ_SIZE);
+	if (!viewer->packet_buffer || connect_viewer(viewer) ||
+			establish_session(viewer) ||
+			list_sessions(viewer, &session_id, &found) ||
+			(found && attach_session(viewer, session_id))) {
+		viewer->error = 1;
+	}
+
+	uatomic_inc(&bench_ready_count);
+	while (!uatomic_read(&bench_start)) {
+		caa_cpu_relax();
+	}
+
+	while (!viewer->error && !uatomic_read(&bench_stop)) {
+		if (viewer->stream_count) {
+			ret = viewer->capabilities &
+						LTTNG_VIEWER_CAPABILITY_BATCH ?
+					read_streams_batched(viewer) :
+					read_streams(viewer);
+			if (ret == 1) {
+				/* The session is gone, fall back to listing. */
+				viewer->stream_count = 0;
+				ret = 0;
+			}
+		} else {
+			ret = TIMED_REQUEST(viewer, REQUEST_LIST_SESSIONS,
+					list_sessions(viewer, NULL, NULL));
+		}
+		if (ret) {
+			fprintf(stderr, "Viewer %u: request failed\n",
+					viewer->id);
+			viewer->error = 1;
+			break;
+		}
+
+		if ((viewer->capabilities &
+					LTTNG_VIEWER_CAPABILITY_WAIT_NEW_DATA) &&
+				viewer->stream_count && viewer->idle) {
+			ret = TIMED_REQUEST(viewer, REQUEST_WAIT_NEW_DATA,
+					wait_new_data(viewer));
+			if (ret) {
+				fprintf(stderr, "Viewer %u: wait for new data failed\n",
+						viewer->id);
+				viewer->error = 1;
+				break;
+			}
+		} else if (!viewer->greedy && opt_think_time_us) {
+			(void) usleep(opt_think_time_us);
+		}
+	}
+
+	if (viewer->sock >= 0) {
+		(void) close(viewer->sock);
+	}
+	free(viewer->packet_buffer);
+	free(viewer->streams);
+	free(viewer->stream_indexes);
+	free(viewer->packet_requests);
+	return NULL;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+	const uint64_t va = *(const uint64_t *) a;
+	const uint64_t vb = *(const uint64_t *) b;
+
+	return va < vb ? -1 : va > vb;
+}
+
+static double percentile_us(const struct latency_samples *samples,
+		double percentile)
+{
+	size_t rank;
+
+	if (!samples->count) {
+		return 0;
+	}
+
+	rank = (size_t) (percentile / 100.0 * (samples->count - 1) + 0.5);
+	return (double) samples->values[rank] / NSEC_PER_USEC;
+}
+
+/*
+ * Merge the latencies of a request type measured by all viewers and print
+ * their percentiles.
+ */
+static int report_latencies(struct viewer *viewers, enum request_type type)
+{
+	unsigned int i;
+	struct latency_samples merged = {};
+
+	for (i = 0; i < opt_viewers; i++) {
+		const struct latency_samples *samples =
+				&viewers[i].latencies[type];
+		size_t j;
+
+		for (j = 0; j < samples->count; j++) {
+			if (add_latency(&merged, samples->values[j])) {
+				free(merged.values);
+				return -1;
+			}
+		}
+	}
+
+	if (!merged.count) {
+		goto end;
+	}
+
+	qsort(merged.values, merged.count, sizeof(*merged.values),
+			compare_u64);
+	printf("%-16s %10zu %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+			request_type_names[type], merged.count,
+			percentile_us(&merged, 50), percentile_us(&merged, 90),
+			percentile_us(&merged, 99),
+			percentile_us(&merged, 99.9),
+			percentile_us(&merged, 100));
+end:
+	free(merged.values);
+	return 0;
+}
+
+static void print_usage(const char *progname)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n\n"
+			"  -H, --host HOST           Relay daemon host (default: %s)\n"
+			"  -P, --port PORT           Relay daemon live port (default: %d)\n"
+			"  -n, --viewers COUNT       Number of viewers (default: %u)\n"
+			"  -g, --greedy COUNT        Number of viewers without think time (default: %u)\n"
+			"  -d, --duration SECONDS    Duration of the run (default: %u)\n"
+			"  -t, --think-time USEC     Think time between two rounds of requests (default: %u)\n"
+			"  -b, --batch               Read the streams with batched requests\n"
+			"  -w, --wait MSEC           Wait for new data, up to MSEC, when idle (default: %u, disabled)\n",
+			progname, DEFAULT_HOSTNAME, DEFAULT_NETWORK_VIEWER_PORT,
+			DEFAULT_VIEWERS, DEFAULT_GREEDY_VIEWERS,
+			DEFAULT_DURATION_S, DEFAULT_THINK_TIME_US,
+			DEFAULT_WAIT_TIMEOUT_MS);
+}
+
+int main(int argc, char **argv)
+{
+	int ret = 0, opt;
+	unsigned int i, launched = 0, attached = 0;
+	uint64_t total_requests = 0, begin_ns, elapsed_ns;
+	struct viewer *viewers;
+	static const struct option long_options[] = {
+		{ "host", 1, 0, 'H' },
+		{ "port", 1, 0, 'P' },
+		{ "viewers", 1, 0, 'n' },
+		{ "greedy", 1, 0, 'g' },
+		{ "duration", 1, 0, 'd' },
+		{ "think-time", 1, 0, 't' },
+		{ "wait", 1, 0, 'w' },
+		{ "batch", 0, 0, 'b' },
+		{ "help", 0, 0, 'h' },
+		{ NULL, 0, 0, 0 },
+	};
+
+	while ((opt = getopt_long(argc, argv, "H:P:n:g:d:t:w:bh", long_options,
+			NULL)) != -1) {
+		switch (opt) {
+		case 'H':
+			opt_hostname = optarg;
+			break;
+		case 'P':
+			opt_port = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			opt_viewers = strtoul(optarg, NULL, 0);
+			break;
+		case 'g':
+			opt_greedy_viewers = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			opt_duration_s = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			opt_think_time_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			opt_wait_timeout_ms = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			opt_batch = true;
+			break;
+		case 'h':
+			print_usage(argv[0]);
+			return EXIT_SUCCESS;
+		default:
+			print_usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!opt_viewers || opt_greedy_viewers > opt_viewers ||
+			!opt_duration_s || !opt_port || opt_port > 65535) {
+		print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	viewers = calloc(opt_viewers, sizeof(*viewers));
+	if (!viewers) {
+		PERROR("calloc");
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < opt_viewers; i++) {
+		viewers[i].id = i;
+		viewers[i].sock = -1;
+		/* The greedy viewers attach to the first sessions. */
+		viewers[i].greedy = i < opt_greedy_viewers;
+		ret = pthread_create(&viewers[i].thread, NULL, viewer_thread,
+				&viewers[i]);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_create");
+			ret = -1;
+			break;
+		}
+		launched++;
+	}
+
+	while (uatomic_read(&bench_ready_count) != launched) {
+		(void) usleep(1000);
+	}
+
+	begin_ns = now_ns();
+	uatomic_set(&bench_start, 1);
+	(void) sleep(opt_duration_s);
+	uatomic_set(&bench_stop, 1);
+	elapsed_ns = now_ns() - begin_ns;
+
+	for (i = 0; i < launched; i++) {
+		(void) pthread_join(viewers[i].thread, NULL);
+		if (viewers[i].error) {
+			ret = -1;
+		}
+		if (viewers[i].attached) {
+			attached++;
+		}
+		total_requests += viewers[i].request_count;
+	}
+
+	printf("viewers: %u (%u greedy, %u attached to a session)\n",
+			launched, opt_greedy_viewers, attached);
+	printf("requests: %" PRIu64 " (%.0f/s)%s\n\n", total_requests,
+			(double) total_requests /
+				((double) elapsed_ns / NSEC_PER_SEC),
+			ret ? ", with errors" : "");
+	printf("%-16s %10s %10s %10s %10s %10s %10s\n", "request (us)",
+			"count", "p50", "p90", "p99", "p99.9", "max");
+	for (i = 0; i < REQUEST_TYPE_COUNT; i++) {
+		if (report_latencies(viewers, i)) {
+			fprintf(stderr, "Failed to merge the latencies\n");
+			ret = -1;
+			break;
+		}
+	}
+
+	for (i = 0; i < opt_viewers; i++) {
+		unsigned int j;
+
+		for (j = 0; j < REQUEST_TYPE_COUNT; j++) {
+			free(viewers[i].latencies[j].values);
+		}
+	}
+	free(viewers);
+	return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,766 @@
+/*
+ * Copyright (C) 2020 EfficiOS Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ */
+
+/*
+ * Relay daemon ingest benchmark.
+ *
+ * Simulates a number of consumer daemons streaming trace packets to a
+ * running lttng-relayd and reports the aggregate throughput (MB/s) for an
+ * increasing number of simulated consumers. Each simulated consumer owns a
+ * control and a data connection, creates its own (snapshot) session to
+ * avoid the generation of indexes, and sends fixed-size packets round-robin
+ * on its streams for the requested duration.
+ *
+ * The packets are sent either as the consumer daemon used to send them (a
+ * header, then the payload), with a single vectored sendmsg(), or with a
+ * single vectored sendmsg() using MSG_ZEROCOPY. Along with the throughput,
+ * the number of packets sent per second of CPU time consumed by the
+ * simulated consumers is reported to compare the per-packet cost of the send
+ * modes.
+ *
+ * The packets can also be compressed before they are sent, as the consumer
+ * daemon does when it streams with compression. The throughput is then
+ * reported both in uncompressed terms and in terms of bytes on the wire. By
+ * default, the payload is made of synthetic event records; a recorded trace
+ * file (e.g. a CTF stream file) gives a more realistic compression ratio.
+ *
+ * Typical use:
+ *   lttng-relayd -o /tmp/bench-out --worker-threads=4 &
+ *   ./relayd_ingest -c 256 -d 5
+ *   ./relayd_ingest -c 8 -p 4096 -m split
+ *   ./relayd_ingest -c 8 -p 4096 -m vectored
+ *   ./relayd_ingest -c 8 -z lz4 -i /tmp/trace/ust/uid/1000/64-bit/channel0_0
+ */
+
+#define _LGPL_SOURCE
+#include <assert.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <urcu/uatomic.h>
+
+#include <common/common.h>
+#include <common/compat/endian.h>
+#include <common/compat/time.h>
+#include <common/compression.h>
+#include <common/relayd/relayd.h>
+#include <common/sessiond-comm/inet.h>
+#include <common/sessiond-comm/relayd.h>
+#include <common/sessiond-comm/sessiond-comm.h>
+#include <common/time.h>
+#include <common/trace-chunk.h>
+#include <common/uri.h>
+
+/*
+ * Protocol 2.10 is used since the relay daemon then manages an anonymous
+ * trace chunk for the session, sparing the benchmark the trace chunk
+ * negotiation performed by the session daemon.
+ */
+#define BENCH_RELAYD_PROTOCOL_MINOR	10
+#define DEFAULT_RELAYD_URL		"net://localhost"
+#define DEFAULT_MAX_CONSUMERS		64
+#define DEFAULT_STREAMS_PER_CONSUMER	4
+#define DEFAULT_PACKET_SIZE		(256 * 1024)
+#define DEFAULT_DURATION_S		5
+#define DEFAULT_SEND_MODE		SEND_MODE_VECTORED
+/* Seed of the synthetic payload, for reproducible compression ratios. */
+#define SYNTHETIC_PAYLOAD_SEED		42
+
+/* Required by the common libraries. */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+int lttng_opt_mi;
+
+enum send_mode {
+	/* Header and payload sent separately. */
+	SEND_MODE_SPLIT,
+	/* Header and payload sent with a single sendmsg(). */
+	SEND_MODE_VECTORED,
+	/* Same as SEND_MODE_VECTORED, with MSG_ZEROCOPY. */
+	SEND_MODE_ZEROCOPY,
+};
+
+static const char *send_mode_names[] = {
+	[SEND_MODE_SPLIT] = "split",
+	[SEND_MODE_VECTORED] = "vectored",
+	[SEND_MODE_ZEROCOPY] = "zerocopy",
+};
+
+struct bench_consumer {
+	unsigned int id;
+	pthread_t thread;
+	struct lttcomm_relayd_sock *control_sock;
+	struct lttcomm_relayd_sock *data_sock;
+	struct relayd_zerocopy zerocopy;
+	struct lttng_compression_context *compression;
+	char *compressed_payload;
+	size_t compressed_payload_capacity;
+	uint64_t *stream_ids;
+	uint64_t *next_net_seq_nums;
+	/* Bytes sent, counting the packets' uncompressed size. */
+	uint64_t bytes_sent;
+	uint64_t wire_bytes_sent;
+	uint64_t packets_sent;
+	int error;
+};
+
+static const char *opt_url = DEFAULT_RELAYD_URL;
+static unsigned int opt_max_consumers = DEFAULT_MAX_CONSUMERS;
+static unsigned int opt_streams_per_consumer = DEFAULT_STREAMS_PER_CONSUMER;
+static unsigned int opt_packet_size = DEFAULT_PACKET_SIZE;
+static unsigned int opt_duration_s = DEFAULT_DURATION_S;
+static enum send_mode opt_send_mode = DEFAULT_SEND_MODE;
+static enum lttng_compression_algorithm opt_compression;
+static const char *opt_input_path;
+
+static struct lttng_uri *relayd_uris;
+static char *packet_payload;
+
+static int bench_ready_count;
+static int bench_start;
+static int bench_stop;
+
+static struct lttcomm_relayd_sock *connect_relayd(struct lttng_uri *uri)
+{
+	int ret;
+	struct lttcomm_relayd_sock *rsock;
+
+	rsock = lttcomm_alloc_relayd_sock(uri, RELAYD_VERSION_COMM_MAJOR,
+			BENCH_RELAYD_PROTOCOL_MINOR);
+	if (!rsock) {
+		goto error;
+	}
+
+	ret = relayd_connect(rsock);
+	if (ret < 0) {
+		fprintf(stderr, "Failed to connect to relay daemon\n");
+		goto error_free;
+	}
+
+	return rsock;
+
+error_free:
+	free(rsock);
+error:
+	return NULL;
+}
+
+static void disconnect_relayd(struct lttcomm_relayd_sock *rsock)
+{
+	if (!rsock) {
+		return;
+	}
+	(void) relayd_close(rsock);
+	free(rsock);
+}
+
+static int setup_consumer(struct bench_consumer *consumer,
+		struct lttng_trace_chunk *chunk)
+{
+	int ret;
+	unsigned int i;
+	uint64_t relayd_session_id;
+	char session_name[LTTNG_NAME_MAX];
+	char output_path[LTTNG_PATH_MAX] = {};
+	const lttng_uuid nil_uuid = {};
+
+	consumer->control_sock = connect_relayd(&relayd_uris[0]);
+	consumer->data_sock = connect_relayd(&relayd_uris[1]);
+	if (!consumer->control_sock || !consumer->data_sock) {
+		ret = -1;
+		goto end;
+	}
+
+	ret = relayd_version_check(consumer->control_sock);
+	if (ret) {
+		fprintf(stderr, "Relay daemon version check failed\n");
+		ret = -1;
+		goto end;
+	}
+	consumer->data_sock->minor = consumer->control_sock->minor;
+
+	if (opt_send_mode == SEND_MODE_ZEROCOPY) {
+		ret = relayd_enable_zerocopy(consumer->data_sock,
+				&consumer->zerocopy);
+		if (ret) {
+			fprintf(stderr, "Failed to enable zero-copy sends\n");
+			goto end;
+		}
+	}
+
+	if (opt_compression != LTTNG_COMPRESSION_ALGORITHM_NONE) {
+		consumer->compression = lttng_compression_context_create(
+				opt_compression);
+		consumer->compressed_payload_capacity = lttng_compression_bound(
+				opt_compression, opt_packet_size);
+		consumer->compressed_payload = zmalloc(
+				consumer->compressed_payload_capacity);
+		if (!consumer->compression || !consumer->compressed_payload) {
+			fprintf(stderr, "Failed to set up the compression\n");
+			ret = -1;
+			goto end;
+		}
+	}
+
+	ret = snprintf(session_name, sizeof(session_name),
+			"relayd-ingest-%d-%u", (int) getpid(), consumer->id);
+	if (ret < 0 || ret >= sizeof(session_name)) {
+		ret = -1;
+		goto end;
+	}
+
+	/* Snapshot sessions don't expect indexes for their packets. */
+	ret = relayd_create_session(consumer->control_sock,
+			&relayd_session_id, session_name, "bench", NULL, 0, 1,
+			0, nil_uuid, NULL, time(NULL), false, output_path);
+	if (ret) {
+		fprintf(stderr, "Failed to create relay daemon session\n");
+		goto end;
+	}
+
+	consumer->stream_ids = calloc(opt_streams_per_consumer,
+			sizeof(*consumer->stream_ids));
+	consumer->next_net_seq_nums = calloc(opt_streams_per_consumer,
+			sizeof(*consumer->next_net_seq_nums));
+	if (!consumer->stream_ids || !consumer->next_net_seq_nums) {
+		ret = -1;
+		goto end;
+	}
+
+	for (i = 0; i < opt_streams_per_consumer; i++) {
+		char channel_name[32];
+
+		ret = snprintf(channel_name, sizeof(channel_name),
+				"channel0_%u", i);
+		if (ret < 0 || ret >= sizeof(channel_name)) {
+			ret = -1;
+			goto end;
+		}
+
+		ret = relayd_add_stream(consumer->control_sock, channel_name,
+				"ust", session_name, &consumer->stream_ids[i],
+				0, 0, chunk);
+		if (ret) {
+			fprintf(stderr, "Failed to add relay daemon stream\n");
+			goto end;
+		}
+	}
+
+	ret = relayd_streams_sent(consumer->control_sock);
+end:
+	return ret;
+}
+
+static void teardown_consumer(struct bench_consumer *consumer)
+{
+	unsigned int i;
+
+	if (consumer->stream_ids && consumer->control_sock &&
+			!consumer->error) {
+		for (i = 0; i < opt_streams_per_consumer; i++) {
+			(void) relayd_send_close_stream(consumer->control_sock,
+					consumer->stream_ids[i],
+					consumer->next_net_seq_nums[i] - 1);
+		}
+	}
+
+	disconnect_relayd(consumer->data_sock);
+	disconnect_relayd(consumer->control_sock);
+	free(consumer->stream_ids);
+	free(consumer->next_net_seq_nums);
+	lttng_compression_context_destroy(consumer->compression);
+	free(consumer->compressed_payload);
+}
+
+static int send_packet(struct bench_consumer *consumer, unsigned int stream_idx)
+{
+	int ret;
+	struct lttcomm_relayd_data_hdr hdr = {};
+	struct lttcomm_sock *sock = &consumer->data_sock->sock;
+	const char *payload = packet_payload;
+	size_t payload_len = opt_packet_size;
+
+	hdr.stream_id = htobe64(consumer->stream_ids[stream_idx]);
+	hdr.net_seq_num = htobe64(consumer->next_net_seq_nums[stream_idx]);
+	hdr.data_size = htobe32(opt_packet_size);
+
+	if (consumer->compression &&
+			opt_packet_size <= DEFAULT_NETWORK_RELAYD_COMPRESSED_PACKET_MAX_SIZE) {
+		ssize_t compressed_len;
+
+		compressed_len = lttng_compression_context_compress(
+				consumer->compression, packet_payload,
+				opt_packet_size, consumer->compressed_payload,
+				consumer->compressed_payload_capacity);
+		if (compressed_len < 0) {
+			ret = -1;
+			goto end;
+		}
+
+		/* Like the consumer daemon, send incompressible packets as is. */
+		if (compressed_len < opt_packet_size) {
+			hdr.compression = htobe32(opt_compression);
+			hdr.uncompressed_size = htobe32(opt_packet_size);
+			hdr.data_size = htobe32(compressed_len);
+			payload = consumer->compressed_payload;
+			payload_len = compressed_len;
+		}
+	}
+
+	switch (opt_send_mode) {
+	case SEND_MODE_SPLIT:
+		ret = relayd_send_data_hdr(consumer->data_sock, &hdr,
+				sizeof(hdr));
+		if (ret < 0) {
+			goto end;
+		}
+
+		ret = sock->ops->sendmsg(sock, payload, payload_len, 0);
+		if (ret < (int) payload_len) {
+			ret = -1;
+			goto end;
+		}
+		break;
+	case SEND_MODE_VECTORED:
+	case SEND_MODE_ZEROCOPY:
+	{
+		uint32_t zerocopy_id;
+
+		/* The payload is never modified: don't track the completions. */
+		ret = relayd_send_data_packet(consumer->data_sock, &hdr,
+				payload, payload_len, &consumer->zerocopy,
+				&zerocopy_id);
+		if (ret < 0) {
+			goto end;
+		}
+		break;
+	}
+	default:
+		abort();
+	}
+
+	consumer->next_net_seq_nums[stream_idx]++;
+	consumer->bytes_sent += sizeof(hdr) + opt_packet_size;
+	consumer->wire_bytes_sent += sizeof(hdr) + payload_len;
+	consumer->packets_sent++;
+	ret = 0;
+end:
+	return ret;
+}
+
+static void *consumer_thread(void *data)
+{
+	int ret;
+	unsigned int stream_idx = 0;
+	struct bench_consumer *consumer = data;
+	struct lttng_trace_chunk *chunk;
+
+	chunk = lttng_trace_chunk_create_anonymous();
+	if (!chunk) {
+		consumer->error = 1;
+		goto ready;
+	}
+
+	ret = setup_consumer(consumer, chunk);
+	if (ret) {
+		consumer->error = 1;
+	}
+ready:
+	uatomic_inc(&bench_ready_count);
+	while (!uatomic_read(&bench_start)) {
+		caa_cpu_relax();
+	}
+
+	while (!consumer->error && !uatomic_read(&bench_stop)) {
+		ret = send_packet(consumer, stream_idx);
+		if (ret) {
+			fprintf(stderr, "Failed to send packet to relay daemon\n");
+			consumer->error = 1;
+			break;
+		}
+		stream_idx = (stream_idx + 1) % opt_streams_per_consumer;
+	}
+
+	teardown_consumer(consumer);
+	lttng_trace_chunk_put(chunk);
+	return NULL;
+}
+
+static uint64_t timespec_to_ns(const struct timespec *ts)
+{
+	return (uint64_t) ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec;
+}
+
+static uint64_t rusage_cpu_ns(const struct rusage *usage)
+{
+	return ((uint64_t) usage->ru_utime.tv_sec +
+			(uint64_t) usage->ru_stime.tv_sec) * NSEC_PER_SEC +
+			((uint64_t) usage->ru_utime.tv_usec +
+			(uint64_t) usage->ru_stime.tv_usec) * NSEC_PER_USEC;
+}
+
+static int run_bench(unsigned int consumer_count)
+{
+	int ret = 0;
+	unsigned int i, launched = 0;
+	struct bench_consumer *consumers;
+	struct timespec begin, end;
+	struct rusage begin_usage, end_usage;
+	uint64_t total_bytes = 0, total_wire_bytes = 0, total_packets = 0;
+	uint64_t elapsed_ns, cpu_ns;
+	double mb_per_s, wire_mb_per_s, packets_per_s, packets_per_cpu_s;
+
+	consumers = calloc(consumer_count, sizeof(*consumers));
+	if (!consumers) {
+		return -1;
+	}
+
+	uatomic_set(&bench_ready_count, 0);
+	uatomic_set(&bench_start, 0);
+	uatomic_set(&bench_stop, 0);
+
+	for (i = 0; i < consumer_count; i++) {
+		consumers[i].id = i;
+		ret = pthread_create(&consumers[i].thread, NULL,
+				consumer_thread, &consumers[i]);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_create");
+			ret = -1;
+			break;
+		}
+		launched++;
+	}
+
+	while (uatomic_read(&bench_ready_count) != launched) {
+		(void) usleep(1000);
+	}
+
+	ret = lttng_clock_gettime(CLOCK_MONOTONIC, &begin);
+	if (ret) {
+		PERROR("clock_gettime");
+	}
+	/* The CPU time of the simulated consumers is that of the process. */
+	ret = getrusage(RUSAGE_SELF, &begin_usage);
+	if (ret) {
+		PERROR("getrusage");
+	}
+	uatomic_set(&bench_start, 1);
+	(void) sleep(opt_duration_s);
+	uatomic_set(&bench_stop, 1);
+	ret = lttng_clock_gettime(CLOCK_MONOTONIC, &end);
+	if (ret) {
+		PERROR("clock_gettime");
+	}
+
+	for (i = 0; i < launched; i++) {
+		(void) pthread_join(consumers[i].thread, NULL);
+		if (consumers[i].error) {
+			ret = -1;
+		}
+		total_bytes += consumers[i].bytes_sent;
+		total_wire_bytes += consumers[i].wire_bytes_sent;
+		total_packets += consumers[i].packets_sent;
+	}
+	if (getrusage(RUSAGE_SELF, &end_usage)) {
+		PERROR("getrusage");
+	}
+
+	elapsed_ns = timespec_to_ns(&end) - timespec_to_ns(&begin);
+	cpu_ns = rusage_cpu_ns(&end_usage) - rusage_cpu_ns(&begin_usage);
+	mb_per_s = ((double) total_bytes / (1024.0 * 1024.0)) /
+			((double) elapsed_ns / NSEC_PER_SEC);
+	wire_mb_per_s = ((double) total_wire_bytes / (1024.0 * 1024.0)) /
+			((double) elapsed_ns / NSEC_PER_SEC);
+	packets_per_s = (double) total_packets /
+			((double) elapsed_ns / NSEC_PER_SEC);
+	packets_per_cpu_s = cpu_ns ? (double) total_packets /
+			((double) cpu_ns / NSEC_PER_SEC) : 0;
+	printf("%10u %12u %14" PRIu64 " %12.2f %12.2f %12.0f %14.0f%s\n",
+			consumer_count,
+			consumer_count * opt_streams_per_consumer,
+			total_packets, mb_per_s, wire_mb_per_s, packets_per_s,
+			packets_per_cpu_s, ret ? " (errors)" : "");
+	fflush(stdout);
+
+	free(consumers);
+	return ret;
+}
+
+static int parse_send_mode(const char *str)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(send_mode_names); i++) {
+		if (!strcmp(str, send_mode_names[i])) {
+			opt_send_mode = i;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * Fill the payload with event records resembling those of a CTF stream: a
+ * small set of event IDs, increasing timestamps and mostly small integer
+ * fields.
+ */
+static void fill_synthetic_payload(char *payload, size_t len)
+{
+	struct synthetic_record {
+		uint32_t id;
+		uint64_t timestamp;
+		uint32_t cpu_id;
+		uint64_t counter;
+		uint64_t value;
+	} LTTNG_PACKED record = {};
+	unsigned int seed = SYNTHETIC_PAYLOAD_SEED;
+	size_t offset;
+
+	for (offset = 0; offset < len; offset += sizeof(record)) {
+		record.id = rand_r(&seed) % 8;
+		record.timestamp += 100 + rand_r(&seed) % 1000;
+		record.cpu_id = 3;
+		record.counter++;
+		record.value = rand_r(&seed) % 65536;
+		memcpy(payload + offset, &record,
+				min_t(size_t, sizeof(record), len - offset));
+	}
+}
+
+/*
+ * Fill the payload with the content of a file, repeated as needed.
+ */
+static int load_payload(const char *path, char *payload, size_t len)
+{
+	int ret = 0;
+	size_t offset = 0;
+	FILE *file;
+
+	file = fopen(path, "r");
+	if (!file) {
+		PERROR("Failed to open %s", path);
+		return -1;
+	}
+
+	while (offset < len) {
+		size_t read_len;
+
+		read_len = fread(payload + offset, 1, len - offset, file);
+		if (read_len == 0) {
+			if (ferror(file) || offset == 0) {
+				fprintf(stderr, "Failed to read %s\n", path);
+				ret = -1;
+				break;
+			}
+			rewind(file);
+		}
+		offset += read_len;
+	}
+
+	if (fclose(file)) {
+		PERROR("Failed to close %s", path);
+	}
+	return ret;
+}
+
+/*
+ * Check that the relay daemon decompresses the packets. The simulated
+ * consumers speak protocol 2.10, which predates the configuration query,
+ * hence the separate connection.
+ */
+static int check_relayd_compression(void)
+{
+	int ret;
+	uint64_t flags = 0, required_flag;
+	struct lttcomm_relayd_sock *rsock;
+
+	switch (opt_compression) {
+	case LTTNG_COMPRESSION_ALGORITHM_NONE:
+		return 0;
+	case LTTNG_COMPRESSION_ALGORITHM_LZ4:
+		required_flag = LTTCOMM_RELAYD_CONFIGURATION_FLAG_COMPRESSION_LZ4;
+		break;
+	case LTTNG_COMPRESSION_ALGORITHM_ZSTD:
+		required_flag = LTTCOMM_RELAYD_CONFIGURATION_FLAG_COMPRESSION_ZSTD;
+		break;
+	default:
+		abort();
+	}
+
+	rsock = lttcomm_alloc_relayd_sock(&relayd_uris[0],
+			RELAYD_VERSION_COMM_MAJOR, RELAYD_VERSION_COMM_MINOR);
+	if (!rsock) {
+		return -1;
+	}
+
+	ret = relayd_connect(rsock);
+	if (ret < 0) {
+		fprintf(stderr, "Failed to connect to relay daemon\n");
+		free(rsock);
+		return -1;
+	}
+
+	ret = relayd_version_check(rsock);
+	if (!ret) {
+		ret = relayd_get_configuration(rsock, 0, &flags);
+	}
+	if (!ret && !(flags & required_flag)) {
+		fprintf(stderr, "The relay daemon does not support %s compression\n",
+				lttng_compression_algorithm_str(opt_compression));
+		ret = -1;
+	}
+
+	disconnect_relayd(rsock);
+	return ret ? -1 : 0;
+}
+
+static void print_usage(const char *progname)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n\n"
+			"  -u, --url URL             Relay daemon URL (default: %s)\n"
+			"  -c, --consumers COUNT     Maximal number of simulated consumers (default: %u)\n"
+			"  -s, --streams COUNT       Streams per simulated consumer (default: %u)\n"
+			"  -p, --packet-size SIZE    Packet size in bytes (default: %u)\n"
+			"  -d, --duration SECONDS    Duration of each run (default: %u)\n"
+			"  -m, --send-mode MODE      split, vectored or zerocopy (default: %s)\n"
+			"  -z, --compression ALGO    none, lz4 or zstd (default: none)\n"
+			"  -i, --input FILE          Fill the packets with the content of FILE\n"
+			"                            (default: synthetic event records)\n\n"
+			"The benchmark is run for 1, 2, 4, ... simulated consumers up to the\n"
+			"maximal number of consumers.\n",
+			progname, DEFAULT_RELAYD_URL, DEFAULT_MAX_CONSUMERS,
+			DEFAULT_STREAMS_PER_CONSUMER, DEFAULT_PACKET_SIZE,
+			DEFAULT_DURATION_S, send_mode_names[DEFAULT_SEND_MODE]);
+}
+
+int main(int argc, char **argv)
+{
+	int ret, opt;
+	ssize_t uri_count;
+	unsigned int consumer_count;
+	static const struct option long_options[] = {
+		{ "url", 1, 0, 'u' },
+		{ "consumers", 1, 0, 'c' },
+		{ "streams", 1, 0, 's' },
+		{ "packet-size", 1, 0, 'p' },
+		{ "duration", 1, 0, 'd' },
+		{ "send-mode", 1, 0, 'm' },
+		{ "compression", 1, 0, 'z' },
+		{ "input", 1, 0, 'i' },
+		{ "help", 0, 0, 'h' },
+		{ NULL, 0, 0, 0 },
+	};
+
+	while ((opt = getopt_long(argc, argv, "u:c:s:p:d:m:z:i:h", long_options,
+			NULL)) != -1) {
+		switch (opt) {
+		case 'u':
+			opt_url = optarg;
+			break;
+		case 'c':
+			opt_max_consumers = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			opt_streams_per_consumer = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			opt_packet_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			opt_duration_s = strtoul(optarg, NULL, 0);
+			break;
+		case 'm':
+			if (parse_send_mode(optarg)) {
+				print_usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'z':
+			if (lttng_compression_algorithm_from_string(optarg,
+					&opt_compression)) {
+				print_usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			if (!lttng_compression_algorithm_is_supported(
+					opt_compression)) {
+				fprintf(stderr, "%s compression is not supported by this build\n",
+						optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'i':
+			opt_input_path = optarg;
+			break;
+		case 'h':
+			print_usage(argv[0]);
+			return EXIT_SUCCESS;
+		default:
+			print_usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!opt_max_consumers || !opt_streams_per_consumer ||
+			!opt_packet_size || !opt_duration_s) {
+		print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	uri_count = uri_parse_str_urls(opt_url, NULL, &relayd_uris);
+	if (uri_count != 2) {
+		fprintf(stderr, "Invalid relay daemon URL: %s\n", opt_url);
+		return EXIT_FAILURE;
+	}
+
+	packet_payload = zmalloc(opt_packet_size);
+	if (!packet_payload) {
+		PERROR("zmalloc");
+		ret = -1;
+		goto end;
+	}
+	if (opt_input_path) {
+		ret = load_payload(opt_input_path, packet_payload,
+				opt_packet_size);
+		if (ret) {
+			goto end;
+		}
+	} else {
+		fill_synthetic_payload(packet_payload, opt_packet_size);
+	}
+
+	lttcomm_init();
+	lttcomm_inet_init();
+
+	ret = check_relayd_compression();
+	if (ret) {
+		goto end;
+	}
+
+	printf("%10s %12s %14s %12s %12s %12s %14s\n", "consumers", "streams",
+			"packets", "MB/s", "wire MB/s", "packets/s",
+			"packets/cpu-s");
+	for (consumer_count = 1; consumer_count <= opt_max_consumers;
+			consumer_count *= 2) {
+		ret = run_bench(consumer_count);
+		if (ret) {
+			break;
+		}
+	}
+end:
+	free(packet_payload);
+	uri_free(relayd_uris);
+	return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,385 @@
+/*
+ * Copyright (C) 2020 EfficiOS Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ */
+
+/*
+ * Trace file read-back benchmark.
+ *
+ * Writes a set of trace files concurrently, one packet per file in
+ * round-robin, like the consumer and relay daemons do for the streams of a
+ * session. The files are written twice: first growing with their writes,
+ * then with their storage preallocated in steps of --preallocation bytes.
+ * For each layout, the number of extents per file and the throughput at
+ * which the files are read back, from the disk, are reported.
+ *
+ * The files are created in --directory, which must be on the file system
+ * being evaluated (i.e. not a tmpfs).
+ *
+ * Typical use:
+ *   ./trace_file_readback -d /var/tmp -s 128 -f 32M
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#endif
+
+#include <common/common.h>
+#include <common/compat/fcntl.h>
+#include <common/compat/time.h>
+#include <common/readwrite.h>
+#include <common/time.h>
+#include <common/utils.h>
+
+#define DEFAULT_DIRECTORY		"."
+#define DEFAULT_STREAMS			64
+#define DEFAULT_FILE_SIZE		(16 * 1024 * 1024)
+#define DEFAULT_PACKET_SIZE		(16 * 1024)
+#define DEFAULT_PREALLOCATION		(4 * 1024 * 1024)
+#define READ_BUFFER_SIZE		(1024 * 1024)
+
+/* Required by the common libraries. */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+int lttng_opt_mi;
+
+static const char *opt_directory = DEFAULT_DIRECTORY;
+static unsigned int opt_streams = DEFAULT_STREAMS;
+static uint64_t opt_file_size = DEFAULT_FILE_SIZE;
+static uint64_t opt_packet_size = DEFAULT_PACKET_SIZE;
+static uint64_t opt_preallocation = DEFAULT_PREALLOCATION;
+
+struct layout_result {
+	double write_s;
+	double read_s;
+	double extents_per_file;
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	if (lttng_clock_gettime(CLOCK_MONOTONIC, &ts)) {
+		PERROR("clock_gettime");
+		return 0;
+	}
+	return (uint64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void file_path(char *buf, size_t len, unsigned int stream)
+{
+	(void) snprintf(buf, len, "%s/readback-stream-%u", opt_directory,
+			stream);
+}
+
+/* Returns the number of extents of a file, or -1 if unknown. */
+static int64_t file_extent_count(int fd)
+{
+#ifdef FS_IOC_FIEMAP
+	struct fiemap fiemap = {};
+
+	fiemap.fm_length = FIEMAP_MAX_OFFSET;
+	fiemap.fm_flags = FIEMAP_FLAG_SYNC;
+	/* With no extent buffer, the extents are only counted. */
+	fiemap.fm_extent_count = 0;
+	if (ioctl(fd, FS_IOC_FIEMAP, &fiemap)) {
+		return -1;
+	}
+	return fiemap.fm_mapped_extents;
+#else
+	return -1;
+#endif
+}
+
+static void close_files(int *fds)
+{
+	unsigned int i;
+
+	for (i = 0; i < opt_streams; i++) {
+		char path[PATH_MAX];
+
+		if (fds[i] < 0) {
+			continue;
+		}
+		(void) close(fds[i]);
+		fds[i] = -1;
+		file_path(path, sizeof(path), i);
+		(void) unlink(path);
+	}
+}
+
+static int write_files(int *fds, uint64_t preallocation, double *write_s)
+{
+	int ret = 0;
+	unsigned int i;
+	uint64_t written, begin_ns;
+	uint64_t *allocated_sizes = NULL;
+	char *packet = NULL;
+
+	allocated_sizes = zmalloc(opt_streams * sizeof(*allocated_sizes));
+	packet = malloc(opt_packet_size);
+	if (!allocated_sizes || !packet) {
+		ret = -1;
+		goto end;
+	}
+	memset(packet, 0x42, opt_packet_size);
+
+	for (i = 0; i < opt_streams; i++) {
+		char path[PATH_MAX];
+
+		file_path(path, sizeof(path), i);
+		fds[i] = open(path, O_RDWR | O_CREAT | O_TRUNC,
+				S_IRUSR | S_IWUSR);
+		if (fds[i] < 0) {
+			PERROR("Failed to create %s", path);
+			ret = -1;
+			goto end;
+		}
+	}
+
+	begin_ns = now_ns();
+	for (written = 0; written < opt_file_size;
+			written += opt_packet_size) {
+		for (i = 0; i < opt_streams; i++) {
+			if (preallocation && utils_preallocate_stream_file(
+					fds[i], written + opt_packet_size,
+					preallocation, 0,
+					&allocated_sizes[i])) {
+				PERROR("Failed to preallocate trace file");
+				ret = -1;
+				goto end;
+			}
+			if (lttng_write(fds[i], packet, opt_packet_size) !=
+					(ssize_t) opt_packet_size) {
+				PERROR("Failed to write trace file");
+				ret = -1;
+				goto end;
+			}
+		}
+	}
+
+	for (i = 0; i < opt_streams; i++) {
+		if (utils_release_stream_file_preallocation(fds[i],
+				&allocated_sizes[i]) || fsync(fds[i])) {
+			ret = -1;
+			goto end;
+		}
+	}
+	*write_s = (double) (now_ns() - begin_ns) / NSEC_PER_SEC;
+end:
+	free(allocated_sizes);
+	free(packet);
+	return ret;
+}
+
+static int read_files(int *fds, double *read_s, double *extents_per_file)
+{
+	int ret = 0;
+	unsigned int i;
+	int64_t extents = 0;
+	uint64_t begin_ns;
+	char *buffer;
+
+	buffer = malloc(READ_BUFFER_SIZE);
+	if (!buffer) {
+		return -1;
+	}
+
+	for (i = 0; i < opt_streams; i++) {
+		const int64_t file_extents = file_extent_count(fds[i]);
+
+		extents = file_extents < 0 || extents < 0 ?
+				-1 : extents + file_extents;
+		/* The files are read back from the disk. */
+		ret = posix_fadvise(fds[i], 0, 0, POSIX_FADV_DONTNEED);
+		if (ret) {
+			errno = ret;
+			PERROR("Failed to drop trace file from the page cache");
+			ret = -1;
+			goto end;
+		}
+	}
+	*extents_per_file = extents < 0 ? -1.0 :
+			(double) extents / opt_streams;
+
+	begin_ns = now_ns();
+	for (i = 0; i < opt_streams; i++) {
+		off_t offset = 0;
+
+		for (;;) {
+			const ssize_t read_ret = pread(fds[i], buffer,
+					READ_BUFFER_SIZE, offset);
+
+			if (read_ret < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				PERROR("Failed to read trace file");
+				ret = -1;
+				goto end;
+			} else if (read_ret == 0) {
+				break;
+			}
+			offset += read_ret;
+		}
+
+		if ((uint64_t) offset != opt_file_size) {
+			fprintf(stderr, "Trace file %u holds %" PRIu64
+					" bytes instead of %" PRIu64 "\n",
+					i, (uint64_t) offset, opt_file_size);
+			ret = -1;
+			goto end;
+		}
+	}
+	*read_s = (double) (now_ns() - begin_ns) / NSEC_PER_SEC;
+end:
+	free(buffer);
+	return ret;
+}
+
+static int run_layout(uint64_t preallocation, struct layout_result *result)
+{
+	int ret;
+	unsigned int i;
+	int *fds;
+
+	fds = malloc(opt_streams * sizeof(*fds));
+	if (!fds) {
+		return -1;
+	}
+	for (i = 0; i < opt_streams; i++) {
+		fds[i] = -1;
+	}
+
+	ret = write_files(fds, preallocation, &result->write_s);
+	if (ret) {
+		goto end;
+	}
+	ret = read_files(fds, &result->read_s, &result->extents_per_file);
+end:
+	close_files(fds);
+	free(fds);
+	return ret;
+}
+
+static void print_result(const char *name, const struct layout_result *result)
+{
+	const double total_mib = (double) opt_file_size * opt_streams /
+			(1024 * 1024);
+
+	printf("%-14s write: %8.1f MiB/s, read back: %8.1f MiB/s, ",
+			name, total_mib / result->write_s,
+			total_mib / result->read_s);
+	if (result->extents_per_file < 0) {
+		printf("extents per file: unknown\n");
+	} else {
+		printf("extents per file: %.1f\n", result->extents_per_file);
+	}
+}
+
+static void print_usage(const char *progname)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n\n"
+			"  -d, --directory PATH         Directory of the trace files (default: %s)\n"
+			"  -s, --streams COUNT          Number of trace files written concurrently (default: %u)\n"
+			"  -f, --file-size SIZE         Size of each trace file (default: %u)\n"
+			"  -p, --packet-size SIZE       Size of the packets (default: %u)\n"
+			"  -P, --preallocation SIZE     Preallocation step of the trace files (default: %u)\n",
+			progname, DEFAULT_DIRECTORY, DEFAULT_STREAMS,
+			DEFAULT_FILE_SIZE, DEFAULT_PACKET_SIZE,
+			DEFAULT_PREALLOCATION);
+}
+
+int main(int argc, char **argv)
+{
+	int ret = 0, opt;
+	struct layout_result fragmented, preallocated;
+	static const struct option long_options[] = {
+		{ "directory", 1, 0, 'd' },
+		{ "streams", 1, 0, 's' },
+		{ "file-size", 1, 0, 'f' },
+		{ "packet-size", 1, 0, 'p' },
+		{ "preallocation", 1, 0, 'P' },
+		{ "help", 0, 0, 'h' },
+		{ NULL, 0, 0, 0 },
+	};
+
+	while ((opt = getopt_long(argc, argv, "d:s:f:p:P:h", long_options,
+			NULL)) != -1) {
+		switch (opt) {
+		case 'd':
+			opt_directory = optarg;
+			break;
+		case 's':
+			opt_streams = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			ret = utils_parse_size_suffix(optarg, &opt_file_size);
+			break;
+		case 'p':
+			ret = utils_parse_size_suffix(optarg, &opt_packet_size);
+			break;
+		case 'P':
+			ret = utils_parse_size_suffix(optarg,
+					&opt_preallocation);
+			break;
+		case 'h':
+			print_usage(argv[0]);
+			return EXIT_SUCCESS;
+		default:
+			print_usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+		if (ret) {
+			print_usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!opt_streams || !opt_packet_size || !opt_preallocation ||
+			opt_file_size < opt_packet_size ||
+			opt_file_size % opt_packet_size) {
+		fprintf(stderr, "The file size must be a multiple of the packet size\n");
+		print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	ret = run_layout(0, &fragmented);
+	if (ret) {
+		goto end;
+	}
+	ret = run_layout(opt_preallocation, &preallocated);
+	if (ret) {
+		goto end;
+	}
+
+	printf("streams: %u, file size: %" PRIu64 ", packet size: %" PRIu64
+			", preallocation: %" PRIu64 "\n",
+			opt_streams, opt_file_size, opt_packet_size,
+			opt_preallocation);
+	print_result("fragmented", &fragmented);
+	print_result("preallocated", &preallocated);
+end:
+	if (ret) {
+		fprintf(stderr, "Benchmark failed; the file system of %s may not support preallocation\n",
+				opt_directory);
+	}
+	return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2020 EfficiOS Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ */
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <common/common.h>
+#include <common/defaults.h>
+#include <common/consumer/consumer.h>
+#include <common/consumer/consumer-metadata-cache.h>
+
+#include <tap/tap.h>
+
+#define NUM_TESTS		10
+/* Spans several chunks of the cache. */
+#define METADATA_SIZE		(8 * DEFAULT_METADATA_CACHE_CHUNK_SIZE + 123)
+#define MAX_APPEND_LEN		97
+/* One append in OVERLAP_PERIOD rewrites the end of the cached metadata. */
+#define OVERLAP_PERIOD		16
+#define GAP_LEN			4096
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+int lttng_opt_mi;
+
+/* Defined by the consumer daemon, referenced by libconsumer. */
+struct health_app *health_consumerd;
+
+static char metadata[METADATA_SIZE];
+
+static void init_metadata(void)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(metadata); i++) {
+		metadata[i] = 'a' + (i * 7 + i / 13) % 26;
+	}
+}
+
+static int cache_write(struct lttng_consumer_channel *channel,
+		uint64_t offset, uint64_t len, uint64_t version)
+{
+	int ret;
+
+	pthread_mutex_lock(&channel->metadata_cache->lock);
+	ret = consumer_metadata_cache_write(channel, offset, len, version,
+			metadata + offset);
+	pthread_mutex_unlock(&channel->metadata_cache->lock);
+	return ret;
+}
+
+/*
+ * Compare the metadata cached in [offset, offset + len) with `expected`,
+ * reading it as the metadata thread does, without crossing a chunk.
+ */
+static bool cache_matches(struct lttng_consumer_channel *channel,
+		uint64_t offset, const char *expected, uint64_t len)
+{
+	bool match = true;
+	struct consumer_metadata_cache *cache = channel->metadata_cache;
+
+	pthread_mutex_lock(&cache->lock);
+	while (len) {
+		uint64_t span_len;
+		const char *span = consumer_metadata_cache_get_data(cache,
+				offset, &span_len);
+
+		if (span_len == 0 || span_len > DEFAULT_METADATA_CACHE_CHUNK_SIZE ||
+				(offset % DEFAULT_METADATA_CACHE_CHUNK_SIZE) +
+				span_len > DEFAULT_METADATA_CACHE_CHUNK_SIZE) {
+			diag("Span of %" PRIu64 " bytes at offset %" PRIu64
+					" crosses a chunk", span_len, offset);
+			match = false;
+			break;
+		}
+		span_len = min_t(uint64_t, span_len, len);
+		if (memcmp(span, expected, span_len)) {
+			diag("Mismatch in the %" PRIu64 " bytes at offset %" PRIu64,
+					span_len, offset);
+			match = false;
+			break;
+		}
+		offset += span_len;
+		expected += span_len;
+		len -= span_len;
+	}
+	pthread_mutex_unlock(&cache->lock);
+	return match;
+}
+
+static void test_small_appends(struct lttng_consumer_channel *channel)
+{
+	int ret = 0;
+	uint64_t offset = 0;
+	unsigned int appends = 0;
+
+	srand(42);
+	while (offset < sizeof(metadata)) {
+		const uint64_t len = min_t(uint64_t,
+				1 + rand() % MAX_APPEND_LEN,
+				sizeof(metadata) - offset);
+		uint64_t write_offset = offset;
+
+		if (++appends % OVERLAP_PERIOD == 0) {
+			/* Overlapping updates must be contiguous. */
+			write_offset -= min_t(uint64_t, offset,
+					rand() % MAX_APPEND_LEN);
+		}
+		ret = cache_write(channel, write_offset,
+				offset + len - write_offset, 1);
+		if (ret) {
+			break;
+		}
+		offset += len;
+	}
+	ok(!ret, "Push %u small appends of metadata", appends);
+	ok(channel->metadata_cache->max_offset == sizeof(metadata),
+			"Max offset is the size of the metadata");
+	ok(channel->metadata_cache->chunk_count ==
+			(sizeof(metadata) + DEFAULT_METADATA_CACHE_CHUNK_SIZE - 1) /
+				DEFAULT_METADATA_CACHE_CHUNK_SIZE,
+			"Only the chunks holding the metadata are allocated");
+	ok(cache_matches(channel, 0, metadata, sizeof(metadata)),
+			"Cached metadata matches the appended metadata");
+}
+
+static void test_version_change(struct lttng_consumer_channel *channel)
+{
+	char zeroes[GAP_LEN] = {};
+	const uint64_t chunk_count = channel->metadata_cache->chunk_count;
+
+	ok(!cache_write(channel, 0, MAX_APPEND_LEN, 2) &&
+			channel->metadata_cache->max_offset == MAX_APPEND_LEN,
+			"Version change resets the cache");
+	ok(channel->metadata_cache->chunk_count == chunk_count,
+			"Chunks are kept across versions");
+	ok(cache_matches(channel, 0, metadata, MAX_APPEND_LEN),
+			"Cached metadata matches the metadata of the new version");
+
+	ok(!cache_write(channel, MAX_APPEND_LEN + GAP_LEN, MAX_APPEND_LEN, 2),
+			"Write past the max offset");
+	ok(cache_matches(channel, MAX_APPEND_LEN, zeroes, GAP_LEN) &&
+			cache_matches(channel, MAX_APPEND_LEN + GAP_LEN,
+				metadata + MAX_APPEND_LEN + GAP_LEN,
+				MAX_APPEND_LEN),
+			"Metadata of the previous version is not exposed");
+}
+
+int main(void)
+{
+	int ret;
+	struct lttng_consumer_channel channel = {};
+
+	plan_tests(NUM_TESTS);
+
+	init_metadata();
+	ret = consumer_metadata_cache_allocate(&channel);
+	ok(!ret, "Allocate the metadata cache");
+	if (ret) {
+		goto end;
+	}
+
+	test_small_appends(&channel);
+	test_version_change(&channel);
+
+	consumer_metadata_cache_destroy(&channel);
+end:
+	return exit_status();
+}
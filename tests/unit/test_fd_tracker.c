@@ -33,11 +33,15 @@ int lttng_opt_verbose;
 int lttng_opt_mi;
 
 /* Number of TAP tests in this file */
-#define NUM_TESTS 61
+#define NUM_TESTS 66
 /* 3 for stdin, stdout, and stderr */
 #define STDIO_FD_COUNT 3
 #define TRACKER_FD_LIMIT 50
 #define TMP_DIR_PATTERN "/tmp/fd-tracker-XXXXXX"
+/* Files accessed by the eviction policy tests. */
+#define ACCESS_PATTERN_FILE_COUNT (TRACKER_FD_LIMIT * 4)
+/* Accesses before the eviction policy is checked, in passes over the files. */
+#define ACCESS_PATTERN_WARMUP_PASSES 32
 #define TEST_UNLINK_DIRECTORY_NAME "unlinked_files"
 
 /*
@@ -740,6 +744,200 @@ end:
 	free(unlinked_files_directory);
 }
 
+typedef unsigned int (*next_handle_cb)(unsigned int access_index);
+
+static
+unsigned int next_handle_round_robin(unsigned int access_index)
+{
+	return access_index % ACCESS_PATTERN_FILE_COUNT;
+}
+
+/* Every other access is to the first file, the others are random. */
+static
+unsigned int next_handle_random_hot(unsigned int access_index)
+{
+	return access_index % 2 ?
+			1 + rand() % (ACCESS_PATTERN_FILE_COUNT - 1) : 0;
+}
+
+static
+int access_handle(struct fs_handle *handle, bool mark)
+{
+	int fd;
+
+	fd = fs_handle_get_fd(handle);
+	if (fd < 0) {
+		goto end;
+	}
+	/*
+	 * A restored handle is reopened without the flags set on its
+	 * previous file descriptor.
+	 */
+	if (mark && fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK)) {
+		fd = -1;
+	}
+	fs_handle_put_fd(handle);
+end:
+	return fd;
+}
+
+/*
+ * Access the files following `next_handle`, mark the file descriptors used
+ * during one pass over the files and report, in `kept`, which files kept
+ * their marked file descriptor during the four passes that follow.
+ */
+static
+int run_access_pattern(next_handle_cb next_handle, bool *kept)
+{
+	int ret;
+	const unsigned int pass = ACCESS_PATTERN_FILE_COUNT;
+	unsigned int i, access_index = 0;
+	struct fd_tracker *tracker;
+	char *output_files[ACCESS_PATTERN_FILE_COUNT];
+	struct fs_handle *handles[ACCESS_PATTERN_FILE_COUNT];
+	int marked_fds[ACCESS_PATTERN_FILE_COUNT];
+	ino_t marked_inos[ACCESS_PATTERN_FILE_COUNT];
+	struct lttng_directory_handle *dir_handle = NULL;
+	char *test_directory = NULL, *unlinked_files_directory = NULL;
+
+	memset(output_files, 0, sizeof(output_files));
+	memset(handles, 0, sizeof(handles));
+	for (i = 0; i < ACCESS_PATTERN_FILE_COUNT; i++) {
+		marked_fds[i] = -1;
+		kept[i] = false;
+	}
+
+	get_temporary_directories(&test_directory, &unlinked_files_directory);
+
+	tracker = fd_tracker_create(unlinked_files_directory, TRACKER_FD_LIMIT);
+	if (!tracker) {
+		ret = -1;
+		goto end;
+	}
+
+	dir_handle = lttng_directory_handle_create(test_directory);
+	assert(dir_handle);
+
+	ret = open_files(tracker, dir_handle, ACCESS_PATTERN_FILE_COUNT,
+			handles, output_files);
+	if (ret) {
+		goto end_cleanup;
+	}
+
+	for (i = 0; i < ACCESS_PATTERN_WARMUP_PASSES * pass; i++) {
+		ret = access_handle(handles[next_handle(access_index++)],
+				false);
+		if (ret < 0) {
+			goto end_cleanup;
+		}
+	}
+
+	for (i = 0; i < pass; i++) {
+		struct stat fd_stat;
+		const unsigned int handle_index = next_handle(access_index++);
+
+		ret = access_handle(handles[handle_index], true);
+		if (ret < 0) {
+			goto end_cleanup;
+		}
+		marked_fds[handle_index] = ret;
+		ret = fstat(marked_fds[handle_index], &fd_stat);
+		assert(!ret);
+		marked_inos[handle_index] = fd_stat.st_ino;
+	}
+
+	for (i = 0; i < 4 * pass; i++) {
+		ret = access_handle(handles[next_handle(access_index++)],
+				false);
+		if (ret < 0) {
+			goto end_cleanup;
+		}
+	}
+	ret = 0;
+
+	/*
+	 * The file descriptor of a suspended handle may have been reused by
+	 * another handle: check that it still refers to the same file.
+	 */
+	for (i = 0; i < ACCESS_PATTERN_FILE_COUNT; i++) {
+		struct stat fd_stat;
+		int flags;
+
+		if (marked_fds[i] < 0 || fstat(marked_fds[i], &fd_stat) ||
+				fd_stat.st_ino != marked_inos[i]) {
+			continue;
+		}
+		flags = fcntl(marked_fds[i], F_GETFL);
+		kept[i] = flags >= 0 && (flags & O_NONBLOCK);
+	}
+
+end_cleanup:
+	if (cleanup_files(tracker, test_directory, ACCESS_PATTERN_FILE_COUNT,
+			handles, output_files)) {
+		ret = -1;
+	}
+	if (rmdir(test_directory)) {
+		ret = -1;
+	}
+	fd_tracker_destroy(tracker);
+	lttng_directory_handle_put(dir_handle);
+end:
+	free(test_directory);
+	free(unlinked_files_directory);
+	return ret;
+}
+
+static
+unsigned int count_kept(const bool *kept, unsigned int first)
+{
+	unsigned int i, count = 0;
+
+	for (i = first; i < ACCESS_PATTERN_FILE_COUNT; i++) {
+		count += kept[i];
+	}
+	return count;
+}
+
+/*
+ * Round-robin accesses over more files than the tracker's capacity make
+ * every access suspend a handle with an LRU policy. The tracker must detect
+ * it and keep a stable set of handles active.
+ */
+static
+void test_suspendable_round_robin(void)
+{
+	int ret;
+	bool kept[ACCESS_PATTERN_FILE_COUNT];
+
+	ret = run_access_pattern(next_handle_round_robin, kept);
+	ok(!ret, "Accessed %d files in round-robin with a limit of %d simultaneously-opened file descriptors",
+			ACCESS_PATTERN_FILE_COUNT, TRACKER_FD_LIMIT);
+	ok(count_kept(kept, 0) >= TRACKER_FD_LIMIT / 2,
+			"A stable set of handles is kept active during round-robin accesses (%u handles)",
+			count_kept(kept, 0));
+}
+
+/*
+ * Random accesses must not be mistaken for a cyclic pattern: the least
+ * recently used handles are suspended and a handle that is accessed often
+ * is never suspended.
+ */
+static
+void test_suspendable_random(void)
+{
+	int ret;
+	bool kept[ACCESS_PATTERN_FILE_COUNT];
+
+	srand(42);
+	ret = run_access_pattern(next_handle_random_hot, kept);
+	ok(!ret, "Accessed %d files randomly with a limit of %d simultaneously-opened file descriptors",
+			ACCESS_PATTERN_FILE_COUNT, TRACKER_FD_LIMIT);
+	ok(kept[0], "The frequently accessed handle is never suspended");
+	ok(count_kept(kept, 1) <= TRACKER_FD_LIMIT / 4,
+			"No stable set of handles is kept active during random accesses (%u handles)",
+			count_kept(kept, 1));
+}
+
 static
 void test_unlink(void)
 {
@@ -900,6 +1098,10 @@ int main(int argc, char **argv)
 	test_suspendable_limit();
 	diag("Suspendable - restoration test");
 	test_suspendable_restore();
+	diag("Suspendable - round-robin access pattern");
+	test_suspendable_round_robin();
+	diag("Suspendable - random access pattern");
+	test_suspendable_random();
 
 	diag("Mixed - check that file descriptor limit is enforced");
 	test_mixed_limit();
@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2020 EfficiOS Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <common/common.h>
+#include <common/compat/directory-handle.h>
+#include <common/compat/endian.h>
+#include <common/defaults.h>
+#include <common/index/index.h>
+#include <common/trace-chunk.h>
+#include <tap/tap.h>
+
+#define TEST_COUNT		12
+#define ENTRY_COUNT		1000
+#define STREAM_NAME		"stream"
+#define FIRST_TIMESTAMP		1000
+#define TIMESTAMP_STEP		100
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+int lttng_opt_mi;
+
+static char test_dir[] = "/tmp/test_index_file_view.XXXXXX";
+
+static struct lttng_trace_chunk *create_chunk(void)
+{
+	struct lttng_trace_chunk *chunk;
+	struct lttng_directory_handle *handle = NULL;
+
+	chunk = lttng_trace_chunk_create_anonymous();
+	if (!chunk) {
+		goto error;
+	}
+
+	handle = lttng_directory_handle_create(test_dir);
+	if (!handle ||
+			lttng_trace_chunk_set_credentials_current_user(chunk) !=
+				LTTNG_TRACE_CHUNK_STATUS_OK ||
+			lttng_trace_chunk_set_as_owner(chunk, handle) !=
+				LTTNG_TRACE_CHUNK_STATUS_OK ||
+			lttng_trace_chunk_create_subdirectory(chunk,
+				DEFAULT_INDEX_DIR) !=
+				LTTNG_TRACE_CHUNK_STATUS_OK) {
+		goto error;
+	}
+	lttng_directory_handle_put(handle);
+	return chunk;
+
+error:
+	lttng_directory_handle_put(handle);
+	lttng_trace_chunk_put(chunk);
+	return NULL;
+}
+
+/*
+ * Packet `i` begins at FIRST_TIMESTAMP + i * TIMESTAMP_STEP and has sequence
+ * number 2 * i.
+ */
+static int write_index_file(struct lttng_trace_chunk *chunk)
+{
+	int ret = 0;
+	uint64_t i;
+	struct lttng_index_file *index_file;
+
+	if (lttng_index_file_create_from_trace_chunk(chunk, "", STREAM_NAME,
+			0, 0, CTF_INDEX_MAJOR, CTF_INDEX_MINOR, false,
+			&index_file) != LTTNG_TRACE_CHUNK_STATUS_OK) {
+		return -1;
+	}
+
+	for (i = 0; i < ENTRY_COUNT; i++) {
+		struct ctf_packet_index element = {};
+
+		element.offset = htobe64(i * 4096);
+		element.packet_size = htobe64(4096 * CHAR_BIT);
+		element.content_size = htobe64(4096 * CHAR_BIT);
+		element.timestamp_begin = htobe64(FIRST_TIMESTAMP +
+				i * TIMESTAMP_STEP);
+		element.timestamp_end = htobe64(FIRST_TIMESTAMP +
+				(i + 1) * TIMESTAMP_STEP - 1);
+		element.packet_seq_num = htobe64(2 * i);
+		ret = lttng_index_file_write(index_file, &element);
+		if (ret) {
+			break;
+		}
+	}
+
+	lttng_index_file_put(index_file);
+	return ret;
+}
+
+static void test_view(struct lttng_trace_chunk *chunk)
+{
+	int ret;
+	uint64_t position = 0, count;
+	struct lttng_index_file *index_file;
+	struct lttng_index_file_view view;
+	struct ctf_packet_index elements[10];
+
+	if (lttng_index_file_create_from_trace_chunk_read_only(chunk, "",
+			STREAM_NAME, 0, 0, CTF_INDEX_MAJOR, CTF_INDEX_MINOR,
+			false, &index_file) != LTTNG_TRACE_CHUNK_STATUS_OK) {
+		fail("Open index file read-only");
+		return;
+	}
+
+	ret = lttng_index_file_view_map(index_file, &view);
+	/* The view outlives the index file. */
+	lttng_index_file_put(index_file);
+	ok(ret == 0, "Map index file");
+	if (ret) {
+		return;
+	}
+
+	ok(lttng_index_file_view_get_count(&view) == ENTRY_COUNT,
+			"View holds all the entries");
+
+	ret = lttng_index_file_view_find_timestamp(&view,
+			FIRST_TIMESTAMP - 1, &position);
+	ok(ret == -1, "No packet covers a timestamp before the first packet");
+
+	ret = lttng_index_file_view_find_timestamp(&view, FIRST_TIMESTAMP,
+			&position);
+	ok(ret == 0 && position == 0, "Find the first packet by timestamp");
+
+	ret = lttng_index_file_view_find_timestamp(&view,
+			FIRST_TIMESTAMP + 42 * TIMESTAMP_STEP + 1, &position);
+	ok(ret == 0 && position == 42, "Find the packet covering a timestamp");
+
+	ret = lttng_index_file_view_find_timestamp(&view, UINT64_MAX,
+			&position);
+	ok(ret == 0 && position == ENTRY_COUNT - 1,
+			"Find the last packet by timestamp");
+
+	ret = lttng_index_file_view_find_seq_num(&view, 2 * 123, &position);
+	ok(ret == 0 && position == 123, "Find a packet by sequence number");
+
+	ret = lttng_index_file_view_find_seq_num(&view, 2 * 123 + 1,
+			&position);
+	ok(ret == -1, "Missing sequence number is not found");
+
+	ret = lttng_index_file_view_find_seq_num(&view, 2 * ENTRY_COUNT,
+			&position);
+	ok(ret == -1, "Sequence number past the last packet is not found");
+
+	count = lttng_index_file_view_read(&view, 500, elements, 10);
+	ok(count == 10 && be64toh(elements[0].offset) == 500 * 4096 &&
+			be64toh(elements[9].packet_seq_num) == 2 * 509,
+			"Read a batch of entries");
+
+	count = lttng_index_file_view_read(&view, ENTRY_COUNT - 3, elements,
+			10);
+	ok(count == 3, "Read a batch of entries at the end of the view");
+
+	count = lttng_index_file_view_read(&view, ENTRY_COUNT, elements, 10);
+	ok(count == 0, "Read no entry past the end of the view");
+
+	lttng_index_file_view_unmap(&view);
+}
+
+static void cleanup(void)
+{
+	char path[PATH_MAX];
+
+	(void) snprintf(path, sizeof(path), "%s/" DEFAULT_INDEX_DIR "/"
+			STREAM_NAME DEFAULT_INDEX_FILE_SUFFIX, test_dir);
+	(void) unlink(path);
+	(void) snprintf(path, sizeof(path), "%s/" DEFAULT_INDEX_DIR,
+			test_dir);
+	(void) rmdir(path);
+	(void) rmdir(test_dir);
+}
+
+int main(void)
+{
+	struct lttng_trace_chunk *chunk;
+
+	plan_tests(TEST_COUNT);
+
+	if (!mkdtemp(test_dir)) {
+		diag("Failed to create temporary directory");
+		return exit_status();
+	}
+
+	chunk = create_chunk();
+	if (!chunk || write_index_file(chunk)) {
+		diag("Failed to write index file");
+		goto end;
+	}
+
+	test_view(chunk);
+end:
+	lttng_trace_chunk_put(chunk);
+	cleanup();
+	return exit_status();
+}
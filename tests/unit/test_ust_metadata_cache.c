@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2020 EfficiOS Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <urcu.h>
+
+#include <common/common.h>
+#include <common/compat/endian.h>
+#include <bin/lttng-sessiond/ust-metadata-cache.h>
+
+#include <tap/tap.h>
+
+#define NUM_TESTS		11
+#define NR_FIELDS		2
+#define FRAGMENT		"event { name = \"provider:event\"; };\n\n"
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+int lttng_opt_mi;
+
+static struct ustctl_field fields[NR_FIELDS];
+static struct ust_registry_channel chan;
+static struct ust_registry_event event;
+static char model_emf_uri[] = "http://example.com/model";
+
+static void init_event(void)
+{
+	strcpy(fields[0].name, "int_field");
+	fields[0].type.atype = ustctl_atype_integer;
+	fields[0].type.u.integer.size = 32;
+	fields[0].type.u.integer.alignment = 8;
+	fields[0].type.u.integer.base = 10;
+	strcpy(fields[1].name, "string_field");
+	fields[1].type.atype = ustctl_atype_string;
+	fields[1].type.u.string.encoding = ustctl_encode_UTF8;
+
+	chan.chan_id = 1;
+	strcpy(event.name, "provider:event");
+	event.id = 42;
+	event.loglevel_value = 13;
+	event.nr_fields = NR_FIELDS;
+	event.fields = fields;
+}
+
+static void test_cache(void)
+{
+	struct ust_metadata_fragment *first, *second, *fragment;
+	struct ust_registry_event other_event;
+	struct ustctl_field other_fields[NR_FIELDS];
+
+	fragment = ust_metadata_cache_lookup(BYTE_ORDER, &chan, &event);
+	ok(!fragment, "Lookup in an empty cache misses");
+
+	first = ust_metadata_cache_add(BYTE_ORDER, &chan, &event, FRAGMENT,
+			strlen(FRAGMENT));
+	ok(first && ust_metadata_fragment_get_len(first) == strlen(FRAGMENT) &&
+			!memcmp(ust_metadata_fragment_get_data(first),
+				FRAGMENT, strlen(FRAGMENT)),
+			"Add a fragment");
+
+	second = ust_metadata_cache_lookup(BYTE_ORDER, &chan, &event);
+	ok(second == first, "Lookup of the same event hits");
+
+	fragment = ust_metadata_cache_add(BYTE_ORDER, &chan, &event, FRAGMENT,
+			strlen(FRAGMENT));
+	ok(fragment == first, "Adding a cached fragment returns the cached fragment");
+	ust_metadata_fragment_put(fragment);
+
+	fragment = ust_metadata_cache_lookup(
+			BYTE_ORDER == LITTLE_ENDIAN ? BIG_ENDIAN : LITTLE_ENDIAN,
+			&chan, &event);
+	ok(!fragment, "Lookup with another byte order misses");
+	ust_metadata_fragment_put(fragment);
+
+	other_event = event;
+	other_event.id++;
+	fragment = ust_metadata_cache_lookup(BYTE_ORDER, &chan, &other_event);
+	ok(!fragment, "Lookup with another event id misses");
+	ust_metadata_fragment_put(fragment);
+
+	other_event = event;
+	other_event.model_emf_uri = model_emf_uri;
+	fragment = ust_metadata_cache_lookup(BYTE_ORDER, &chan, &other_event);
+	ok(!fragment, "Lookup with another model EMF URI misses");
+	ust_metadata_fragment_put(fragment);
+
+	memcpy(other_fields, fields, sizeof(other_fields));
+	other_fields[1].type.u.string.encoding = ustctl_encode_ASCII;
+	other_event = event;
+	other_event.fields = other_fields;
+	fragment = ust_metadata_cache_lookup(BYTE_ORDER, &chan, &other_event);
+	ok(!fragment, "Lookup with another field description misses");
+	ust_metadata_fragment_put(fragment);
+
+	memset(&other_fields[1].type, 0, sizeof(other_fields[1].type));
+	other_fields[1].type.atype = ustctl_atype_enum_nestable;
+	fragment = ust_metadata_cache_add(BYTE_ORDER, &chan, &other_event,
+			FRAGMENT, strlen(FRAGMENT));
+	ok(!fragment, "Events with enumeration fields are not shared");
+	ust_metadata_fragment_put(fragment);
+
+	ust_metadata_fragment_put(first);
+	fragment = ust_metadata_cache_lookup(BYTE_ORDER, &chan, &event);
+	ok(fragment == second, "Fragment is cached while referenced");
+	ust_metadata_fragment_put(fragment);
+
+	ust_metadata_fragment_put(second);
+	fragment = ust_metadata_cache_lookup(BYTE_ORDER, &chan, &event);
+	ok(!fragment, "Fragment is dropped once unreferenced");
+	ust_metadata_fragment_put(fragment);
+}
+
+int main(void)
+{
+	plan_tests(NUM_TESTS);
+
+	rcu_register_thread();
+	init_event();
+	test_cache();
+	rcu_barrier();
+	rcu_unregister_thread();
+
+	return exit_status();
+}
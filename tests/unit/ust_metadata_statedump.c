@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2020 EfficiOS Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ */
+
+/*
+ * UST metadata generation microbenchmark.
+ *
+ * Registers synthetic events in a UST registry session, like the session
+ * daemon does when applications register their events, and generates their
+ * metadata through ust_metadata_event_statedump(). The number of events
+ * registered per second and the size of the generated metadata are reported.
+ *
+ * With --directory, the metadata is also written to a metadata file in that
+ * directory, as it is for the sessions using a shm path.
+ *
+ * Typical use:
+ *   ./ust_metadata_statedump -e 100000 -f 8
+ *   ./ust_metadata_statedump -e 100000 -f 8 -d /dev/shm
+ */
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <urcu.h>
+
+#include <common/common.h>
+#include <common/compat/endian.h>
+#include <common/compat/time.h>
+#include <common/time.h>
+#include <bin/lttng-sessiond/ust-registry.h>
+
+#define DEFAULT_EVENTS			100000
+#define DEFAULT_FIELDS			8
+#define CHANNEL_KEY			0
+#define METADATA_DIR_NAME		"ust-metadata-bench-XXXXXX"
+
+/* Required by the common libraries. */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+int lttng_opt_mi;
+
+static unsigned int opt_events = DEFAULT_EVENTS;
+static unsigned int opt_fields = DEFAULT_FIELDS;
+static const char *opt_directory;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	if (lttng_clock_gettime(CLOCK_MONOTONIC, &ts)) {
+		PERROR("clock_gettime");
+		return 0;
+	}
+	return (uint64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/*
+ * Every other field is an integer, with a string field after each integer,
+ * which covers the two most common field types of the instrumented
+ * applications.
+ */
+static struct ustctl_field *create_fields(void)
+{
+	unsigned int i;
+	struct ustctl_field *fields;
+
+	fields = zmalloc(opt_fields * sizeof(*fields));
+	if (!fields) {
+		return NULL;
+	}
+
+	for (i = 0; i < opt_fields; i++) {
+		struct ustctl_field *field = &fields[i];
+
+		(void) snprintf(field->name, sizeof(field->name),
+				"bench_field_%u", i);
+		if (i % 2) {
+			field->type.atype = ustctl_atype_string;
+			field->type.u.string.encoding = ustctl_encode_UTF8;
+		} else {
+			field->type.atype = ustctl_atype_integer;
+			field->type.u.integer.size = 64;
+			field->type.u.integer.alignment = 8;
+			field->type.u.integer.signedness = 1;
+			field->type.u.integer.base = 10;
+			field->type.u.integer.encoding = ustctl_encode_none;
+		}
+	}
+
+	return fields;
+}
+
+static int register_events(struct ust_registry_session *session,
+		struct ust_registry_channel *chan,
+		struct ustctl_field *fields)
+{
+	int ret = 0;
+	unsigned int i;
+	struct ust_registry_event event = {};
+
+	event.nr_fields = opt_fields;
+	event.fields = fields;
+	event.loglevel_value = 13;
+
+	pthread_mutex_lock(&session->lock);
+	for (i = 0; i < opt_events; i++) {
+		event.id = i;
+		(void) snprintf(event.name, sizeof(event.name),
+				"bench_provider:bench_event_%u", i);
+		ret = ust_metadata_event_statedump(session, chan, &event);
+		if (ret) {
+			fprintf(stderr, "Failed to generate the metadata of event %u (ret = %d)\n",
+					i, ret);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&session->lock);
+	return ret;
+}
+
+static void print_usage(const char *progname)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n\n"
+			"  -e, --events COUNT        Number of events registered (default: %u)\n"
+			"  -f, --fields COUNT        Number of fields per event (default: %u)\n"
+			"  -d, --directory PATH      Also write the metadata to a file in PATH\n",
+			progname, DEFAULT_EVENTS, DEFAULT_FIELDS);
+}
+
+int main(int argc, char **argv)
+{
+	int ret = 0, opt;
+	uint64_t begin_ns, elapsed_ns;
+	size_t session_metadata_len;
+	char shm_path[PATH_MAX] = "";
+	char metadata_path[PATH_MAX] = "";
+	struct ust_registry_session *session = NULL;
+	struct ust_registry_channel *chan;
+	struct ustctl_field *fields = NULL;
+	static const struct option long_options[] = {
+		{ "events", 1, 0, 'e' },
+		{ "fields", 1, 0, 'f' },
+		{ "directory", 1, 0, 'd' },
+		{ "help", 0, 0, 'h' },
+		{ NULL, 0, 0, 0 },
+	};
+
+	while ((opt = getopt_long(argc, argv, "e:f:d:h", long_options,
+			NULL)) != -1) {
+		switch (opt) {
+		case 'e':
+			opt_events = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			opt_fields = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			opt_directory = optarg;
+			break;
+		case 'h':
+			print_usage(argv[0]);
+			return EXIT_SUCCESS;
+		default:
+			print_usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!opt_events || !opt_fields) {
+		print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	rcu_register_thread();
+
+	if (opt_directory) {
+		/* The registry creates its metadata file without a run-as worker. */
+		(void) setenv("LTTNG_DEBUG_NOCLONE", "1", 1);
+		(void) snprintf(shm_path, sizeof(shm_path), "%s/"
+				METADATA_DIR_NAME, opt_directory);
+		if (!mkdtemp(shm_path)) {
+			PERROR("Failed to create metadata directory");
+			shm_path[0] = '\0';
+			ret = -1;
+			goto end;
+		}
+		(void) snprintf(metadata_path, sizeof(metadata_path),
+				"%s/metadata", shm_path);
+	}
+
+	fields = create_fields();
+	if (!fields) {
+		ret = -1;
+		goto end;
+	}
+
+	ret = ust_registry_session_init(&session, NULL, 64, CHAR_BIT, CHAR_BIT,
+			CHAR_BIT, CHAR_BIT, CHAR_BIT, BYTE_ORDER, 2, 12,
+			"", shm_path, geteuid(), getegid(), 0, geteuid());
+	if (ret) {
+		fprintf(stderr, "Failed to create the registry session\n");
+		session = NULL;
+		goto end;
+	}
+
+	ret = ust_registry_channel_add(session, CHANNEL_KEY);
+	if (ret) {
+		fprintf(stderr, "Failed to add the registry channel\n");
+		goto end;
+	}
+
+	rcu_read_lock();
+	chan = ust_registry_channel_find(session, CHANNEL_KEY);
+	rcu_read_unlock();
+	if (!chan) {
+		ret = -1;
+		goto end;
+	}
+
+	session_metadata_len = session->metadata_len;
+	begin_ns = now_ns();
+	ret = register_events(session, chan, fields);
+	elapsed_ns = now_ns() - begin_ns;
+	if (ret) {
+		goto end;
+	}
+
+	printf("events: %u, fields per event: %u, metadata file: %s\n",
+			opt_events, opt_fields,
+			metadata_path[0] ? metadata_path : "none");
+	printf("registered: %.0f events/s, metadata: %zu bytes (%.0f bytes/event)\n",
+			(double) opt_events /
+				((double) elapsed_ns / NSEC_PER_SEC),
+			session->metadata_len,
+			(double) (session->metadata_len -
+				session_metadata_len) / opt_events);
+end:
+	if (session) {
+		ust_registry_session_destroy(session);
+		free(session);
+	}
+	if (metadata_path[0]) {
+		(void) unlink(metadata_path);
+	}
+	if (shm_path[0]) {
+		(void) rmdir(shm_path);
+	}
+	free(fields);
+	rcu_unregister_thread();
+	return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}